@@ -0,0 +1,174 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Confslice - A simple configuration file parser.
+ *
+ * Copyright (C) 2014 Giorgos Kappes <geokapp@gmail.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file LICENSE.
+ *
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <new>
+#include <string>
+
+/*
+ * Every benchmark is a single translation unit, so the global allocation
+ * functions are replaced here to count the heap allocations and frees.
+ */
+static uint64_t g_allocations = 0;
+static uint64_t g_frees = 0;
+
+void *operator new(size_t size) {
+  g_allocations++;
+  if (void *p = malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+  g_frees += p != NULL;
+  free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+  g_frees += p != NULL;
+  free(p);
+}
+
+/*
+ * std::pmr::new_delete_resource() allocates through the aligned forms.
+ */
+void *operator new(size_t size, std::align_val_t align) {
+  g_allocations++;
+  size_t a = (size_t)align;
+  void *p = a <= alignof(max_align_t) ? malloc(size ? size : 1) :
+    aligned_alloc(a, (size + a - 1) / a * a);
+  if (p)
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p, std::align_val_t) noexcept {
+  g_frees += p != NULL;
+  free(p);
+}
+
+void operator delete(void *p, size_t, std::align_val_t) noexcept {
+  g_frees += p != NULL;
+  free(p);
+}
+
+/**
+ * @name allocations - Number of heap allocations so far.
+ */
+static inline uint64_t allocations() {
+  return g_allocations;
+}
+
+/**
+ * @name frees - Number of heap frees so far.
+ */
+static inline uint64_t frees() {
+  return g_frees;
+}
+
+/**
+ * @name now_ns - Monotonic clock in nanoseconds.
+ */
+static inline uint64_t now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @name synthetic_config - Build a synthetic configuration.
+ * @param bytes: The approximate size of the configuration.
+ *
+ * Returns a deterministic configuration text that uses every construct of
+ * the grammar: comments, nested entities, values, arrays, lists and pairs.
+ */
+static inline std::string synthetic_config(size_t bytes) {
+  std::string out;
+  char buf[512];
+
+  out.reserve(bytes + 1024);
+  for (uint32_t i = 0; out.size() < bytes; i++) {
+    snprintf(buf, sizeof(buf),
+	     "// Server %u. This comment is here to look like a real config.\n"
+	     "server%u: {\n"
+	     "\tip = \"10.0.%u.%u\";\n"
+	     "\tport = %u; // The listening port.\n"
+	     "\tports = [%u, %u, %u, %u];\n"
+	     "\tgroups = <1, 2, <3, 4, <5, 6>, 7>, %u>;\n"
+	     "\tdisk: {\n"
+	     "\t\tsize = \"1T\";\n"
+	     "\t\tjournal_size = %u;\n"
+	     "\t};\n"
+	     "};\n"
+	     "key%u = \"value %u\";\n\n",
+	     i, i, (i >> 8) & 255, i & 255, 7000 + i % 1000,
+	     i, i + 1, i + 2, i + 3, i, 10000 + i, i, i);
+    out += buf;
+  }
+  return out;
+}
+
+/**
+ * @name commented_config - Build a comment-heavy configuration.
+ * @param bytes: The approximate size of the configuration.
+ *
+ * Returns a deterministic configuration that is mostly comments, deep
+ * indentation and long strings.
+ */
+static inline std::string commented_config(size_t bytes) {
+  std::string out;
+  char buf[1024];
+
+  out.reserve(bytes + 2048);
+  for (uint32_t i = 0; out.size() < bytes; i++) {
+    snprintf(buf, sizeof(buf),
+	     "////////////////////////////////////////////////////////////////////////\n"
+	     "// Section %u. The settings below control the behaviour of the worker\n"
+	     "// pool. Change them only if you know what you are doing, since bad\n"
+	     "// values can hurt the latency of every request that goes through it.\n"
+	     "////////////////////////////////////////////////////////////////////////\n"
+	     "section%u: {\n"
+	     "                description = \"A rather long description of section %u\";\n"
+	     "                                                                  \n"
+	     "                threads = %u;           // Worker threads.\n"
+	     "                queue = %u;             // Queue depth.\n"
+	     "};\n\n",
+	     i, i, i, i % 64, i % 1024);
+    out += buf;
+  }
+  return out;
+}
+
+/**
+ * @name write_file - Write a string to a file.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static inline int32_t write_file(const std::string &path, const std::string &data) {
+  FILE *f = fopen(path.c_str(), "w");
+  if (!f)
+    return -1;
+  size_t n = fwrite(data.data(), 1, data.size(), f);
+  fclose(f);
+  return n == data.size() ? 0 : -1;
+}
+
+#endif
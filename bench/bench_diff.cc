@@ -0,0 +1,138 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Confslice - A simple configuration file parser.
+ *
+ * Copyright (C) 2014 Giorgos Kappes <geokapp@gmail.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file LICENSE.
+ *
+ */
+
+/*
+ * Diff benchmark: two configurations of the same keys that differ in a
+ * few values, once as entities full of keys and once as a single level of
+ * as many keys. Measures the path that callers take: analyzing and
+ * freezing the new version, which computes the digests, diffing the
+ * frozen trees, which skips the unchanged subtrees and runs of keys, making
+ * and applying a patch, and a Reloader reload that reports the changes.
+ *
+ * Usage: bench_diff [entities] [keys per entity] [changes]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "../src/confslice.h"
+#include "../src/diff.h"
+#include "../src/reload.h"
+#include "bench.h"
+
+using namespace std;
+
+/*
+ * Builds the configuration. Every change bumps the value of a key spread
+ * over the tree. A flat configuration holds every key at the top level.
+ */
+static string make_config(int32_t entities, int32_t keys, int32_t changes, bool flat) {
+  string out;
+  int64_t total = (int64_t)entities * keys;
+  int64_t step = changes ? total / changes : 0;
+
+  out.reserve(total * 16);
+  for (int32_t e = 0; e < entities; e++) {
+    if (!flat)
+      out += "entity" + to_string(e) + ": {\n";
+    for (int32_t k = 0; k < keys; k++) {
+      int64_t n = (int64_t)e * keys + k;
+      out += "\tkey" + to_string(flat ? n : k) + " = " +
+	to_string(step && n % step == 0 ? n + 1 : n) + ";\n";
+    }
+    if (!flat)
+      out += "};\n";
+  }
+  return out;
+}
+
+/*
+ * Runs the measurements on one shape.
+ */
+static int32_t run(const char *shape, int32_t entities, int32_t keys, int32_t changes, bool flat) {
+  string from_text = make_config(entities, keys, 0, flat);
+  string to_text = make_config(entities, keys, changes, flat);
+  ConfSlice from(ConfSlice::arena_mem), to(ConfSlice::arena_mem), copy;
+
+  printf("%s: %lld keys, %d changed keys\n", shape, (long long)entities * keys, changes);
+  if (from.analyze_buffer(from_text) || copy.analyze_buffer(from_text)) {
+    fprintf(stderr, "Analysis failed\n");
+    return 1;
+  }
+  from.configuration()->freeze();
+
+  uint64_t start = now_ns();
+  if (to.analyze_buffer(to_text)) {
+    fprintf(stderr, "Analysis failed\n");
+    return 1;
+  }
+  printf("  analyze      %10.3f ms\n", (now_ns() - start) / 1e6);
+  start = now_ns();
+  to.configuration()->freeze();
+  printf("  freeze       %10.3f ms\n", (now_ns() - start) / 1e6);
+
+  vector<Change> found;
+  start = now_ns();
+  if (diff(from.configuration(), to.configuration(), found)) {
+    fprintf(stderr, "Diff failed\n");
+    return 1;
+  }
+  printf("  diff         %10.3f ms %zu changes\n", (now_ns() - start) / 1e6, found.size());
+
+  Patch patch;
+  start = now_ns();
+  patch.make(from.configuration(), to.configuration());
+  printf("  patch make   %10.3f ms %zu operations\n", (now_ns() - start) / 1e6, patch.size());
+  start = now_ns();
+  int32_t result = patch.apply(copy.configuration());
+  printf("  patch apply  %10.3f ms\n", (now_ns() - start) / 1e6);
+  if (result || (int32_t)found.size() != changes) {
+    fprintf(stderr, "Unexpected result\n");
+    return 1;
+  }
+
+  string file = "/tmp/confslice_bench_diff.cfg";
+  Reloader reloader(file);
+  size_t reported = 0;
+  if (write_file(file, from_text) || reloader.reload() || write_file(file, to_text)) {
+    fprintf(stderr, "Reload failed\n");
+    unlink(file.c_str());
+    return 1;
+  }
+  start = now_ns();
+  result = reloader.reload([&](const Change &) { reported++; });
+  printf("  reload       %10.3f ms %zu changes\n", (now_ns() - start) / 1e6, reported);
+  unlink(file.c_str());
+  if (result || (int32_t)reported != changes) {
+    fprintf(stderr, "Unexpected reload\n");
+    return 1;
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  int32_t entities = 10000, keys = 100, changes = 5;
+
+  if (argc > 1)
+    entities = atoi(argv[1]);
+  if (argc > 2)
+    keys = atoi(argv[2]);
+  if (argc > 3)
+    changes = atoi(argv[3]);
+  if (run("nested", entities, keys, changes, false) || run("flat", entities, keys, changes, true))
+    return 1;
+  return 0;
+}
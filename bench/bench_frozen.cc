@@ -0,0 +1,79 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Confslice - A simple configuration file parser.
+ *
+ * Copyright (C) 2014 Giorgos Kappes <geokapp@gmail.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file LICENSE.
+ *
+ */
+
+/*
+ * Concurrent read benchmark: lookups per second on a frozen synthetic
+ * configuration by 1, 2, 4, ... threads up to the CPU count, or up to max
+ * threads. Every thread reads keys of different servers by their
+ * precompiled paths.
+ *
+ * Usage: bench_frozen [reads per thread] [max threads]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../src/confslice.h"
+#include "bench.h"
+
+using namespace std;
+
+int main(int argc, char *argv[]) {
+  int64_t reads = 5000000;
+  int32_t cpus = thread::hardware_concurrency();
+  const int32_t servers = 1000;
+
+  if (argc > 1)
+    reads = atoll(argv[1]);
+  if (argc > 2)
+    cpus = atoi(argv[2]);
+  ConfSlice cs;
+  if (cs.analyze_buffer(synthetic_config(512 << 10))) {
+    fprintf(stderr, "Analysis failed\n");
+    return 1;
+  }
+  const Configuration *conf = cs.configuration()->freeze();
+  vector<Path> paths;
+  for (int32_t i = 0; i < servers; i++)
+    paths.push_back(Path("server" + to_string(i) + ".disk.journal_size"));
+  if (conf->get<int64_t>(paths.back(), -1) < 0) {
+    fprintf(stderr, "Configuration too small\n");
+    return 1;
+  }
+
+  printf("%lld reads per thread\n", (long long)reads);
+  double single = 0;
+  for (int32_t threads = 1; threads <= (cpus > 1 ? cpus : 1); threads *= 2) {
+    vector<thread> pool;
+    vector<int64_t> sums(threads * 8);
+    uint64_t start = now_ns();
+    for (int32_t t = 0; t < threads; t++)
+      pool.emplace_back([&, t]() {
+	  int64_t sum = 0;
+	  for (int64_t i = 0; i < reads; i++)
+	    sum += conf->get<int64_t>(paths[(i * 7 + t) % servers], 0);
+	  sums[t * 8] = sum;
+	});
+    for (thread &t : pool)
+      t.join();
+    uint64_t elapsed = now_ns() - start;
+    double rate = (double)reads * threads / elapsed * 1e3;
+    if (threads == 1)
+      single = rate;
+    printf("%2d threads %10.2f M reads/s %6.2fx\n", threads, rate, rate / single);
+  }
+  return 0;
+}
@@ -0,0 +1,95 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Confslice - A simple configuration file parser.
+ *
+ * Copyright (C) 2014 Giorgos Kappes <geokapp@gmail.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file LICENSE.
+ *
+ */
+
+/*
+ * Lexer throughput for each input mode of LexAnalyzer.
+ *
+ * Usage: bench_input [file] [rounds]
+ * Without a file, a synthetic 16MB configuration is generated.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string>
+#include "../src/lex.h"
+#include "bench.h"
+
+using namespace std;
+
+static int32_t lex_all(const string &file, LexAnalyzer::Input input, uint64_t *tokens) {
+  LexAnalyzer lex;
+  string_view word;
+  int32_t id;
+
+  if (lex.open(file, input))
+    return -1;
+  *tokens = 0;
+  while ((id = lex.analyze(word)) != EOF_TK) {
+    if (id < 0)
+      return -1;
+    (*tokens)++;
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  string file = "/tmp/confslice_bench_input.cfg";
+  int32_t rounds = 5;
+  size_t bytes;
+
+  if (argc > 1 && argv[1][0]) {
+    file = argv[1];
+  } else if (write_file(file, synthetic_config(16 << 20))) {
+    fprintf(stderr, "Cannot write %s\n", file.c_str());
+    return 1;
+  }
+  if (argc > 2)
+    rounds = atoi(argv[2]);
+
+  FILE *f = fopen(file.c_str(), "r");
+  if (!f) {
+    fprintf(stderr, "Cannot open %s\n", file.c_str());
+    return 1;
+  }
+  fseek(f, 0, SEEK_END);
+  bytes = ftell(f);
+  fclose(f);
+
+  const struct {
+    const char *name;
+    LexAnalyzer::Input input;
+  } modes[] = {
+    {"stdio", LexAnalyzer::stdio_in},
+    {"read", LexAnalyzer::read_in},
+    {"mmap", LexAnalyzer::mmap_in},
+  };
+
+  printf("%s: %zu bytes, best of %d rounds\n", file.c_str(), bytes, rounds);
+  for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+    uint64_t best = ~0ULL, tokens = 0;
+    for (int32_t r = 0; r < rounds; r++) {
+      uint64_t start = now_ns();
+      if (lex_all(file, modes[m].input, &tokens)) {
+	fprintf(stderr, "%s: lexical analysis failed\n", modes[m].name);
+	return 1;
+      }
+      uint64_t elapsed = now_ns() - start;
+      if (elapsed < best)
+	best = elapsed;
+    }
+    printf("%-6s %10.2f ms %10.2f MB/s %12llu tokens\n", modes[m].name, best / 1e6,
+	   (bytes / 1048576.0) / (best / 1e9), (unsigned long long)tokens);
+  }
+  return 0;
+}
@@ -0,0 +1,94 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Confslice - A simple configuration file parser.
+ *
+ * Copyright (C) 2014 Giorgos Kappes <geokapp@gmail.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file LICENSE.
+ *
+ */
+
+/*
+ * Lexer microbenchmark: tokens per second over an in-memory buffer, so
+ * that no I/O is measured. The input is lexed once for every SIMD level
+ * that the CPU supports.
+ *
+ * Usage: bench_lex [file] [rounds]
+ * Without a file, a synthetic 16MB configuration and a comment-heavy 16MB
+ * configuration are generated.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string>
+#include "../src/lex.h"
+#include "../src/scan.h"
+#include "bench.h"
+
+using namespace std;
+
+static int32_t run(const char *name, const string &text, int32_t rounds) {
+  static const char *levels[] = {"scalar", "sse2", "avx2"};
+
+  printf("%s: %zu bytes, best of %d rounds\n", name, text.size(), rounds);
+  for (int32_t level = SCAN_SCALAR; level <= SCAN_AVX2; level++) {
+    if (scan_set_level(level))
+      break;
+
+    uint64_t best = ~0ULL, tokens = 0;
+    for (int32_t r = 0; r < rounds; r++) {
+      LexAnalyzer lex;
+      string_view word;
+      int32_t id;
+
+      lex.open_buffer(text.data(), text.size());
+      tokens = 0;
+      uint64_t start = now_ns();
+      while ((id = lex.analyze(word)) != EOF_TK) {
+	if (id < 0) {
+	  fprintf(stderr, "Lexical analysis failed\n");
+	  return -1;
+	}
+	tokens++;
+      }
+      uint64_t elapsed = now_ns() - start;
+      if (elapsed < best)
+	best = elapsed;
+    }
+    printf("%-6s %10.2f ms %10.2f MB/s %10.2f Mtokens/s %8.2f ns/token\n", levels[level],
+	   best / 1e6, (text.size() / 1048576.0) / (best / 1e9), tokens / (best / 1e3),
+	   (double)best / tokens);
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  int32_t rounds = 5;
+
+  if (argc > 2)
+    rounds = atoi(argv[2]);
+
+  if (argc > 1 && argv[1][0]) {
+    string text;
+    FILE *f = fopen(argv[1], "r");
+    if (!f) {
+      fprintf(stderr, "Cannot open %s\n", argv[1]);
+      return 1;
+    }
+    char buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+      text.append(buf, n);
+    fclose(f);
+    return run(argv[1], text, rounds) ? 1 : 0;
+  }
+  if (run("synthetic", synthetic_config(16 << 20), rounds))
+    return 1;
+  if (run("commented", commented_config(16 << 20), rounds))
+    return 1;
+  return 0;
+}
@@ -0,0 +1,99 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Confslice - A simple configuration file parser.
+ *
+ * Copyright (C) 2014 Giorgos Kappes <geokapp@gmail.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file LICENSE.
+ *
+ */
+
+/*
+ * Nested list benchmark: parse time, allocations and read time of keys
+ * whose values are deeply nested lists, e.g. <1, <2, <3, ...>, 3>, 2>.
+ *
+ * Usage: bench_list [depth] [keys] [rounds]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string>
+#include "../src/confslice.h"
+#include "bench.h"
+
+using namespace std;
+
+/*
+ * Builds a list with the given depth. Every level holds two values around
+ * its sub-list.
+ */
+static void nested_list(string &out, int32_t depth) {
+  out += "<" + to_string(depth) + ", ";
+  if (depth > 1) {
+    nested_list(out, depth - 1);
+    out += ", ";
+  }
+  out += to_string(depth) + ">";
+}
+
+/*
+ * Sums every value of a list and of its sub-lists through the views.
+ */
+template <typename L>
+static int64_t sum(const L &klist) {
+  int64_t total = 0;
+  for (const Data &data : klist.data())
+    total += data.template data<int64_t>();
+  for (const auto &sub : klist.klists())
+    total += sum(sub);
+  return total;
+}
+
+int main(int argc, char *argv[]) {
+  int32_t depth = 64, keys = 2000, rounds = 5;
+  string text;
+
+  if (argc > 1)
+    depth = atoi(argv[1]);
+  if (argc > 2)
+    keys = atoi(argv[2]);
+  if (argc > 3)
+    rounds = atoi(argv[3]);
+  for (int32_t i = 0; i < keys; i++) {
+    text += "list" + to_string(i) + " = ";
+    nested_list(text, depth);
+    text += ";\n";
+  }
+
+  printf("%d keys of depth %d: %zu bytes, best of %d rounds\n", keys, depth, text.size(), rounds);
+  uint64_t best = ~0ULL, best_read = ~0ULL, allocs = 0;
+  int64_t total = 0;
+  for (int32_t r = 0; r < rounds; r++) {
+    ConfSlice cs;
+    uint64_t start_allocs = allocations();
+    uint64_t start = now_ns();
+    int32_t result = cs.analyze_buffer(text);
+    uint64_t elapsed = now_ns() - start;
+    allocs = allocations() - start_allocs;
+    if (result) {
+      fprintf(stderr, "Analysis failed\n");
+      return 1;
+    }
+    start = now_ns();
+    total = 0;
+    for (const Key *key : cs.configuration()->keys())
+      total += sum(*(const KList *)key);
+    uint64_t elapsed_read = now_ns() - start;
+    if (elapsed < best)
+      best = elapsed;
+    if (elapsed_read < best_read)
+      best_read = elapsed_read;
+  }
+  printf("parse %10.2f ms %12llu allocations\n", best / 1e6, (unsigned long long)allocs);
+  printf("read  %10.2f ms (sum %lld)\n", best_read / 1e6, (long long)total);
+  return 0;
+}
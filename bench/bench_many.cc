@@ -0,0 +1,97 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Confslice - A simple configuration file parser.
+ *
+ * Copyright (C) 2014 Giorgos Kappes <geokapp@gmail.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file LICENSE.
+ *
+ */
+
+/*
+ * Multi-file loading benchmark: time to load a generated directory of
+ * small configuration files with one ConfSlice per file, and with
+ * ConfSlice::analyze_many() on 1, 2, 4, ... threads up to the CPU count.
+ *
+ * Usage: bench_many [files] [kilobytes per file] [rounds]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../src/confslice.h"
+#include "bench.h"
+
+using namespace std;
+
+int main(int argc, char *argv[]) {
+  const string dir = "/tmp/confslice_bench_many";
+  int32_t files = 400, kilobytes = 16, rounds = 5;
+  vector<string> filenames;
+
+  if (argc > 1)
+    files = atoi(argv[1]);
+  if (argc > 2)
+    kilobytes = atoi(argv[2]);
+  if (argc > 3)
+    rounds = atoi(argv[3]);
+  mkdir(dir.c_str(), 0755);
+  for (int32_t i = 0; i < files; i++) {
+    string text = synthetic_config(kilobytes << 10);
+    // Keep the 1-level IDs of the files apart.
+    text = "file" + to_string(i) + ": {\n" + text + "};\n";
+    filenames.push_back(dir + "/" + to_string(i) + ".cfg");
+    if (write_file(filenames.back(), text)) {
+      fprintf(stderr, "Cannot write %s\n", filenames.back().c_str());
+      return 1;
+    }
+  }
+
+  printf("%s: %d files of %d KB, best of %d rounds\n", dir.c_str(), files, kilobytes, rounds);
+  uint64_t best = ~0ULL, serial;
+  for (int32_t r = 0; r < rounds; r++) {
+    vector<ConfSlice *> slices;
+    uint64_t start = now_ns();
+    for (const string &filename : filenames) {
+      slices.push_back(new ConfSlice);
+      if (slices.back()->analyze(filename)) {
+	fprintf(stderr, "Analysis failed\n");
+	return 1;
+      }
+    }
+    uint64_t elapsed = now_ns() - start;
+    for (ConfSlice *cs : slices)
+      delete cs;
+    if (elapsed < best)
+      best = elapsed;
+  }
+  serial = best;
+  printf("%-22s %10.2f ms\n", "one ConfSlice per file", best / 1e6);
+
+  int32_t cpus = thread::hardware_concurrency();
+  for (int32_t threads = 1; threads <= (cpus > 1 ? cpus : 1); threads *= 2) {
+    best = ~0ULL;
+    for (int32_t r = 0; r < rounds; r++) {
+      ConfSlice cs;
+      uint64_t start = now_ns();
+      int32_t result = cs.analyze_many(filenames, threads);
+      uint64_t elapsed = now_ns() - start;
+      if (result || cs.configuration()->size_of_entities() != files) {
+	fprintf(stderr, "Analysis failed\n");
+	return 1;
+      }
+      if (elapsed < best)
+	best = elapsed;
+    }
+    printf("analyze_many %2d threads %10.2f ms %6.2fx\n", threads, best / 1e6,
+	   (double)serial / best);
+  }
+  return 0;
+}
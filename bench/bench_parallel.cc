@@ -0,0 +1,83 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Confslice - A simple configuration file parser.
+ *
+ * Copyright (C) 2014 Giorgos Kappes <geokapp@gmail.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file LICENSE.
+ *
+ */
+
+/*
+ * Parallel parsing benchmark: time to analyze one large synthetic
+ * configuration serially, and with ConfSlice::analyze_buffer_parallel() on
+ * 1, 2, 4, ... threads up to the CPU count, or up to max threads, in heap
+ * and arena mode.
+ *
+ * Usage: bench_parallel [megabytes] [rounds] [max threads]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include "../src/confslice.h"
+#include "bench.h"
+
+using namespace std;
+
+/*
+ * Returns the best time of a number of analyses.
+ */
+template <typename F>
+static uint64_t best_of(int32_t rounds, ConfSlice::Memory memory, F analyze) {
+  uint64_t best = ~0ULL;
+  for (int32_t r = 0; r < rounds; r++) {
+    ConfSlice cs(memory);
+    uint64_t start = now_ns();
+    int32_t result = analyze(cs);
+    uint64_t elapsed = now_ns() - start;
+    if (result) {
+      fprintf(stderr, "Analysis failed\n");
+      exit(1);
+    }
+    if (elapsed < best)
+      best = elapsed;
+  }
+  return best;
+}
+
+int main(int argc, char *argv[]) {
+  int32_t megabytes = 16, rounds = 5;
+  int32_t cpus = thread::hardware_concurrency();
+
+  if (argc > 1)
+    megabytes = atoi(argv[1]);
+  if (argc > 2)
+    rounds = atoi(argv[2]);
+  if (argc > 3)
+    cpus = atoi(argv[3]);
+  string text = synthetic_config((size_t)megabytes << 20);
+
+  printf("%zu bytes, best of %d rounds\n", text.size(), rounds);
+  for (int32_t memory = 0; memory < 2; memory++) {
+    ConfSlice::Memory mode = memory ? ConfSlice::arena_mem : ConfSlice::heap_mem;
+    const char *name = memory ? "arena" : "heap";
+    uint64_t serial = best_of(rounds, mode, [&](ConfSlice &cs) {
+	return cs.analyze_buffer(text);
+      });
+    printf("%-5s serial            %10.2f ms\n", name, serial / 1e6);
+    for (int32_t threads = 1; threads <= (cpus > 1 ? cpus : 1); threads *= 2) {
+      uint64_t best = best_of(rounds, mode, [&](ConfSlice &cs) {
+	  return cs.analyze_buffer_parallel(text, threads);
+	});
+      printf("%-5s parallel %2d threads %10.2f ms %6.2fx\n", name, threads, best / 1e6,
+	     (double)serial / best);
+    }
+  }
+  return 0;
+}
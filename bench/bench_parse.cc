@@ -0,0 +1,96 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Confslice - A simple configuration file parser.
+ *
+ * Copyright (C) 2014 Giorgos Kappes <geokapp@gmail.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file LICENSE.
+ *
+ */
+
+/*
+ * Full parse throughput of ConfSlice::analyze() on a file and of
+ * ConfSlice::analyze_buffer() on the same text held in memory, with the
+ * tree on the heap and in an arena, and the cost of tearing it down.
+ *
+ * Usage: bench_parse [file] [rounds]
+ * Without a file, a synthetic 2MB configuration is generated.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string>
+#include "../src/confslice.h"
+#include "bench.h"
+
+using namespace std;
+
+int main(int argc, char *argv[]) {
+  string file = "/tmp/confslice_bench_parse.cfg";
+  string text;
+  int32_t rounds = 5;
+
+  if (argc > 1 && argv[1][0]) {
+    file = argv[1];
+    FILE *f = fopen(file.c_str(), "r");
+    if (!f) {
+      fprintf(stderr, "Cannot open %s\n", file.c_str());
+      return 1;
+    }
+    char buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+      text.append(buf, n);
+    fclose(f);
+  } else {
+    text = synthetic_config(2 << 20);
+    if (write_file(file, text)) {
+      fprintf(stderr, "Cannot write %s\n", file.c_str());
+      return 1;
+    }
+  }
+  if (argc > 2)
+    rounds = atoi(argv[2]);
+
+  static const struct {
+    const char *name;
+    bool buffer;
+    ConfSlice::Memory memory;
+  } modes[] = {
+    {"file", false, ConfSlice::heap_mem},
+    {"buffer", true, ConfSlice::heap_mem},
+    {"arena", true, ConfSlice::arena_mem},
+  };
+
+  printf("%s: %zu bytes, best of %d rounds\n", file.c_str(), text.size(), rounds);
+  for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+    uint64_t best = ~0ULL, best_free = ~0ULL, allocs = 0;
+    for (int32_t r = 0; r < rounds; r++) {
+      uint64_t start_allocs = allocations();
+      ConfSlice *cs = new ConfSlice(modes[m].memory);
+      uint64_t start = now_ns();
+      int32_t result = modes[m].buffer ? cs->analyze_buffer(text) : cs->analyze(file);
+      uint64_t elapsed = now_ns() - start;
+      allocs = allocations() - start_allocs;
+      start = now_ns();
+      delete cs;
+      uint64_t elapsed_free = now_ns() - start;
+      if (result) {
+	fprintf(stderr, "Analysis failed\n");
+	return 1;
+      }
+      if (elapsed < best)
+	best = elapsed;
+      if (elapsed_free < best_free)
+	best_free = elapsed_free;
+    }
+    printf("%-8s %10.2f ms %10.2f MB/s %12llu allocations %10.2f ms teardown\n", modes[m].name,
+	   best / 1e6, (text.size() / 1048576.0) / (best / 1e9), (unsigned long long)allocs,
+	   best_free / 1e6);
+  }
+  return 0;
+}
@@ -0,0 +1,123 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Confslice - A simple configuration file parser.
+ *
+ * Copyright (C) 2014 Giorgos Kappes <geokapp@gmail.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file LICENSE.
+ *
+ */
+
+/*
+ * Read path microbenchmark: nanoseconds and allocations per read of a
+ * value that is already parsed, per element of a 10000 element array, and
+ * per lookup of a key by its dotted path or through a handle.
+ *
+ * Usage: bench_read [reads]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string>
+#include "../src/confslice.h"
+#include "bench.h"
+
+using namespace std;
+
+static const char text[] =
+  "server: {\n"
+  "\tport = 7000;\n"
+  "\tratio = 0.75;\n"
+  "\tname = \"blade\";\n"
+  "};\n"
+  "data_server: {\n"
+  "\tdisk.1: {\n"
+  "\t\tjournal_size = 10000;\n"
+  "\t};\n"
+  "};\n";
+
+/*
+ * Runs a read loop and prints its cost. The sink keeps the compiler from
+ * removing the reads.
+ */
+template <typename F>
+static void run(const char *name, int64_t reads, F read, int64_t items = 1) {
+  volatile double sink = 0;
+  uint64_t start_allocs = allocations();
+  uint64_t start = now_ns();
+  for (int64_t i = 0; i < reads; i++)
+    sink = sink + read();
+  uint64_t elapsed = now_ns() - start;
+  printf("%-24s %8.2f ns/read %8.2f allocations/read\n", name,
+	 (double)elapsed / reads / items, (double)(allocations() - start_allocs) / reads / items);
+}
+
+int main(int argc, char *argv[]) {
+  int64_t reads = 10000000;
+  const int32_t items = 10000;
+  ConfSlice cs;
+  string config = text;
+
+  if (argc > 1)
+    reads = atoll(argv[1]);
+  config += "weights = [0";
+  for (int32_t i = 1; i < items; i++)
+    config += ", " + to_string(i);
+  config += "];\n";
+  if (cs.analyze_buffer(config)) {
+    fprintf(stderr, "Analysis failed\n");
+    return 1;
+  }
+  Entity *server = cs.configuration()->find_entity("server");
+  const Data &port = ((KValue *)server->find_key("port"))->value();
+  const Data &ratio = ((KValue *)server->find_key("ratio"))->value();
+
+  printf("%lld reads\n", (long long)reads);
+  run("data<int32_t>()", reads, [&]() { return port.data<int32_t>(); });
+  run("as_int64()", reads, [&]() { int64_t v = 0; port.as_int64(v); return v; });
+  run("data<double>()", reads, [&]() { return ratio.data<double>(); });
+  run("as_double()", reads, [&]() { double v = 0; ratio.as_double(v); return v; });
+
+  const KArray *weights = (const KArray *)cs.configuration()->find_key("weights");
+  int64_t rounds = reads / items + 1;
+  run("array at()", rounds, [&]() {
+      int64_t sum = 0, v = 0;
+      for (int32_t i = 0; i < items; i++)
+	if (!weights->at(i, v))
+	  sum += v;
+      return sum;
+    }, items);
+  run("array as_int64_span()", rounds, [&]() {
+      int64_t sum = 0;
+      Span<int64_t> values;
+      if (!weights->as_int64_span(values))
+	for (int64_t v : values)
+	  sum += v;
+      return sum;
+    }, items);
+
+  const Configuration *conf = cs.configuration();
+  const string data_server = "data_server", disk = "disk.1", journal_size = "journal_size";
+  run("manual traversal", reads, [&]() {
+      int64_t v = 0;
+      const Entity *e = conf->find_entity(data_server);
+      if (e)
+	e = e->find_entity(disk);
+      const Key *key = e ? e->find_key(journal_size) : NULL;
+      if (key && key->type() == Key::value_t)
+	((const KValue *)key)->value().as_int64(v);
+      return v;
+    });
+  run("get<int64_t>(string)", reads, [&]() {
+      return conf->get<int64_t>("data_server.\"disk.1\".journal_size", 0);
+    });
+  Path path("data_server.\"disk.1\".journal_size");
+  run("get<int64_t>(Path)", reads, [&]() { return conf->get<int64_t>(path, 0); });
+  Handle handle = conf->handle("data_server.\"disk.1\".journal_size");
+  run("handle get<int64_t>()", reads, [&]() { return handle.get<int64_t>(0); });
+  return 0;
+}
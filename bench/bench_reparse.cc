@@ -0,0 +1,94 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Confslice - A simple configuration file parser.
+ *
+ * Copyright (C) 2014 Giorgos Kappes <geokapp@gmail.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file LICENSE.
+ *
+ */
+
+/*
+ * Incremental reparse benchmark: a synthetic configuration is analyzed in
+ * full, then reanalyzed after edits to a growing number of servers. Every
+ * edit changes the port of one server.
+ *
+ * Usage: bench_reparse [megabytes] [rounds]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string>
+#include "../src/confslice.h"
+#include "bench.h"
+
+using namespace std;
+
+/*
+ * Changes the port of every step-th server, the round-th time.
+ */
+static string edit(const string &text, int32_t step, int32_t round) {
+  string out = text;
+  int32_t n = 0;
+  for (size_t pos = out.find("\tport = "); pos != string::npos;
+       pos = out.find("\tport = ", pos + 1))
+    if (n++ % step == 0)
+      out[pos + 8] = '1' + round % 8;
+  return out;
+}
+
+int main(int argc, char *argv[]) {
+  size_t megabytes = 16;
+  int32_t rounds = 5;
+
+  if (argc > 1)
+    megabytes = atoi(argv[1]);
+  if (argc > 2)
+    rounds = atoi(argv[2]);
+  string text = synthetic_config(megabytes << 20);
+  printf("%zu bytes\n", text.size());
+
+  uint64_t best = ~0ULL;
+  for (int32_t r = 0; r < rounds; r++) {
+    ConfSlice cs(ConfSlice::arena_mem);
+    uint64_t start = now_ns();
+    if (cs.analyze_buffer(text)) {
+      fprintf(stderr, "Analysis failed\n");
+      return 1;
+    }
+    uint64_t elapsed = now_ns() - start;
+    best = elapsed < best ? elapsed : best;
+  }
+  printf("analyze            %10.3f ms\n", best / 1e6);
+
+  ConfSlice cs;
+  uint64_t start = now_ns();
+  if (cs.reanalyze_buffer(text)) {
+    fprintf(stderr, "Analysis failed\n");
+    return 1;
+  }
+  printf("first reanalyze    %10.3f ms\n", (now_ns() - start) / 1e6);
+  start = now_ns();
+  cs.reanalyze_buffer(text);
+  printf("unchanged          %10.3f ms\n", (now_ns() - start) / 1e6);
+
+  for (int32_t step : {1000000, 10000, 100, 1}) {
+    best = ~0ULL;
+    for (int32_t r = 0; r < rounds; r++) {
+      string edited = edit(text, step, r);
+      start = now_ns();
+      if (cs.reanalyze_buffer(edited)) {
+	fprintf(stderr, "Analysis failed\n");
+	return 1;
+      }
+      uint64_t elapsed = now_ns() - start;
+      best = elapsed < best ? elapsed : best;
+    }
+    printf("1 in %-7d edited %10.3f ms\n", step, best / 1e6);
+  }
+  return 0;
+}
@@ -0,0 +1,110 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Confslice - A simple configuration file parser.
+ *
+ * Copyright (C) 2014 Giorgos Kappes <geokapp@gmail.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file LICENSE.
+ *
+ */
+
+/*
+ * Startup benchmark: time and allocations to get a queryable configuration
+ * by parsing the text file and by loading its compiled snapshot, with and
+ * without checksum verification, and the cost of a path lookup in each.
+ *
+ * Usage: bench_snapshot [megabytes] [rounds]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string>
+#include "../src/confslice.h"
+#include "bench.h"
+
+using namespace std;
+
+int main(int argc, char *argv[]) {
+  const string file = "/tmp/confslice_bench_snapshot.cfg";
+  const string snap = "/tmp/confslice_bench_snapshot.snap";
+  size_t megabytes = 16;
+  int32_t rounds = 5;
+
+  if (argc > 1)
+    megabytes = atoi(argv[1]);
+  if (argc > 2)
+    rounds = atoi(argv[2]);
+  string text = synthetic_config(megabytes << 20);
+  if (write_file(file, text)) {
+    fprintf(stderr, "Cannot write %s\n", file.c_str());
+    return 1;
+  }
+  {
+    ConfSlice cs;
+    if (cs.analyze(file) || Snapshot::compile(cs.configuration(), snap)) {
+      fprintf(stderr, "Compilation failed\n");
+      return 1;
+    }
+  }
+
+  printf("%s: %zu bytes, best of %d rounds\n", file.c_str(), text.size(), rounds);
+  uint64_t best = ~0ULL, allocs = 0;
+  for (int32_t r = 0; r < rounds; r++) {
+    ConfSlice cs(ConfSlice::arena_mem);
+    uint64_t start_allocs = allocations();
+    uint64_t start = now_ns();
+    int32_t result = cs.analyze(file);
+    uint64_t elapsed = now_ns() - start;
+    allocs = allocations() - start_allocs;
+    if (result || cs.configuration()->get<int64_t>("server7.disk.journal_size", 0) != 10007) {
+      fprintf(stderr, "Analysis failed\n");
+      return 1;
+    }
+    if (elapsed < best)
+      best = elapsed;
+  }
+  printf("%-16s %10.3f ms %12llu allocations\n", "parse (arena)", best / 1e6,
+	 (unsigned long long)allocs);
+
+  for (int32_t verify = 1; verify >= 0; verify--) {
+    best = ~0ULL;
+    for (int32_t r = 0; r < rounds; r++) {
+      Snapshot snapshot;
+      uint64_t start_allocs = allocations();
+      uint64_t start = now_ns();
+      int32_t result = snapshot.open(snap, verify);
+      uint64_t elapsed = now_ns() - start;
+      allocs = allocations() - start_allocs;
+      if (result || snapshot.get<int64_t>("server7.disk.journal_size", 0) != 10007) {
+	fprintf(stderr, "Load failed\n");
+	return 1;
+      }
+      if (elapsed < best)
+	best = elapsed;
+    }
+    printf("%-16s %10.3f ms %12llu allocations\n", verify ? "snapshot" : "snapshot (trust)",
+	   best / 1e6, (unsigned long long)allocs);
+  }
+
+  ConfSlice cs;
+  Snapshot snapshot;
+  cs.analyze(file);
+  snapshot.open(snap);
+  const int64_t reads = 1000000;
+  volatile int64_t sink = 0;
+  uint64_t start = now_ns();
+  for (int64_t i = 0; i < reads; i++)
+    sink = sink + cs.configuration()->get<int64_t>("server7.disk.journal_size", 0);
+  uint64_t tree = now_ns() - start;
+  start = now_ns();
+  for (int64_t i = 0; i < reads; i++)
+    sink = sink + snapshot.get<int64_t>("server7.disk.journal_size", 0);
+  uint64_t mapped = now_ns() - start;
+  printf("get() %8.2f ns on the tree, %8.2f ns on the snapshot\n", (double)tree / reads,
+	 (double)mapped / reads);
+  return 0;
+}
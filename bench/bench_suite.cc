@@ -0,0 +1,253 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Confslice - A simple configuration file parser.
+ *
+ * Copyright (C) 2014 Giorgos Kappes <geokapp@gmail.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file LICENSE.
+ *
+ */
+
+/*
+ * End-to-end benchmark suite, run by "make bench". Every profile is a
+ * generated configuration of a different shape. For each one, the suite
+ * measures the lexical analyzer alone on the text in memory, analyze() on
+ * the file with the tree on the heap and in an arena, and the teardown of
+ * each tree. Every phase reports its time, MB/s, tokens/s, heap
+ * allocations and frees, and the peak resident set size.
+ *
+ * The results are written to stdout as JSON and a summary to stderr.
+ *
+ * Usage: bench_suite [rounds] [scale %]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <string>
+#include <vector>
+#include "../src/confslice.h"
+#include "../src/lex.h"
+#include "bench.h"
+#include "generate.h"
+
+using namespace std;
+
+/*
+ * The outcome of a phase: the best time of the rounds, and the counters
+ * and peak memory of the last round. The growth is the peak resident set
+ * size less the resident set size at the start of the phase.
+ */
+struct Phase {
+  const char *name;
+  uint64_t ns;
+  uint64_t allocations;
+  uint64_t frees;
+  uint64_t peak_rss_kb;
+  uint64_t rss_growth_kb;
+};
+
+/*
+ * Reads a "Name: value kB" line of /proc/self/status.
+ */
+static uint64_t status_kb(const char *name) {
+  FILE *f = fopen("/proc/self/status", "r");
+  char line[256];
+  uint64_t kb = 0;
+  size_t len = strlen(name);
+
+  if (!f)
+    return 0;
+  while (fgets(line, sizeof(line), f))
+    if (!strncmp(line, name, len) && line[len] == ':')
+      kb = strtoull(line + len + 1, NULL, 10);
+  fclose(f);
+  return kb;
+}
+
+/*
+ * Resets the peak resident set size to the current one, where the kernel
+ * allows it. Otherwise the peak is that of the whole process.
+ */
+static void reset_peak_rss() {
+  FILE *f = fopen("/proc/self/clear_refs", "w");
+  if (f) {
+    fputs("5", f);
+    fclose(f);
+  }
+}
+
+static uint64_t peak_rss_kb() {
+  uint64_t kb = status_kb("VmHWM");
+  if (!kb) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    kb = usage.ru_maxrss;
+  }
+  return kb;
+}
+
+/*
+ * Runs a phase rounds times. The setup is not measured; the teardown runs
+ * after the measurement.
+ */
+template <typename S, typename F, typename T>
+static int32_t measure(Phase &phase, int32_t rounds, S setup, F run, T teardown) {
+  phase.ns = ~0ULL;
+  for (int32_t r = 0; r < rounds; r++) {
+    setup();
+    reset_peak_rss();
+    uint64_t start_rss = status_kb("VmRSS");
+    uint64_t start_allocs = allocations(), start_frees = frees();
+    uint64_t start = now_ns();
+    int32_t result = run();
+    uint64_t elapsed = now_ns() - start;
+    phase.allocations = allocations() - start_allocs;
+    phase.frees = frees() - start_frees;
+    phase.peak_rss_kb = peak_rss_kb();
+    phase.rss_growth_kb = phase.peak_rss_kb > start_rss ? phase.peak_rss_kb - start_rss : 0;
+    teardown();
+    if (result)
+      return 1;
+    if (elapsed < phase.ns)
+      phase.ns = elapsed;
+  }
+  return 0;
+}
+
+/*
+ * Lexes the whole text and counts the tokens.
+ */
+static int32_t lex(const string &text, uint64_t &tokens) {
+  LexAnalyzer lexer;
+  string_view word;
+  int32_t id;
+
+  lexer.open_buffer(text.data(), text.size());
+  tokens = 0;
+  while ((id = lexer.analyze(word)) != EOF_TK) {
+    if (id < 0)
+      return 1;
+    tokens++;
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  int32_t rounds = 3, scale = 100;
+  const string file = "/tmp/confslice_bench_suite.cfg";
+
+  if (argc > 1)
+    rounds = atoi(argv[1]);
+  if (argc > 2)
+    scale = atoi(argv[2]);
+  if (rounds < 1 || scale < 1) {
+    fprintf(stderr, "Usage: %s [rounds] [scale %%]\n", argv[0]);
+    return 1;
+  }
+
+  // Every profile is a few megabytes at 100%.
+  struct Profile {
+    const char *name;
+    GenOptions options;
+  };
+  vector<Profile> profiles(7);
+  profiles[0].name = "default";
+  profiles[0].options.entities = 6000;
+  profiles[1].name = "flat";
+  profiles[1].options.entities = 40000;
+  profiles[1].options.depth = 1;
+  profiles[1].options.keys = 4;
+  profiles[2].name = "deep";
+  profiles[2].options.entities = 200;
+  profiles[2].options.depth = 6;
+  profiles[2].options.children = 2;
+  profiles[2].options.keys = 4;
+  profiles[3].name = "wide";
+  profiles[3].options.entities = 100;
+  profiles[3].options.depth = 1;
+  profiles[3].options.keys = 1000;
+  profiles[4].name = "arrays";
+  profiles[4].options.entities = 1500;
+  profiles[4].options.elements = 64;
+  profiles[5].name = "comments";
+  profiles[5].options.entities = 5000;
+  profiles[5].options.comments = 100;
+  profiles[6].name = "strings";
+  profiles[6].options.entities = 2000;
+  profiles[6].options.string_length = 256;
+
+  printf("{\n  \"rounds\": %d,\n  \"scale\": %d,\n  \"results\": [", rounds, scale);
+  fprintf(stderr, "%-9s %-14s %10s %10s %10s %12s %12s %10s %10s\n", "profile", "phase", "ms",
+	  "MB/s", "Mtokens/s", "allocations", "frees", "peak KB", "growth KB");
+  bool first = true;
+  for (Profile &profile : profiles) {
+    GenOptions &options = profile.options;
+    options.entities = options.entities * (uint64_t)scale / 100;
+    if (!options.entities)
+      options.entities = 1;
+    string text = generate_config(options);
+    if (write_file(file, text)) {
+      fprintf(stderr, "Cannot write %s\n", file.c_str());
+      return 1;
+    }
+
+    vector<Phase> phases;
+    uint64_t tokens = 0;
+    Phase phase = Phase{"lex", 0, 0, 0, 0, 0};
+    if (measure(phase, rounds, []() {}, [&]() { return lex(text, tokens); }, []() {}))
+      return 1;
+    phases.push_back(phase);
+
+    for (int32_t arena = 0; arena < 2; arena++) {
+      ConfSlice *cs = NULL;
+      Phase analyze = Phase{arena ? "analyze_arena" : "analyze", 0, 0, 0, 0, 0};
+      Phase teardown = Phase{arena ? "teardown_arena" : "teardown", 0, 0, 0, 0, 0};
+      if (measure(analyze, rounds,
+		  [&]() { cs = new ConfSlice(arena ? ConfSlice::arena_mem : ConfSlice::heap_mem); },
+		  [&]() { return cs->analyze(file); },
+		  [&]() { delete cs; }) ||
+	  measure(teardown, rounds,
+		  [&]() {
+		    cs = new ConfSlice(arena ? ConfSlice::arena_mem : ConfSlice::heap_mem);
+		    cs->analyze(file);
+		  },
+		  [&]() {
+		    delete cs;
+		    return 0;
+		  },
+		  []() {})) {
+	fprintf(stderr, "Analysis of %s failed\n", profile.name);
+	return 1;
+      }
+      phases.push_back(analyze);
+      phases.push_back(teardown);
+    }
+
+    for (const Phase &p : phases) {
+      double seconds = p.ns / 1e9;
+      double mbs = text.size() / 1048576.0 / seconds;
+      double tps = tokens / seconds;
+      printf("%s\n    {\"profile\": \"%s\", \"phase\": \"%s\", \"bytes\": %zu, \"tokens\": %llu, "
+	     "\"ms\": %.3f, \"mb_per_s\": %.2f, \"tokens_per_s\": %.0f, \"allocations\": %llu, "
+	     "\"frees\": %llu, \"peak_rss_kb\": %llu, \"rss_growth_kb\": %llu}", first ? "" : ",", profile.name, p.name,
+	     text.size(), (unsigned long long)tokens, p.ns / 1e6, mbs, tps,
+	     (unsigned long long)p.allocations, (unsigned long long)p.frees,
+	     (unsigned long long)p.peak_rss_kb, (unsigned long long)p.rss_growth_kb);
+      fprintf(stderr, "%-9s %-14s %10.2f %10.2f %10.2f %12llu %12llu %10llu %10llu\n",
+	      profile.name, p.name, p.ns / 1e6, mbs, tps / 1e6, (unsigned long long)p.allocations,
+	      (unsigned long long)p.frees, (unsigned long long)p.peak_rss_kb,
+	      (unsigned long long)p.rss_growth_kb);
+      first = false;
+    }
+  }
+  printf("\n  ]\n}\n");
+  unlink(file.c_str());
+  return 0;
+}
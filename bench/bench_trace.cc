@@ -0,0 +1,74 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Confslice - A simple configuration file parser.
+ *
+ * Copyright (C) 2014 Giorgos Kappes <geokapp@gmail.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file LICENSE.
+ *
+ */
+
+/*
+ * Access tracing overhead: lookups per second on a frozen synthetic
+ * configuration without a trace, with a trace that times every lookup and
+ * with a trace that times one lookup in 64.
+ *
+ * Usage: bench_trace [reads]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "../src/confslice.h"
+#include "../src/trace.h"
+#include "bench.h"
+
+using namespace std;
+
+int main(int argc, char *argv[]) {
+  int64_t reads = 5000000;
+  const int32_t servers = 1000;
+
+  if (argc > 1)
+    reads = atoll(argv[1]);
+  ConfSlice cs;
+  if (cs.analyze_buffer(synthetic_config(512 << 10))) {
+    fprintf(stderr, "Analysis failed\n");
+    return 1;
+  }
+  const Configuration *conf = cs.configuration()->freeze();
+  vector<Path> paths;
+  for (int32_t i = 0; i < servers; i++)
+    paths.push_back(Path("server" + to_string(i) + ".disk.journal_size"));
+  if (conf->get<int64_t>(paths.back(), -1) < 0) {
+    fprintf(stderr, "Configuration too small\n");
+    return 1;
+  }
+
+  printf("%lld reads\n", (long long)reads);
+  double base = 0;
+  const uint32_t samples[3] = {0, 1, 64};
+  for (int32_t mode = 0; mode < 3; mode++) {
+    AccessTrace trace(samples[mode]);
+    if (mode)
+      trace.start();
+    int64_t sum = 0;
+    uint64_t start = now_ns();
+    for (int64_t i = 0; i < reads; i++)
+      sum += conf->get<int64_t>(paths[(i * 7) % servers], 0);
+    uint64_t elapsed = now_ns() - start;
+    trace.stop();
+    double ns = (double)elapsed / reads;
+    if (!mode)
+      base = ns;
+    printf("%-16s %8.2f ns/read %+7.2f ns %s\n",
+	   mode ? (mode == 1 ? "trace, all timed" : "trace, 1 in 64") : "no trace", ns, ns - base,
+	   sum ? "" : "(no data)");
+  }
+  return 0;
+}
@@ -0,0 +1,169 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Confslice - A simple configuration file parser.
+ *
+ * Copyright (C) 2014 Giorgos Kappes <geokapp@gmail.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file LICENSE.
+ *
+ */
+
+#ifndef GENERATE_H
+#define GENERATE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+
+/**
+ * @name GenOptions - The shape of a generated configuration.
+ */
+struct GenOptions {
+  uint32_t entities = 1000;      // 1-level entities.
+  uint32_t depth = 2;            // Levels of entities, 1 for flat ones.
+  uint32_t children = 1;         // Sub-entities of every entity above the last level.
+  uint32_t keys = 8;             // Keys per entity.
+  uint32_t elements = 4;         // Elements of every array, list and pairs value.
+  uint32_t comments = 25;        // Percentage of keys preceded by a comment line.
+  uint32_t string_length = 16;   // Length of every string value.
+  uint64_t seed = 1;             // The same seed gives the same text.
+};
+
+/**
+ * @name gen_next - Step the generator's random number sequence.
+ * @param state: The state, advanced in place.
+ *
+ * SplitMix64, so that the text does not depend on the C library.
+ *
+ * @return The next random number.
+ */
+static inline uint64_t gen_next(uint64_t &state) {
+  uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+/**
+ * @name gen_string - Append a quoted string value.
+ */
+static inline void gen_string(std::string &out, uint64_t &state, const uint32_t length) {
+  static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789.";
+
+  out += '"';
+  for (uint32_t i = 0; i < length; i++)
+    out += alphabet[gen_next(state) % (sizeof(alphabet) - 1)];
+  out += '"';
+}
+
+/**
+ * @name gen_scalar - Append an integer, a double or a string value.
+ */
+static inline void gen_scalar(std::string &out, uint64_t &state, const GenOptions &options) {
+  uint64_t r = gen_next(state);
+  char buf[64];
+
+  switch (r % 4) {
+  case 0:
+    gen_string(out, state, options.string_length);
+    return;
+  case 1:
+    snprintf(buf, sizeof(buf), "%.3f", (double)(r >> 40) / 1000);
+    break;
+  default:
+    snprintf(buf, sizeof(buf), "%lld", (long long)(r >> 44) - (1LL << 19));
+    break;
+  }
+  out += buf;
+}
+
+/**
+ * @name gen_key - Append a key definition.
+ *
+ * Scalars are the most common values; arrays, lists with a nested list
+ * and pairs take a share of the rest.
+ */
+static inline void gen_key(std::string &out, uint64_t &state, const GenOptions &options,
+			   const std::string &indent, const uint32_t k) {
+  uint64_t kind = gen_next(state) % 8;
+
+  if (gen_next(state) % 100 < options.comments)
+    out += indent + "// Key " + std::to_string(k) + " controls a setting of this entity.\n";
+  out += indent + "key" + std::to_string(k) + " = ";
+  switch (kind) {
+  case 0:
+    out += '[';
+    for (uint32_t i = 0; i < options.elements; i++) {
+      out += i ? ", " : "";
+      out += std::to_string(gen_next(state) % 100000);
+    }
+    out += ']';
+    break;
+  case 1:
+    out += '<';
+    for (uint32_t i = 0; i < options.elements; i++) {
+      out += i ? ", " : "";
+      gen_scalar(out, state, options);
+    }
+    out += options.elements ? ", <1, 2>>" : "<1, 2>>";
+    break;
+  case 2:
+    out += "{ ";
+    for (uint32_t i = 0; i < options.elements; i++) {
+      out += i ? "; p" : "p";
+      out += std::to_string(i) + " = ";
+      gen_scalar(out, state, options);
+    }
+    out += options.elements ? " }" : "p = 0 }";
+    break;
+  default:
+    gen_scalar(out, state, options);
+    break;
+  }
+  out += ";\n";
+}
+
+/**
+ * @name gen_entity - Append an entity and its sub-entities.
+ */
+static inline void gen_entity(std::string &out, uint64_t &state, const GenOptions &options,
+			      const std::string &id, const uint32_t level) {
+  std::string indent(level, '\t');
+
+  out += indent + id + ": {\n";
+  for (uint32_t k = 0; k < options.keys; k++)
+    gen_key(out, state, options, indent + '\t', k);
+  for (uint32_t c = 0; level + 1 < options.depth && c < options.children; c++)
+    gen_entity(out, state, options, "child" + std::to_string(c), level + 1);
+  // An entity needs at least one definition.
+  if (!options.keys && (level + 1 >= options.depth || !options.children))
+    out += indent + "\tkey0 = 0;\n";
+  out += indent + "};\n";
+}
+
+/**
+ * @name generate_config - Generate a configuration.
+ * @param options: The shape of the configuration.
+ *
+ * Returns a deterministic configuration text that uses every construct of
+ * the grammar, shaped by the options: the 1-level entities, the depth of
+ * their nesting, the keys of every entity, the size of the arrays, lists
+ * and pairs, the share of commented keys and the length of the strings.
+ */
+static inline std::string generate_config(const GenOptions &options) {
+  uint64_t state = options.seed;
+  std::string out;
+
+  for (uint32_t e = 0; e < options.entities; e++) {
+    if (gen_next(state) % 100 < options.comments)
+      out += "// Entity " + std::to_string(e) + ".\n";
+    gen_entity(out, state, options, "entity" + std::to_string(e), 0);
+  }
+  return out;
+}
+
+#endif
@@ -11,14 +11,97 @@
  * Foundation.  See file LICENSE.
  *
  */
+#include <string.h>
+#include <charconv>
 #include <sstream>
 #include <string>
+#include <system_error>
 #include <list>
 #include <map>
+#include <memory_resource>
 #include <utility>
 #include "configuration.h"
+#include "node.h"
+#include "trace.h"
 
 using namespace std;
+using std::pmr::memory_resource;
+
+/*
+ * Allocate and release an entity or a key together with its header.
+ */
+static void *node_allocate(size_t size, memory_resource *resource) {
+  size += node_header;
+  char *ptr = (char *)resource->allocate(size, alignof(max_align_t));
+  NodeHeader *header = (NodeHeader *)ptr;
+  header->resource = resource;
+  header->size = size;
+  return ptr + node_header;
+}
+
+static void node_deallocate(void *ptr) {
+  if (!ptr)
+    return;
+  NodeHeader *header = (NodeHeader *)((char *)ptr - node_header);
+  header->resource->deallocate(header, header->size, alignof(max_align_t));
+}
+
+/*
+ * Digests of values, keys and subtrees. Values, and the elements of
+ * arrays, lists and pairs, are combined in order. The keys and
+ * sub-entities of an entity are summed, since their order does not change
+ * what the entity defines.
+ */
+static inline uint64_t mix(uint64_t h) {
+  h ^= h >> 30;
+  h *= 0xbf58476d1ce4e5b9ULL;
+  h ^= h >> 27;
+  h *= 0x94d049bb133111ebULL;
+  return h ^ (h >> 31);
+}
+
+static inline uint64_t value_digest(const Data::Type type, const uint64_t bits) {
+  return mix(bits + (uint64_t)(type + 1) * 0x9e3779b97f4a7c15ULL);
+}
+
+#define ENTITY_SALT 0x5bd1e9955bd1e995ULL
+
+/*
+ * The run digests of a frozen level, allocated from the resource of the
+ * tree for levels with more than one run. Every object is added to its
+ * run in order.
+ */
+template <typename T>
+static DigestBlock<T> *blocks_allocate(const size_t size, memory_resource *resource) {
+  size_t count = DigestBlock<T>::count(size);
+  if (!count)
+    return NULL;
+  DigestBlock<T> *blocks =
+    (DigestBlock<T> *)resource->allocate(count * sizeof(DigestBlock<T>), alignof(DigestBlock<T>));
+  for (size_t i = 0; i < count; i++)
+    new (&blocks[i]) DigestBlock<T>{0, {}};
+  return blocks;
+}
+
+template <typename T>
+static void blocks_deallocate(DigestBlock<T> *blocks, const size_t size,
+			      memory_resource *resource) {
+  if (blocks)
+    resource->deallocate(blocks, DigestBlock<T>::count(size) * sizeof(DigestBlock<T>),
+			 alignof(DigestBlock<T>));
+}
+
+template <typename T>
+static inline void blocks_add(DigestBlock<T> *blocks, const size_t i,
+			      const typename std::pmr::list<T *>::const_iterator it,
+			      const uint64_t digest) {
+  if (!blocks)
+    return;
+  DigestBlock<T> &block = blocks[i / DigestBlock<T>::length];
+  if (i % DigestBlock<T>::length == 0)
+    block.first = it;
+  block.digest = mix(block.digest ^ digest);
+}
 
 /**
  * @name Data - Constructor.
@@ -28,7 +111,7 @@ using namespace std;
  */
 Data::Data(const Data::Type type) {
   m_type = type;
-  m_data.clear();
+  m_int = 0;
 }
 
 /**
@@ -38,7 +121,41 @@ Data::Data(const Data::Type type) {
  */
 Data::Data() {
   m_type = Data::none_t;
-  m_data.clear();
+  m_int = 0;
+}
+
+/**
+ * @name Data - Constructor.
+ * @param alloc: The allocator of the string buffer.
+ *
+ * This constructor initializes the object.
+ */
+Data::Data(const allocator_type &alloc) : m_str(alloc) {
+  m_type = Data::none_t;
+  m_int = 0;
+}
+
+/**
+ * @name Data - Copy Constructor.
+ * @param data: The data object to copy.
+ * @param alloc: The allocator of the string buffer.
+ *
+ * This constructor copies a data object into another memory resource.
+ */
+Data::Data(const Data &data, const allocator_type &alloc)
+  : m_type(data.m_type), m_int(data.m_int), m_str(data.m_str, alloc) {
+}
+
+/**
+ * @name Data - Move Constructor.
+ * @param data: The data object to move.
+ * @param alloc: The allocator of the string buffer.
+ *
+ * This constructor moves a data object into another memory resource. The
+ * string is copied if the resources differ.
+ */
+Data::Data(Data &&data, const allocator_type &alloc)
+  : m_type(data.m_type), m_int(data.m_int), m_str(std::move(data.m_str), alloc) {
 }
 
 /**
@@ -47,7 +164,7 @@ Data::Data() {
  * This is the destructor. It just clears the buffer.
  */
 Data::~Data() {
-  m_data.clear();
+  m_str.clear();
 }
 
 /**
@@ -57,7 +174,7 @@ Data::~Data() {
  *
  * @return The type of the data object.
  */
-Data::Type Data::type() {
+Data::Type Data::type() const {
   return m_type;
 }
 
@@ -66,24 +183,160 @@ Data::Type Data::type() {
  * @param data: the data to store.
  * @param type: the type of data.
  *
- * This stores the data to the data object.
+ * This stores the data to the data object. Integers and doubles are
+ * converted from their text here and only the number is kept. A leading
+ * + sign is accepted. An integer outside the range of int64_t is kept as
+ * a double, so as_int64() fails on it but as_double() does not.
  *
- * @return Void.
+ * @return 0 on success, 1 if the text is not a valid number of the type.
+ *         In that case the data object is left empty.
  */
-void Data::set_data(const string data, const Data::Type type) {
+int32_t Data::set_data(const string_view data, const Data::Type type) {
+  const char *first = data.data();
+  const char *last = first + data.size();
+  from_chars_result result;
+
+  m_str.clear();
   m_type = type;
-  m_data = data;
+  if (type == int_t || type == double_t) {
+    if (first != last && *first == '+' && last - first > 1 && first[1] != '-')
+      first++;
+    if (type == int_t) {
+      result = from_chars(first, last, m_int);
+      if (result.ec == errc::result_out_of_range && result.ptr == last) {
+	m_type = double_t;
+	result = from_chars(first, last, m_double);
+      }
+    } else {
+      result = from_chars(first, last, m_double);
+    }
+    if (result.ec != errc() || result.ptr != last) {
+      m_type = none_t;
+      m_int = 0;
+      return 1;
+    }
+  } else if (type == string_t) {
+    m_str.assign(data.data(), data.size());
+  }
+  return 0;
+}
+
+/**
+ * @name set_int64 - Set an integer.
+ * @param value: The integer.
+ *
+ * @return Void.
+ */
+void Data::set_int64(const int64_t value) {
+  m_str.clear();
+  m_type = int_t;
+  m_int = value;
+}
+
+/**
+ * @name set_double - Set a double.
+ * @param value: The double.
+ *
+ * @return Void.
+ */
+void Data::set_double(const double value) {
+  m_str.clear();
+  m_type = double_t;
+  m_double = value;
+}
+
+/**
+ * @name set_string - Set a string.
+ * @param value: The string.
+ *
+ * @return Void.
+ */
+void Data::set_string(const string_view value) {
+  m_type = string_t;
+  m_str.assign(value.data(), value.size());
+}
+
+/**
+ * @name as_int64 - Get the integer.
+ * @param value: The integer is returned here.
+ *
+ * @return 0 on success, 1 if the data is not an integer.
+ */
+int32_t Data::as_int64(int64_t &value) const {
+  if (m_type != int_t)
+    return 1;
+  value = m_int;
+  return 0;
+}
+
+/**
+ * @name as_double - Get the double.
+ * @param value: The double is returned here.
+ *
+ * Integers are converted to double.
+ *
+ * @return 0 on success, 1 if the data is not a number.
+ */
+int32_t Data::as_double(double &value) const {
+  if (m_type == double_t)
+    value = m_double;
+  else if (m_type == int_t)
+    value = (double)m_int;
+  else
+    return 1;
+  return 0;
+}
+
+/**
+ * @name as_string_view - Get the string.
+ * @param value: The string is returned here. It is valid as long as the
+ *               data object is not changed.
+ *
+ * @return 0 on success, 1 if the data is not a string.
+ */
+int32_t Data::as_string_view(string_view &value) const {
+  if (m_type != string_t)
+    return 1;
+  value = m_str;
+  return 0;
+}
+
+/**
+ * @name digest - Hash the type and the value.
+ *
+ * @return The digest. Equal data have equal digests.
+ */
+uint64_t Data::digest() const {
+  uint64_t bits = 0;
+
+  if (m_type == int_t)
+    bits = (uint64_t)m_int;
+  else if (m_type == double_t)
+    memcpy(&bits, &m_double, sizeof(bits));
+  else if (m_type == string_t)
+    bits = hash_id(m_str);
+  return value_digest(m_type, bits);
 }
 
 /**
  * @name data_str - Return data string.
  *
- * This function returns the string that contains the data.
+ * This function returns the data as a string. Numbers are formatted in
+ * their shortest form that reads back to the same value.
  *
  * @return A string that contains the data value.
  */
-std::string Data::data_str() {
-  return m_data;
+std::string Data::data_str() const {
+  char buf[32];
+  to_chars_result result;
+
+  if (m_type == int_t)
+    result = to_chars(buf, buf + sizeof(buf), m_int);
+  else if (m_type == double_t)
+    result = to_chars(buf, buf + sizeof(buf), m_double);
+  else
+    return string(m_str);
+  return string(buf, result.ptr);
 }
 
 /**
@@ -95,6 +348,74 @@ Key::Key() {
   m_id.clear();
 }
 
+/**
+ * @name Key - Constructor.
+ * @param resource: The memory resource of the key contents.
+ *
+ * This constructor initializes the key object.
+ */
+Key::Key(memory_resource *resource) : m_id(resource) {
+}
+
+/**
+ * @name operator new - Allocate a key.
+ * @param size: The size of the key object.
+ *
+ * Allocates a key from the default memory resource.
+ *
+ * @return The memory of the key.
+ */
+void *Key::operator new(size_t size) {
+  return node_allocate(size, std::pmr::get_default_resource());
+}
+
+/**
+ * @name operator new - Allocate a key.
+ * @param size: The size of the key object.
+ * @param resource: The memory resource.
+ *
+ * Allocates a key from the given memory resource.
+ *
+ * @return The memory of the key.
+ */
+void *Key::operator new(size_t size, memory_resource *resource) {
+  return node_allocate(size, resource);
+}
+
+/**
+ * @name operator delete - Release a key.
+ * @param ptr: The memory of the key.
+ *
+ * Returns the memory to the resource it was allocated from.
+ *
+ * @return Void.
+ */
+void Key::operator delete(void *ptr) {
+  node_deallocate(ptr);
+}
+
+/**
+ * @name operator delete - Release a key.
+ * @param ptr: The memory of the key.
+ *
+ * Called when the constructor of a key that was placed in a resource
+ * throws. The resource is recorded in the header of the memory.
+ *
+ * @return Void.
+ */
+void Key::operator delete(void *ptr, memory_resource *) {
+  node_deallocate(ptr);
+}
+
+/**
+ * @name resource - Get the memory resource.
+ *
+ * @return The memory resource of the key contents.
+ */
+memory_resource *Key::resource() const {
+  return m_id.get_allocator().resource();
+}
+
 /**
  * @name ~Key - Destructor.
  *
@@ -123,7 +444,7 @@ void Key::set_type(const Key::Type type) {
  *
  * @return The key type.
  */
-Key::Type Key::type() {
+Key::Type Key::type() const {
   return m_type;
 }
 
@@ -135,8 +456,8 @@ Key::Type Key::type() {
  *
  * @return Void.
  */
-void Key::set_id(const string id) {
-  m_id = id;
+void Key::set_id(const string_view id) {
+  m_id.assign(id.data(), id.size());
 }
 
 /**
@@ -144,9 +465,9 @@ void Key::set_id(const string id) {
  *
  * This returns the id part of the key.
  *
- * @return The key ID.
+ * @return The key ID. It is valid as long as the key.
  */
-string Key::id() {
+string_view Key::id() const {
   return m_id;
 }
 
@@ -160,6 +481,16 @@ KPairs::KPairs() {
   m_list.clear();
 }
 
+/**
+ * @name KPairs - Constructor.
+ * @param resource: The memory resource of the pairs.
+ *
+ * This constructor initializes the KPairs object.
+ */
+KPairs::KPairs(memory_resource *resource) : Key(resource), m_list(resource) {
+  this->set_type(Key::pairs_t);
+}
+
 /**
  * @name ~KPairs - Destructor.
  *
@@ -178,11 +509,8 @@ KPairs::~KPairs() {
  *
  * @return Void.
  */
-void KPairs::insert(const string key, const Data value) {
-  pair<string, Data> element;
-  element.first = key;
-  element.second = value;
-  m_list.push_back(element);
+void KPairs::insert(const string_view key, Data value) {
+  m_list.emplace_back(key, std::move(value));
   if (m_list.size() == 1)
     m_it = m_list.begin();
 }
@@ -217,10 +545,22 @@ void KPairs::reset() {
  *
  * @return The number of elements.
  */
-int32_t KPairs::size() {
+int32_t KPairs::size() const {
   return m_list.size();
 }
 
+/**
+ * @name pairs - View the pairs.
+ *
+ * This returns a read-only view over the pairs in insertion order. Unlike
+ * get_next(), it does not remove or copy the pairs.
+ *
+ * @return The view.
+ */
+KPairs::PairView KPairs::pairs() const {
+  return PairView(m_list.begin(), m_list.end(), m_list.size());
+}
+
 /**
  * @name get_next - Return the next list element.
  *
@@ -233,7 +573,7 @@ int32_t KPairs::size() {
  */
 pair<string, Data> *KPairs::get_next() {
   if (m_it != m_list.end() && !m_list.empty()) {
-    pair<string, Data> *result = new pair<string, Data>(*m_it);
+    pair<string, Data> *result = new pair<string, Data>(string(m_it->first), m_it->second);
     ++m_it;
     m_list.pop_front();    
     return result;
@@ -242,6 +582,46 @@ pair<string, Data> *KPairs::get_next() {
   }
 }
 
+/**
+ * @name data - View the Data elements.
+ *
+ * @return A view over the Data elements of the list.
+ */
+KListNode::DataView KListNode::data() const {
+  const KList::Node &node = m_klist->m_nodes[m_index];
+  return DataView(m_klist->m_data.data() + node.first_data, node.size_of_data);
+}
+
+/**
+ * @name klists - View the sub-lists.
+ *
+ * @return A view over the sub-lists of the list.
+ */
+KListNode::KListView KListNode::klists() const {
+  const KList::Node &node = m_klist->m_nodes[m_index];
+  return KListView(iterator(m_klist, node.first_klist),
+		   iterator(m_klist, node.first_klist + node.size_of_klist),
+		   node.size_of_klist);
+}
+
+/**
+ * @name size_of_data - Data list size.
+ *
+ * @return The number of Data elements of the list.
+ */
+int32_t KListNode::size_of_data() const {
+  return m_klist->m_nodes[m_index].size_of_data;
+}
+
+/**
+ * @name size_of_klist - KList list size.
+ *
+ * @return The number of sub-lists of the list.
+ */
+int32_t KListNode::size_of_klist() const {
+  return m_klist->m_nodes[m_index].size_of_klist;
+}
+
 /**
  * @name KList - Constructor.
  *
@@ -249,8 +629,35 @@ pair<string, Data> *KPairs::get_next() {
  */
 KList::KList() {
   this->set_type(Key::list_t);
-  m_list.clear();
-  m_data.clear();
+  m_nodes.push_back(Node{0, 0, 0, 0});
+}
+
+/**
+ * @name KList - Constructor.
+ * @param resource: The memory resource of the list.
+ *
+ * This constructor initializes the KList object.
+ */
+KList::KList(memory_resource *resource) : Key(resource), m_data(resource), m_nodes(resource) {
+  this->set_type(Key::list_t);
+  m_nodes.push_back(Node{0, 0, 0, 0});
+}
+
+/**
+ * @name KList - Copy Constructor.
+ * @param klist: The KList object to copy.
+ * @param alloc: The allocator of the copy.
+ *
+ * This constructor copies a KList object, with its sub-lists, into a
+ * memory resource. Elements that were already read with get_next_*() are
+ * not copied.
+ */
+KList::KList(const KList &klist, const allocator_type &alloc)
+  : Key(alloc.resource()), m_data(alloc), m_nodes(alloc) {
+  this->set_type(klist.type());
+  this->set_id(klist.id());
+  m_nodes.push_back(Node{0, 0, 0, 0});
+  copy_node(klist, 0, 0);
 }
 
 /**
@@ -260,17 +667,8 @@ KList::KList() {
  */
 KList::KList(KList *kl_ptr) {
   this->set_type(kl_ptr->type());
-  for (std::list<Data>::iterator it = kl_ptr->m_data.begin(); it != kl_ptr->m_data.end(); ++it) 
-    m_data.push_back(*it);
-
-  for (std::list<KList>::iterator it = kl_ptr->m_list.begin(); it != kl_ptr->m_list.end(); ++it) 
-    m_list.push_back(*it);
-
-  if (!m_data.empty())
-    m_it_data = m_data.begin();
-
-  if (!m_list.empty())
-    m_it_list = m_list.begin();
+  m_nodes.push_back(Node{0, 0, 0, 0});
+  copy_node(*kl_ptr, 0, 0);
 }
 
 /**
@@ -279,82 +677,132 @@ KList::KList(KList *kl_ptr) {
  * Clears the list.
  */
 KList::~KList() {
-  m_list.clear();
-  m_data.clear();
+}
+
+/**
+ * @name copy_node - Copy a list.
+ * @param klist: The source KList object.
+ * @param src: The node of the list in the source.
+ * @param dst: The node that receives the copy. It must be empty.
+ *
+ * This method appends the Data elements of the source list and, for each
+ * sub-list, a new node right after each other, and then copies each
+ * sub-list into its node.
+ *
+ * @return Void.
+ */
+void KList::copy_node(const KList &klist, const uint32_t src, const uint32_t dst) {
+  const Node from = klist.m_nodes[src];
+  Node to = {(uint32_t)m_data.size(), from.size_of_data,
+	     (uint32_t)m_nodes.size(), from.size_of_klist};
+
+  m_data.insert(m_data.end(), klist.m_data.begin() + from.first_data,
+		klist.m_data.begin() + from.first_data + from.size_of_data);
+  m_nodes.resize(m_nodes.size() + from.size_of_klist, Node{0, 0, 0, 0});
+  m_nodes[dst] = to;
+  for (uint32_t i = 0; i < from.size_of_klist; i++)
+    copy_node(klist, from.first_klist + i, to.first_klist + i);
 }
 
 /**
  * @name insert_data - Insert a Data object.
  * @param data: The Data object.
  *
- * This method inserts a data object into the list.
+ * This method appends a data object to the top list. If other elements
+ * were stored after the data objects of the top list, these are moved to
+ * the end first.
  *
  * @return Void.
  */
-void KList::insert_data(const Data data) {
-  m_data.push_back(data);
-  if (m_data.size() == 1)
-    m_it_data = m_data.begin();
+void KList::insert_data(Data data) {
+  Node &root = m_nodes[0];
+  if (root.first_data + root.size_of_data != m_data.size()) {
+    uint32_t first = m_data.size();
+    for (uint32_t i = 0; i < root.size_of_data; i++)
+      m_data.push_back(Data(m_data[root.first_data + i]));
+    root.first_data = first;
+  }
+  m_data.push_back(std::move(data));
+  root.size_of_data++;
 }
 
 /**
  * @name insert_klist - Insert a KList object.
  * @klist: The KList object.
  *
- * This method inserts a klist object into the list.
+ * This method appends a copy of a klist object to the top list. If other
+ * nodes were stored after the sub-lists of the top list, these are moved
+ * to the end first.
  *
  * @return Void.
  */
-void KList::insert_klist(const KList klist) {
-  m_list.push_back(klist);
-  if (m_list.size() == 1)
-    m_it_list = m_list.begin();
+void KList::insert_klist(const KList &klist) {
+  if (&klist == this) {
+    KList copy(klist);
+    insert_klist(copy);
+    return;
+  }
+  Node root = m_nodes[0];
+  if (root.first_klist + root.size_of_klist != m_nodes.size()) {
+    m_nodes[0].first_klist = m_nodes.size();
+    for (uint32_t i = 0; i < root.size_of_klist; i++)
+      m_nodes.push_back(Node(m_nodes[root.first_klist + i]));
+  }
+  m_nodes.push_back(Node{0, 0, 0, 0});
+  m_nodes[0].size_of_klist++;
+  copy_node(klist, 0, m_nodes.size() - 1);
 }
 
 /**
  * @name clear_data - Clears the data list.
  *
- * This method clears the data list.
+ * This method clears the data list of the top list.
  *
  * Return: Void.
  */
 void KList::clear_data() {
-  m_data.clear();
+  m_nodes[0].size_of_data = 0;
+  if (!m_nodes[0].size_of_klist) {
+    m_data.clear();
+    m_nodes.resize(1);
+  }
 }
 
 /**
  * @name clear_klist - Clears the klist list.
  *
- * This method clears the klist list.
+ * This method clears the sub-lists of the top list.
  *
  * @return Void.
  */
 void KList::clear_klist() {
-  m_list.clear();
+  m_nodes[0].size_of_klist = 0;
+  if (!m_nodes[0].size_of_data) {
+    m_data.clear();
+    m_nodes.resize(1);
+  }
 }
 
 /**
  * @name reset_data - Reset the data iterator.
  *
- * This method resets the data list iterator. After returning, the iterator
- * points to the first element.
+ * get_next_data() always returns the first element that is left, so there
+ * is nothing to reset. Kept for compatibility.
  *
  * @return Void.
  */
 void KList::reset_data() {
-  m_it_data = m_data.begin();
 }
 
 /**
  * @name reset_klist - Reset the klist iterator.
  *
- * This method resets the entities list iterator. After returning, the iterator
- * points to the first element.
+ * get_next_klist() always returns the first sub-list that is left, so
+ * there is nothing to reset. Kept for compatibility.
  *
  * @return Void.
  */
 void KList::reset_klist() {
-  m_it_list = m_list.begin();
 }
 
 /**
@@ -364,8 +812,8 @@ void KList::reset_klist() {
  *
  * @return The number of elements.
  */
-int32_t KList::size_of_data() {
-  return m_data.size();
+int32_t KList::size_of_data() const {
+  return m_nodes[0].size_of_data;
 }
 
 /**
@@ -375,26 +823,26 @@ int32_t KList::size_of_data() {
  *
  * @return The number of elements.
  */
-int32_t KList::size_of_klist() {
-  return m_list.size();
+int32_t KList::size_of_klist() const {
+  return m_nodes[0].size_of_klist;
 }
 
 /**
  * @name get_next_data - Return the next Data element.
  *
- * This returns the next Data element and moves the iterator one step
- * forward. It also deletes the element from the list.
+ * This returns the next Data element of the top list and removes it from
+ * the list.
  *
  * @return Pointer to a new initialized Data object or NULL.
  *         The user should take care by properly deleting the
  *         returned object.
  */
 Data *KList::get_next_data() {
-  if (m_it_data != m_data.end() && !m_data.empty()) {
-    Data *result = new Data;
-    result->set_data((*m_it_data).data_str(), (*m_it_data).type());
-    ++m_it_data;
-    m_data.pop_front();
+  Node &root = m_nodes[0];
+  if (root.size_of_data) {
+    Data *result = new Data(m_data[root.first_data]);
+    root.first_data++;
+    root.size_of_data--;
     return result;
   } else {
     return NULL;
@@ -404,18 +852,21 @@ Data *KList::get_next_data() {
 /**
  * @name get_next_klist - Return the next KList element.
  *
- * This returns the next KList element and moves the iterator one step
- * forward. It also deletes the element from the list.
+ * This returns a copy of the next sub-list of the top list and removes it
+ * from the list. Use klists() to read the sub-lists without copying them.
  *
  * @return Pointer to a new initialized KList object or NULL.
  *         The user should take care by properly deleting the
  *         returned object.
  */
 KList *KList::get_next_klist() {
-  if (m_it_list != m_list.end() && !m_list.empty()) {
-    KList *result = new KList(*m_it_list);
-    ++m_it_data;
-    m_list.pop_front();
+  Node &root = m_nodes[0];
+  if (root.size_of_klist) {
+    KList *result = new KList;
+    result->set_id(id());
+    result->copy_node(*this, root.first_klist, 0);
+    m_nodes[0].first_klist++;
+    m_nodes[0].size_of_klist--;
     return result;
   } else {
     return NULL;
@@ -423,108 +874,612 @@ KList *KList::get_next_klist() {
 }
 
 /**
- * @name KArray - Constructor.
+ * @name data - View the Data elements.
  *
- * This constructor initializes the KArray object.
+ * This returns a read-only view over the Data elements of the top list.
+ * Unlike get_next_data(), it does not remove or copy the elements.
+ *
+ * @return The view.
  */
-KArray::KArray() {
-  this->set_type(Key::array_t);
-  m_array.clear();
+KList::DataView KList::data() const {
+  return KListNode(this, 0).data();
 }
 
 /**
- * @name ~KArray - Destructor.
+ * @name klists - View the KList elements.
  *
- * Clears the array.
+ * This returns a read-only view over the sub-lists of the top list. Unlike
+ * get_next_klist(), it does not remove or copy the sub-lists.
+ *
+ * @return The view.
  */
-KArray::~KArray() {
-  m_array.clear();
-  
+KList::KListView KList::klists() const {
+  return KListNode(this, 0).klists();
 }
 
 /**
- * @name Operator [] - Array operator.
- * @param index: The array index.
+ * @name KListBuilder - Constructor.
  *
- * Overloads the array operator.
+ * Creates an idle builder.
+ */
+KListBuilder::KListBuilder() {
+  m_klist = NULL;
+}
+
+/**
+ * @name ~KListBuilder - Destructor.
  *
- * @return A reference to a data object.
+ * Drops the elements of a list that was not ended.
  */
-Data &KArray::operator[] (int32_t index) {
-  return m_array[index];
+KListBuilder::~KListBuilder() {
+  clear();
 }
 
 /**
- * @name size - The array size.
+ * @name begin - Begin a list.
+ * @param klist: The KList object to fill. Its top list must be empty.
  *
- * Returns the array size.
+ * Opens the top list. The elements that follow are added to it, until
+ * end() is called.
  *
- * @return The array size.
+ * @return Void.
  */
-int32_t KArray::size() {
-  return m_array.size();
+void KListBuilder::begin(KList *klist) {
+  clear();
+  m_klist = klist;
+  m_frames.push_back(Frame{0, 0});
 }
 
 /**
- * @name KValue - Constructor.
+ * @name begin_klist - Begin a sub-list.
  *
- * This constructor initializes the KValue object.
+ * Opens a sub-list of the innermost open list.
+ *
+ * @return Void.
  */
-KValue::KValue() {
-  this->set_type(Key::value_t);
+void KListBuilder::begin_klist() {
+  m_frames.push_back(Frame{m_data.size(), m_nodes.size()});
 }
 
 /**
- * @name ~KValue - Destructor.
+ * @name insert_data - Insert a Data object.
+ * @param data: The Data object.
  *
- * Currently it does nothing.
+ * Appends a data object to the innermost open list.
+ *
+ * @return Void.
  */
-KValue::~KValue() {
+void KListBuilder::insert_data(Data data) {
+  m_data.push_back(std::move(data));
 }
 
 /**
- * @name set_value - Set the value.
- * @param value: the Data object that contains the value.
+ * @name end_klist - End a sub-list.
  *
- * This method sets the value of the object.
+ * Closes the innermost open sub-list and adds it to its parent.
  *
  * @return Void.
  */
-void KValue::set_value(const Data value) {
-  m_value = value;
+void KListBuilder::end_klist() {
+  KList::Node node = flush();
+  m_nodes.push_back(node);
 }
 
 /**
- * @name value - Return the value.
+ * @name end - End the top list.
  *
- * This method returns the value of the object.
+ * Closes the top list. The KList object is complete after this.
  *
- * @return Data
+ * @return Void.
  */
-Data KValue::value() {
-  return m_value;
+void KListBuilder::end() {
+  m_klist->m_nodes[0] = flush();
+  m_klist = NULL;
 }
 
 /**
- * @name Entity - Constructor.
+ * @name clear - Drop the open lists.
  *
- * This constructor initializes the Entity object.
+ * @return Void.
  */
-Entity::Entity() {
-  m_keys.clear();
-  m_entities.clear();
-  m_id.clear();
+void KListBuilder::clear() {
+  m_data.clear();
+  m_nodes.clear();
+  m_frames.clear();
+  m_klist = NULL;
 }
 
 /**
- * @name ~Entity - Destructor.
+ * @name flush - Move the innermost open list into the KList.
  *
- * Clears the entities and keys lists.
+ * Moves the data objects and the sub-list nodes of the innermost open
+ * list to the end of the KList arrays and closes it.
+ *
+ * @return The node of the list.
  */
-Entity::~Entity() {
-  while (!m_entities.empty()) {
-    Entity *front = m_entities.front();
-    delete front;
+KList::Node KListBuilder::flush() {
+  Frame frame = m_frames.back();
+  KList::Node node = {(uint32_t)m_klist->m_data.size(),
+		      (uint32_t)(m_data.size() - frame.first_data),
+		      (uint32_t)m_klist->m_nodes.size(),
+		      (uint32_t)(m_nodes.size() - frame.first_klist)};
+
+  for (size_t i = frame.first_data; i < m_data.size(); i++)
+    m_klist->m_data.push_back(std::move(m_data[i]));
+  m_klist->m_nodes.insert(m_klist->m_nodes.end(), m_nodes.begin() + frame.first_klist,
+			  m_nodes.end());
+  m_data.resize(frame.first_data);
+  m_nodes.resize(frame.first_klist);
+  m_frames.pop_back();
+  return node;
+}
+
+/**
+ * @name KArray - Constructor.
+ *
+ * This constructor initializes the KArray object.
+ */
+KArray::KArray() {
+  this->set_type(Key::array_t);
+  m_type = Data::none_t;
+}
+
+/**
+ * @name KArray - Constructor.
+ * @param resource: The memory resource of the array.
+ *
+ * This constructor initializes the KArray object.
+ */
+KArray::KArray(memory_resource *resource)
+  : Key(resource), m_ints(resource), m_doubles(resource), m_data(resource) {
+  this->set_type(Key::array_t);
+  m_type = Data::none_t;
+}
+
+/**
+ * @name ~KArray - Destructor.
+ *
+ * Clears the array.
+ */
+KArray::~KArray() {
+}
+
+/**
+ * @name insert_data - Append an element.
+ * @param data: The Data object.
+ *
+ * This method appends an element to the array. Integers and doubles stay
+ * unboxed as long as every element has the same type. The first element
+ * of another type boxes the array.
+ *
+ * @return Void.
+ */
+void KArray::insert_data(Data data) {
+  Data::Type type = data.type();
+
+  if (!size() && (type == Data::int_t || type == Data::double_t))
+    m_type = type;
+  else if (m_type != Data::none_t && m_type != type)
+    box();
+
+  if (m_type == Data::int_t) {
+    int64_t value;
+    data.as_int64(value);
+    m_ints.push_back(value);
+  } else if (m_type == Data::double_t) {
+    double value;
+    data.as_double(value);
+    m_doubles.push_back(value);
+  } else {
+    m_data.push_back(std::move(data));
+  }
+}
+
+/**
+ * @name set_data - Replace an element.
+ * @param index: The array index.
+ * @param data: The Data object.
+ *
+ * The array stays unboxed if the element has its type. An element of
+ * another type boxes it.
+ *
+ * @return 0 on success, 1 if the index is out of range.
+ */
+int32_t KArray::set_data(const int32_t index, Data data) {
+  int64_t i;
+  double d;
+
+  if (index < 0 || index >= size())
+    return 1;
+  if (m_type == Data::int_t && !data.as_int64(i))
+    m_ints[index] = i;
+  else if (m_type == Data::double_t && data.type() == Data::double_t && !data.as_double(d))
+    m_doubles[index] = d;
+  else {
+    box();
+    m_data[index] = std::move(data);
+  }
+  return 0;
+}
+
+/**
+ * @name data_type - The element type.
+ *
+ * Returns the type that all the elements share. Boxed arrays are scanned.
+ *
+ * @return The element type, or none_t if the array is empty or its
+ *         elements have different types.
+ */
+Data::Type KArray::data_type() const {
+  if (m_type != Data::none_t || m_data.empty())
+    return m_type;
+  Data::Type type = m_data.front().type();
+  for (size_t i = 1; i < m_data.size(); i++)
+    if (m_data[i].type() != type)
+      return Data::none_t;
+  return type;
+}
+
+/**
+ * @name at - Get an integer element.
+ * @param index: The array index.
+ * @param value: The integer is returned here.
+ *
+ * @return 0 on success, 1 if the index is out of range or the element is
+ *         not an integer.
+ */
+int32_t KArray::at(const int32_t index, int64_t &value) const {
+  if (index < 0 || index >= size())
+    return 1;
+  if (m_type == Data::int_t) {
+    value = m_ints[index];
+    return 0;
+  }
+  if (m_type == Data::double_t)
+    return 1;
+  return m_data[index].as_int64(value);
+}
+
+/**
+ * @name at - Get a double element.
+ * @param index: The array index.
+ * @param value: The double is returned here.
+ *
+ * Integers are converted to double.
+ *
+ * @return 0 on success, 1 if the index is out of range or the element is
+ *         not a number.
+ */
+int32_t KArray::at(const int32_t index, double &value) const {
+  if (index < 0 || index >= size())
+    return 1;
+  if (m_type == Data::int_t)
+    value = (double)m_ints[index];
+  else if (m_type == Data::double_t)
+    value = m_doubles[index];
+  else
+    return m_data[index].as_double(value);
+  return 0;
+}
+
+/**
+ * @name at - Get a string element.
+ * @param index: The array index.
+ * @param value: The string is returned here.
+ *
+ * @return 0 on success, 1 if the index is out of range or the element is
+ *         not a string.
+ */
+int32_t KArray::at(const int32_t index, string_view &value) const {
+  if (index < 0 || index >= size() || m_type != Data::none_t)
+    return 1;
+  return m_data[index].as_string_view(value);
+}
+
+/**
+ * @name as_int64_span - View an integer array.
+ * @param values: The view is returned here.
+ *
+ * @return 0 on success, 1 if the array is not stored as integers.
+ */
+int32_t KArray::as_int64_span(Span<int64_t> &values) const {
+  if (m_type != Data::int_t)
+    return 1;
+  values = Span<int64_t>(m_ints.data(), m_ints.size());
+  return 0;
+}
+
+/**
+ * @name as_double_span - View a double array.
+ * @param values: The view is returned here.
+ *
+ * @return 0 on success, 1 if the array is not stored as doubles.
+ */
+int32_t KArray::as_double_span(Span<double> &values) const {
+  if (m_type != Data::double_t)
+    return 1;
+  values = Span<double>(m_doubles.data(), m_doubles.size());
+  return 0;
+}
+
+/**
+ * @name as_data_span - View a boxed array.
+ * @param values: The view is returned here.
+ *
+ * @return 0 on success, 1 if the array is stored unboxed.
+ */
+int32_t KArray::as_data_span(Span<Data> &values) const {
+  if (m_type != Data::none_t)
+    return 1;
+  values = Span<Data>(m_data.data(), m_data.size());
+  return 0;
+}
+
+/**
+ * @name Operator [] - Array operator.
+ * @param index: The array index.
+ *
+ * Overloads the array operator. It returns a copy of the element, which
+ * can be moved from, and leaves the storage of the array alone. Use set_data() to change an
+ * element, and at() or the spans to read without a copy.
+ *
+ * @return The element, or an empty data object if the index is out of
+ *         range.
+ */
+Data KArray::operator[] (const int32_t index) const {
+  Data data;
+  int64_t i;
+  double d;
+
+  if (index < 0 || index >= size())
+    return data;
+  if (m_type == Data::int_t && !at(index, i))
+    data.set_int64(i);
+  else if (m_type == Data::double_t && !at(index, d))
+    data.set_double(d);
+  else if (m_type == Data::none_t)
+    data = m_data[index];
+  return data;
+}
+
+/**
+ * @name size - The array size.
+ *
+ * Returns the array size.
+ *
+ * @return The array size.
+ */
+int32_t KArray::size() const {
+  if (m_type == Data::int_t)
+    return m_ints.size();
+  if (m_type == Data::double_t)
+    return m_doubles.size();
+  return m_data.size();
+}
+
+/**
+ * @name box - Store the elements as Data objects.
+ *
+ * @return Void.
+ */
+void KArray::box() {
+  if (m_type == Data::int_t) {
+    m_data.resize(m_ints.size());
+    for (size_t i = 0; i < m_ints.size(); i++)
+      m_data[i].set_int64(m_ints[i]);
+    std::pmr::vector<int64_t>(m_ints.get_allocator()).swap(m_ints);
+  } else if (m_type == Data::double_t) {
+    m_data.resize(m_doubles.size());
+    for (size_t i = 0; i < m_doubles.size(); i++)
+      m_data[i].set_double(m_doubles[i]);
+    std::pmr::vector<double>(m_doubles.get_allocator()).swap(m_doubles);
+  }
+  m_type = Data::none_t;
+}
+
+/**
+ * @name KValue - Constructor.
+ *
+ * This constructor initializes the KValue object.
+ */
+KValue::KValue() {
+  this->set_type(Key::value_t);
+}
+
+/**
+ * @name KValue - Constructor.
+ * @param resource: The memory resource of the value.
+ *
+ * This constructor initializes the KValue object.
+ */
+KValue::KValue(memory_resource *resource)
+  : Key(resource), m_value(Data::allocator_type(resource)) {
+  this->set_type(Key::value_t);
+}
+
+/**
+ * @name ~KValue - Destructor.
+ *
+ * Currently it does nothing.
+ */
+KValue::~KValue() {
+}
+
+/**
+ * @name set_value - Set the value.
+ * @param value: the Data object that contains the value.
+ *
+ * This method sets the value of the object.
+ *
+ * @return Void.
+ */
+void KValue::set_value(Data value) {
+  m_value = std::move(value);
+}
+
+/**
+ * @name value - Return the value.
+ *
+ * This method returns the value of the object.
+ *
+ * @return A reference to the Data object. It is valid as long as the key.
+ */
+const Data &KValue::value() const {
+  return m_value;
+}
+
+/**
+ * @name list_digest - Hash a list and its sub-lists.
+ * @param klist: A KList or a KListNode.
+ *
+ * @return The digest.
+ */
+template <typename L>
+static uint64_t list_digest(const L &klist) {
+  uint64_t h = mix(klist.size_of_data() + ((uint64_t)klist.size_of_klist() << 32));
+  for (const Data &data : klist.data())
+    h = mix(h ^ data.digest());
+  for (const KListNode &sub : klist.klists())
+    h = mix(h ^ list_digest(sub));
+  return h;
+}
+
+/**
+ * @name digest - Hash the ID, the type and the contents of the key.
+ *
+ * @return The digest. Equal keys have equal digests.
+ */
+uint64_t Key::digest() const {
+  uint64_t h = mix(hash_id(m_id) + m_type);
+
+  if (m_type == value_t) {
+    h = mix(h ^ ((const KValue *)this)->value().digest());
+  } else if (m_type == array_t) {
+    const KArray *array = (const KArray *)this;
+    Span<int64_t> ints;
+    Span<double> doubles;
+    Span<Data> data;
+    h = mix(h ^ array->size());
+    if (!array->as_int64_span(ints)) {
+      for (int64_t v : ints)
+	h = mix(h ^ value_digest(Data::int_t, (uint64_t)v));
+    } else if (!array->as_double_span(doubles)) {
+      for (double v : doubles) {
+	uint64_t bits;
+	memcpy(&bits, &v, sizeof(bits));
+	h = mix(h ^ value_digest(Data::double_t, bits));
+      }
+    } else if (!array->as_data_span(data)) {
+      for (const Data &d : data)
+	h = mix(h ^ d.digest());
+    }
+  } else if (m_type == list_t) {
+    h = mix(h ^ list_digest(*(const KList *)this));
+  } else if (m_type == pairs_t) {
+    for (const KPairs::Pair &pair : ((const KPairs *)this)->pairs())
+      h = mix(h ^ hash_id(pair.first) ^ mix(pair.second.digest()));
+  }
+  return h;
+}
+
+/**
+ * @name Entity - Constructor.
+ *
+ * This constructor initializes the Entity object.
+ */
+Entity::Entity() {
+  m_frozen = false;
+  m_key_blocks = NULL;
+  m_entity_blocks = NULL;
+  m_parent = NULL;
+  m_owner = NULL;
+  m_keys.clear();
+  m_entities.clear();
+  m_id.clear();
+}
+
+/**
+ * @name Entity - Constructor.
+ * @param resource: The memory resource of the entity contents.
+ *
+ * This constructor initializes the Entity object.
+ */
+Entity::Entity(memory_resource *resource)
+  : m_id(resource), m_keys(resource), m_entities(resource),
+    m_key_index(resource), m_entity_index(resource), m_frozen(false),
+    m_key_blocks(NULL), m_entity_blocks(NULL), m_parent(NULL), m_owner(NULL) {
+}
+
+/**
+ * @name operator new - Allocate an entity.
+ * @param size: The size of the entity object.
+ *
+ * Allocates an entity from the default memory resource.
+ *
+ * @return The memory of the entity.
+ */
+void *Entity::operator new(size_t size) {
+  return node_allocate(size, std::pmr::get_default_resource());
+}
+
+/**
+ * @name operator new - Allocate an entity.
+ * @param size: The size of the entity object.
+ * @param resource: The memory resource.
+ *
+ * Allocates an entity from the given memory resource.
+ *
+ * @return The memory of the entity.
+ */
+void *Entity::operator new(size_t size, memory_resource *resource) {
+  return node_allocate(size, resource);
+}
+
+/**
+ * @name operator delete - Release an entity.
+ * @param ptr: The memory of the entity.
+ *
+ * Returns the memory to the resource it was allocated from.
+ *
+ * @return Void.
+ */
+void Entity::operator delete(void *ptr) {
+  node_deallocate(ptr);
+}
+
+/**
+ * @name operator delete - Release an entity.
+ * @param ptr: The memory of the entity.
+ *
+ * Called when the constructor of an entity that was placed in a resource
+ * throws. The resource is recorded in the header of the memory.
+ *
+ * @return Void.
+ */
+void Entity::operator delete(void *ptr, memory_resource *) {
+  node_deallocate(ptr);
+}
+
+/**
+ * @name resource - Get the memory resource.
+ *
+ * @return The memory resource of the entity contents.
+ */
+memory_resource *Entity::resource() const {
+  return m_id.get_allocator().resource();
+}
+
+/**
+ * @name ~Entity - Destructor.
+ *
+ * Clears the entities and keys lists.
+ */
+Entity::~Entity() {
+  blocks_deallocate(m_key_blocks, m_keys.size(), resource());
+  blocks_deallocate(m_entity_blocks, m_entities.size(), resource());
+  while (!m_entities.empty()) {
+    Entity *front = m_entities.front();
+    delete front;
     m_entities.pop_front();
   }
 
@@ -543,8 +1498,8 @@ Entity::~Entity() {
  *
  * @return Void.
  */
-void Entity::set_id(const std::string id) {
-  m_id = id;
+void Entity::set_id(const std::string_view id) {
+  m_id.assign(id.data(), id.size());
 }
 
 /**
@@ -552,9 +1507,9 @@ void Entity::set_id(const std::string id) {
  *
  * This method returns the entity ID.
  *
- * @return The ID string.
+ * @return The ID string. It is valid as long as the entity.
  */
-string Entity::id() {
+string_view Entity::id() const {
   return m_id;
 }
 
@@ -568,11 +1523,23 @@ string Entity::id() {
  * @return The key object or NULL. The user should take
  *         care by properly deleting the returned object.
  */
-Key *Entity::find_key(std::string id) {
-  for (list<Key *>::iterator it = m_keys.begin(); it != m_keys.end(); ++it)
-    if ((*it)->id() == id)
-      return *it;
-  return NULL;
+Key *Entity::find_key(const std::string_view id) {
+  TraceLookup lookup(AccessTrace::key_l);
+  Key *key = m_key_index.find(id);
+  AccessTrace::read(key);
+  return key;
+}
+
+/**
+ * @name find_key - Search for a key of a const entity.
+ *
+ * @return The read-only key object or NULL.
+ */
+const Key *Entity::find_key(const std::string_view id) const {
+  TraceLookup lookup(AccessTrace::key_l);
+  const Key *key = m_key_index.find(id);
+  AccessTrace::read(key);
+  return key;
 }
 
 /**
@@ -585,11 +1552,67 @@ Key *Entity::find_key(std::string id) {
  * @return The entity object or NULL. The user should take
  *         care by properly deleting the returned object.
  */
-Entity *Entity::find_entity(std::string id) {
-  for (list<Entity *>::iterator it = m_entities.begin(); it != m_entities.end(); ++it)
-    if ((*it)->id() == id)
-      return *it;
-  return NULL;
+Entity *Entity::find_entity(const std::string_view id) {
+  TraceLookup lookup(AccessTrace::entity_l);
+  return m_entity_index.find(id);
+}
+
+/**
+ * @name find_entity - Search for an entity of a const entity.
+ *
+ * @return The read-only entity object or NULL.
+ */
+const Entity *Entity::find_entity(const std::string_view id) const {
+  TraceLookup lookup(AccessTrace::entity_l);
+  return m_entity_index.find(id);
+}
+
+/**
+ * @name find_key - Search for a key by a precomputed hash.
+ * @param id: The id of the key to search.
+ * @param hash: The hash_id() of the id.
+ *
+ * @return The key object or NULL.
+ */
+Key *Entity::find_key(const std::string_view id, const uint64_t hash) {
+  TraceLookup lookup(AccessTrace::key_l);
+  Key *key = m_key_index.find(id, hash);
+  AccessTrace::read(key);
+  return key;
+}
+
+/**
+ * @name find_key - Search for a key of a const entity.
+ *
+ * @return The read-only key object or NULL.
+ */
+const Key *Entity::find_key(const std::string_view id, const uint64_t hash) const {
+  TraceLookup lookup(AccessTrace::key_l);
+  const Key *key = m_key_index.find(id, hash);
+  AccessTrace::read(key);
+  return key;
+}
+
+/**
+ * @name find_entity - Search for an entity by a precomputed hash.
+ * @param id: The id of the entity to search.
+ * @param hash: The hash_id() of the id.
+ *
+ * @return The entity object or NULL.
+ */
+Entity *Entity::find_entity(const std::string_view id, const uint64_t hash) {
+  TraceLookup lookup(AccessTrace::entity_l);
+  return m_entity_index.find(id, hash);
+}
+
+/**
+ * @name find_entity - Search for an entity of a const entity.
+ *
+ * @return The read-only entity object or NULL.
+ */
+const Entity *Entity::find_entity(const std::string_view id, const uint64_t hash) const {
+  TraceLookup lookup(AccessTrace::entity_l);
+  return m_entity_index.find(id, hash);
 }
 
 /**
@@ -599,31 +1622,89 @@ Entity *Entity::find_entity(std::string id) {
  * This method inserts a new entity object into the list if it does
  * not already exist.
  *
- * @return Void.
+ * @return 0 on success, 1 if an entity with the same ID exists or the
+ *         tree is frozen.
  */
-void Entity::add_entity(Entity *entity) { 
-  if (!find_entity(entity->id())) {      
-    m_entities.push_back(entity);
-    if (m_entities.size() == 1)
-      m_it_entities = m_entities.begin();
-  }
+int32_t Entity::add_entity(Entity *entity) {
+  if (m_frozen || m_entity_index.find(entity->id()))
+    return 1;
+  entity->adopt(this, NULL);
+  m_entities.push_back(entity);
+  m_entity_index.insert(entity);
+  if (m_entities.size() == 1)
+    m_it_entities = m_entities.begin();
+  return 0;
 }
 
 /**
  * @name add_key - Insert a key into the key list.
- * @param key: The new entity.
+ * @param key: The new key.
  *
- * This method inserts a new entity object into the list if it does
+ * This method inserts a new key object into the list if it does
  * not already exist.
  *
- * @return Void
+ * @return 0 on success, 1 if a key with the same ID exists or the tree
+ *         is frozen.
+ */
+int32_t Entity::add_key(Key *key) {
+  if (m_frozen || m_key_index.find(key->id()))
+    return 1;
+  m_keys.push_back(key);
+  m_key_index.insert(key);
+  if (m_keys.size() == 1)
+    m_it_keys = m_keys.begin();
+  return 0;
+}
+
+/**
+ * @name remove_entity - Remove an entity and delete it.
+ * @param id: The ID of the entity.
+ *
+ * @return 0 on success, 1 if there is no such entity or the tree is
+ *         frozen.
+ */
+int32_t Entity::remove_entity(const std::string_view id) {
+  Entity *entity = m_frozen ? NULL : m_entity_index.find(id);
+
+  if (!entity)
+    return 1;
+  for (auto it = m_entities.begin(); it != m_entities.end(); ++it) {
+    if (*it == entity) {
+      if (m_it_entities == it)
+	++m_it_entities;
+      m_entities.erase(it);
+      break;
+    }
+  }
+  m_entity_index.erase(entity);
+  delete entity;
+  advance();
+  return 0;
+}
+
+/**
+ * @name remove_key - Remove a key and delete it.
+ * @param id: The ID of the key.
+ *
+ * @return 0 on success, 1 if there is no such key or the tree is frozen.
  */
-void Entity::add_key(Key *key) {
-  if (!find_key(key->id())) {      
-    m_keys.push_back(key);
-    if (m_keys.size() == 1)
-      m_it_keys = m_keys.begin();
+int32_t Entity::remove_key(const std::string_view id) {
+  Key *key = m_frozen ? NULL : m_key_index.find(id);
+
+  if (!key)
+    return 1;
+  for (auto it = m_keys.begin(); it != m_keys.end(); ++it) {
+    if (*it == key) {
+      if (m_it_keys == it)
+	++m_it_keys;
+      m_keys.erase(it);
+      break;
+    }
   }
+  m_key_index.erase(key);
+  delete key;
+  advance();
+  return 0;
 }
 
 /**
@@ -636,10 +1717,12 @@ void Entity::add_key(Key *key) {
  *         care by properly deleting the returned object.
  */
 Key *Entity::get_next_key() {
-  if (m_it_keys != m_keys.end() && !m_keys.empty()) {
+  if (!m_frozen && m_it_keys != m_keys.end() && !m_keys.empty()) {
     Key *key = *m_it_keys;
     ++m_it_keys;
     m_keys.pop_front();
+    m_key_index.erase(key);
+    advance();
     return key;
   } else {
     return NULL;
@@ -656,16 +1739,43 @@ Key *Entity::get_next_key() {
  *         care by properly deleting the returned object.
  */
 Entity *Entity::get_next_entity() {
-  if (m_it_entities != m_entities.end() && !m_entities.empty()) {
+  if (!m_frozen && m_it_entities != m_entities.end() && !m_entities.empty()) {
     Entity *entity = *m_it_entities;
     ++m_it_entities;
     m_entities.pop_front();
+    m_entity_index.erase(entity);
+    entity->adopt(NULL, NULL);
+    advance();
     return entity;
   } else {
     return NULL;
   }
 }
 
+/**
+ * @name keys - View the keys.
+ *
+ * This returns a read-only view over the keys in insertion order. Unlike
+ * get_next_key(), it does not remove the keys from the list.
+ *
+ * @return The view.
+ */
+Entity::KeyView Entity::keys() const {
+  return KeyView(m_keys.begin(), m_keys.end(), m_keys.size());
+}
+
+/**
+ * @name entities - View the entities.
+ *
+ * This returns a read-only view over the entities in insertion order.
+ * Unlike get_next_entity(), it does not remove the entities from the list.
+ *
+ * @return The view.
+ */
+Entity::EntityView Entity::entities() const {
+  return EntityView(m_entities.begin(), m_entities.end(), m_entities.size());
+}
+
 /**
  * @name clear_keys - Clears the keys list.
  *
@@ -674,11 +1784,16 @@ Entity *Entity::get_next_entity() {
  * @return Void.
  */
 void Entity::clear_keys() {
+  if (m_frozen)
+    return;
+  if (!m_keys.empty())
+    advance();
   while (!m_keys.empty()) {
     Key *front = m_keys.front();
     delete front;
     m_keys.pop_front();
   }
+  m_key_index.clear();
 }
 
 /**
@@ -689,11 +1804,16 @@ void Entity::clear_keys() {
  * @return Void.
  */
 void Entity::clear_entities() {
+  if (m_frozen)
+    return;
+  if (!m_entities.empty())
+    advance();
   while (!m_entities.empty()) {
     Entity *front = m_entities.front();
     delete front;
     m_entities.pop_front();
   }
+  m_entity_index.clear();
 }
 
 /**
@@ -727,7 +1847,7 @@ void Entity::reset_entities() {
  *
  * @return The number of keys in the list.
  */
-int32_t Entity::size_of_keys() {
+int32_t Entity::size_of_keys() const {
   return m_keys.size();
 }
 
@@ -738,18 +1858,103 @@ int32_t Entity::size_of_keys() {
  *
  * @return The number of entities in the list.
  */
-int32_t Entity::size_of_entities() {
+int32_t Entity::size_of_entities() const {
   return m_entities.size();
 }
 
+/**
+ * @name freeze - Make the entity and its sub-entities immutable.
+ *
+ * Computes the digest of the subtree and the run digests of large levels
+ * on the way.
+ *
+ * @return The digest.
+ */
+uint64_t Entity::freeze() {
+  uint64_t sum = 0;
+  size_t i = 0;
+
+  m_frozen = true;
+  m_it_keys = m_keys.begin();
+  m_it_entities = m_entities.begin();
+  m_key_blocks = blocks_allocate<Key>(m_keys.size(), resource());
+  m_entity_blocks = blocks_allocate<Entity>(m_entities.size(), resource());
+  for (auto it = m_keys.cbegin(); it != m_keys.cend(); ++it, i++) {
+    uint64_t digest = (*it)->digest();
+    sum += mix(digest);
+    blocks_add(m_key_blocks, i, it, digest);
+  }
+  i = 0;
+  for (auto it = m_entities.cbegin(); it != m_entities.cend(); ++it, i++) {
+    uint64_t digest = (*it)->freeze();
+    sum += mix(digest ^ ENTITY_SALT);
+    blocks_add(m_entity_blocks, i, it, digest);
+  }
+  m_digest = mix(hash_id(m_id) ^ sum);
+  return m_digest;
+}
+
+/*
+ * Advances the generation of the configuration that holds the entity, if
+ * any.
+ */
+void Entity::advance() {
+  const Entity *root = this;
+  while (root->m_parent)
+    root = root->m_parent;
+  if (root->m_owner)
+    root->m_owner->advance();
+}
+
+/*
+ * Records the entity or the configuration that holds the entity. Both are
+ * NULL for an entity that is not in a tree.
+ */
+void Entity::adopt(Entity *parent, Configuration *owner) {
+  m_parent = parent;
+  m_owner = owner;
+}
+
+/**
+ * @name frozen - Whether the entity is immutable.
+ *
+ * @return True if the configuration that holds it was frozen.
+ */
+bool Entity::frozen() const {
+  return m_frozen;
+}
+
+/**
+ * @name digest - Get the digest of the subtree.
+ *
+ * The digest covers the ID, the keys and the sub-entities, regardless of
+ * their order. It is computed when the entity is frozen.
+ *
+ * @return The digest, or 0 if the entity is not frozen.
+ */
+uint64_t Entity::digest() const {
+  return m_frozen ? m_digest : 0;
+}
+
 /**
  * @name Configuration - Constructor.
  *
  * This constructor initializes the Configuration object.
  */
-Configuration::Configuration() {
-  m_keys.clear();
-  m_entities.clear();
+Configuration::Configuration() : Configuration(std::pmr::get_default_resource()) {
+}
+
+/**
+ * @name Configuration - Constructor.
+ * @param resource: The memory resource of the tree.
+ *
+ * This constructor initializes a Configuration object whose entities and
+ * keys are allocated from the given memory resource.
+ */
+Configuration::Configuration(memory_resource *resource)
+  : m_resource(resource), m_keys(resource), m_entities(resource),
+    m_key_index(resource), m_entity_index(resource), m_frozen(false),
+    m_key_blocks(NULL), m_entity_blocks(NULL), m_generation(0) {
 }
 
 /**
@@ -758,6 +1963,8 @@ Configuration::Configuration() {
  * Clears the entities and keys lists.
  */
 Configuration::~Configuration() {
+  blocks_deallocate(m_key_blocks, m_keys.size(), m_resource);
+  blocks_deallocate(m_entity_blocks, m_entities.size(), m_resource);
   while (!m_keys.empty()) {
     Key *front = m_keys.front();
     delete front;
@@ -770,6 +1977,144 @@ Configuration::~Configuration() {
   }
 }
 
+/**
+ * @name resource - Get the memory resource.
+ *
+ * @return The memory resource of the tree.
+ */
+memory_resource *Configuration::resource() const {
+  return m_resource;
+}
+
+/**
+ * @name advance - Advance the generation.
+ *
+ * Called whenever an entity or a key is removed from the tree.
+ *
+ * @return Void.
+ */
+void Configuration::advance() {
+  m_generation++;
+}
+
+/**
+ * @name handle - Create a handle to a key.
+ * @param path: The dotted path of the key.
+ *
+ * @return A handle that resolves the path on its first use.
+ */
+Handle Configuration::handle(const std::string_view path) const {
+  return Handle(this, path);
+}
+
+/**
+ * @name remove_entity - Remove an entity and delete it.
+ * @param id: The ID of the entity.
+ *
+ * @return 0 on success, 1 if there is no such entity or the tree is
+ *         frozen.
+ */
+int32_t Configuration::remove_entity(const std::string_view id) {
+  Entity *entity = m_frozen ? NULL : m_entity_index.find(id);
+
+  if (!entity)
+    return 1;
+  for (auto it = m_entities.begin(); it != m_entities.end(); ++it) {
+    if (*it == entity) {
+      if (m_it_entities == it)
+	++m_it_entities;
+      m_entities.erase(it);
+      break;
+    }
+  }
+  m_entity_index.erase(entity);
+  delete entity;
+  advance();
+  return 0;
+}
+
+/**
+ * @name remove_key - Remove a key and delete it.
+ * @param id: The ID of the key.
+ *
+ * @return 0 on success, 1 if there is no such key or the tree is frozen.
+ */
+int32_t Configuration::remove_key(const std::string_view id) {
+  Key *key = m_frozen ? NULL : m_key_index.find(id);
+
+  if (!key)
+    return 1;
+  for (auto it = m_keys.begin(); it != m_keys.end(); ++it) {
+    if (*it == key) {
+      if (m_it_keys == it)
+	++m_it_keys;
+      m_keys.erase(it);
+      break;
+    }
+  }
+  m_key_index.erase(key);
+  delete key;
+  advance();
+  return 0;
+}
+
+/**
+ * @name replace_entity - Replace an entity and delete it.
+ * @param id: The ID of the entity.
+ * @param entity: The new entity, with the same ID.
+ *
+ * The new entity takes the place of the old one in the list.
+ *
+ * @return 0 on success, 1 if there is no such entity, the IDs differ or
+ *         the tree is frozen.
+ */
+int32_t Configuration::replace_entity(const std::string_view id, Entity *entity) {
+  Entity *old = m_frozen ? NULL : m_entity_index.find(id);
+
+  if (!old || entity->id() != id)
+    return 1;
+  entity->adopt(NULL, this);
+  for (auto it = m_entities.begin(); it != m_entities.end(); ++it) {
+    if (*it == old) {
+      *it = entity;
+      break;
+    }
+  }
+  m_entity_index.erase(old);
+  m_entity_index.insert(entity);
+  delete old;
+  advance();
+  return 0;
+}
+
+/**
+ * @name replace_key - Replace a key and delete it.
+ * @param id: The ID of the key.
+ * @param key: The new key, with the same ID.
+ *
+ * The new key takes the place of the old one in the list.
+ *
+ * @return 0 on success, 1 if there is no such key, the IDs differ or the
+ *         tree is frozen.
+ */
+int32_t Configuration::replace_key(const std::string_view id, Key *key) {
+  Key *old = m_frozen ? NULL : m_key_index.find(id);
+
+  if (!old || key->id() != id)
+    return 1;
+  for (auto it = m_keys.begin(); it != m_keys.end(); ++it) {
+    if (*it == old) {
+      *it = key;
+      break;
+    }
+  }
+  m_key_index.erase(old);
+  m_key_index.insert(key);
+  delete old;
+  advance();
+  return 0;
+}
+
 /**
  * @name get_next_key - Return the next key.
  *
@@ -780,10 +2125,12 @@ Configuration::~Configuration() {
  *         care by properly deleting the returned object.
  */
 Key *Configuration::get_next_key() {
-  if (m_it_keys != m_keys.end() && !m_keys.empty()) {
+  if (!m_frozen && m_it_keys != m_keys.end() && !m_keys.empty()) {
     Key *key = *m_it_keys;
     ++m_it_keys;
     m_keys.pop_front();
+    m_key_index.erase(key);
+    advance();
     return key;
   } else {
     return NULL;
@@ -800,10 +2147,13 @@ Key *Configuration::get_next_key() {
  *         care by properly deleting the returned object.
  */
 Entity *Configuration::get_next_entity() {
-  if (m_it_entities != m_entities.end() && !m_entities.empty()) {
+  if (!m_frozen && m_it_entities != m_entities.end() && !m_entities.empty()) {
     Entity *entity = *m_it_entities;
     ++m_it_entities;
     m_entities.pop_front();
+    m_entity_index.erase(entity);
+    entity->adopt(NULL, NULL);
+    advance();
     return entity;
   } else {
     return NULL;
@@ -820,11 +2170,23 @@ Entity *Configuration::get_next_entity() {
  * @return The key object or NULL. The user should take
  *         care by properly deleting the returned object.
  */
-Key *Configuration::find_key(std::string id) {
-  for (list<Key *>::iterator it = m_keys.begin(); it != m_keys.end(); ++it)
-    if ((*it)->id() == id)
-      return *it;
-  return NULL;
+Key *Configuration::find_key(const std::string_view id) {
+  TraceLookup lookup(AccessTrace::key_l);
+  Key *key = m_key_index.find(id);
+  AccessTrace::read(key);
+  return key;
+}
+
+/**
+ * @name find_key - Search for a key of a const configuration.
+ *
+ * @return The read-only key object or NULL.
+ */
+const Key *Configuration::find_key(const std::string_view id) const {
+  TraceLookup lookup(AccessTrace::key_l);
+  const Key *key = m_key_index.find(id);
+  AccessTrace::read(key);
+  return key;
 }
 
 /**
@@ -837,11 +2199,155 @@ Key *Configuration::find_key(std::string id) {
  * @return The entity object or NULL. The user should take
  *         care by properly deleting the returned object.
  */
-Entity *Configuration::find_entity(std::string id) {
-  for (list<Entity *>::iterator it = m_entities.begin(); it != m_entities.end(); ++it)
-    if ((*it)->id() == id)
-      return *it;
-  return NULL;
+Entity *Configuration::find_entity(const std::string_view id) {
+  TraceLookup lookup(AccessTrace::entity_l);
+  return m_entity_index.find(id);
+}
+
+/**
+ * @name find_entity - Search for an entity of a const configuration.
+ *
+ * @return The read-only entity object or NULL.
+ */
+const Entity *Configuration::find_entity(const std::string_view id) const {
+  TraceLookup lookup(AccessTrace::entity_l);
+  return m_entity_index.find(id);
+}
+
+/**
+ * @name find_key - Search for a key by a precomputed hash.
+ * @param id: The id of the key to search.
+ * @param hash: The hash_id() of the id.
+ *
+ * @return The key object or NULL.
+ */
+Key *Configuration::find_key(const std::string_view id, const uint64_t hash) {
+  TraceLookup lookup(AccessTrace::key_l);
+  Key *key = m_key_index.find(id, hash);
+  AccessTrace::read(key);
+  return key;
+}
+
+/**
+ * @name find_key - Search for a key of a const configuration.
+ *
+ * @return The read-only key object or NULL.
+ */
+const Key *Configuration::find_key(const std::string_view id, const uint64_t hash) const {
+  TraceLookup lookup(AccessTrace::key_l);
+  const Key *key = m_key_index.find(id, hash);
+  AccessTrace::read(key);
+  return key;
+}
+
+/**
+ * @name find_entity - Search for an entity by a precomputed hash.
+ * @param id: The id of the entity to search.
+ * @param hash: The hash_id() of the id.
+ *
+ * @return The entity object or NULL.
+ */
+Entity *Configuration::find_entity(const std::string_view id, const uint64_t hash) {
+  TraceLookup lookup(AccessTrace::entity_l);
+  return m_entity_index.find(id, hash);
+}
+
+/**
+ * @name find_entity - Search for an entity of a const configuration.
+ *
+ * @return The read-only entity object or NULL.
+ */
+const Entity *Configuration::find_entity(const std::string_view id, const uint64_t hash) const {
+  TraceLookup lookup(AccessTrace::entity_l);
+  return m_entity_index.find(id, hash);
+}
+
+/**
+ * @name find_path - Search for a key by its dotted path.
+ * @param path: The path of the key, e.g. "server.port". See Path for the
+ *              quoting of IDs that contain dots.
+ *
+ * Every segment but the last names an entity, and the last one names the
+ * key. The path is parsed as it is walked, without allocating.
+ *
+ * @return The key object or NULL.
+ */
+Key *Configuration::find_path(const std::string_view path) {
+  TraceLookup lookup(AccessTrace::path_l);
+  return path_find_key(this, path);
+}
+
+/**
+ * @name find_path - Search for a key by its path of a const configuration.
+ *
+ * @return The read-only key object or NULL.
+ */
+const Key *Configuration::find_path(const std::string_view path) const {
+  TraceLookup lookup(AccessTrace::path_l);
+  return path_find_key(this, path);
+}
+
+/**
+ * @name find_path - Search for a key by a precompiled path.
+ * @param path: The path of the key.
+ *
+ * @return The key object or NULL.
+ */
+Key *Configuration::find_path(const Path &path) {
+  TraceLookup lookup(AccessTrace::path_l);
+  return path_find_key(this, path);
+}
+
+/**
+ * @name find_path - Search for a key by its path of a const configuration.
+ *
+ * @return The read-only key object or NULL.
+ */
+const Key *Configuration::find_path(const Path &path) const {
+  TraceLookup lookup(AccessTrace::path_l);
+  return path_find_key(this, path);
+}
+
+/**
+ * @name find_entity_path - Search for an entity by its dotted path.
+ * @param path: The path of the entity, e.g. data_server."disk.1".
+ *
+ * @return The entity object or NULL.
+ */
+Entity *Configuration::find_entity_path(const std::string_view path) {
+  TraceLookup lookup(AccessTrace::entity_path_l);
+  return path_find_entity(this, path);
+}
+
+/**
+ * @name find_entity_path - Search for an entity by its path of a const configuration.
+ *
+ * @return The read-only entity object or NULL.
+ */
+const Entity *Configuration::find_entity_path(const std::string_view path) const {
+  TraceLookup lookup(AccessTrace::entity_path_l);
+  return path_find_entity(this, path);
+}
+
+/**
+ * @name find_entity_path - Search for an entity by a precompiled path.
+ * @param path: The path of the entity.
+ *
+ * @return The entity object or NULL.
+ */
+Entity *Configuration::find_entity_path(const Path &path) {
+  TraceLookup lookup(AccessTrace::entity_path_l);
+  return path_find_entity(this, path);
+}
+
+/**
+ * @name find_entity_path - Search for an entity by its path of a const configuration.
+ *
+ * @return The read-only entity object or NULL.
+ */
+const Entity *Configuration::find_entity_path(const Path &path) const {
+  TraceLookup lookup(AccessTrace::entity_path_l);
+  return path_find_entity(this, path);
 }
 
 /**
@@ -851,30 +2357,147 @@ Entity *Configuration::find_entity(std::string id) {
  * This method inserts a new entity object into the list if it does
  * not already exist.
  *
- * @return Void.
+ * @return 0 on success, 1 if an entity with the same ID exists or the
+ *         tree is frozen.
  */
-void Configuration::add_entity(Entity *entity) {
-  if (!find_entity(entity->id())) {      
-    m_entities.push_back(entity);
-    if (m_entities.size() == 1)
-      m_it_entities = m_entities.begin();
-  }
+int32_t Configuration::add_entity(Entity *entity) {
+  if (m_frozen || m_entity_index.find(entity->id()))
+    return 1;
+  entity->adopt(NULL, this);
+  m_entities.push_back(entity);
+  m_entity_index.insert(entity);
+  if (m_entities.size() == 1)
+    m_it_entities = m_entities.begin();
+  return 0;
 }
 
 /**
  * @name add_key - Insert a key into the key list.
- * @param key: The new entity.
+ * @param key: The new key.
  *
- * This method inserts a new entity object into the list.
+ * This method inserts a new key object into the list if it does
+ * not already exist.
+ *
+ * @return 0 on success, 1 if a key with the same ID exists or the tree
+ *         is frozen.
+ */
+int32_t Configuration::add_key(Key *key) {
+  if (m_frozen || m_key_index.find(key->id()))
+    return 1;
+  m_keys.push_back(key);
+  m_key_index.insert(key);
+  if (m_keys.size() == 1)
+    m_it_keys = m_keys.begin();
+  return 0;
+}
+
+/**
+ * @name merge - Move the contents of another configuration into this one.
+ * @param other: The configuration to empty. It must use a memory resource
+ *               that outlives this configuration.
+ *
+ * The keys and entities of other are appended in order. As with
+ * add_key() and add_entity(), the ones whose ID is already defined here
+ * are deleted. Nothing is moved if either configuration is frozen.
  *
  * @return Void.
  */
-void Configuration::add_key(Key *key) {
-  if (!find_key(key->id())) {      
-    m_keys.push_back(key);
-    if (m_keys.size() == 1)
-      m_it_keys = m_keys.begin();
+void Configuration::merge(Configuration *other) {
+  if (m_frozen || other->m_frozen || (other->m_keys.empty() && other->m_entities.empty()))
+    return;
+  for (Key *key : other->m_keys)
+    if (add_key(key))
+      delete key;
+  for (Entity *entity : other->m_entities)
+    if (add_entity(entity))
+      delete entity;
+  other->m_keys.clear();
+  other->m_entities.clear();
+  other->m_key_index.clear();
+  other->m_entity_index.clear();
+  other->advance();
+  advance();
+}
+
+/**
+ * @name freeze - Make the configuration immutable.
+ *
+ * Freezes the configuration and all of its entities. Afterwards, adding,
+ * removing, clearing and merging fail or do nothing, so the tree never
+ * changes again. The configuration is returned as a const object, which
+ * only gives read access to the tree and can be shared by any number of
+ * threads without synchronization. The digests of the configuration and
+ * of every entity, and the run digests of the levels with more than
+ * DigestBlock::length keys or entities, are computed on the way.
+ *
+ * @return The frozen configuration.
+ */
+const Configuration *Configuration::freeze() {
+  uint64_t sum = 0;
+  size_t i = 0;
+
+  if (m_frozen)
+    return this;
+  m_frozen = true;
+  m_it_keys = m_keys.begin();
+  m_it_entities = m_entities.begin();
+  m_key_blocks = blocks_allocate<Key>(m_keys.size(), m_resource);
+  m_entity_blocks = blocks_allocate<Entity>(m_entities.size(), m_resource);
+  for (auto it = m_keys.cbegin(); it != m_keys.cend(); ++it, i++) {
+    uint64_t digest = (*it)->digest();
+    sum += mix(digest);
+    blocks_add(m_key_blocks, i, it, digest);
+  }
+  i = 0;
+  for (auto it = m_entities.cbegin(); it != m_entities.cend(); ++it, i++) {
+    uint64_t digest = (*it)->freeze();
+    sum += mix(digest ^ ENTITY_SALT);
+    blocks_add(m_entity_blocks, i, it, digest);
   }
+  m_digest = mix(sum);
+  return this;
+}
+
+/**
+ * @name frozen - Whether the configuration is immutable.
+ *
+ * @return True after freeze().
+ */
+bool Configuration::frozen() const {
+  return m_frozen;
+}
+
+/**
+ * @name digest - Get the digest of the tree.
+ *
+ * @return The digest, or 0 if the configuration is not frozen.
+ */
+uint64_t Configuration::digest() const {
+  return m_frozen ? m_digest : 0;
+}
+
+/**
+ * @name keys - View the keys.
+ *
+ * This returns a read-only view over the keys in insertion order. Unlike
+ * get_next_key(), it does not remove the keys from the list.
+ *
+ * @return The view.
+ */
+Configuration::KeyView Configuration::keys() const {
+  return KeyView(m_keys.begin(), m_keys.end(), m_keys.size());
+}
+
+/**
+ * @name entities - View the entities.
+ *
+ * This returns a read-only view over the entities in insertion order.
+ * Unlike get_next_entity(), it does not remove the entities from the list.
+ *
+ * @return The view.
+ */
+Configuration::EntityView Configuration::entities() const {
+  return EntityView(m_entities.begin(), m_entities.end(), m_entities.size());
 }
 
 /**
@@ -885,11 +2508,16 @@ void Configuration::add_key(Key *key) {
  * @return Void.
  */
 void Configuration::clear_keys() {
+  if (m_frozen)
+    return;
+  if (!m_keys.empty())
+    advance();
   while (!m_keys.empty()) {
     Key *front = m_keys.front();
     delete front;
     m_keys.pop_front();
   }
+  m_key_index.clear();
 }
 
 /**
@@ -900,11 +2528,42 @@ void Configuration::clear_keys() {
  * @return Void.
  */
 void Configuration::clear_entities() {
+  if (m_frozen)
+    return;
+  if (!m_entities.empty())
+    advance();
   while (!m_entities.empty()) {
     Entity *front = m_entities.front();
     delete front;
     m_entities.pop_front();
   }
+  m_entity_index.clear();
+}
+
+/**
+ * @name detach - Empty the configuration without deleting its contents.
+ *
+ * Removes every key and entity from the lists and the indexes but does not
+ * delete them. The caller keeps the objects, e.g. from the keys() and
+ * entities() views, and must add them to a tree or delete them.
+ *
+ * @return 0 on success, 1 if the tree is frozen.
+ */
+int32_t Configuration::detach() {
+  if (m_frozen)
+    return 1;
+  if (m_keys.empty() && m_entities.empty())
+    return 0;
+  for (Entity *entity : m_entities)
+    entity->adopt(NULL, NULL);
+  m_keys.clear();
+  m_entities.clear();
+  m_key_index.clear();
+  m_entity_index.clear();
+  m_it_keys = m_keys.end();
+  m_it_entities = m_entities.end();
+  advance();
+  return 0;
 }
 
 /**
@@ -938,7 +2597,7 @@ void Configuration::reset_entities() {
  *
  * @return The number of keys.
  */
-int32_t Configuration::size_of_keys() {
+int32_t Configuration::size_of_keys() const {
   return m_keys.size();
 }
 
@@ -949,7 +2608,65 @@ int32_t Configuration::size_of_keys() {
  *
  * @return The number of entities.
  */
-int32_t Configuration::size_of_entities() {
+int32_t Configuration::size_of_entities() const {
   return m_entities.size();
 }
 
+
+/**
+ * @name Handle - Constructor.
+ *
+ * Creates a handle that resolves to nothing.
+ */
+Handle::Handle()
+  : m_conf(NULL), m_source(NULL), m_key(NULL), m_data(NULL), m_generation(0), m_version(0) {}
+
+/**
+ * @name Handle - Constructor.
+ * @param conf: The configuration.
+ * @param path: The dotted path of the key.
+ *
+ * Parses the path. It is resolved on the first use of the handle.
+ */
+Handle::Handle(const Configuration *conf, const std::string_view path)
+  : m_conf(conf), m_source(NULL), m_path(path), m_key(NULL), m_data(NULL), m_generation(0),
+    m_version(0) {}
+
+/**
+ * @name Handle - Constructor.
+ * @param source: The published version to follow.
+ * @param path: The dotted path of the key.
+ *
+ * Parses the path. It is resolved on the first use of the handle.
+ */
+Handle::Handle(const std::atomic<Published *> *source, const std::string_view path)
+  : m_conf(NULL), m_source(source), m_path(path), m_key(NULL), m_data(NULL), m_generation(0),
+    m_version(0) {}
+
+/**
+ * @name path - Get the path.
+ *
+ * @return The path of the key.
+ */
+const Path &Handle::path() const {
+  return m_path;
+}
+
+/**
+ * @name resolve - Resolve the path.
+ *
+ * Looks the key up again, in the published version if the handle follows
+ * one, and records the generation of the configuration.
+ *
+ * @return Void.
+ */
+void Handle::resolve() const {
+  if (m_source) {
+    const Published *current = m_source->load(std::memory_order_acquire);
+    m_conf = current ? current->conf : NULL;
+    m_version = current ? current->number : 0;
+  }
+  m_generation = m_conf ? m_conf->generation() : 0;
+  m_key = m_conf ? m_conf->find_path(m_path) : NULL;
+  m_data = Configuration::value_data(m_key);
+}
@@ -16,20 +16,101 @@
 #define CONFIGURATION_H
 
 #include <stdint.h>
+#include <atomic>
 #include <string>
+#include <string_view>
 #include <sstream>
+#include <limits>
 #include <list>
 #include <map>
+#include <memory_resource>
+#include <type_traits>
 #include <utility>
+#include <vector>
+#include "index.h"
+#include "path.h"
+#include "trace.h"
+
+/**
+ * @name View - A read-only view over a container.
+ *
+ * This class gives const, range-for compatible access to the elements of a
+ * list held by a configuration object. It does not copy, allocate or
+ * consume the elements, so the same object can be walked any number of
+ * times and by any number of readers. T is the type that dereferencing an
+ * iterator yields, e.g. const Key * for a list of Key pointers or
+ * const Data & for a list of Data objects. The view is valid as long as
+ * the container is not modified.
+ */
+template <typename Iter, typename T>
+class View {
+ public:
+  class iterator {
+   private:
+    Iter m_it;
+
+   public:
+    explicit iterator(Iter it) : m_it(it) {}
+    T operator*() const { return *m_it; }
+    iterator &operator++() { ++m_it; return *this; }
+    iterator operator++(int) { iterator old = *this; ++m_it; return old; }
+    bool operator==(const iterator &other) const { return m_it == other.m_it; }
+    bool operator!=(const iterator &other) const { return m_it != other.m_it; }
+  };
+
+ private:
+  Iter m_begin;
+  Iter m_end;
+  size_t m_size;
+
+ public:
+  View(Iter begin, Iter end, size_t size) : m_begin(begin), m_end(end), m_size(size) {}
+
+  iterator begin() const { return iterator(m_begin); }
+  iterator end() const { return iterator(m_end); }
+  size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+};
+
+/**
+ * @name Span - A read-only view over contiguous elements.
+ *
+ * This class gives const, range-for compatible access to elements that are
+ * stored one after the other, e.g. the integers of an array. The view is
+ * valid as long as the elements are not modified.
+ */
+template <typename T>
+class Span {
+ private:
+  const T *m_data;
+  size_t m_size;
+
+ public:
+  Span() : m_data(NULL), m_size(0) {}
+  Span(const T *data, size_t size) : m_data(data), m_size(size) {}
+
+  const T *data() const { return m_data; }
+  size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+  const T &operator[](size_t index) const { return m_data[index]; }
+  const T *begin() const { return m_data; }
+  const T *end() const { return m_data + m_size; }
+};
 
 /**
  * @name Data - The data object.
  *
- * This class defines the data object. it uses a string buffer to store
- * the data. The data can be either a string, an itneger, or a double.
- * The get method uses a template type to return the correct type.
+ * This class defines the data object. The data can be either a string, an
+ * integer, or a double. Numbers are converted once, when the data is set,
+ * and are stored in place, so reading them does not parse or allocate.
+ * The as_*() methods return the value in its stored type, while the data
+ * method uses a template type to convert it to any type. Strings are
+ * allocated from a memory resource, which the containers of the tree pass
+ * on to the data objects they hold.
  */
 class Data {
+  friend class MemoryWalk;
+
  public:
   enum Type 
   {
@@ -38,41 +119,73 @@ class Data {
     string_t,
     none_t
   };
+  typedef std::pmr::polymorphic_allocator<char> allocator_type;
 
  private:
   Type m_type;
-  std::string m_data;
+  union {
+    int64_t m_int;
+    double m_double;
+  };
+  std::pmr::string m_str;
 
  public: 
   explicit Data(const Data::Type type);
   explicit Data();
+  explicit Data(const allocator_type &alloc);
+  Data(const Data &data) = default;
+  Data(Data &&data) = default;
+  Data(const Data &data, const allocator_type &alloc);
+  Data(Data &&data, const allocator_type &alloc);
   ~Data();
+
+  Data &operator=(const Data &data) = default;
+  Data &operator=(Data &&data) = default;
   
-  Data::Type type();
-  void set_data(const std::string data, const Data::Type type);
+  Data::Type type() const;
+  int32_t set_data(const std::string_view data, const Data::Type type);
+  void set_int64(const int64_t value);
+  void set_double(const double value);
+  void set_string(const std::string_view value);
+
+  int32_t as_int64(int64_t &value) const;
+  int32_t as_double(double &value) const;
+  int32_t as_string_view(std::string_view &value) const;
+
+  uint64_t digest() const;
+
   template<typename T> 
-  T data() {
-    T result;
+  T data() const {
+    if constexpr (std::is_arithmetic_v<T>) {
+      if (m_type == int_t)
+	return (T)m_int;
+      if (m_type == double_t)
+	return (T)m_double;
+    } else if constexpr (std::is_same_v<T, std::string>) {
+      return data_str();
+    }
+    T result = T();
     std::stringstream ss(std::stringstream::in | std::stringstream::out);
-    if (m_type == double_t) {
-      // Keep precision.
-      ss.precision(m_data.length());
-      ss << std::fixed;
-    }    
-    ss << m_data;
+    ss << data_str();
     ss >> result;
     return result;
   }
-  std::string data_str();
+  std::string data_str() const;
   
 };
 
 /**
  * @name Key - The Key object.
  *
- * This class defines the base key object which holds its type.
+ * This class defines the base key object which holds its type. Keys and
+ * their contents are allocated from a memory resource. Plain new and
+ * delete use the default resource; new (resource) places a key in the
+ * given one. Either way, delete returns the key to the resource it came
+ * from.
  */
 class Key {
+  friend class MemoryWalk;
+
  public:
   enum Type 
   {
@@ -84,56 +197,138 @@ class Key {
     
  private:
   Type m_type;
-  std::string m_id;
+  std::pmr::string m_id;
 
  public:
   Key();
+  explicit Key(std::pmr::memory_resource *resource);
   virtual ~Key();
 
+  static void *operator new(size_t size);
+  static void *operator new(size_t size, std::pmr::memory_resource *resource);
+  static void operator delete(void *ptr);
+  static void operator delete(void *ptr, std::pmr::memory_resource *resource);
+
+  std::pmr::memory_resource *resource() const;
+
   void set_type(const Key::Type type);
-  Key::Type type();
-  void set_id(const std::string id);
-  std::string id();
+  Key::Type type() const;
+  void set_id(const std::string_view id);
+  std::string_view id() const;
+
+  uint64_t digest() const;
 };
 
 class KPairs : public Key {
+  friend class MemoryWalk;
+
+ public:
+  typedef std::pair<std::pmr::string, Data> Pair;
+  typedef View<std::pmr::list<Pair>::const_iterator, const Pair &> PairView;
+
  private:
-  std::list<std::pair<std::string, Data> > m_list;
-  std::list<std::pair<std::string, Data> >::iterator m_it;
+  std::pmr::list<Pair> m_list;
+  std::pmr::list<Pair>::iterator m_it;
 
  public:
   KPairs();
+  explicit KPairs(std::pmr::memory_resource *resource);
   ~KPairs();
-  void insert(const std::string key, const Data value);
+  void insert(const std::string_view key, Data value);
   std::pair<std::string, Data> *get_next();
+  PairView pairs() const;
   void clear();
   void reset();
-  int32_t size();
+  int32_t size() const;
+};
+
+class KList;
+class Configuration;
+class Handle;
+
+/**
+ * @name KListNode - A list inside a KList.
+ *
+ * This class is a read-only view of a list that is stored in a KList,
+ * either the top list or one of its sub-lists. It is valid as long as
+ * the KList is not modified.
+ */
+class KListNode {
+ public:
+  class iterator {
+   private:
+    const KList *m_klist;
+    uint32_t m_index;
+
+   public:
+    iterator(const KList *klist, uint32_t index) : m_klist(klist), m_index(index) {}
+    KListNode operator*() const { return KListNode(m_klist, m_index); }
+    iterator &operator++() { ++m_index; return *this; }
+    iterator operator++(int) { iterator old = *this; ++m_index; return old; }
+    bool operator==(const iterator &other) const { return m_index == other.m_index; }
+    bool operator!=(const iterator &other) const { return m_index != other.m_index; }
+  };
+  typedef Span<Data> DataView;
+  typedef View<iterator, KListNode> KListView;
+
+ private:
+  const KList *m_klist;
+  uint32_t m_index;
+
+ public:
+  KListNode(const KList *klist, uint32_t index) : m_klist(klist), m_index(index) {}
+
+  DataView data() const;
+  KListView klists() const;
+  int32_t size_of_data() const;
+  int32_t size_of_klist() const;
 };
 
 /**
  * @name KList - The Key List.
  *
  * This class defines a key list object which holds a list
- * of data objects or a list of lists.
+ * of data objects or a list of lists. The lists are flattened into two
+ * arrays: one with the data objects and one with a node per list. Each
+ * node holds the range of its data objects and the range of its
+ * sub-lists, so the sub-lists of a list are read in place through
+ * KListNode views. Node 0 is the top list.
  */
 class KList : public Key {
+  friend class KListNode;
+  friend class KListBuilder;
+  friend class MemoryWalk;
+
+ public:
+  typedef KListNode::DataView DataView;
+  typedef KListNode::KListView KListView;
+  typedef std::pmr::polymorphic_allocator<char> allocator_type;
+
  private:
-  std::list<Data> m_data;
-  std::list<KList> m_list;
-  std::list<Data>::iterator m_it_data;
-  std::list<KList>::iterator m_it_list;
+  struct Node {
+    uint32_t first_data;
+    uint32_t size_of_data;
+    uint32_t first_klist;
+    uint32_t size_of_klist;
+  };
+  std::pmr::vector<Data> m_data;
+  std::pmr::vector<Node> m_nodes;
 
  public:
   KList();
+  explicit KList(std::pmr::memory_resource *resource);
   KList(KList *kl_ptr);
+  KList(const KList &klist, const allocator_type &alloc = allocator_type());
   ~KList();
 
-  void insert_data(const Data data);
-  void insert_klist(const KList klist);
+  void insert_data(Data data);
+  void insert_klist(const KList &klist);
 
   Data *get_next_data();
   KList *get_next_klist();
+
+  DataView data() const;
+  KListView klists() const;
   
   void clear_data();
   void clear_klist();
@@ -141,26 +336,92 @@ class KList : public Key {
   void reset_data();
   void reset_klist();
   
-  int32_t size_of_data();
-  int32_t size_of_klist();
+  int32_t size_of_data() const;
+  int32_t size_of_klist() const;
+
+ private:
+  void copy_node(const KList &klist, const uint32_t src, const uint32_t dst);
+};
+
+/**
+ * @name KListBuilder - The KList builder.
+ *
+ * This class fills a KList from a stream of values and sub-list
+ * boundaries, in the order they appear in the text. The values and the
+ * nodes of the open lists are kept on two stacks and are moved into the
+ * KList when their list ends, so the data objects of each list and the
+ * sub-lists of each list end up next to each other. The stacks are reused
+ * from one list to the next.
+ */
+class KListBuilder {
+ private:
+  struct Frame {
+    size_t first_data;
+    size_t first_klist;
+  };
+  KList *m_klist;
+  std::vector<Data> m_data;
+  std::vector<KList::Node> m_nodes;
+  std::vector<Frame> m_frames;
+
+ public:
+  KListBuilder();
+  ~KListBuilder();
+
+  void begin(KList *klist);
+  void begin_klist();
+  void insert_data(Data data);
+  void end_klist();
+  void end();
+  void clear();
+
+ private:
+  KList::Node flush();
 };
 
 /**
  * @name KArray - The Key Array.
  *
  * This class defines a key array object which holds an array
- * of data objects.
+ * of data objects. The elements are stored contiguously. An array whose
+ * elements are all integers or all doubles is stored unboxed, as a plain
+ * array of int64_t or double; any other array is stored as Data objects.
+ *
+ * operator[] only reads: it returns a copy of an element, since unboxed
+ * elements have no Data object to refer to. Code that assigned to an
+ * element through operator[] must call set_data() instead.
  */
 class KArray : public Key {
+  friend class MemoryWalk;
+
  private:
-  std::map<int32_t, Data> m_array;
+  Data::Type m_type;
+  std::pmr::vector<int64_t> m_ints;
+  std::pmr::vector<double> m_doubles;
+  std::pmr::vector<Data> m_data;
 
  public:
   KArray();
+  explicit KArray(std::pmr::memory_resource *resource);
   ~KArray();
 
-  Data &operator[] (int32_t index);
-  int32_t size();
+  void insert_data(Data data);
+  int32_t set_data(const int32_t index, Data data);
+
+  Data::Type data_type() const;
+  int32_t at(const int32_t index, int64_t &value) const;
+  int32_t at(const int32_t index, double &value) const;
+  int32_t at(const int32_t index, std::string_view &value) const;
+
+  int32_t as_int64_span(Span<int64_t> &values) const;
+  int32_t as_double_span(Span<double> &values) const;
+  int32_t as_data_span(Span<Data> &values) const;
+
+  Data operator[] (const int32_t index) const;
+  int32_t size() const;
+
+ private:
+  void box();
  };
 
 /**
@@ -170,15 +431,40 @@ class KArray : public Key {
  * data object.
  */
 class KValue : public Key {
+  friend class MemoryWalk;
+
  private:
   Data m_value;
 
  public:
   KValue();
+  explicit KValue(std::pmr::memory_resource *resource);
   ~KValue();
 
-  void set_value(const Data value);
-  Data value();
+  void set_value(Data value);
+  const Data &value() const;
+};
+
+/**
+ * @name DigestBlock - The digest of a run of keys or entities.
+ *
+ * A frozen level with more than one run of length objects keeps the
+ * digest of every run, combined in order, and the position of its first
+ * object, so that diff() can step over the runs that did not change.
+ */
+template <typename T>
+struct DigestBlock {
+  static constexpr size_t length = 64;
+
+  uint64_t digest;
+  typename std::pmr::list<T *>::const_iterator first;
+
+  /*
+   * The number of runs that a level of size objects keeps.
+   */
+  static size_t count(const size_t size) {
+    return size > length ? (size + length - 1) / length : 0;
+  }
 };
 
 /**
@@ -188,31 +474,81 @@ class KValue : public Key {
  * independent component. It holds the entity ID, as well as two lists:
  * one that holds the 1-level nested entities and another one that holds
  * the keys. It also includes two iterators which help to get the
- * contained entities and keys.
+ * contained entities and keys. Both lists are indexed by ID and can be
+ * walked without consuming them through the keys() and entities() views.
+ * Like keys, entities are allocated from a memory resource. An entity
+ * knows the entity or the configuration that holds it, so that removals
+ * advance the generation of its configuration.
+ *
+ * The find methods of a const entity return const objects, so a const
+ * entity can only be read. A frozen entity refuses every change and keeps
+ * a digest of its subtree.
  */
 class Entity {
+  friend class Configuration;
+  friend class MemoryWalk;
+  friend class DiffWalk;
+
+ public:
+  typedef View<std::pmr::list<Key *>::const_iterator, const Key *> KeyView;
+  typedef View<std::pmr::list<Entity *>::const_iterator, const Entity *> EntityView;
+
  private:
-  std::string m_id;
-  std::list<Key *> m_keys;
-  std::list<Entity *> m_entities;
-  std::list<Key *>::iterator m_it_keys;
-  std::list<Entity *>::iterator m_it_entities;
+  std::pmr::string m_id;
+  std::pmr::list<Key *> m_keys;
+  std::pmr::list<Entity *> m_entities;
+  std::pmr::list<Key *>::iterator m_it_keys;
+  std::pmr::list<Entity *>::iterator m_it_entities;
+  Index<Key> m_key_index;
+  Index<Entity> m_entity_index;
+  bool m_frozen;
+  uint64_t m_digest;
+  DigestBlock<Key> *m_key_blocks;
+  DigestBlock<Entity> *m_entity_blocks;
+  Entity *m_parent;
+  Configuration *m_owner;
+
+  uint64_t freeze();
+  void advance();
+  void adopt(Entity *parent, Configuration *owner);
 
  public:
   Entity();
+  explicit Entity(std::pmr::memory_resource *resource);
   ~Entity();
 
-  void set_id(const std::string id);
-  std::string id();
+  static void *operator new(size_t size);
+  static void *operator new(size_t size, std::pmr::memory_resource *resource);
+  static void operator delete(void *ptr);
+  static void operator delete(void *ptr, std::pmr::memory_resource *resource);
 
-  Key *find_key(std::string id);
-  Entity *find_entity(std::string id);
+  std::pmr::memory_resource *resource() const;
+
+  void set_id(const std::string_view id);
+  std::string_view id() const;
+
+  Key *find_key(const std::string_view id);
+  Entity *find_entity(const std::string_view id);
+  Key *find_key(const std::string_view id, const uint64_t hash);
+  Entity *find_entity(const std::string_view id, const uint64_t hash);
+  const Key *find_key(const std::string_view id) const;
+  const Entity *find_entity(const std::string_view id) const;
+  const Key *find_key(const std::string_view id, const uint64_t hash) const;
+  const Entity *find_entity(const std::string_view id, const uint64_t hash) const;
+
+  bool frozen() const;
+  uint64_t digest() const;
   
-  void add_entity(Entity *entity);
-  void add_key(Key *key);
+  int32_t add_entity(Entity *entity);
+  int32_t add_key(Key *key);
+  int32_t remove_entity(const std::string_view id);
+  int32_t remove_key(const std::string_view id);
 
   Key *get_next_key();
   Entity *get_next_entity();
+
+  KeyView keys() const;
+  EntityView entities() const;
   
   void clear_keys();
   void clear_entities();
@@ -220,46 +556,305 @@ class Entity {
   void reset_keys();
   void reset_entities();
   
-  int32_t size_of_keys();
-  int32_t size_of_entities();
+  int32_t size_of_keys() const;
+  int32_t size_of_entities() const;
 };
 
+/**
+ * @name value_or - Read a value in the type of a typed getter.
+ * @param data: The data or NULL. D is Data or any type with the same
+ *               as_int64(), as_double() and as_string_view() methods.
+ * @param fallback: The value to return if there is no matching value.
+ *
+ * T can be an integral type, a floating point type, std::string_view or
+ * std::string. Integral types need an integer that fits in T, floating
+ * point types a number and the string types a string.
+ *
+ * @return The value or the fallback.
+ */
+template <typename T, typename D>
+T value_or(const D *data, const T &fallback) {
+  if (!data)
+    return fallback;
+  if constexpr (std::is_integral_v<T>) {
+    int64_t value;
+    if (data->as_int64(value))
+      return fallback;
+    if constexpr (std::is_signed_v<T>) {
+      if (value < (int64_t)std::numeric_limits<T>::min() ||
+	  value > (int64_t)std::numeric_limits<T>::max())
+	return fallback;
+    } else {
+      if (value < 0 || (uint64_t)value > (uint64_t)std::numeric_limits<T>::max())
+	return fallback;
+    }
+    return (T)value;
+  } else if constexpr (std::is_floating_point_v<T>) {
+    double value;
+    return data->as_double(value) ? fallback : (T)value;
+  } else {
+    static_assert(std::is_same_v<T, std::string_view> || std::is_same_v<T, std::string>,
+		  "get() supports numbers and strings");
+    std::string_view value;
+    return data->as_string_view(value) ? fallback : T(value);
+  }
+}
+
 /**
  * @name Configuration - The Configuration object.
  *
  * This class defines the configuration object which is used to describe
  * a system. It holds two lists: one that holds the 1-level entities and
  * another one that holds the keys. It also includes two iterators which
- * help to get the contained entities and keys.
+ * help to get the contained entities and keys. Both lists are indexed by ID
+ * and can be walked without consuming them through the keys() and
+ * entities() views.
+ *
+ * The whole tree is allocated from the memory resource of the
+ * configuration. Use create() to allocate its entities and keys.
+ *
+ * A generation counter is advanced whenever an entity or a key is removed
+ * from the tree, so that handles know when to resolve their path again.
+ *
+ * freeze() makes the tree immutable and returns it as a const object.
+ * Lookups, views and typed reads of a const configuration return const
+ * objects and change no state, so any number of threads can read a frozen
+ * configuration without synchronization. Handles cache their result and
+ * belong to one thread each.
  */
 class Configuration {
+  friend class Entity;
+  friend class Handle;
+  friend class MemoryWalk;
+  friend class DiffWalk;
+
+ public:
+  typedef Entity::KeyView KeyView;
+  typedef Entity::EntityView EntityView;
+
  private:
-  std::list<Key *> m_keys;
-  std::list<Entity *> m_entities;
-  std::list<Key *>::iterator m_it_keys;
-  std::list<Entity *>::iterator m_it_entities;
+  std::pmr::memory_resource *m_resource;
+  std::pmr::list<Key *> m_keys;
+  std::pmr::list<Entity *> m_entities;
+  std::pmr::list<Key *>::iterator m_it_keys;
+  std::pmr::list<Entity *>::iterator m_it_entities;
+  Index<Key> m_key_index;
+  Index<Entity> m_entity_index;
+  bool m_frozen;
+  uint64_t m_digest;
+  DigestBlock<Key> *m_key_blocks;
+  DigestBlock<Entity> *m_entity_blocks;
+  uint64_t m_generation;
 
  public:
   Configuration();
+  explicit Configuration(std::pmr::memory_resource *resource);
   ~Configuration();
 
-  Key *find_key(std::string id);
-  Entity *find_entity(std::string id);
-  
-  void add_entity(Entity *entity);
-  void add_key(Key *key);
+  std::pmr::memory_resource *resource() const;
+
+  /**
+   * @name create - Create an entity or a key.
+   *
+   * Allocates a new Entity, KValue, KArray, KList or KPairs object from
+   * the memory resource of the configuration.
+   *
+   * @return The new object. It can be released with delete.
+   */
+  template <typename T>
+  T *create() const {
+    return new (m_resource) T(m_resource);
+  }
+
+  Key *find_key(const std::string_view id);
+  Entity *find_entity(const std::string_view id);
+  Key *find_key(const std::string_view id, const uint64_t hash);
+  Entity *find_entity(const std::string_view id, const uint64_t hash);
+  const Key *find_key(const std::string_view id) const;
+  const Entity *find_entity(const std::string_view id) const;
+  const Key *find_key(const std::string_view id, const uint64_t hash) const;
+  const Entity *find_entity(const std::string_view id, const uint64_t hash) const;
+
+  Key *find_path(const std::string_view path);
+  Key *find_path(const Path &path);
+  Entity *find_entity_path(const std::string_view path);
+  Entity *find_entity_path(const Path &path);
+  const Key *find_path(const std::string_view path) const;
+  const Key *find_path(const Path &path) const;
+  const Entity *find_entity_path(const std::string_view path) const;
+  const Entity *find_entity_path(const Path &path) const;
+
+  /**
+   * @name get - Get the value of a key by its path.
+   * @param path: The dotted path of the key, e.g. "server.port".
+   * @param fallback: The value to return if the key is not found.
+   *
+   * T can be an integral type, a floating point type, std::string_view or
+   * std::string. The key must be a KValue whose data has a matching type:
+   * an integer that fits in T for integral types, a number for floating
+   * point types and a string for the string types. The returned string
+   * view points into the tree.
+   *
+   * @return The value or the fallback.
+   */
+  template <typename T>
+  T get(const std::string_view path, const T &fallback) const {
+    return value_or(value_data(find_path(path)), fallback);
+  }
+
+  template <typename T>
+  T get(const Path &path, const T &fallback) const {
+    return value_or(value_data(find_path(path)), fallback);
+  }
+
+  Handle handle(const std::string_view path) const;
+
+  void merge(Configuration *other);
+
+  const Configuration *freeze();
+  bool frozen() const;
+  uint64_t digest() const;
+
+  /**
+   * @name generation - Get the generation of the configuration.
+   *
+   * @return The number of removals from the tree so far.
+   */
+  uint64_t generation() const {
+    return m_generation;
+  }
+
+  int32_t add_entity(Entity *entity);
+  int32_t add_key(Key *key);
+  int32_t remove_entity(const std::string_view id);
+  int32_t remove_key(const std::string_view id);
+  int32_t replace_entity(const std::string_view id, Entity *entity);
+  int32_t replace_key(const std::string_view id, Key *key);
 
   Key *get_next_key();
   Entity *get_next_entity();
 
+  KeyView keys() const;
+  EntityView entities() const;
+
   void clear_keys();
   void clear_entities();
+  int32_t detach();
   
   void reset_keys();
   void reset_entities();
   
-  int32_t size_of_keys();
-  int32_t size_of_entities();
+  int32_t size_of_keys() const;
+  int32_t size_of_entities() const;
+
+ private:
+  void advance();
+
+  static const Data *value_data(const Key *key) {
+    if (!key || key->type() != Key::value_t)
+      return NULL;
+    return &((const KValue *)key)->value();
+  }
+};
+
+/**
+ * @name Published - A published version of a configuration.
+ *
+ * A configuration that replaces another one, e.g. on every reload of a
+ * Reloader, is published with a number that is never reused by the same
+ * publisher. Handles of the publisher follow the published version.
+ */
+struct Published {
+  const Configuration *conf;
+  uint64_t number;
+};
+
+/**
+ * @name Handle - A cached lookup of a key.
+ *
+ * A handle keeps a precompiled path together with the key it resolved to
+ * and the generation of its configuration at that time. Reading through
+ * it is a pointer load and a generation check; the path is resolved again
+ * only after an entity or a key was removed from the tree, or while the
+ * key is missing. Keys that are added later never change an existing
+ * result since the first definition of an ID wins.
+ *
+ * Every read through a handle counts its key in the active AccessTrace,
+ * once, whether it is served from the cache or resolved again.
+ *
+ * A handle of a configuration must not outlive it. A handle of a Reloader
+ * follows its reloads instead: it is resolved again on the first read after
+ * a new version was published. Like every read of a reloader, it must be
+ * read while the thread holds a Guard.
+ */
+class Handle {
+  friend class Reloader;
+
+ private:
+  mutable const Configuration *m_conf;
+  const std::atomic<Published *> *m_source;
+  Path m_path;
+  mutable const Key *m_key;
+  mutable const Data *m_data;
+  mutable uint64_t m_generation;
+  mutable uint64_t m_version;
+
+  Handle(const std::atomic<Published *> *source, const std::string_view path);
+  void resolve() const;
+
+  bool stale() const {
+    if (m_source) {
+      const Published *current = m_source->load(std::memory_order_acquire);
+      if (!current || current->number != m_version)
+	return true;
+    }
+    return !m_key || m_generation != m_conf->generation();
+  }
+
+ public:
+  Handle();
+  Handle(const Configuration *conf, const std::string_view path);
+
+  const Path &path() const;
+
+  /**
+   * @name key - Get the key.
+   *
+   * @return The key object or NULL.
+   */
+  const Key *key() const {
+    if (stale())
+      resolve();
+    else
+      AccessTrace::read(m_key);
+    return m_key;
+  }
+
+  /**
+   * @name data - Get the data of the key.
+   *
+   * @return The data of the key if it is a KValue, otherwise NULL.
+   */
+  const Data *data() const {
+    if (stale())
+      resolve();
+    else
+      AccessTrace::read(m_key);
+    return m_data;
+  }
+
+  /**
+   * @name get - Get the value of the key.
+   * @param fallback: The value to return if the key is not found.
+   *
+   * Same as Configuration::get().
+   *
+   * @return The value or the fallback.
+   */
+  template <typename T>
+  T get(const T &fallback) const {
+    return value_or(data(), fallback);
+  }
 };
 
 #endif
@@ -11,56 +11,720 @@
  * Foundation.  See file LICENSE.
  * 
  */
+#include <stdio.h>
+#include <atomic>
 #include <iostream>
 #include <string>
+#include <thread>
 #include "confslice.h"
 #include "configuration.h"
 #include "global.h"
+#include "scan.h"
 #include "syntax.h"
 
 using namespace std;
 
+/*
+ * The size of the first arena block. Later blocks grow geometrically.
+ */
+#define ARENA_BLOCK (64 * 1024)
+
+/*
+ * Parallel analysis of a single text: the smallest chunk worth a task, and
+ * the number of chunks per thread that balances their uneven sizes.
+ */
+#define CHUNK_MIN (64 * 1024)
+#define CHUNKS_PER_THREAD 4
+
+/*
+ * Incremental analysis: the most edited statements that are swapped into
+ * the tree one by one before it is cheaper to rebuild its lists.
+ */
+#define REPLACE_MAX 32
+
+/*
+ * A part of a text that holds whole 1-level statements, and the line it
+ * starts at.
+ */
+struct Chunk {
+  const char *data;
+  size_t len;
+  uint32_t line;
+};
+
+/*
+ * Bytes that the statement pre-scan stops at.
+ */
+struct SplitBytes {
+  bool stop[256];
+
+  constexpr SplitBytes() : stop() {
+    stop[(unsigned char)'"'] = true;
+    stop[(unsigned char)'/'] = true;
+    stop[(unsigned char)'{'] = true;
+    stop[(unsigned char)'}'] = true;
+    stop[(unsigned char)';'] = true;
+    stop[0xff] = true;
+  }
+};
+
+constexpr SplitBytes SPLIT;
+
+/**
+ * @name split_statements - Split a text into chunks of 1-level statements.
+ * @param text: The configuration text.
+ * @param count: The number of chunks wanted.
+ * @param chunks: A reference to the chunks.
+ *
+ * Every chunk ends at a ';' that is outside of braces, strings and
+ * comments, so it holds whole entities and keys. Strings end where the
+ * lexical analyzer ends them, and the byte 0xff ends the text.
+ *
+ * @return 0 on success, 1 if the braces do not balance.
+ */
+static int32_t split_statements(const std::string_view text, const size_t count,
+				std::vector<Chunk> &chunks) {
+  const char *begin = text.data(), *end = begin + text.size();
+  const char *p = begin, *start = begin;
+  size_t target = text.size() / (count ? count : 1);
+  size_t next = target;
+  uint32_t line = 1;
+  int64_t depth = 0;
+
+  while (p < end) {
+    while (p < end && !SPLIT.stop[(unsigned char)*p])
+      p++;
+    if (p == end)
+      break;
+    switch (*p) {
+    case '"':
+      p = LexAnalyzer::skip_string(p + 1, end);
+      continue;
+    case '/':
+      if (end - p > 1 && p[1] == '/') {
+	p = scan_eol(p + 2, end);
+	continue;
+      }
+      break;
+    case '{':
+      depth++;
+      break;
+    case '}':
+      if (--depth < 0)
+	return 1;
+      break;
+    case ';':
+      if (!depth && (size_t)(p + 1 - begin) >= next) {
+	chunks.push_back(Chunk{start, (size_t)(p + 1 - start), line});
+	line += scan_lines(start, p + 1);
+	start = p + 1;
+	next = (start - begin) + target;
+      }
+      break;
+    default:
+      // 0xff is the EOF of the lexical analyzer.
+      end = p;
+      continue;
+    }
+    p++;
+  }
+  if (depth)
+    return 1;
+  if (start < end)
+    chunks.push_back(Chunk{start, (size_t)(end - start), line});
+  return 0;
+}
+
 /**
  * @name ConfSlice - Constructor.
+ * @param memory: Where the configuration tree is allocated.
  *
  * Creates the confslice object.
  */
-ConfSlice::ConfSlice() {
+ConfSlice::ConfSlice(const ConfSlice::Memory memory) {
+  m_gc = new GlobalContext;
+  m_syntax = new SyntaxAnalyzer(m_gc);
+  m_arena = NULL;
+  m_release = false;
+  m_recorded = false;
+  m_counter = NULL;
+  m_gc->set_stats(&m_stats);
+  if (memory == arena_mem) {
+    m_arena = new std::pmr::monotonic_buffer_resource(ARENA_BLOCK);
+    m_release = true;
+    std::pmr::memory_resource *resource = tree_resource(m_arena);
+    m_configuration = new (resource->allocate(sizeof(Configuration), alignof(Configuration)))
+      Configuration(resource);
+  } else {
+    m_configuration = new Configuration(tree_resource(std::pmr::get_default_resource()));
+  }
+}
+
+/**
+ * @name ConfSlice - Constructor.
+ * @param resource: The memory resource of the configuration tree.
+ * @param release: Whether the caller releases the resource at once.
+ *
+ * Creates a confslice object whose configuration tree is allocated from
+ * the given resource. The resource must outlive the object. If release is
+ * true, the tree is not freed node by node when the object is destroyed;
+ * the caller is expected to release the whole resource instead, as with
+ * a std::pmr::monotonic_buffer_resource.
+ */
+ConfSlice::ConfSlice(std::pmr::memory_resource *resource, const bool release) {
   m_gc = new GlobalContext;
   m_syntax = new SyntaxAnalyzer(m_gc);
-  m_configuration = new Configuration;
+  m_arena = NULL;
+  m_release = release;
+  m_recorded = false;
+  m_counter = NULL;
+  m_gc->set_stats(&m_stats);
+  resource = tree_resource(resource);
+  if (release)
+    m_configuration = new (resource->allocate(sizeof(Configuration), alignof(Configuration)))
+      Configuration(resource);
+  else
+    m_configuration = new Configuration(resource);
 }
 
 /**
  * @name ConfSlice - Destructor.
  *
- * Deletes the the ConfSlice object and frees memory resources.
+ * Deletes the the ConfSlice object and frees memory resources. If the tree
+ * is released at once, it is dropped without walking it.
  */
 ConfSlice::~ConfSlice() {
   if (m_gc)
     delete m_gc;
   if (m_syntax)
     delete m_syntax;
-  if (m_configuration)
+  if (m_configuration && !m_release)
     delete m_configuration; 
+  if (m_arena)
+    delete m_arena;
+  for (std::pmr::monotonic_buffer_resource *arena : m_worker_arenas)
+    delete arena;
+  if (m_counter)
+    delete m_counter;
 }
 
 /**
  * @name analyze - Begin the configuration analysis.
  * @param filename: The filename of a configuration file.
  *
- * Loads and analyzes a configuration file.
+ * Loads and analyzes a configuration file. The file is memory-mapped
+ * when possible, otherwise it is read into a buffer.
  *
  * @return 0 if the analysis was successfull, otherwise 1.
  */
 int32_t ConfSlice::analyze(string filename) {
+  StatsScope scope(m_gc->stats(), m_counter);
   int32_t result;
+  forget();
   result = m_syntax->open(filename);  
   if (!result)
     result = m_syntax->analyze(m_configuration);
 
   return result;
 }
+
+/**
+ * @name analyze_buffer - Analyze an in-memory configuration.
+ * @param data: The configuration text.
+ * @param len: The length of the text in bytes.
+ *
+ * Analyzes a configuration that is already in memory. The text is read in
+ * place and it is not copied.
+ *
+ * @return 0 if the analysis was successfull, otherwise 1.
+ */
+int32_t ConfSlice::analyze_buffer(const char *data, const size_t len) {
+  StatsScope scope(m_gc->stats(), m_counter);
+  int32_t result;
+  forget();
+  result = m_syntax->open_buffer(data, len);
+  if (!result)
+    result = m_syntax->analyze(m_configuration);
+
+  return result;
+}
+
+/**
+ * @name analyze_buffer - Analyze an in-memory configuration.
+ * @param text: The configuration text.
+ *
+ * Same as analyze_buffer(data, len).
+ *
+ * @return 0 if the analysis was successfull, otherwise 1.
+ */
+int32_t ConfSlice::analyze_buffer(const std::string_view text) {
+  return analyze_buffer(text.data(), text.size());
+}
+
+/**
+ * @name parse - Stream a configuration file to a handler.
+ * @param filename: The filename of a configuration file.
+ * @param handler: The receiver of the parse events.
+ * @param input: How the file is read. With stdio_in, the memory used does
+ *               not depend on the size of the file.
+ *
+ * The configuration is not changed.
+ *
+ * @return 0 if the analysis was successfull, otherwise 1.
+ */
+int32_t ConfSlice::parse(const std::string filename, ParseHandler *handler,
+			 const LexAnalyzer::Input input) {
+  StatsScope scope(m_gc->stats(), m_counter);
+  int32_t result = m_syntax->open(filename, input);
+  if (!result)
+    result = m_syntax->analyze(handler);
+
+  return result;
+}
+
+/**
+ * @name parse_buffer - Stream an in-memory configuration to a handler.
+ * @param text: The configuration text.
+ * @param handler: The receiver of the parse events.
+ *
+ * The configuration is not changed.
+ *
+ * @return 0 if the analysis was successfull, otherwise 1.
+ */
+int32_t ConfSlice::parse_buffer(const std::string_view text, ParseHandler *handler) {
+  StatsScope scope(m_gc->stats(), m_counter);
+  int32_t result = m_syntax->open_buffer(text.data(), text.size());
+  if (!result)
+    result = m_syntax->analyze(handler);
+
+  return result;
+}
+
+/**
+ * @name analyze_parallel - Analyze a large configuration file in parallel.
+ * @param filename: The filename of a configuration file.
+ * @param threads: The number of threads, or 0 for one per CPU.
+ *
+ * Loads the file like analyze() and analyzes it with
+ * analyze_buffer_parallel().
+ *
+ * @return 0 if the analysis was successfull, otherwise 1.
+ */
+int32_t ConfSlice::analyze_parallel(const std::string filename, int32_t threads) {
+  LexAnalyzer input(m_gc);
+  int32_t result;
+
+  if (input.open(filename))
+    return 1;
+  result = analyze_buffer_parallel(input.buffer(), threads);
+  input.close();
+  return result;
+}
+
+/**
+ * @name analyze_buffer_parallel - Analyze a large configuration in parallel.
+ * @param text: The configuration text.
+ * @param threads: The number of threads, or 0 for one per CPU.
+ *
+ * A quick pre-scan splits the text into chunks of whole 1-level
+ * statements, at the ';' that ends an entity or a key outside of any
+ * braces, strings or comments. The chunks are analyzed concurrently into
+ * separate configurations that are merged in source order, so the result
+ * is the same as that of analyze_buffer(). Each chunk is analyzed from the
+ * line it starts at, so error messages refer to lines of the whole text.
+ * If a chunk fails, the chunks before it and the part of it that was
+ * analyzed are kept, as with a serial analysis, and only its errors are
+ * reported.
+ *
+ * Small texts, texts whose braces do not balance and configurations with
+ * a caller-supplied memory resource are analyzed serially.
+ *
+ * @return 0 if the analysis was successfull, otherwise 1.
+ */
+int32_t ConfSlice::analyze_buffer_parallel(const std::string_view text, int32_t threads) {
+  vector<Chunk> chunks;
+  size_t count;
+
+  threads = workers(threads, text.size() / CHUNK_MIN);
+  count = std::min((size_t)threads * CHUNKS_PER_THREAD, text.size() / CHUNK_MIN);
+  if (threads <= 1 || split_statements(text, count, chunks) || chunks.size() < 2)
+    return analyze_buffer(text);
+
+  vector<Configuration *> parts;
+  vector<FileReport> reports;
+  forget();
+  m_stats.clear();
+  parse_parts(chunks.size(), threads, [&](SyntaxAnalyzer &syntax, const size_t i) {
+      return syntax.open_buffer(chunks[i].data, chunks[i].len, chunks[i].line);
+    }, parts, reports);
+
+  int32_t result = 0;
+  for (size_t i = 0; i < parts.size(); i++) {
+    if (!result) {
+      m_configuration->merge(parts[i]);
+      if (reports[i].result) {
+	m_gc->report("%s", reports[i].errors.c_str());
+	result = 1;
+      }
+    }
+    delete parts[i];
+  }
+  return result;
+}
+
+/**
+ * @name analyze_many - Analyze several configuration files in parallel.
+ * @param filenames: The configuration files.
+ * @param threads: The number of threads, or 0 for one per CPU.
+ * @param reports: A pointer to a vector that receives the outcome of every
+ *                 file, in the order of filenames, or NULL.
+ *
+ * The files are parsed concurrently. Every thread has its own syntax
+ * analyzer and global context and builds a separate configuration per
+ * file, with its errors collected apart. The configurations are then
+ * merged into this one in the order of filenames, so the result does not
+ * depend on the scheduling: as within a file, the first definition of a
+ * 1-level key or entity wins. Files that fail to parse are not merged.
+ * Without reports, their errors are printed to stderr after the merge,
+ * prefixed with the file name.
+ *
+ * In arena mode every thread carves its nodes from an arena of its own.
+ * A caller-supplied memory resource is not assumed to be thread safe, so
+ * the files are parsed by one thread.
+ *
+ * @return 0 if every file was analyzed successfully, otherwise 1.
+ */
+int32_t ConfSlice::analyze_many(const std::vector<std::string> &filenames, int32_t threads,
+				std::vector<FileReport> *reports) {
+  vector<Configuration *> parts;
+  vector<FileReport> local;
+  vector<FileReport> &out = reports ? *reports : local;
+  int32_t result = 0;
+
+  forget();
+  m_stats.clear();
+  parse_parts(filenames.size(), workers(threads, filenames.size()),
+	      [&](SyntaxAnalyzer &syntax, const size_t i) {
+		return syntax.open(filenames[i]);
+	      }, parts, out);
+
+  for (size_t i = 0; i < parts.size(); i++) {
+    out[i].filename = filenames[i];
+    if (out[i].result) {
+      result = 1;
+      for (size_t pos = 0; !reports && pos < out[i].errors.size();) {
+	size_t end = out[i].errors.find('\n', pos);
+	end = (end == string::npos) ? out[i].errors.size() : end + 1;
+	fprintf(stderr, "%s: %.*s", out[i].filename.c_str(), (int)(end - pos),
+		out[i].errors.data() + pos);
+	pos = end;
+      }
+    } else {
+      m_configuration->merge(parts[i]);
+    }
+    delete parts[i];
+  }
+  return result;
+}
+
+/**
+ * @name reanalyze - Analyze a configuration file again.
+ * @param filename: The filename of a configuration file.
+ *
+ * Loads the file like analyze() and analyzes it with reanalyze_buffer().
+ *
+ * @return 0 if the analysis was successfull, otherwise 1.
+ */
+int32_t ConfSlice::reanalyze(const std::string filename) {
+  LexAnalyzer input(m_gc);
+  int32_t result;
+
+  if (input.open(filename))
+    return 1;
+  result = reanalyze_buffer(input.buffer());
+  input.close();
+  return result;
+}
+
+/**
+ * @name reanalyze_buffer - Analyze a new version of the configuration.
+ * @param text: The new configuration text.
+ *
+ * Replaces the configuration with the one in text, analyzing only the
+ * 1-level statements that changed since the previous call. The text is
+ * split at every ';' outside of braces, strings and comments, and the
+ * hash and size of every statement are recorded along with the key or
+ * entity it defined. A statement whose bytes, but for leading white
+ * space, match a recorded one keeps its key or entity as it is, at the
+ * same address; the others are
+ * analyzed from the line they start at, and the keys and entities that
+ * are no longer defined are deleted. The result is the same as that of
+ * analyze() on an empty configuration, including the first definition of
+ * an ID winning. The first call analyzes every statement and replaces
+ * whatever the configuration held.
+ *
+ * If the text has an error, it is reported and the configuration is left
+ * as it was. The tree must not be changed between the calls by anything
+ * else, since the recorded statements point into it; analyze() and the
+ * other analysis methods drop the records.
+ *
+ * @return 0 if the analysis was successfull, otherwise 1. It fails if the
+ *         configuration is frozen.
+ */
+int32_t ConfSlice::reanalyze_buffer(const std::string_view text) {
+  StatsScope scope(m_gc->stats(), m_counter);
+  Configuration *conf = m_configuration;
+  vector<Chunk> chunks;
+
+  if (conf->frozen())
+    return 1;
+  if (split_statements(text, text.size(), chunks)) {
+    // The braces do not balance: the text is analyzed as a whole, which
+    // reports the error.
+    Configuration whole(conf->resource());
+    if (m_syntax->open_buffer(text.data(), text.size()) || m_syntax->analyze(&whole))
+      return 1;
+    conf->clear_keys();
+    conf->clear_entities();
+    conf->merge(&whole);
+    forget();
+    return 0;
+  }
+
+  // The recorded statements are looked up in place first, then in an
+  // open-addressing table by hash, which is built on the first miss.
+  // Duplicates are always analyzed again, since the definition that won
+  // may be gone.
+  vector<bool> reused(m_statements.size(), false);
+  vector<size_t> table;
+  size_t mask = 0;
+  auto matches = [&](const size_t j, const Statement &statement) {
+    const Statement &old = m_statements[j];
+    return !reused[j] && !old.duplicate && old.hash == statement.hash && old.size == statement.size;
+  };
+  auto find = [&](const Statement &statement) {
+    if (table.empty()) {
+      for (mask = 1; mask < 2 * m_statements.size(); mask <<= 1)
+	;
+      table.assign(mask--, 0);
+      for (size_t j = 0; j < m_statements.size(); j++) {
+	if (m_statements[j].duplicate)
+	  continue;
+	size_t slot = m_statements[j].hash & mask;
+	while (table[slot])
+	  slot = (slot + 1) & mask;
+	table[slot] = j + 1;
+      }
+    }
+    for (size_t slot = statement.hash & mask; table[slot]; slot = (slot + 1) & mask)
+      if (matches(table[slot] - 1, statement))
+	return table[slot] - 1;
+    return m_statements.size();
+  };
+
+  // The tree is patched in place as long as every statement keeps its
+  // position and an edited one defines the same ID as before.
+  vector<Statement> statements(chunks.size());
+  vector<bool> parsed(chunks.size(), false);
+  Configuration part(conf->resource());
+  bool in_place = m_recorded && chunks.size() == m_statements.size();
+  size_t next = 0, replaced = 0;
+  int32_t result = 0;
+  for (size_t i = 0; i < chunks.size() && !result; i++) {
+    // Leading white space is not part of a statement, so blank lines can
+    // come and go.
+    const char *end = chunks[i].data + chunks[i].len;
+    uint32_t lines = 0;
+    const char *begin = scan_space(chunks[i].data, end, &lines);
+    Statement &statement = statements[i];
+    statement = Statement{hash_id(string_view(begin, end - begin)), (size_t)(end - begin),
+			  NULL, NULL, false};
+    size_t j = (next < m_statements.size() && matches(next, statement)) ? next : find(statement);
+    if (j < m_statements.size()) {
+      reused[j] = true;
+      statement.key = m_statements[j].key;
+      statement.entity = m_statements[j].entity;
+      in_place = in_place && j == i;
+      next = j + 1;
+      continue;
+    }
+
+    // A statement holds at most one key or entity.
+    parsed[i] = true;
+    result = m_syntax->open_buffer(chunks[i].data, chunks[i].len, chunks[i].line);
+    if (!result)
+      result = m_syntax->analyze(&part);
+    statement.key = part.get_next_key();
+    statement.entity = part.get_next_entity();
+    part.clear_keys();
+    part.clear_entities();
+    if (in_place) {
+      const Statement &old = m_statements[i];
+      in_place = ++replaced <= REPLACE_MAX && !old.duplicate &&
+	!old.key == !statement.key && !old.entity == !statement.entity &&
+	(!old.key || old.key->id() == statement.key->id()) &&
+	(!old.entity || old.entity->id() == statement.entity->id());
+    }
+  }
+  if (result) {
+    for (size_t i = 0; i < statements.size(); i++) {
+      if (parsed[i] && statements[i].key)
+	delete statements[i].key;
+      if (parsed[i] && statements[i].entity)
+	delete statements[i].entity;
+    }
+    return 1;
+  }
+
+  if (in_place) {
+    for (size_t i = 0; i < statements.size(); i++) {
+      if (parsed[i] && statements[i].key)
+	conf->replace_key(statements[i].key->id(), statements[i].key);
+      if (parsed[i] && statements[i].entity)
+	conf->replace_entity(statements[i].entity->id(), statements[i].entity);
+    }
+    m_statements.swap(statements);
+    return 0;
+  }
+
+  // Rebuild the lists in the new order. Duplicates are deleted as in
+  // add_key() and add_entity().
+  if (m_recorded) {
+    conf->detach();
+  } else {
+    conf->clear_keys();
+    conf->clear_entities();
+  }
+  for (Statement &statement : statements) {
+    if (statement.key && conf->add_key(statement.key)) {
+      delete statement.key;
+      statement.key = NULL;
+      statement.duplicate = true;
+    }
+    if (statement.entity && conf->add_entity(statement.entity)) {
+      delete statement.entity;
+      statement.entity = NULL;
+      statement.duplicate = true;
+    }
+  }
+  for (size_t i = 0; i < m_statements.size(); i++) {
+    if (reused[i])
+      continue;
+    if (m_statements[i].key)
+      delete m_statements[i].key;
+    if (m_statements[i].entity)
+      delete m_statements[i].entity;
+  }
+  m_statements.swap(statements);
+  m_recorded = true;
+  return 0;
+}
+
+/**
+ * @name workers - Choose the number of parsing threads.
+ * @param threads: The requested number, or 0 for one per CPU.
+ * @param tasks: The number of inputs.
+ *
+ * A caller-supplied memory resource is not assumed to be thread safe, so
+ * it gets one thread.
+ *
+ * @return The number of threads.
+ */
+int32_t ConfSlice::workers(int32_t threads, const size_t tasks) const {
+  if (threads <= 0)
+    threads = std::thread::hardware_concurrency();
+  if (threads <= 0)
+    threads = 1;
+  if ((size_t)threads > tasks)
+    threads = tasks;
+  std::pmr::memory_resource *resource = m_counter ? m_counter->upstream() :
+    m_configuration->resource();
+  if (threads > 1 && !m_arena && resource != std::pmr::new_delete_resource())
+    threads = 1;
+  return threads;
+}
+
+/**
+ * @name parse_parts - Analyze several inputs on a pool of threads.
+ * @param tasks: The number of inputs.
+ * @param threads: The number of threads.
+ * @param open: Opens an input on a syntax analyzer.
+ * @param parts: A reference to the configuration of every input.
+ * @param reports: A reference to the outcome of every input.
+ *
+ * Every thread has its own syntax analyzer and global context, takes the
+ * next input from a shared counter and analyzes it into a configuration
+ * of its own. In arena mode every thread allocates from an arena of its
+ * own. The arenas back nodes that are merged into the tree, so like the
+ * arena of the tree they are released when the object is destroyed; later
+ * calls reuse them instead of adding new ones.
+ *
+ * @return Void.
+ */
+void ConfSlice::parse_parts(const size_t tasks, const int32_t threads,
+			    const std::function<int32_t(SyntaxAnalyzer &, const size_t)> &open,
+			    std::vector<Configuration *> &parts, std::vector<FileReport> &reports) {
+  vector<std::pmr::memory_resource *> resources(threads, m_configuration->resource());
+  std::atomic<size_t> next(0);
+
+  parts.assign(tasks, NULL);
+  reports.assign(tasks, FileReport());
+  while (m_arena && m_worker_arenas.size() < (size_t)threads)
+    m_worker_arenas.push_back(new std::pmr::monotonic_buffer_resource(ARENA_BLOCK));
+  for (int32_t w = 0; m_arena && w < threads; w++)
+    resources[w] = m_worker_arenas[w];
+
+  auto worker = [&](int32_t w) {
+    GlobalContext gc;
+    SyntaxAnalyzer syntax(&gc);
+    size_t i;
+    while ((i = next.fetch_add(1)) < tasks) {
+      FileReport &report = reports[i];
+      gc.set_errors(&report.errors);
+      parts[i] = new Configuration(resources[w]);
+      report.result = open(syntax, i);
+      if (!report.result)
+	report.result = syntax.analyze(parts[i]);
+      report.result = report.result ? 1 : 0;
+    }
+  };
+  vector<std::thread> pool;
+  for (int32_t w = 1; w < threads; w++)
+    pool.emplace_back(worker, w);
+  if (threads > 0)
+    worker(0);
+  for (std::thread &t : pool)
+    t.join();
+}
+
+/**
+ * @name forget - Drop the statements recorded by reanalyze_buffer().
+ *
+ * Called whenever the configuration is changed by another analysis.
+ *
+ * @return Void.
+ */
+void ConfSlice::forget() {
+  m_statements.clear();
+  m_recorded = false;
+}
+
+/**
+ * @name tree_resource - Choose the memory resource of the tree.
+ * @param resource: The resource that allocates the tree.
+ *
+ * With statistics, the resource is wrapped in one that counts the
+ * allocations.
+ *
+ * @return The resource to build the tree from.
+ */
+std::pmr::memory_resource *ConfSlice::tree_resource(std::pmr::memory_resource *resource) {
+  if (!ParseStats::enabled)
+    return resource;
+  m_counter = new StatsResource(resource);
+  return m_counter;
+}
+
 /**
  * @name configuration - Return the configuration
  *
@@ -73,3 +737,15 @@ Configuration *ConfSlice::configuration() {
   return m_configuration;
 }
 
+/**
+ * @name stats - Return the statistics of the last analysis.
+ *
+ * The statistics are filled by analyze(), analyze_buffer() and
+ * reanalyze(), when the library is built with CONFSLICE_STATS. Otherwise
+ * they stay empty and ParseStats::enabled is false.
+ *
+ * @return A reference to the statistics.
+ */
+const ParseStats &ConfSlice::stats() const {
+  return m_stats;
+}
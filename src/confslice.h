@@ -15,9 +15,15 @@
 #ifndef CONFSLICE_H
 #define CONFSLICE_H
 
+#include <functional>
+#include <memory_resource>
 #include <string>
+#include <string_view>
+#include <vector>
 #include "configuration.h"
 #include "global.h"
+#include "snapshot.h"
+#include "stats.h"
 #include "syntax.h"
 
 /**
@@ -28,18 +34,89 @@
  * this object to load and analyze configuration files. You shoud 
  * To load and analyze a configuration file use the "analyze()" method. To
  * get the generated configuration use the "configuration()" method.
+ *
+ * The configuration tree is allocated from the heap by default. With
+ * arena_mem it is allocated from a few large blocks owned by the object,
+ * which are released at once instead of freeing every node. A
+ * caller-supplied memory resource can be used as well.
+ *
+ * A configuration that is loaded again with reanalyze() keeps the keys and
+ * entities of the 1-level statements that did not change.
+ *
+ * parse() streams the events of a file to a handler instead, without
+ * building or changing the configuration.
+ *
+ * When the library is built with statistics, stats() describes the last
+ * serial analysis.
  */
 class ConfSlice {  
+ public:
+  enum Memory
+  {
+    heap_mem,   // Every node is allocated and freed on its own.
+    arena_mem   // Nodes are carved from blocks that are released at once.
+  };
+
+  /**
+   * @name FileReport - The outcome of loading a file with analyze_many().
+   */
+  struct FileReport {
+    std::string filename;
+    int32_t result;
+    std::string errors;
+  };
+
  private:
+  /*
+   * A 1-level statement of the text last given to reanalyze(): the hash and
+   * size of its bytes and the key or entity it defined, if any. The
+   * definition of a duplicate is not kept.
+   */
+  struct Statement {
+    uint64_t hash;
+    size_t size;
+    Key *key;
+    Entity *entity;
+    bool duplicate;
+  };
+
   GlobalContext *m_gc;
   SyntaxAnalyzer *m_syntax;
   Configuration *m_configuration;
+  std::pmr::monotonic_buffer_resource *m_arena;
+  std::vector<std::pmr::monotonic_buffer_resource *> m_worker_arenas;
+  bool m_release;
+  std::vector<Statement> m_statements;
+  bool m_recorded;
+  ParseStats m_stats;
+  StatsResource *m_counter;
     
  public:
-  ConfSlice();
+  explicit ConfSlice(const ConfSlice::Memory memory = heap_mem);
+  ConfSlice(std::pmr::memory_resource *resource, const bool release = false);
   ~ConfSlice();
   int32_t analyze(const std::string filename);
+  int32_t analyze_buffer(const char *data, const size_t len);
+  int32_t analyze_buffer(const std::string_view text);
+  int32_t analyze_parallel(const std::string filename, int32_t threads = 0);
+  int32_t analyze_buffer_parallel(const std::string_view text, int32_t threads = 0);
+  int32_t analyze_many(const std::vector<std::string> &filenames, int32_t threads = 0,
+		       std::vector<FileReport> *reports = NULL);
+  int32_t reanalyze(const std::string filename);
+  int32_t reanalyze_buffer(const std::string_view text);
+  int32_t parse(const std::string filename, ParseHandler *handler,
+		const LexAnalyzer::Input input = LexAnalyzer::auto_in);
+  int32_t parse_buffer(const std::string_view text, ParseHandler *handler);
   Configuration *configuration();
+  const ParseStats &stats() const;
+
+ private:
+  int32_t workers(int32_t threads, const size_t tasks) const;
+  void parse_parts(const size_t tasks, const int32_t threads,
+		   const std::function<int32_t(SyntaxAnalyzer &, const size_t)> &open,
+		   std::vector<Configuration *> &parts, std::vector<FileReport> &reports);
+  void forget();
+  std::pmr::memory_resource *tree_resource(std::pmr::memory_resource *resource);
 };
 
 #endif
@@ -0,0 +1,538 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Confslice - A simple configuration file parser.
+ *
+ * Copyright (C) 2014 Giorgos Kappes <geokapp@gmail.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file LICENSE.
+ *
+ */
+#include <string.h>
+#include <algorithm>
+#include <iterator>
+#include <memory_resource>
+#include <string>
+#include "diff.h"
+
+using namespace std;
+using std::pmr::memory_resource;
+
+/**
+ * @name data_equal - Compare two values by type and value.
+ *
+ * Doubles are equal if their bits are.
+ *
+ * @return True if the values are equal.
+ */
+static bool data_equal(const Data &a, const Data &b) {
+  int64_t ia, ib;
+  double da, db;
+  string_view sa, sb;
+
+  if (a.type() != b.type())
+    return false;
+  if (!a.as_int64(ia))
+    return !b.as_int64(ib) && ia == ib;
+  if (!a.as_string_view(sa))
+    return !b.as_string_view(sb) && sa == sb;
+  if (!a.as_double(da))
+    return !b.as_double(db) && !memcmp(&da, &db, sizeof(da));
+  return true;
+}
+
+/**
+ * @name element - Read an element of an array as a value.
+ *
+ * @return The value.
+ */
+static Data element(const KArray *array, const int32_t index) {
+  Data data;
+  int64_t i;
+  double d;
+  string_view s;
+
+  if (!array->at(index, i))
+    data.set_int64(i);
+  else if (!array->at(index, s))
+    data.set_string(s);
+  else if (!array->at(index, d))
+    data.set_double(d);
+  return data;
+}
+
+/**
+ * @name array_equal - Compare two arrays element by element.
+ *
+ * @return True if the arrays are equal.
+ */
+static bool array_equal(const KArray *a, const KArray *b) {
+  Span<int64_t> ia, ib;
+  Span<double> da, db;
+
+  if (a->size() != b->size())
+    return false;
+  if (!a->as_int64_span(ia) && !b->as_int64_span(ib))
+    return !memcmp(ia.data(), ib.data(), ia.size() * sizeof(int64_t));
+  if (!a->as_double_span(da) && !b->as_double_span(db))
+    return !memcmp(da.data(), db.data(), da.size() * sizeof(double));
+  for (int32_t i = 0; i < a->size(); i++)
+    if (!data_equal(element(a, i), element(b, i)))
+      return false;
+  return true;
+}
+
+/**
+ * @name list_equal - Compare two lists and their sub-lists.
+ * @param a, b: KList or KListNode objects.
+ *
+ * @return True if the lists are equal.
+ */
+template <typename A, typename B>
+static bool list_equal(const A &a, const B &b) {
+  if (a.size_of_data() != b.size_of_data() || a.size_of_klist() != b.size_of_klist())
+    return false;
+  auto da = a.data().begin(), db = b.data().begin();
+  for (; da != a.data().end(); ++da, ++db)
+    if (!data_equal(*da, *db))
+      return false;
+  auto ka = a.klists().begin(), kb = b.klists().begin();
+  for (; ka != a.klists().end(); ++ka, ++kb)
+    if (!list_equal(*ka, *kb))
+      return false;
+  return true;
+}
+
+/**
+ * @name pairs_equal - Compare two lists of pairs in order.
+ *
+ * @return True if the pairs are equal.
+ */
+static bool pairs_equal(const KPairs *a, const KPairs *b) {
+  if (a->size() != b->size())
+    return false;
+  auto pb = b->pairs().begin();
+  for (const KPairs::Pair &pa : a->pairs()) {
+    if (pa.first != (*pb).first || !data_equal(pa.second, (*pb).second))
+      return false;
+    ++pb;
+  }
+  return true;
+}
+
+/**
+ * @name key_equal - Compare the contents of two keys.
+ *
+ * @return True if the keys have the same type and contents.
+ */
+static bool key_equal(const Key *a, const Key *b) {
+  if (a->type() != b->type())
+    return false;
+  switch (a->type()) {
+  case Key::value_t:
+    return data_equal(((const KValue *)a)->value(), ((const KValue *)b)->value());
+  case Key::array_t:
+    return array_equal((const KArray *)a, (const KArray *)b);
+  case Key::list_t:
+    return list_equal(*(const KList *)a, *(const KList *)b);
+  case Key::pairs_t:
+    return pairs_equal((const KPairs *)a, (const KPairs *)b);
+  }
+  return false;
+}
+
+/**
+ * @name emit - Report a change.
+ *
+ * @return Void.
+ */
+static void emit(const function<void(const Change &)> &event, string &path, const string_view id,
+		 const Change::Kind kind, const Key *old_key, const Key *new_key,
+		 const Entity *old_entity, const Entity *new_entity) {
+  size_t base = path.size();
+
+  Path::append(path, id);
+  event(Change{kind, path, old_key, new_key, old_entity, new_entity});
+  path.resize(base);
+}
+
+/**
+ * @name counterpart - Find the object with the same ID on the other side.
+ * @param item: A key or an entity of the old level.
+ * @param it: The object at the same position on the new level.
+ * @param end: The end of the new level.
+ * @param find: Looks the ID up on the new level.
+ * @param aligned: Whether every object so far was found at the same
+ *                 position. Cleared otherwise.
+ *
+ * Reloaded configurations mostly keep their order, so the object at the
+ * same position is tried before the index.
+ *
+ * @return The object or NULL.
+ */
+template <typename T, typename I, typename F>
+static const T *counterpart(const T *item, I &it, const I &end, F find, bool &aligned) {
+  const T *other = NULL;
+
+  if (aligned && it != end && (*it)->id() == item->id())
+    other = *it;
+  else
+    other = find(item->id());
+  if (aligned && (it == end || other != *it))
+    aligned = false;
+  if (it != end)
+    ++it;
+  return other;
+}
+
+/**
+ * @name DiffWalk - Compare two frozen trees level by level.
+ *
+ * Keys and entities are matched by ID at every level. While both levels
+ * hold the same IDs at the same positions, runs of keys or entities whose
+ * digests match are stepped over, and so are entities whose digests
+ * match, so the cost depends on the size of the changes rather than of
+ * the trees.
+ */
+class DiffWalk {
+ private:
+  std::string m_path;
+  const function<void(const Change &)> &m_event;
+
+ public:
+  explicit DiffWalk(const function<void(const Change &)> &event) : m_event(event) {}
+
+  /**
+   * @name level - Compare the keys and entities of two levels.
+   * @param from, to: Frozen configurations or entities at the same path.
+   *
+   * If both levels hold the same IDs in the same order, the new level is
+   * not searched for additions.
+   *
+   * @return Void.
+   */
+  template <typename R>
+  void level(const R *from, const R *to) {
+    bool aligned = from->m_keys.size() == to->m_keys.size();
+    auto ki = to->m_keys.cbegin();
+    size_t i = 0;
+
+    for (auto it = from->m_keys.cbegin(); it != from->m_keys.cend(); ++it, i++) {
+      if (aligned && skip(from->m_key_blocks, to->m_key_blocks, from->m_keys.size(), i, it, ki))
+	continue;
+      const Key *key = *it;
+      const Key *other = counterpart(key, ki, to->m_keys.cend(),
+				     [&](string_view id) { return to->find_key(id); }, aligned);
+      if (!other)
+	emit(m_event, m_path, key->id(), Change::removed, key, NULL, NULL, NULL);
+      else if (!key_equal(key, other))
+	emit(m_event, m_path, key->id(), Change::changed, key, other, NULL, NULL);
+    }
+    if (!aligned)
+      for (const Key *key : to->m_keys)
+	if (!from->find_key(key->id()))
+	  emit(m_event, m_path, key->id(), Change::added, NULL, key, NULL, NULL);
+
+    aligned = from->m_entities.size() == to->m_entities.size();
+    auto ei = to->m_entities.cbegin();
+    i = 0;
+    for (auto it = from->m_entities.cbegin(); it != from->m_entities.cend(); ++it, i++) {
+      if (aligned && skip(from->m_entity_blocks, to->m_entity_blocks, from->m_entities.size(),
+			  i, it, ei))
+	continue;
+      const Entity *entity = *it;
+      const Entity *other = counterpart(entity, ei, to->m_entities.cend(),
+					[&](string_view id) { return to->find_entity(id); },
+					aligned);
+      if (!other) {
+	emit(m_event, m_path, entity->id(), Change::removed, NULL, NULL, entity, NULL);
+      } else if (entity->digest() != other->digest()) {
+	size_t base = m_path.size();
+	Path::append(m_path, entity->id());
+	level(entity, other);
+	m_path.resize(base);
+      }
+    }
+    if (!aligned)
+      for (const Entity *entity : to->m_entities)
+	if (!from->find_entity(entity->id()))
+	  emit(m_event, m_path, entity->id(), Change::added, NULL, NULL, NULL, entity);
+  }
+
+ private:
+  /*
+   * Steps over the run that starts at position i if its digest is the
+   * same on both sides. it and other are left on the last object of the
+   * run, other one past it, as counterpart() would.
+   */
+  template <typename T, typename I>
+  static bool skip(const DigestBlock<T> *from, const DigestBlock<T> *to, const size_t size,
+		   size_t &i, I &it, I &other) {
+    size_t run = i / DigestBlock<T>::length;
+    size_t last;
+
+    if (!from || !to || i % DigestBlock<T>::length || from[run].digest != to[run].digest)
+      return false;
+    last = std::min(i + DigestBlock<T>::length, size) - 1;
+    if (last + 1 < size) {
+      it = std::prev(from[run + 1].first);
+      other = to[run + 1].first;
+    } else {
+      std::advance(it, last - i);
+      std::advance(other, last - i + 1);
+    }
+    i = last;
+    return true;
+  }
+};
+
+/**
+ * @name diff - Compare two frozen configurations.
+ * @param from: The old configuration.
+ * @param to: The new configuration.
+ * @param event: Called for every change, in the order of the old tree
+ *               and then of the new one at every level.
+ *
+ * Keys and entities are matched by ID at every level, and keys are
+ * compared by type and value. Both trees must be frozen: the digests that
+ * freeze() computes let unchanged subtrees and unchanged runs of keys be
+ * skipped without being walked.
+ *
+ * @return 0 on success, 1 if either configuration is not frozen. Nothing
+ *         is compared then.
+ */
+int32_t diff(const Configuration *from, const Configuration *to,
+	     const function<void(const Change &)> &event) {
+  if (!from->frozen() || !to->frozen())
+    return 1;
+  if (from->digest() != to->digest())
+    DiffWalk(event).level(from, to);
+  return 0;
+}
+
+/**
+ * @name diff - Compare two frozen configurations.
+ * @param from: The old configuration.
+ * @param to: The new configuration.
+ * @param changes: The changes are appended here.
+ *
+ * @return 0 on success, 1 if either configuration is not frozen.
+ */
+int32_t diff(const Configuration *from, const Configuration *to, vector<Change> &changes) {
+  return diff(from, to, [&](const Change &change) { changes.push_back(change); });
+}
+
+/**
+ * @name clone_key - Copy a key into a memory resource.
+ *
+ * @return The copy.
+ */
+static Key *clone_key(const Key *key, memory_resource *resource) {
+  Data::allocator_type alloc(resource);
+  Key *copy = NULL;
+
+  if (key->type() == Key::value_t) {
+    KValue *value = new (resource) KValue(resource);
+    value->set_value(Data(((const KValue *)key)->value(), alloc));
+    copy = value;
+  } else if (key->type() == Key::array_t) {
+    const KArray *from = (const KArray *)key;
+    KArray *array = new (resource) KArray(resource);
+    for (int32_t i = 0; i < from->size(); i++)
+      array->insert_data(Data(element(from, i), alloc));
+    copy = array;
+  } else if (key->type() == Key::list_t) {
+    copy = new (resource) KList(*(const KList *)key, KList::allocator_type(resource));
+  } else {
+    KPairs *pairs = new (resource) KPairs(resource);
+    for (const KPairs::Pair &pair : ((const KPairs *)key)->pairs())
+      pairs->insert(pair.first, Data(pair.second, alloc));
+    copy = pairs;
+  }
+  copy->set_id(key->id());
+  return copy;
+}
+
+/**
+ * @name clone_entity - Copy an entity and its subtree into a memory resource.
+ *
+ * @return The copy.
+ */
+static Entity *clone_entity(const Entity *entity, memory_resource *resource) {
+  Entity *copy = new (resource) Entity(resource);
+
+  copy->set_id(entity->id());
+  for (const Key *key : entity->keys())
+    copy->add_key(clone_key(key, resource));
+  for (const Entity *sub : entity->entities())
+    copy->add_entity(clone_entity(sub, resource));
+  return copy;
+}
+
+/**
+ * @name Patch - Constructor.
+ *
+ * Creates an empty patch.
+ */
+Patch::Patch() {
+}
+
+/**
+ * @name ~Patch - Destructor.
+ *
+ * Deletes the copies of the keys and entities.
+ */
+Patch::~Patch() {
+  clear();
+}
+
+/**
+ * @name make - Record the changes between two frozen configurations.
+ * @param from: The old configuration.
+ * @param to: The new configuration.
+ *
+ * Replaces the operations of the patch with those that turn from into to.
+ *
+ * @return 0 on success, 1 if either configuration is not frozen or a path
+ *         could not be recorded.
+ */
+int32_t Patch::make(const Configuration *from, const Configuration *to) {
+  memory_resource *resource = std::pmr::new_delete_resource();
+  int32_t result = 0;
+
+  clear();
+  if (!from->frozen() || !to->frozen())
+    return 1;
+  diff(from, to, [&](const Change &change) {
+      Op op{change.kind, Path(), change.old_key || change.new_key, NULL, NULL};
+      if (op.path.set(change.path)) {
+	result = 1;
+	return;
+      }
+      if (change.new_key)
+	op.key = clone_key(change.new_key, resource);
+      else if (change.new_entity)
+	op.entity = clone_entity(change.new_entity, resource);
+      m_ops.push_back(op);
+    });
+  return result;
+}
+
+/**
+ * @name apply_at - Apply an operation to the level that holds its target.
+ *
+ * @return 0 on success, otherwise 1.
+ */
+template <typename R>
+static int32_t apply_at(R *parent, const Change::Kind kind, const string_view id, const bool is_key,
+			const Key *key, const Entity *entity, memory_resource *resource) {
+  if (kind == Change::removed)
+    return is_key ? parent->remove_key(id) : parent->remove_entity(id);
+  if (kind == Change::changed && parent->remove_key(id))
+    return 1;
+  if (is_key) {
+    Key *copy = clone_key(key, resource);
+    if (parent->add_key(copy)) {
+      delete copy;
+      return 1;
+    }
+  } else {
+    Entity *copy = clone_entity(entity, resource);
+    if (parent->add_entity(copy)) {
+      delete copy;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @name apply - Replay the patch on a configuration.
+ * @param conf: A configuration that matches the old one.
+ *
+ * Removed keys and entities are deleted, added ones are copied into the
+ * tree and changed keys are replaced. Replaced and added keys and entities
+ * are appended to their level. The operations are applied in order and
+ * the first one that does not match the tree stops the patch; the ones
+ * before it stay applied.
+ *
+ * @return 0 on success, 1 if the tree does not match the patch or is
+ *         frozen.
+ */
+int32_t Patch::apply(Configuration *conf) const {
+  for (const Op &op : m_ops) {
+    size_t last = op.path.size() - 1;
+    Entity *entity = NULL;
+    int32_t result;
+
+    for (size_t i = 0; i < last; i++) {
+      entity = i ? entity->find_entity(op.path.id(i), op.path.hash(i)) :
+	conf->find_entity(op.path.id(i), op.path.hash(i));
+      if (!entity)
+	return 1;
+    }
+    if (entity)
+      result = apply_at(entity, op.kind, op.path.id(last), op.is_key, op.key, op.entity,
+			conf->resource());
+    else
+      result = apply_at(conf, op.kind, op.path.id(last), op.is_key, op.key, op.entity,
+			conf->resource());
+    if (result)
+      return 1;
+  }
+  return 0;
+}
+
+/**
+ * @name clear - Remove every operation.
+ *
+ * @return Void.
+ */
+void Patch::clear() {
+  for (Op &op : m_ops) {
+    if (op.key)
+      delete op.key;
+    if (op.entity)
+      delete op.entity;
+  }
+  m_ops.clear();
+}
+
+/**
+ * @name size - Number of operations.
+ *
+ * @return The number of operations.
+ */
+size_t Patch::size() const {
+  return m_ops.size();
+}
+
+/**
+ * @name str - Print the patch.
+ *
+ * One line per operation: '+' for an addition, '-' for a removal and '~'
+ * for a change, followed by the path, a ':' for entities and, for single
+ * values, the new value.
+ *
+ * @return The text.
+ */
+string Patch::str() const {
+  string out;
+
+  for (const Op &op : m_ops) {
+    out += op.kind == Change::added ? "+ " : op.kind == Change::removed ? "- " : "~ ";
+    out += op.path.str();
+    if (!op.is_key)
+      out += ":";
+    if (op.key && op.key->type() == Key::value_t) {
+      const Data &value = ((const KValue *)op.key)->value();
+      out += " = ";
+      out += value.type() == Data::string_t ? "\"" + value.data_str() + "\"" : value.data_str();
+    }
+    out += "\n";
+  }
+  return out;
+}
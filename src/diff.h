@@ -0,0 +1,87 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Confslice - A simple configuration file parser.
+ *
+ * Copyright (C) 2014 Giorgos Kappes <geokapp@gmail.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file LICENSE.
+ *
+ */
+
+#ifndef DIFF_H
+#define DIFF_H
+
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <vector>
+#include "configuration.h"
+#include "path.h"
+
+/**
+ * @name Change - A difference between two configurations.
+ *
+ * A key is added, removed or changed; an entity is added or removed as a
+ * whole, and the changes inside an entity that exists in both trees are
+ * reported for its keys and sub-entities. The path is the full dotted path
+ * of the key or the entity, with IDs that contain dots quoted. The objects
+ * point into the two trees.
+ */
+struct Change {
+  enum Kind
+  {
+    added,
+    removed,
+    changed
+  };
+
+  Kind kind;
+  std::string path;
+  const Key *old_key;         // The removed or changed key, or NULL.
+  const Key *new_key;         // The added or changed key, or NULL.
+  const Entity *old_entity;   // The removed entity, or NULL.
+  const Entity *new_entity;   // The added entity, or NULL.
+};
+
+int32_t diff(const Configuration *from, const Configuration *to,
+	     const std::function<void(const Change &)> &event);
+int32_t diff(const Configuration *from, const Configuration *to, std::vector<Change> &changes);
+
+/**
+ * @name Patch - The changes that turn one configuration into another.
+ *
+ * A patch holds one operation per change, with its path and a copy of
+ * every added or changed key and of every added entity, so it does not
+ * depend on the trees it was made from. apply() replays the operations on
+ * a tree that matches the old configuration.
+ */
+class Patch {
+ private:
+  struct Op {
+    Change::Kind kind;
+    Path path;
+    bool is_key;
+    Key *key;         // A copy of the added or changed key.
+    Entity *entity;   // A copy of the added entity.
+  };
+  std::vector<Op> m_ops;
+
+ public:
+  Patch();
+  ~Patch();
+  Patch(const Patch &) = delete;
+  Patch &operator=(const Patch &) = delete;
+
+  int32_t make(const Configuration *from, const Configuration *to);
+  int32_t apply(Configuration *conf) const;
+  void clear();
+
+  size_t size() const;
+  std::string str() const;
+};
+
+#endif
@@ -12,6 +12,7 @@
  * 
  */
 
+#include <stdio.h>
 #include <iostream>
 #include "configuration.h"
 #include "global.h"
@@ -24,7 +25,8 @@ using namespace std;
  * Creates a new GlobalContext object.
  */
 GlobalContext::GlobalContext() {
-  m_current_entity = NULL;
+  m_errors = NULL;
+  m_stats = NULL;
 }
 
 /**
@@ -33,30 +35,61 @@ GlobalContext::GlobalContext() {
  * Destroys the GlobalContext object.
  */
 GlobalContext::~GlobalContext() {
-  if (m_current_entity)
-    delete m_current_entity;
-  m_current_entity = NULL;
 }
 
 /**
- * @name set_current_entity - Set the current entity.
- * @param entity: The entity object.
+ * @name set_errors - Set the error buffer.
+ * @param errors: The buffer, or NULL to print the errors to stderr.
  *
- * Sets the current entity.
+ * @return Void.
+ */
+void GlobalContext::set_errors(std::string *errors) {
+  m_errors = errors;
+}
+
+/**
+ * @name set_stats - Set the statistics to collect.
+ * @param stats: The statistics, or NULL to collect none.
  *
  * @return Void.
  */
-void GlobalContext::set_current_entity(Entity *entity) {
-  m_current_entity = entity;
+void GlobalContext::set_stats(ParseStats *stats) {
+  m_stats = stats;
 }
 
 /**
- * @name current_entity - Return the current entity.
+ * @name report - Report an error.
+ * @param format: A printf format, followed by its arguments.
  *
- * Returns the current entity.
+ * Appends the message to the error buffer or prints it to stderr.
  *
- * @return A pointer to an entity obeject or NULL.
+ * @return Void.
  */
-Entity *GlobalContext::current_entity() {
-  return m_current_entity;
+void GlobalContext::report(const char *format, ...) {
+  va_list args;
+
+  va_start(args, format);
+  vreport(format, args);
+  va_end(args);
+}
+
+/**
+ * @name vreport - Report an error.
+ * @param format: A printf format.
+ * @param args: Its arguments.
+ *
+ * Same as report().
+ *
+ * @return Void.
+ */
+void GlobalContext::vreport(const char *format, va_list args) {
+  char buf[512];
+
+  if (m_errors) {
+    int n = vsnprintf(buf, sizeof(buf), format, args);
+    if (n > 0)
+      m_errors->append(buf, (size_t)n < sizeof(buf) ? n : sizeof(buf) - 1);
+  } else {
+    vfprintf(stderr, format, args);
+  }
 }
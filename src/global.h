@@ -15,7 +15,10 @@
 #ifndef GLOBAL_H
 #define GLOBAL_H
 
+#include <stdarg.h>
+#include <string>
 #include "configuration.h"
+#include "stats.h"
 
 /**
  * @name GlobalContext - The global context object.
@@ -23,17 +26,36 @@
  * This class defiens the global context object that contain global
  * variables between other objects that are able to see the same
  * instance of GlobalContext.
+ *
+ * The analyzers report their errors through the context. They are
+ * printed to stderr unless an error buffer is set. They also collect
+ * their statistics through it, when they are built in.
  */
 class GlobalContext {
  private:
-  Entity *m_current_entity;
+  std::string *m_errors;
+  ParseStats *m_stats;
 
  public:
   GlobalContext();
   ~GlobalContext();
 
-  void set_current_entity(Entity *entity);
-  Entity *current_entity();
+  void set_errors(std::string *errors);
+  void report(const char *format, ...) __attribute__((format(printf, 2, 3)));
+  void vreport(const char *format, va_list args);
+
+  void set_stats(ParseStats *stats);
+
+  /**
+   * @name stats - Get the statistics to collect.
+   *
+   * Inline, so that the hooks are dead code without statistics.
+   *
+   * @return The statistics, or NULL if none are collected.
+   */
+  ParseStats *stats() {
+    return ParseStats::enabled ? m_stats : NULL;
+  }
 };
 
 #endif
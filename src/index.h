@@ -0,0 +1,233 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Confslice - A simple configuration file parser.
+ *
+ * Copyright (C) 2014 Giorgos Kappes <geokapp@gmail.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file LICENSE.
+ *
+ */
+
+#ifndef INDEX_H
+#define INDEX_H
+
+#include <stdint.h>
+#include <string.h>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+/**
+ * @name hash_id - Hash an ID.
+ * @param id: The ID.
+ *
+ * A 64-bit multiplicative hash that consumes eight bytes per step.
+ *
+ * @return The hash value.
+ */
+inline uint64_t hash_id(const std::string_view id) {
+  const uint64_t m = 0x9e3779b97f4a7c15ULL;
+  const char *p = id.data();
+  size_t n = id.size();
+  uint64_t h = n * m;
+
+  for (; n >= 8; n -= 8, p += 8) {
+    uint64_t w;
+    memcpy(&w, p, 8);
+    h = (h ^ w) * m;
+    h ^= h >> 29;
+  }
+  if (n) {
+    uint64_t w = 0;
+    memcpy(&w, p, n);
+    h = (h ^ w) * m;
+    h ^= h >> 29;
+  }
+  h *= m;
+  return h ^ (h >> 32);
+}
+
+/**
+ * @name Index - An ID index.
+ *
+ * This class maps IDs to objects with an open addressing hash table and
+ * linear probing. The objects are not owned; the index only stores their
+ * pointers together with the hash of their ID, so it is kept next to the
+ * list that holds the objects in insertion order. Lookups take a string
+ * view and never allocate. T must have an id() method that returns
+ * something convertible to std::string_view.
+ *
+ * Up to INDEX_SMALL objects are kept densely and searched linearly by
+ * their hash, since most entities hold a handful of keys. The table is
+ * allocated from the memory resource of its owner.
+ */
+#define INDEX_SMALL 8
+
+template <typename T>
+class Index {
+ private:
+  struct Slot {
+    uint64_t hash;
+    T *item;
+  };
+  std::pmr::vector<Slot> m_slots;
+  size_t m_size;
+  bool m_hashed;
+
+ public:
+  explicit Index(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+    : m_slots(resource), m_size(0), m_hashed(false) {}
+
+  /**
+   * @name find - Find an object.
+   * @param id: The ID of the object.
+   *
+   * @return The object or NULL.
+   */
+  T *find(const std::string_view id) const {
+    if (m_slots.empty())
+      return NULL;
+    return find(id, hash_id(id));
+  }
+
+  /**
+   * @name find - Find an object by a precomputed hash.
+   * @param id: The ID of the object.
+   * @param hash: The hash_id() of the ID.
+   *
+   * @return The object or NULL.
+   */
+  T *find(const std::string_view id, const uint64_t hash) const {
+    if (m_slots.empty())
+      return NULL;
+    if (!m_hashed) {
+      for (size_t i = 0; i < m_size; i++)
+	if (m_slots[i].hash == hash && std::string_view(m_slots[i].item->id()) == id)
+	  return m_slots[i].item;
+      return NULL;
+    }
+    size_t mask = m_slots.size() - 1;
+    for (size_t i = hash & mask; m_slots[i].item; i = (i + 1) & mask)
+      if (m_slots[i].hash == hash && std::string_view(m_slots[i].item->id()) == id)
+	return m_slots[i].item;
+    return NULL;
+  }
+
+  /**
+   * @name insert - Insert an object.
+   * @param item: The object. Its ID must not be in the index.
+   *
+   * @return Void.
+   */
+  void insert(T *item) {
+    if (!m_hashed && m_size < INDEX_SMALL) {
+      if (m_slots.empty())
+	m_slots.reserve(INDEX_SMALL);
+      m_slots.push_back(Slot{hash_id(item->id()), item});
+      m_size++;
+      return;
+    }
+    if ((m_size + 1) * 2 > m_slots.size() || !m_hashed)
+      grow();
+    place(hash_id(item->id()), item);
+    m_size++;
+  }
+
+  /**
+   * @name erase - Remove an object.
+   * @param item: The object.
+   *
+   * Removes the object and shifts back the slots of its probe sequence, so
+   * no tombstones are left behind.
+   *
+   * @return Void.
+   */
+  void erase(const T *item) {
+    if (m_slots.empty())
+      return;
+    if (!m_hashed) {
+      for (size_t i = 0; i < m_size; i++) {
+	if (m_slots[i].item == item) {
+	  m_slots.erase(m_slots.begin() + i);
+	  m_size--;
+	  return;
+	}
+      }
+      return;
+    }
+    size_t mask = m_slots.size() - 1;
+    size_t i = hash_id(item->id()) & mask;
+    while (m_slots[i].item && m_slots[i].item != item)
+      i = (i + 1) & mask;
+    if (!m_slots[i].item)
+      return;
+
+    for (size_t j = (i + 1) & mask; m_slots[j].item; j = (j + 1) & mask) {
+      // Move slot j to the hole at i if its home slot is not in (i, j].
+      size_t home = m_slots[j].hash & mask;
+      if (((j - home) & mask) >= ((j - i) & mask)) {
+	m_slots[i] = m_slots[j];
+	i = j;
+      }
+    }
+    m_slots[i].item = NULL;
+    m_size--;
+  }
+
+  /**
+   * @name clear - Remove all the objects.
+   *
+   * @return Void.
+   */
+  void clear() {
+    std::pmr::vector<Slot>(m_slots.get_allocator()).swap(m_slots);
+    m_size = 0;
+    m_hashed = false;
+  }
+
+  /**
+   * @name size - Number of objects.
+   *
+   * @return The number of objects.
+   */
+  size_t size() const {
+    return m_size;
+  }
+
+  /**
+   * @name bytes - Size of the table.
+   *
+   * @return The number of bytes allocated for the table.
+   */
+  size_t bytes() const {
+    return m_slots.capacity() * sizeof(Slot);
+  }
+
+ private:
+  void place(uint64_t hash, T *item) {
+    size_t mask = m_slots.size() - 1;
+    size_t i = hash & mask;
+    while (m_slots[i].item)
+      i = (i + 1) & mask;
+    m_slots[i].hash = hash;
+    m_slots[i].item = item;
+  }
+
+  void grow() {
+    size_t size = 4 * INDEX_SMALL;
+    while (size < (m_size + 1) * 2)
+      size *= 2;
+    std::pmr::vector<Slot> old(size, Slot{0, NULL}, m_slots.get_allocator());
+    old.swap(m_slots);
+    m_hashed = true;
+    for (size_t i = 0; i < old.size(); i++)
+      if (old[i].item)
+	place(old[i].hash, old[i].item);
+  }
+};
+
+#endif
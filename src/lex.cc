@@ -15,20 +15,120 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
-#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <iostream>
+#include <stdarg.h>
+#include "global.h"
 #include "lex.h"
+#include "scan.h"
 
 using namespace std;
 
+namespace {
+
+/**
+ * CharClasses - Symbol ID of each input byte.
+ *
+ * The table is built at compile time and replaces the locale-dependent
+ * ctype calls. Letters, digits and white space follow the C locale. The
+ * byte 0xff is the EOF that fgetc() returns when it is stored in a char.
+ */
+struct CharClasses {
+  uint8_t id[256];
+
+  constexpr CharClasses() : id() {
+    for (int32_t c = 0; c < 256; c++)
+      id[c] = OTHER;
+    for (int32_t c = 'a'; c <= 'z'; c++)
+      id[c] = LETTER;
+    for (int32_t c = 'A'; c <= 'Z'; c++)
+      id[c] = LETTER;
+    for (int32_t c = '0'; c <= '9'; c++)
+      id[c] = DIGIT;
+    id[(unsigned char)' '] = WHITE;
+    id[(unsigned char)'\t'] = WHITE;
+    id[(unsigned char)'\v'] = WHITE;
+    id[(unsigned char)'\f'] = WHITE;
+    id[(unsigned char)'\r'] = WHITE;
+    id[(unsigned char)'\n'] = EOL_TK;
+    id[(unsigned char)EOF] = EOF_TK;
+    id[(unsigned char)'/'] = SLASH;
+    id[(unsigned char)'"'] = DITTO;
+    id[(unsigned char)'\\'] = BACKSLASH;
+    id[(unsigned char)'-'] = MINUS;
+    id[(unsigned char)'_'] = UNDERSCORE;
+    id[(unsigned char)'.'] = PERIOD;
+    id[(unsigned char)'+'] = PLUS;
+  }
+};
+
+/**
+ * CharTokens - Token ID of each single character token.
+ *
+ * Characters that are not defined words keep their symbol ID.
+ */
+struct CharTokens {
+  uint8_t id[256];
+
+  constexpr CharTokens() : id() {
+    const char defined_words[DSIZE] = {'=', '[', ']', '(', ')', '{', '}', '<', '>', ';', ':', ','};
+    const CharClasses classes;
+
+    for (int32_t c = 0; c < 256; c++)
+      id[c] = classes.id[c];
+    for (int32_t i = 0; i < DSIZE; i++)
+      id[(unsigned char)defined_words[i]] = ASSIGN_TK + i;
+  }
+};
+
+constexpr CharClasses CLASSES;
+constexpr CharTokens TOKENS;
+
+// The state table.
+constexpr uint8_t STATES[STATESIZE][SSIZE] = {
+  //ws,  lt   dg  EOL  EOF    /    "    \    -    _    .    +    o
+  {ST0, ST1, ST2, ST0,  OK, ST3, ST5,  OK, ST8,  OK, ST7, ST8,  OK}, // 0
+  { BK, ST1, ST1,  BK,  BK,  BK,  BK,  BK, ST1, ST1, ST1, ST1,  BK}, // 1
+  { BK,  BK, ST2,  BK,  BK,  BK,  BK,  BK,  BK,  BK, ST7,  BK,  BK}, // 2
+  { BK,  BK,  BK,  BK,  BK, ST4,  BK,  BK,  BK,  BK,  BK,  BK,  BK}, // 3
+  {ST4, ST4, ST4, ST0, ERR, ST4, ST4, ST4, ST4, ST4, ST4, ST4, ST4}, // 4
+  {ST5, ST5, ST5, ERR, ERR, ST5,  OK, ST6, ST5, ST5, ST5, ST5, ST5}, // 5
+  {ST5, ST5, ST5, ERR, ERR, ST5, ST5, ST6, ST5, ST5, ST5, ST5, ST5}, // 6
+  { BK,  BK, ST7,  BK,  BK,  BK,  BK,  BK,  BK,  BK,  BK,  BK,  BK}, // 7
+  { BK,  BK, ST2,  BK,  BK,  BK,  BK,  BK,  BK,  BK,  BK,  BK,  BK}, // 8
+};
+
+static_assert(CLASSES.id[(unsigned char)'.'] == PERIOD, "bad symbol table");
+static_assert(TOKENS.id[(unsigned char)','] == COMMA_TK, "bad token table");
+
+/*
+ * The statistics that an analyzer collects, or NULL.
+ */
+inline ParseStats *stats_of(GlobalContext *gc) {
+  return gc ? gc->stats() : NULL;
+}
+
+}
+
 /**
  * @name LexAnalyzer - Constructor.
+ * @param gc: A pointer to a global context object that receives the
+ *            errors, or NULL to print them to stderr.
  *
  * This method initializes the LexAnalyzer object.
  */
-LexAnalyzer::LexAnalyzer() {
+LexAnalyzer::LexAnalyzer(GlobalContext *gc) {
+  m_gc_ptr = gc;
   m_line = 1;
   m_file = NULL;
+  m_begin = m_cur = m_end = NULL;
+  m_map = NULL;
+  m_map_size = 0;
+  m_heap = NULL;
 }
 
 /**
@@ -38,10 +138,7 @@ LexAnalyzer::LexAnalyzer() {
  * it is still open.
  */
 LexAnalyzer::~LexAnalyzer() {
-  if (m_file) {
-    fclose(m_file);
-    m_file = NULL;
-  }
+  close();
   m_line = 0;
 }
 
@@ -59,26 +156,104 @@ uint32_t LexAnalyzer::line() {
 /**
  * @name open - Open the input file
  * @param file: The filename.
+ * @param input: How the file contents are fed to the analyzer.
  *
- * This method loads a configuration file to the analyzer.
+ * This method loads a configuration file to the analyzer. By default the
+ * file is memory-mapped, or read into a buffer if it cannot be mapped.
  *
- * @return 0 on success, 1 on error.
+ * @return 0 on success, -1 on error.
  */
-int32_t LexAnalyzer::open(const string file) {
-  if (!(m_file = fopen(file.c_str(), "r"))) {
-    fprintf(stderr,"File \"%s\" not found. \n",file.c_str());
-    m_file = NULL;
+int32_t LexAnalyzer::open(const string file, const LexAnalyzer::Input input) {
+  StatsTimer timer(stats_of(m_gc_ptr), ParseStats::io_phase);
+  struct stat st;
+  int fd;
+  int32_t result;
+
+  close();
+  m_line = 1;
+
+  if (input == stdio_in) {
+    if (!(m_file = fopen(file.c_str(), "r"))) {
+      report("File \"%s\" not found. \n",file.c_str());
+      m_file = NULL;
+      return -1;
+    }
+    return 0;
+  }
+
+  if ((fd = ::open(file.c_str(), O_RDONLY)) < 0) {
+    report("File \"%s\" not found. \n",file.c_str());
+    return -1;
+  }
+  if (fstat(fd, &st) < 0) {
+    report("File \"%s\": %s. \n",file.c_str(), strerror(errno));
+    ::close(fd);
     return -1;
   }
+
+  result = -1;
+  if (input != read_in && S_ISREG(st.st_mode))
+    result = map_file(fd, st.st_size);
+  if (result && input != mmap_in)
+    result = read_file(fd, S_ISREG(st.st_mode) ? st.st_size : 0);
+  if (result)
+    report("File \"%s\" could not be loaded. \n",file.c_str());
+  else if (ParseStats *stats = stats_of(m_gc_ptr))
+    stats->bytes += m_end - m_begin;
+  ::close(fd);
+  return result;
+}
+
+/**
+ * @name open_buffer - Use a memory buffer as input.
+ * @param data: The configuration text.
+ * @param len: The length of the text in bytes.
+ *
+ * @param line: The line number of the first line of the text.
+ *
+ * This method loads a configuration that is already in memory. The buffer
+ * is not copied, so it must stay valid until the analyzer is closed. A
+ * part of a larger text can be analyzed on its own by passing the line it
+ * starts at, so that errors refer to the whole text.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int32_t LexAnalyzer::open_buffer(const char *data, const size_t len, const uint32_t line) {
+  static const char empty[1] = {0};
+
+  close();
+  m_line = line;
+  if (!data) {
+    if (len)
+      return -1;
+    data = empty;
+  }
+  m_begin = m_cur = data;
+  m_end = data + len;
+  if (ParseStats *stats = stats_of(m_gc_ptr))
+    stats->bytes += len;
   return 0;
 }
 
+/**
+ * @name buffer - Get the input.
+ *
+ * @return The whole input if it is in memory, that is if it was mapped,
+ *         read into a buffer or given to open_buffer(); otherwise an
+ *         empty view.
+ */
+std::string_view LexAnalyzer::buffer() const {
+  if (!m_begin)
+    return std::string_view();
+  return std::string_view(m_begin, m_end - m_begin);
+}
+
 /**
  * @name close - Close the input file.
  *
- * This method closes the input file.
+ * This method closes the input file and releases the input buffer.
  *
- * @return 0 on success, 1 on error.
+ * @return 0 on success, -1 on error.
  */
 int32_t LexAnalyzer::close() {
   int32_t status = -1;
@@ -86,110 +261,270 @@ int32_t LexAnalyzer::close() {
     status = fclose(m_file);
     m_file = NULL;
   }
+  if (m_begin) {
+    status = 0;
+    if (m_map && munmap(m_map, m_map_size))
+      status = -1;
+    if (m_heap)
+      free(m_heap);
+    m_map = NULL;
+    m_map_size = 0;
+    m_heap = NULL;
+    m_begin = m_cur = m_end = NULL;
+  }
   return status;
 }
 
+/**
+ * @name report - Report an error.
+ * @param format: A printf format, followed by its arguments.
+ *
+ * @return Void.
+ */
+void LexAnalyzer::report(const char *format, ...) {
+  va_list args;
+
+  va_start(args, format);
+  if (m_gc_ptr)
+    m_gc_ptr->vreport(format, args);
+  else
+    vfprintf(stderr, format, args);
+  va_end(args);
+}
+
+/**
+ * @name map_file - Map the input file.
+ * @param fd: An open file descriptor of a regular file.
+ * @param size: The file size.
+ *
+ * This method maps the whole file read-only and advises the kernel that it
+ * will be read sequentially.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int32_t LexAnalyzer::map_file(int fd, size_t size) {
+  static const char empty[1] = {0};
+  void *addr;
+
+  if (size == 0) {
+    // Nothing to map. Use an empty range.
+    m_begin = m_cur = m_end = empty;
+    return 0;
+  }
+  addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (addr == MAP_FAILED)
+    return -1;
+  madvise(addr, size, MADV_SEQUENTIAL);
+  madvise(addr, size, MADV_WILLNEED);
+
+  m_map = addr;
+  m_map_size = size;
+  m_begin = m_cur = (const char *)addr;
+  m_end = m_begin + size;
+  return 0;
+}
+
+/**
+ * @name read_file - Read the input file into a buffer.
+ * @param fd: An open file descriptor.
+ * @param size_hint: The expected file size or 0 if it is unknown.
+ *
+ * This method reads the whole input into a heap buffer. It is used for
+ * files that cannot be mapped.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int32_t LexAnalyzer::read_file(int fd, size_t size_hint) {
+  size_t capacity = size_hint ? size_hint + 1 : 65536;
+  size_t size = 0;
+  char *buf = (char *)malloc(capacity);
+
+  if (!buf)
+    return -1;
+  for (;;) {
+    if (size == capacity) {
+      char *tmp = (char *)realloc(buf, capacity * 2);
+      if (!tmp) {
+	free(buf);
+	return -1;
+      }
+      buf = tmp;
+      capacity *= 2;
+    }
+    ssize_t n = read(fd, buf + size, capacity - size);
+    if (n < 0) {
+      if (errno == EINTR)
+	continue;
+      free(buf);
+      return -1;
+    }
+    if (n == 0)
+      break;
+    size += n;
+  }
+
+  m_heap = buf;
+  m_begin = m_cur = buf;
+  m_end = buf + size;
+  return 0;
+}
+
 /**
  * @name analyze - Lexixal analyzer.
- * @param word: A reference to the identified token.
+ * @param token: A reference to the identified token.
  
  * This method parses the configuration file and returns the next identified
- * token and its ID.
+ * token and its ID. When the input is in memory the token points into the
+ * input and it stays valid until the analyzer is closed. Otherwise, it
+ * points to an internal buffer that the next call overwrites. The token of
+ * the end of the input is empty.
  *
  * @return Token ID or -1 on error.
  */
-int32_t LexAnalyzer::analyze(string &word) {
+int32_t LexAnalyzer::analyze(std::string_view &token) {
+  ParseStats *stats = stats_of(m_gc_ptr);
+  if (!stats)
+    return scan(token);
+
+  StatsTimer timer(stats, ParseStats::lex_phase);
+  int32_t id = scan(token);
+  if (id != EOF_TK)
+    stats->count_token(id);
+  return id;
+}
+
+/**
+ * @name scan - Identify the next token.
+ * @param token: A reference to the identified token.
+ *
+ * The body of analyze(), without the statistics.
+ *
+ * @return Token ID or -1 on error.
+ */
+int32_t LexAnalyzer::scan(std::string_view &token) {
   // If the input file has not been opened immediately return.
-  if (!m_file)
+  if (!m_file && !m_begin)
     return -1;
   
-  // The state table. 
-  const int32_t STATES[STATESIZE][SSIZE] = {
-    //ws,  lt   dg  EOL  EOF    /    "    \    -    _    .    +    o
-    {ST0, ST1, ST2, ST0,  OK, ST3, ST5,  OK, ST8,  OK, ST7, ST8,  OK}, // 0
-    { BK, ST1, ST1,  BK,  BK,  BK,  BK,  BK, ST1, ST1, ST1, ST1,  BK}, // 1 
-    { BK,  BK, ST2,  BK,  BK,  BK,  BK,  BK,  BK,  BK, ST7,  BK,  BK}, // 2
-    { BK,  BK,  BK,  BK,  BK, ST4,  BK,  BK,  BK,  BK,  BK,  BK,  BK}, // 3
-    {ST4, ST4, ST4, ST0, ERR, ST4, ST4, ST4, ST4, ST4, ST4, ST4, ST4}, // 4
-    {ST5, ST5, ST5, ERR, ERR, ST5,  OK, ST6, ST5, ST5, ST5, ST5, ST5}, // 5
-    {ST5, ST5, ST5, ERR, ERR, ST5, ST5, ST6, ST5, ST5, ST5, ST5, ST5}, // 6
-    { BK, BK,  ST7,  BK,  BK,  BK,  BK,  BK,  BK,  BK,  BK,  BK,  BK}, // 7
-    { BK, BK,  ST2,  BK,  BK,  BK,  BK,  BK,  BK,  BK,  BK,  BK,  BK}, // 8
-  };
- 
-  // The defined words.
-  const char defined_words[DSIZE] = {'=', '[', ']', '(', ')', '{', '}', '<', '>', ';', ':', ','};
-  
-  int32_t id, i;
+  int32_t cls, ch;
   char c;
-  string current;
+  int32_t last = ST0;
   int32_t state = ST0;
+  const char *start = m_cur;
 
-  while (state != OK && state != ERR && state!= BK) {
-    if (state == ST0)
-      current.clear();
-    
-    c = fgetc(m_file);
-    if (c == '\n') {
-      m_line++;
-      id = EOL_TK;
-    } else {
-      id = get_id(c);
-    }
-    if (id == ERR) {
-	fprintf(stderr, "Error at Line %d: '%c': Not allowed character.\n",m_line,c);
-	return -1;
+  do {
+    if (m_begin) {
+      if (state == ST0) {
+	// Skip white space runs in blocks. The token starts after them.
+	if (m_cur < m_end) {
+	  cls = CLASSES.id[(unsigned char)*m_cur];
+	  if (cls == WHITE || cls == EOL_TK)
+	    m_cur = scan_space(m_cur, m_end, &m_line);
+	}
+	start = m_cur;
+      } else if (state == ST4) {
+	// Jump to the end of a comment.
+	m_cur = scan_eol(m_cur, m_end);
+      } else if (state == ST5) {
+	// Jump to the end of a string body.
+	m_cur = scan_string(m_cur, m_end);
+      }
+    } else if (state == ST0) {
+      m_scratch.clear();
     }
-    state = STATES[state][id];
-    if (state != BK && state != ERR && id != WHITE && state != ST4) 
-      current += c;
-  }
+
+    ch = next_char();
+    c = (char)ch;
+    cls = CLASSES.id[(unsigned char)c];
+    if (cls == EOL_TK)
+      m_line++;
+    last = state;
+    state = STATES[state][cls];
+    if (!m_begin && state != BK && state != ERR && state != ST4 && (cls != WHITE || state == ST5))
+      m_scratch += c;
+  } while (state <= ST8);
   
   if (state == ERR) {
-    fprintf(stderr, "Error at line %d: end of line or file is not allowed here.\n",m_line);
+    report("Error at line %d: end of line or file is not allowed here.\n",m_line);
     return -1;
   }
 
-  if (state == BK) ungetc(c, m_file);
+  if (state == BK) {
+    // The new line will be counted again when it is read back.
+    if (c == '\n')
+      m_line--;
+    unget_char(ch);
+  }
 
-  for (i = 0; i < DSIZE; i++) {
-    if (current.at(0) == defined_words[i]) { 
-      word = current;
-      return 50 + i;
+  if (m_begin)
+    token = std::string_view(start, m_cur - start);
+  else if (ch == EOF)
+    token = std::string_view();
+  else
+    token = m_scratch;
+
+  if (state == BK) {
+    // The token type depends on the state that was left.
+    switch (last) {
+    case ST1:
+      return ID_TK;
+    case ST2:
+      return INTEGER_TK;
+    case ST7:
+      // A lone '.' is not a number.
+      return (token.size() > 1) ? DOUBLE_TK : OTHER;
+    default:
+      return OTHER;
     }
   }
-  word = current;
-  if (isalpha(current.at(0))) {
-    return ID_TK;
-  } else if (current.find('"') != string::npos) {
+
+  // A string ends in ST5, everything else is a single character token.
+  if (last == ST5)
     return STRING_TK;
-  } else if (isdigit(current.at(0)) || (current.at(0) == '-' && isdigit(current.at(1)))) {
-    if (current.find('.') != string::npos)
-      return DOUBLE_TK;
-    else
-      return INTEGER_TK;
-  } else {
-    return id;
-  }   
+  return TOKENS.id[(unsigned char)c];
 }
 
 /**
- * @name get_id - Returns the ID of a symbol.
- * @param c: A character.
+ * @name skip_string - Find the end of a string in memory.
+ * @param p: The first byte after the opening quote.
+ * @param end: The end of the text.
  *
- * This method returns the ID of a input symbol.
+ * Runs the string states of the analyzer, so a string ends where analyze()
+ * ends it: a quote after a run of backslashes is escaped, and a new line
+ * or EOF ends an unterminated string, which is an error.
  *
- * @return Symbol ID.
+ * @return The byte after the closing quote, or the new line or EOF that
+ *         ends the string, or end.
  */
-int32_t LexAnalyzer::get_id(const char c) {
-  char symbols[SSIZE]= {'x','x','x','\n', EOF, '/', '\"', '\\', '-', '_', 'x'};
-  
-  for (int32_t i = 3; i < SSIZE; i++) {
-    if (c == symbols[i]) 
-      return i;
+const char *LexAnalyzer::skip_string(const char *p, const char *end) {
+  int32_t state = ST5;
+
+  while (p < end) {
+    if (state == ST5 && (p = scan_string(p, end)) == end)
+      break;
+    state = STATES[state][CLASSES.id[(unsigned char)*p]];
+    if (state == ERR)
+      break;
+    p++;
+    if (state == OK)
+      break;
   }
-  if (isalpha(c)) return 1;
-  else if (isdigit(c)) return 2;
-  else if (isspace(c)) return 0;
-  else return SSIZE - 1;
+  return p;
+}
+
+/**
+ * @name analyze - Lexixal analyzer.
+ * @param word: A reference to the identified token.
+ 
+ * This method returns the next identified token and its ID. It is the same
+ * as analyze(std::string_view &) but it copies the token.
+ *
+ * @return Token ID or -1 on error.
+ */
+int32_t LexAnalyzer::analyze(string &word) {
+  std::string_view token;
+  int32_t id = analyze(token);
+
+  word.assign(token.data(), token.size());
+  return id;
 }
@@ -16,9 +16,13 @@
 #define LEX_H
 
 #include <stdint.h>
+#include <stdio.h>
 #include <string>
+#include <string_view>
 #include <list>
 
+class GlobalContext;
+
 // Symbols
 #define WHITE        0  // \n \t space
 #define LETTER       1  // Letter
@@ -78,24 +82,75 @@
  *
  * This class defines the analyzer object. You must first call the open method in order
  * to load a configuration file. Then,tTo analyze the next token use the analyze method.
+ *
+ * The input is either read through stdio one character at a time, or it is
+ * exposed as a contiguous byte range which the analyzer walks by pointer. The
+ * byte range is a read-only memory mapping of the file, or a heap buffer filled
+ * with read() when the file cannot be mapped (pipes, character devices, etc).
  */
 class LexAnalyzer {
+ public:
+  enum Input
+  {
+    auto_in,   // Map the file, fall back to read_in.
+    mmap_in,   // Memory-mapped file.
+    read_in,   // Whole file read() into a heap buffer.
+    stdio_in   // fgetc() on a FILE stream.
+  };
+
  private:
   uint32_t m_line;
   FILE *m_file;
+  const char *m_begin;
+  const char *m_cur;
+  const char *m_end;
+  void *m_map;
+  size_t m_map_size;
+  char *m_heap;
+  std::string m_scratch;
+  GlobalContext *m_gc_ptr;
   
  public:
-  LexAnalyzer();
+  explicit LexAnalyzer(GlobalContext *gc = NULL);
   ~LexAnalyzer();
   
   uint32_t line();
   
-  int32_t open(const std::string file);
+  int32_t open(const std::string file, const LexAnalyzer::Input input = auto_in);
+  int32_t open_buffer(const char *data, const size_t len, const uint32_t line = 1);
+  std::string_view buffer() const;
   int32_t close();
+  int32_t analyze(std::string_view &token);
   int32_t analyze(std::string &word);
+
+  static const char *skip_string(const char *p, const char *end);
   
  private:
-  int32_t get_id(const char c);
+  int32_t scan(std::string_view &token);
+  int32_t map_file(int fd, size_t size);
+  int32_t read_file(int fd, size_t size_hint);
+  void report(const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+  /**
+   * next_char - Return the next input character or EOF.
+   */
+  inline int32_t next_char() {
+    if (m_begin)
+      return (m_cur < m_end) ? (unsigned char)*m_cur++ : EOF;
+    return fgetc(m_file);
+  }
+
+  /**
+   * unget_char - Push back the last character returned by next_char().
+   */
+  inline void unget_char(int32_t c) {
+    if (c == EOF)
+      return;
+    if (m_begin)
+      m_cur--;
+    else
+      ungetc(c, m_file);
+  }
 };
 
 #endif
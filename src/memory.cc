@@ -0,0 +1,454 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Confslice - A simple configuration file parser.
+ *
+ * Copyright (C) 2014 Giorgos Kappes <geokapp@gmail.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file LICENSE.
+ *
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include <algorithm>
+#include "memory.h"
+#include "node.h"
+#include "stats.h"
+
+using namespace std;
+using std::pmr::memory_resource;
+
+/**
+ * @name ListNode - The layout of a node of std::list.
+ *
+ * Two links and the element.
+ */
+template <typename T>
+struct ListNode {
+  void *next;
+  void *prev;
+  T value;
+};
+
+/**
+ * @name on_heap - Whether a resource hands its requests to malloc.
+ * @param resource: The memory resource.
+ *
+ * The statistics resource is looked through.
+ *
+ * @return True if the resource allocates from the heap.
+ */
+static bool on_heap(memory_resource *resource) {
+  const StatsResource *stats = dynamic_cast<const StatsResource *>(resource);
+  if (stats)
+    resource = stats->upstream();
+  return resource->is_equal(*std::pmr::new_delete_resource());
+}
+
+/**
+ * @name malloc_overhead - The bytes that malloc adds to a request.
+ * @param size: The size of the request.
+ *
+ * A size word in front of every chunk, chunks aligned to two words and at
+ * least four words long, as in glibc. Other resources, such as arenas, are
+ * counted without overhead.
+ *
+ * @return The overhead in bytes.
+ */
+static size_t malloc_overhead(const size_t size) {
+  const size_t word = sizeof(size_t);
+  const size_t align = 2 * word;
+  size_t chunk = (size + word + align - 1) & ~(align - 1);
+  if (chunk < 4 * word)
+    chunk = 4 * word;
+  return chunk - size;
+}
+
+/**
+ * @name MemoryWalk - Account the memory of a tree.
+ *
+ * Walks a tree and charges every allocation to the kind of the node that
+ * holds it. The allocator of each entity and key is the one of its own
+ * memory resource.
+ */
+class MemoryWalk {
+ private:
+  MemoryUsage &m_usage;
+  bool m_heap;
+
+ public:
+  explicit MemoryWalk(MemoryUsage &usage) : m_usage(usage), m_heap(false) {}
+
+  void configuration(const Configuration *conf);
+
+ private:
+  void entity(const Entity *entity);
+  void key(const Key *key);
+  void data(const MemoryUsage::Kind kind, const Data &data);
+  void buffer(const MemoryUsage::Kind kind, const std::pmr::string &str);
+  void node(const MemoryUsage::Kind kind, const size_t size, const size_t vptr);
+  void charge(const MemoryUsage::Kind kind, const MemoryUsage::Part part, const size_t size);
+  void allocation(const MemoryUsage::Kind kind, const MemoryUsage::Part part, const size_t size);
+
+  template <typename T>
+  void list(const MemoryUsage::Kind kind, const std::pmr::list<T> &list);
+  template <typename T>
+  void vector(const MemoryUsage::Kind kind, const std::pmr::vector<T> &vector);
+  template <typename T>
+  void index(const MemoryUsage::Kind kind, const Index<T> &index);
+  template <typename T>
+  void blocks(const MemoryUsage::Kind kind, const DigestBlock<T> *blocks, const size_t size);
+};
+
+/**
+ * @name charge - Add bytes to the account.
+ * @param kind: The kind of the node that holds the bytes.
+ * @param part: What the bytes are.
+ * @param size: The number of bytes.
+ *
+ * @return Void.
+ */
+void MemoryWalk::charge(const MemoryUsage::Kind kind, const MemoryUsage::Part part,
+			const size_t size) {
+  m_usage.bytes[kind] += size;
+  m_usage.part_bytes[part] += size;
+  m_usage.total += size;
+}
+
+/**
+ * @name allocation - Charge an allocation.
+ * @param kind: The kind of the node that holds the allocation.
+ * @param part: What the allocation holds.
+ * @param size: The size of the request.
+ *
+ * On the heap, the overhead of malloc is charged as well.
+ *
+ * @return Void.
+ */
+void MemoryWalk::allocation(const MemoryUsage::Kind kind, const MemoryUsage::Part part,
+			    const size_t size) {
+  charge(kind, part, size);
+  if (m_heap)
+    charge(kind, MemoryUsage::overhead_p, malloc_overhead(size));
+  m_usage.allocations++;
+}
+
+/**
+ * @name list - Charge the nodes of a list.
+ * @param kind: The kind of the node that holds the list.
+ * @param list: The list.
+ *
+ * Every element is an allocation of its own.
+ *
+ * @return Void.
+ */
+template <typename T>
+void MemoryWalk::list(const MemoryUsage::Kind kind, const std::pmr::list<T> &list) {
+  for (size_t i = 0; i < list.size(); i++)
+    allocation(kind, MemoryUsage::list_node_p, sizeof(ListNode<T>));
+}
+
+/**
+ * @name vector - Charge the buffer of a vector.
+ * @param kind: The kind of the node that holds the vector.
+ * @param vector: The vector.
+ *
+ * The whole capacity is charged, including the unused part.
+ *
+ * @return Void.
+ */
+template <typename T>
+void MemoryWalk::vector(const MemoryUsage::Kind kind, const std::pmr::vector<T> &vector) {
+  if (vector.capacity())
+    allocation(kind, MemoryUsage::element_p, vector.capacity() * sizeof(T));
+}
+
+/**
+ * @name index - Charge the table of an ID index.
+ * @param kind: The kind of the node that holds the index.
+ * @param index: The index.
+ *
+ * @return Void.
+ */
+template <typename T>
+void MemoryWalk::index(const MemoryUsage::Kind kind, const Index<T> &index) {
+  if (index.bytes())
+    allocation(kind, MemoryUsage::index_p, index.bytes());
+}
+
+/**
+ * @name blocks - Charge the run digests of a frozen level.
+ * @param kind: The kind of the node that holds the level.
+ * @param blocks: The run digests or NULL.
+ * @param size: The number of objects of the level.
+ *
+ * @return Void.
+ */
+template <typename T>
+void MemoryWalk::blocks(const MemoryUsage::Kind kind, const DigestBlock<T> *blocks,
+			const size_t size) {
+  if (blocks)
+    allocation(kind, MemoryUsage::index_p, DigestBlock<T>::count(size) * sizeof(DigestBlock<T>));
+}
+
+/**
+ * @name node - Charge an entity or a key.
+ * @param kind: The kind of the node.
+ * @param size: The size of the object.
+ * @param vptr: The size of its vtable pointer, or 0.
+ *
+ * The object, its vtable pointer and the header that precedes it are one
+ * allocation.
+ *
+ * @return Void.
+ */
+void MemoryWalk::node(const MemoryUsage::Kind kind, const size_t size, const size_t vptr) {
+  m_usage.nodes[kind]++;
+  charge(kind, MemoryUsage::object_p, size - vptr);
+  charge(kind, MemoryUsage::vptr_p, vptr);
+  charge(kind, MemoryUsage::overhead_p, node_header);
+  if (m_heap)
+    charge(kind, MemoryUsage::overhead_p, malloc_overhead(size + node_header));
+  m_usage.allocations++;
+}
+
+/**
+ * @name buffer - Charge the buffer of a string.
+ * @param kind: The kind of the node that holds the string.
+ * @param str: The string.
+ *
+ * Short strings are stored inside the string object and cost nothing more.
+ *
+ * @return Void.
+ */
+void MemoryWalk::buffer(const MemoryUsage::Kind kind, const std::pmr::string &str) {
+  const char *object = (const char *)&str;
+  if (str.data() < object || str.data() >= object + sizeof(str))
+    allocation(kind, MemoryUsage::string_p, str.capacity() + 1);
+}
+
+/**
+ * @name data - Charge a value.
+ * @param kind: The kind of the node that holds the value.
+ * @param data: The value.
+ *
+ * Only strings hold memory outside the value.
+ *
+ * @return Void.
+ */
+void MemoryWalk::data(const MemoryUsage::Kind kind, const Data &data) {
+  buffer(kind, data.m_str);
+}
+
+/**
+ * @name key - Charge a key and its contents.
+ * @param key: The key.
+ *
+ * The key is charged to the kind of its type.
+ *
+ * @return Void.
+ */
+void MemoryWalk::key(const Key *key) {
+  bool heap = m_heap;
+  MemoryUsage::Kind kind = MemoryUsage::value_k;
+
+  m_heap = on_heap(key->resource());
+  switch (key->type()) {
+  case Key::value_t: {
+    const KValue *kv = (const KValue *)key;
+    node(kind, sizeof(KValue), sizeof(void *));
+    data(kind, kv->m_value);
+    break;
+  }
+  case Key::array_t: {
+    const KArray *ka = (const KArray *)key;
+    kind = MemoryUsage::array_k;
+    node(kind, sizeof(KArray), sizeof(void *));
+    vector(kind, ka->m_ints);
+    vector(kind, ka->m_doubles);
+    vector(kind, ka->m_data);
+    for (const Data &d : ka->m_data)
+      data(kind, d);
+    break;
+  }
+  case Key::list_t: {
+    const KList *kl = (const KList *)key;
+    kind = MemoryUsage::list_k;
+    node(kind, sizeof(KList), sizeof(void *));
+    vector(kind, kl->m_data);
+    vector(kind, kl->m_nodes);
+    for (const Data &d : kl->m_data)
+      data(kind, d);
+    break;
+  }
+  case Key::pairs_t: {
+    const KPairs *kp = (const KPairs *)key;
+    kind = MemoryUsage::pairs_k;
+    node(kind, sizeof(KPairs), sizeof(void *));
+    list(kind, kp->m_list);
+    for (const KPairs::Pair &pair : kp->m_list) {
+      buffer(kind, pair.first);
+      data(kind, pair.second);
+    }
+    break;
+  }
+  }
+  buffer(kind, key->m_id);
+  m_heap = heap;
+}
+
+/**
+ * @name entity - Charge an entity and its subtree.
+ * @param entity: The entity.
+ *
+ * The keys and the sub-entities are charged to their own kinds.
+ *
+ * @return Void.
+ */
+void MemoryWalk::entity(const Entity *entity) {
+  const MemoryUsage::Kind kind = MemoryUsage::entity_k;
+  bool heap = m_heap;
+
+  m_heap = on_heap(entity->resource());
+  node(kind, sizeof(Entity), 0);
+  buffer(kind, entity->m_id);
+  list(kind, entity->m_keys);
+  list(kind, entity->m_entities);
+  index(kind, entity->m_key_index);
+  index(kind, entity->m_entity_index);
+  blocks(kind, entity->m_key_blocks, entity->m_keys.size());
+  blocks(kind, entity->m_entity_blocks, entity->m_entities.size());
+  for (const Key *k : entity->m_keys)
+    key(k);
+  for (const Entity *e : entity->m_entities)
+    this->entity(e);
+  m_heap = heap;
+}
+
+/**
+ * @name configuration - Charge a configuration and its tree.
+ * @param conf: The configuration.
+ *
+ * Every top-level entity and key becomes a consumer with the bytes and
+ * the nodes charged while its subtree is walked.
+ *
+ * @return Void.
+ */
+void MemoryWalk::configuration(const Configuration *conf) {
+  const MemoryUsage::Kind kind = MemoryUsage::configuration_k;
+  auto nodes = [this]() {
+    uint64_t n = 0;
+    for (size_t i = 0; i < MemoryUsage::kinds; i++)
+      n += m_usage.nodes[i];
+    return n;
+  };
+
+  m_heap = on_heap(conf->resource());
+  m_usage.nodes[kind]++;
+  allocation(kind, MemoryUsage::object_p, sizeof(Configuration));
+  list(kind, conf->m_keys);
+  list(kind, conf->m_entities);
+  index(kind, conf->m_key_index);
+  index(kind, conf->m_entity_index);
+  blocks(kind, conf->m_key_blocks, conf->m_keys.size());
+  blocks(kind, conf->m_entity_blocks, conf->m_entities.size());
+
+  for (const Entity *e : conf->m_entities) {
+    uint64_t bytes = m_usage.total, n = nodes();
+    entity(e);
+    m_usage.consumers.push_back(MemoryUsage::Consumer{std::string(e->id()), true, nodes() - n,
+						      m_usage.total - bytes});
+  }
+  for (const Key *k : conf->m_keys) {
+    uint64_t bytes = m_usage.total, n = nodes();
+    key(k);
+    m_usage.consumers.push_back(MemoryUsage::Consumer{std::string(k->id()), false, nodes() - n,
+						      m_usage.total - bytes});
+  }
+}
+
+/**
+ * @name MemoryUsage - Constructor.
+ *
+ * Creates an empty account.
+ */
+MemoryUsage::MemoryUsage() {
+  clear();
+}
+
+/**
+ * @name clear - Reset the account.
+ *
+ * @return Void.
+ */
+void MemoryUsage::clear() {
+  memset(nodes, 0, sizeof(nodes));
+  memset(bytes, 0, sizeof(bytes));
+  memset(part_bytes, 0, sizeof(part_bytes));
+  allocations = 0;
+  total = 0;
+  consumers.clear();
+}
+
+/**
+ * @name top - Get the largest consumers.
+ * @param count: The number of consumers to return.
+ *
+ * @return Up to count consumers, the largest first. Consumers of the same
+ * size keep the order of the tree.
+ */
+std::vector<MemoryUsage::Consumer> MemoryUsage::top(const size_t count) const {
+  std::vector<Consumer> result = consumers;
+  std::stable_sort(result.begin(), result.end(), [](const Consumer &a, const Consumer &b) {
+    return a.bytes > b.bytes;
+  });
+  if (result.size() > count)
+    result.resize(count);
+  return result;
+}
+
+/**
+ * @name kind_name - Get the name of a kind of node.
+ * @param kind: The kind.
+ *
+ * @return The name, or NULL if there is no such kind.
+ */
+const char *MemoryUsage::kind_name(const size_t kind) {
+  static const char *names[kinds] = {"configuration", "entity", "value", "array", "list", "pairs"};
+  return kind < kinds ? names[kind] : NULL;
+}
+
+/**
+ * @name part_name - Get the name of a part.
+ * @param part: The part.
+ *
+ * @return The name, or NULL if there is no such part.
+ */
+const char *MemoryUsage::part_name(const size_t part) {
+  static const char *names[parts] = {"objects", "vptrs", "strings", "list_nodes", "elements",
+				     "indexes", "overhead"};
+  return part < parts ? names[part] : NULL;
+}
+
+/**
+ * @name memory_usage - Account the memory of a configuration.
+ * @param conf: The configuration.
+ * @param usage: Where the account is stored.
+ *
+ * Walks the whole tree and adds up every allocation it holds, including
+ * the configuration object itself. The sizes are the ones requested from
+ * the memory resources; on the heap, the overhead of malloc is estimated
+ * from the size of every request. The unused tail of the blocks of an
+ * arena is not counted.
+ *
+ * @return Void.
+ */
+void memory_usage(const Configuration *conf, MemoryUsage &usage) {
+  usage.clear();
+  MemoryWalk walk(usage);
+  walk.configuration(conf);
+}
@@ -0,0 +1,84 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Confslice - A simple configuration file parser.
+ *
+ * Copyright (C) 2014 Giorgos Kappes <geokapp@gmail.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file LICENSE.
+ *
+ */
+
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <stdint.h>
+#include <memory_resource>
+#include <string>
+#include <vector>
+#include "configuration.h"
+
+/**
+ * @name MemoryUsage - The memory held by a configuration tree.
+ *
+ * Breaks the bytes of a tree down by the kind of node that holds them and
+ * by what they are: the node objects, the virtual table pointers of the
+ * keys, the string buffers that do not fit in place, the nodes of the
+ * lists, the element buffers of the vectors, the index tables, the run
+ * digests of frozen levels and the overhead of the allocator. The
+ * overhead is the header that every entity and key carries, plus, on the
+ * heap, the rounding and bookkeeping of malloc. Every top-level entity
+ * and key is a consumer with the bytes of its whole subtree.
+ */
+struct MemoryUsage {
+  enum Kind
+  {
+    configuration_k,
+    entity_k,
+    value_k,
+    array_k,
+    list_k,
+    pairs_k,
+    kinds
+  };
+
+  enum Part
+  {
+    object_p,      // The node objects, less the vtable pointers.
+    vptr_p,        // The vtable pointers of the keys.
+    string_p,      // String buffers outside the objects.
+    list_node_p,   // The nodes of std::list containers.
+    element_p,     // The buffers of std::vector containers.
+    index_p,       // The ID index tables and the run digests.
+    overhead_p,    // Node headers and allocator overhead.
+    parts
+  };
+
+  struct Consumer {
+    std::string id;
+    bool entity;
+    uint64_t nodes;
+    uint64_t bytes;
+  };
+
+  uint64_t nodes[kinds];
+  uint64_t bytes[kinds];
+  uint64_t part_bytes[parts];
+  uint64_t allocations;
+  uint64_t total;
+  std::vector<Consumer> consumers;   // In the order of the tree.
+
+  MemoryUsage();
+  void clear();
+  std::vector<Consumer> top(const size_t count) const;
+
+  static const char *kind_name(const size_t kind);
+  static const char *part_name(const size_t part);
+};
+
+void memory_usage(const Configuration *conf, MemoryUsage &usage);
+
+#endif
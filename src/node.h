@@ -0,0 +1,35 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Confslice - A simple configuration file parser.
+ *
+ * Copyright (C) 2014 Giorgos Kappes <geokapp@gmail.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file LICENSE.
+ *
+ */
+
+#ifndef NODE_H
+#define NODE_H
+
+#include <stddef.h>
+#include <memory_resource>
+
+/*
+ * Entities and keys are preceded by a header that records the memory
+ * resource and the size of their allocation, so that delete can return
+ * them to the resource they came from. The header takes node_header
+ * bytes, which keeps the node aligned as the resource returned it.
+ */
+struct NodeHeader {
+  std::pmr::memory_resource *resource;
+  size_t size;
+};
+
+static const size_t node_header = alignof(std::max_align_t);
+static_assert(sizeof(NodeHeader) <= node_header, "The node header does not fit.");
+
+#endif
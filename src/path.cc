@@ -0,0 +1,161 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Confslice - A simple configuration file parser.
+ *
+ * Copyright (C) 2014 Giorgos Kappes <geokapp@gmail.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file LICENSE.
+ *
+ */
+
+#include "path.h"
+#include "index.h"
+
+using namespace std;
+
+/**
+ * @name Path - Constructor.
+ *
+ * Creates an empty path.
+ */
+Path::Path() {}
+
+/**
+ * @name Path - Constructor.
+ * @param path: The dotted path.
+ *
+ * Parses the path. If it is not valid the path is left empty.
+ */
+Path::Path(const std::string_view path) {
+  set(path);
+}
+
+/**
+ * @name set - Parse a dotted path.
+ * @param path: The dotted path.
+ *
+ * Splits the path into its segments and hashes their IDs. If the path is
+ * not valid it is left empty.
+ *
+ * @return 0 on success, 1 if the path is not valid.
+ */
+int32_t Path::set(const std::string_view path) {
+  string_view segment;
+  size_t pos = 0;
+
+  m_path.assign(path);
+  m_segments.clear();
+  while (pos < m_path.size()) {
+    if (next_segment(m_path, pos, segment)) {
+      m_path.clear();
+      m_segments.clear();
+      return 1;
+    }
+    m_segments.push_back(Segment{(uint32_t)(segment.data() - m_path.data()),
+	  (uint32_t)segment.size(), hash_id(segment)});
+  }
+  return m_segments.empty() ? 1 : 0;
+}
+
+/**
+ * @name str - Get the path.
+ *
+ * @return The text of the path.
+ */
+string_view Path::str() const {
+  return m_path;
+}
+
+/**
+ * @name size - Get the number of segments.
+ *
+ * @return The number of segments.
+ */
+size_t Path::size() const {
+  return m_segments.size();
+}
+
+/**
+ * @name id - Get the ID of a segment.
+ * @param index: The index of the segment.
+ *
+ * @return The ID without its quotes.
+ */
+string_view Path::id(const size_t index) const {
+  return string_view(m_path.data() + m_segments[index].offset, m_segments[index].size);
+}
+
+/**
+ * @name hash - Get the hash of a segment.
+ * @param index: The index of the segment.
+ *
+ * @return The hash_id() of the ID of the segment.
+ */
+uint64_t Path::hash(const size_t index) const {
+  return m_segments[index].hash;
+}
+
+/**
+ * @name next_segment - Parse the next segment of a dotted path.
+ * @param path: The dotted path.
+ * @param pos: The position of the segment. It is moved past the segment
+ *             and its trailing dot.
+ * @param segment: A reference to the ID of the segment.
+ *
+ * This lets a path be walked without building a Path object. A segment
+ * is either a non-empty run of characters up to the next dot or a
+ * non-empty string in double quotes. A trailing dot is not allowed.
+ *
+ * @return 0 on success, 1 if the path is not valid.
+ */
+int32_t Path::next_segment(const std::string_view path, size_t &pos,
+			   std::string_view &segment) {
+  size_t start = pos, end;
+
+  if (start >= path.size())
+    return 1;
+  if (path[start] == '"') {
+    end = path.find('"', ++start);
+    if (end == string_view::npos)
+      return 1;
+    pos = end + 1;
+  } else {
+    for (end = start; end < path.size() && path[end] != '.' && path[end] != '"'; end++)
+      ;
+    pos = end;
+  }
+  if (end == start)
+    return 1;
+  segment = path.substr(start, end - start);
+  if (pos == path.size())
+    return 0;
+  if (path[pos] != '.' || ++pos == path.size())
+    return 1;
+  return 0;
+}
+
+/**
+ * @name append - Append a segment to a dotted path.
+ * @param path: The dotted path. It may be empty.
+ * @param id: The ID of the segment.
+ *
+ * The ID is put in double quotes if it contains dots, so that
+ * next_segment() reads it back as one segment.
+ *
+ * @return Void.
+ */
+void Path::append(string &path, const string_view id) {
+  if (!path.empty())
+    path += '.';
+  if (id.find('.') == string_view::npos) {
+    path += id;
+  } else {
+    path += '"';
+    path += id;
+    path += '"';
+  }
+}
@@ -0,0 +1,157 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Confslice - A simple configuration file parser.
+ *
+ * Copyright (C) 2014 Giorgos Kappes <geokapp@gmail.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file LICENSE.
+ *
+ */
+
+#ifndef PATH_H
+#define PATH_H
+
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @name Path - A precompiled dotted path.
+ *
+ * A path names a key or an entity through the IDs of the entities that
+ * lead to it, separated by dots: "server.port". Since IDs may contain
+ * dots themselves, a segment can be put in double quotes, in which case
+ * it ends at the closing quote: data_server."disk.1".journal_size. IDs
+ * never contain double quotes, so no escapes are needed.
+ *
+ * The path is parsed once and every segment keeps the hash of its ID, so
+ * a lookup through it costs one index probe per segment and does not
+ * allocate. A path that fails to parse has no segments and matches
+ * nothing.
+ */
+class Path {
+ private:
+  struct Segment {
+    uint32_t offset;
+    uint32_t size;
+    uint64_t hash;
+  };
+  std::string m_path;
+  std::vector<Segment> m_segments;
+
+ public:
+  Path();
+  explicit Path(const std::string_view path);
+
+  int32_t set(const std::string_view path);
+  std::string_view str() const;
+
+  size_t size() const;
+  std::string_view id(const size_t index) const;
+  uint64_t hash(const size_t index) const;
+
+  static int32_t next_segment(const std::string_view path, size_t &pos,
+			      std::string_view &segment);
+  static void append(std::string &path, const std::string_view id);
+};
+
+/**
+ * @name path_find_key - Walk a dotted path to a key.
+ * @param root: The configuration or entity where the path starts.
+ * @param path: The dotted path.
+ *
+ * Every segment but the last names an entity, and the last one names the
+ * key. The path is parsed as it is walked, without allocating. R must have
+ * find_key() and find_entity() methods, as do its entities. The result
+ * is const if the root is.
+ *
+ * @return The key or NULL.
+ */
+template <typename R>
+auto path_find_key(R *root, const std::string_view path) -> decltype(root->find_key(path)) {
+  std::string_view id;
+  size_t pos = 0;
+
+  if (Path::next_segment(path, pos, id))
+    return NULL;
+  if (pos == path.size())
+    return root->find_key(id);
+  auto entity = root->find_entity(id);
+  while (entity) {
+    if (Path::next_segment(path, pos, id))
+      return NULL;
+    if (pos == path.size())
+      return entity->find_key(id);
+    entity = entity->find_entity(id);
+  }
+  return NULL;
+}
+
+/**
+ * @name path_find_key - Walk a precompiled path to a key.
+ * @param root: The configuration or entity where the path starts.
+ * @param path: The path.
+ *
+ * Same as above, with the hashes of the segments already computed.
+ *
+ * @return The key or NULL.
+ */
+template <typename R>
+auto path_find_key(R *root, const Path &path) -> decltype(root->find_key(path.id(0))) {
+  if (!path.size())
+    return NULL;
+  size_t last = path.size() - 1;
+  if (!last)
+    return root->find_key(path.id(0), path.hash(0));
+  auto entity = root->find_entity(path.id(0), path.hash(0));
+  for (size_t i = 1; entity && i < last; i++)
+    entity = entity->find_entity(path.id(i), path.hash(i));
+  return entity ? entity->find_key(path.id(last), path.hash(last)) : NULL;
+}
+
+/**
+ * @name path_find_entity - Walk a dotted path to an entity.
+ * @param root: The configuration or entity where the path starts.
+ * @param path: The dotted path.
+ *
+ * @return The entity or NULL.
+ */
+template <typename R>
+auto path_find_entity(R *root, const std::string_view path) -> decltype(root->find_entity(path)) {
+  std::string_view id;
+  size_t pos = 0;
+
+  if (Path::next_segment(path, pos, id))
+    return NULL;
+  auto entity = root->find_entity(id);
+  while (entity && pos < path.size()) {
+    if (Path::next_segment(path, pos, id))
+      return NULL;
+    entity = entity->find_entity(id);
+  }
+  return entity;
+}
+
+/**
+ * @name path_find_entity - Walk a precompiled path to an entity.
+ * @param root: The configuration or entity where the path starts.
+ * @param path: The path.
+ *
+ * @return The entity or NULL.
+ */
+template <typename R>
+auto path_find_entity(R *root, const Path &path) -> decltype(root->find_entity(path.id(0))) {
+  if (!path.size())
+    return NULL;
+  auto entity = root->find_entity(path.id(0), path.hash(0));
+  for (size_t i = 1; entity && i < path.size(); i++)
+    entity = entity->find_entity(path.id(i), path.hash(i));
+  return entity;
+}
+
+#endif
@@ -0,0 +1,269 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Confslice - A simple configuration file parser.
+ *
+ * Copyright (C) 2014 Giorgos Kappes <geokapp@gmail.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file LICENSE.
+ *
+ */
+#include <errno.h>
+#include <limits>
+#include "reload.h"
+
+using namespace std;
+
+/**
+ * @name Reader - Constructor.
+ * @param reloader: The reloader to read from.
+ *
+ * Registers the reader with a slot of its own, reusing one that was
+ * released by a destroyed reader.
+ */
+Reloader::Reader::Reader(Reloader &reloader) {
+  std::lock_guard<std::mutex> locked(reloader.m_lock);
+
+  m_reloader = &reloader;
+  m_slot = NULL;
+  m_depth = 0;
+  for (Slot *slot : reloader.m_slots)
+    if (!slot->used) {
+      m_slot = slot;
+      break;
+    }
+  if (!m_slot) {
+    m_slot = new Slot;
+    m_slot->epoch.store(0);
+    reloader.m_slots.push_back(m_slot);
+  }
+  m_slot->used = true;
+}
+
+/**
+ * @name Reader - Destructor.
+ *
+ * Releases the slot of the reader.
+ */
+Reloader::Reader::~Reader() {
+  std::lock_guard<std::mutex> locked(m_reloader->m_lock);
+
+  m_slot->epoch.store(0);
+  m_slot->used = false;
+}
+
+/**
+ * @name Reloader - Constructor.
+ * @param filename: The configuration file.
+ *
+ * Nothing is published until the first reload().
+ */
+Reloader::Reloader(const std::string filename) : m_filename(filename) {
+  m_current.store(NULL);
+  m_epoch.store(1);
+  m_versions.store(0);
+  m_stop.store(false);
+  sem_init(&m_requests, 0, 0);
+}
+
+/**
+ * @name Reloader - Destructor.
+ *
+ * Stops the reload thread and frees every version. No reader may be left.
+ */
+Reloader::~Reloader() {
+  stop();
+  Version *current = (Version *)m_current.load();
+  if (current)
+    m_retired.push_back(current);
+  for (Version *version : m_retired) {
+    delete version->slice;
+    delete version;
+  }
+  for (Slot *slot : m_slots)
+    delete slot;
+  sem_destroy(&m_requests);
+}
+
+/**
+ * @name reload - Parse the configuration file and publish it.
+ *
+ * The file is parsed into a new version, which is frozen and replaces
+ * the current one for the readers that enter from then on. The replaced
+ * version is retired, and the retired versions that no reader uses any
+ * more are freed. If the file does not parse, its errors are printed to stderr and
+ * the current version stays.
+ *
+ * @return 0 if the file was published, otherwise 1.
+ */
+int32_t Reloader::reload() {
+  return reload(std::function<void(const Change &)>());
+}
+
+/**
+ * @name reload - Parse the configuration file, publish it and report the
+ *                changes.
+ * @param event: Called for every difference between the replaced version
+ *               and the new one, after the new one is published and
+ *               before the replaced one is retired. It can be empty.
+ *
+ * Nothing is reported for the first version.
+ *
+ * @return 0 if the file was published, otherwise 1.
+ */
+int32_t Reloader::reload(const std::function<void(const Change &)> &event) {
+  std::lock_guard<std::mutex> reloading(m_reload);
+  ConfSlice *slice = new ConfSlice(ConfSlice::arena_mem);
+
+  if (slice->analyze(m_filename)) {
+    delete slice;
+    return 1;
+  }
+  Version *version = new Version;
+  version->conf = slice->configuration()->freeze();
+  version->number = m_versions.load() + 1;
+  version->slice = slice;
+  version->retired = 0;
+  Version *old = (Version *)m_current.exchange(version);
+  m_versions.store(version->number);
+  if (old && event)
+    diff(old->conf, version->conf, event);
+  if (old) {
+    // Readers that see this epoch or a later one see the new version.
+    old->retired = m_epoch.fetch_add(1) + 1;
+    std::lock_guard<std::mutex> locked(m_lock);
+    m_retired.push_back(old);
+    reclaim_locked();
+  }
+  return 0;
+}
+
+/**
+ * @name start - Start the reload thread.
+ *
+ * The thread waits for request() and reloads the file once per wakeup,
+ * however many requests arrived meanwhile.
+ *
+ * @return 0 on success, 1 if the thread is already running.
+ */
+int32_t Reloader::start() {
+  if (m_thread.joinable())
+    return 1;
+  m_stop.store(false);
+  m_thread = std::thread([this]() {
+      for (;;) {
+	while (sem_wait(&m_requests) && errno == EINTR)
+	  ;
+	while (!sem_trywait(&m_requests))
+	  ;
+	if (m_stop.load())
+	  break;
+	reload();
+      }
+    });
+  return 0;
+}
+
+/**
+ * @name request - Ask the reload thread to reload the file.
+ *
+ * This method is async-signal-safe.
+ *
+ * @return Void.
+ */
+void Reloader::request() {
+  sem_post(&m_requests);
+}
+
+/**
+ * @name stop - Stop the reload thread.
+ *
+ * A reload that is running is completed first.
+ *
+ * @return Void.
+ */
+void Reloader::stop() {
+  if (!m_thread.joinable())
+    return;
+  m_stop.store(true);
+  sem_post(&m_requests);
+  m_thread.join();
+}
+
+/**
+ * @name reclaim - Free the retired versions that no reader uses.
+ *
+ * reload() reclaims as well; this is for freeing the last retired versions
+ * once the readers have left them.
+ *
+ * @return Void.
+ */
+void Reloader::reclaim() {
+  std::lock_guard<std::mutex> locked(m_lock);
+  reclaim_locked();
+}
+
+/**
+ * @name reclaim_locked - Free the retired versions that no reader uses.
+ *
+ * A reader that entered at an epoch before the one a version was retired
+ * with may hold it. The caller holds m_lock.
+ *
+ * @return Void.
+ */
+void Reloader::reclaim_locked() {
+  uint64_t oldest = std::numeric_limits<uint64_t>::max();
+  size_t kept = 0;
+
+  for (Slot *slot : m_slots) {
+    uint64_t epoch = slot->epoch.load();
+    if (epoch && epoch < oldest)
+      oldest = epoch;
+  }
+  for (Version *version : m_retired) {
+    if (version->retired <= oldest) {
+      delete version->slice;
+      delete version;
+    } else {
+      m_retired[kept++] = version;
+    }
+  }
+  m_retired.resize(kept);
+}
+
+/**
+ * @name version - Return the number of the current version.
+ *
+ * Versions are numbered from 1 in the order they were published.
+ *
+ * @return The number, or 0 if nothing was published.
+ */
+uint64_t Reloader::version() const {
+  return m_versions.load();
+}
+
+/**
+ * @name retired - Return the number of retired versions not yet freed.
+ *
+ * @return The number of versions.
+ */
+size_t Reloader::retired() {
+  std::lock_guard<std::mutex> locked(m_lock);
+  return m_retired.size();
+}
+
+/**
+ * @name handle - Create a handle to a key of the current version.
+ * @param path: The dotted path of the key.
+ *
+ * The handle is resolved again on its first read after a reload. It must
+ * be read under a Guard and must not outlive the reloader.
+ *
+ * @return A handle that resolves the path on its first use.
+ */
+Handle Reloader::handle(const std::string_view path) const {
+  return Handle(&m_current, path);
+}
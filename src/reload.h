@@ -0,0 +1,154 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Confslice - A simple configuration file parser.
+ *
+ * Copyright (C) 2014 Giorgos Kappes <geokapp@gmail.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file LICENSE.
+ *
+ */
+
+#ifndef RELOAD_H
+#define RELOAD_H
+
+#include <semaphore.h>
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "confslice.h"
+#include "diff.h"
+
+/**
+ * @name Reloader - Publish reloaded configurations to concurrent readers.
+ *
+ * A reloader parses a configuration file into a frozen version and
+ * publishes it through an atomic pointer. reload() parses the file again
+ * and swaps the new version in. A published version is never changed, and
+ * readers that still use a replaced version keep it until they leave it.
+ *
+ * Every reader thread registers once with a Reader and pins the current
+ * version with a Guard. A Reader owns a cache line that holds the epoch it
+ * entered at, so entering and leaving take a store and a load, with no
+ * lock and no shared counter. A replaced version is retired with the epoch
+ * of its replacement, and it is freed once every reader has either left or
+ * entered at a later epoch.
+ *
+ * Handles of a reloader, from handle(), are resolved again after every
+ * reload. reload() can also report what changed, by diffing the replaced
+ * version against the new one; both are frozen, so only the changed runs
+ * and subtrees are walked.
+ *
+ * request() is async-signal-safe. It wakes the thread started by start(),
+ * which reloads the file, so it can be called from a SIGHUP handler.
+ */
+class Reloader {
+ private:
+  struct Version : Published {
+    ConfSlice *slice;
+    uint64_t retired;
+  };
+
+  struct alignas(64) Slot {
+    std::atomic<uint64_t> epoch;   // 0 while the reader is outside.
+    bool used;
+  };
+
+  std::string m_filename;
+  std::atomic<Published *> m_current;
+  std::atomic<uint64_t> m_epoch;
+  std::atomic<uint64_t> m_versions;
+  std::mutex m_reload;   // Serializes the reloads.
+  std::mutex m_lock;     // Protects the slots and the retired versions.
+  std::vector<Slot *> m_slots;
+  std::vector<Version *> m_retired;
+  std::thread m_thread;
+  sem_t m_requests;
+  std::atomic<bool> m_stop;
+
+  void reclaim_locked();
+
+ public:
+  class Guard;
+
+  /**
+   * @name Reader - The registration of a reader thread.
+   *
+   * A Reader is used by one thread at a time and must not outlive its
+   * reloader.
+   */
+  class Reader {
+    friend class Guard;
+
+   private:
+    Reloader *m_reloader;
+    Slot *m_slot;
+    uint32_t m_depth;
+
+    const Published *enter() {
+      if (!m_depth++)
+	m_slot->epoch.store(m_reloader->m_epoch.load());
+      return m_reloader->m_current.load();
+    }
+
+    void leave() {
+      if (!--m_depth)
+	m_slot->epoch.store(0, std::memory_order_release);
+    }
+
+   public:
+    explicit Reader(Reloader &reloader);
+    ~Reader();
+    Reader(const Reader &) = delete;
+    Reader &operator=(const Reader &) = delete;
+  };
+
+  /**
+   * @name Guard - Pin the current version while it is read.
+   *
+   * The configuration of a guard stays valid until the guard is destroyed.
+   * Guards of the same reader can be nested.
+   */
+  class Guard {
+   private:
+    Reader &m_reader;
+    const Published *m_version;
+
+   public:
+    explicit Guard(Reader &reader) : m_reader(reader), m_version(reader.enter()) {}
+    ~Guard() { m_reader.leave(); }
+    Guard(const Guard &) = delete;
+    Guard &operator=(const Guard &) = delete;
+
+    const Configuration *configuration() const {
+      return m_version ? m_version->conf : NULL;
+    }
+    const Configuration *operator->() const { return configuration(); }
+    uint64_t version() const { return m_version ? m_version->number : 0; }
+  };
+
+  explicit Reloader(const std::string filename);
+  ~Reloader();
+  Reloader(const Reloader &) = delete;
+  Reloader &operator=(const Reloader &) = delete;
+
+  int32_t reload();
+  int32_t reload(const std::function<void(const Change &)> &event);
+  int32_t start();
+  void request();
+  void stop();
+  void reclaim();
+
+  uint64_t version() const;
+  size_t retired();
+  Handle handle(const std::string_view path) const;
+};
+
+#endif
@@ -0,0 +1,329 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Confslice - A simple configuration file parser.
+ *
+ * Copyright (C) 2014 Giorgos Kappes <geokapp@gmail.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file LICENSE.
+ *
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "scan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+inline bool is_space(unsigned char c) {
+  return c == ' ' || (unsigned char)(c - '\t') <= '\r' - '\t';
+}
+
+inline bool is_eol(unsigned char c) {
+  return c == '\n' || c == 0xff;
+}
+
+inline bool is_string_end(unsigned char c) {
+  return c == '"' || c == '\\' || is_eol(c);
+}
+
+const char *space_scalar(const char *p, const char *end, uint32_t *lines) {
+  for (; p < end && is_space(*p); p++)
+    if (*p == '\n')
+      (*lines)++;
+  return p;
+}
+
+const char *eol_scalar(const char *p, const char *end) {
+  while (p < end && !is_eol(*p))
+    p++;
+  return p;
+}
+
+const char *string_scalar(const char *p, const char *end) {
+  while (p < end && !is_string_end(*p))
+    p++;
+  return p;
+}
+
+uint32_t lines_scalar(const char *p, const char *end) {
+  uint32_t lines = 0;
+  for (; p < end; p++)
+    lines += (*p == '\n');
+  return lines;
+}
+
+#ifdef SCAN_X86
+
+/*
+ * The byte masks below have one bit per byte of the block. A byte is white
+ * space if it is ' ' or in ['\t', '\r']; the range test is done with an
+ * unsigned minimum.
+ */
+
+__attribute__((target("sse2")))
+const char *space_sse2(const char *p, const char *end, uint32_t *lines) {
+  const __m128i sp = _mm_set1_epi8(' ');
+  const __m128i nl = _mm_set1_epi8('\n');
+  const __m128i tab = _mm_set1_epi8('\t');
+  const __m128i range = _mm_set1_epi8('\r' - '\t');
+
+  while (end - p >= 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    __m128i x = _mm_sub_epi8(v, tab);
+    __m128i ws = _mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(x, range), x),
+			      _mm_cmpeq_epi8(v, sp));
+    uint32_t other = ~(uint32_t)_mm_movemask_epi8(ws) & 0xffff;
+    uint32_t eols = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl));
+    if (other) {
+      uint32_t n = __builtin_ctz(other);
+      *lines += __builtin_popcount(eols & ((1u << n) - 1));
+      return p + n;
+    }
+    *lines += __builtin_popcount(eols);
+    p += 16;
+  }
+  return space_scalar(p, end, lines);
+}
+
+__attribute__((target("sse2")))
+const char *eol_sse2(const char *p, const char *end) {
+  const __m128i nl = _mm_set1_epi8('\n');
+  const __m128i ff = _mm_set1_epi8((char)0xff);
+
+  while (end - p >= 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    uint32_t hits = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, nl),
+						   _mm_cmpeq_epi8(v, ff)));
+    if (hits)
+      return p + __builtin_ctz(hits);
+    p += 16;
+  }
+  return eol_scalar(p, end);
+}
+
+__attribute__((target("sse2")))
+const char *string_sse2(const char *p, const char *end) {
+  const __m128i nl = _mm_set1_epi8('\n');
+  const __m128i ff = _mm_set1_epi8((char)0xff);
+  const __m128i dq = _mm_set1_epi8('"');
+  const __m128i bs = _mm_set1_epi8('\\');
+
+  while (end - p >= 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, nl), _mm_cmpeq_epi8(v, ff)),
+			     _mm_or_si128(_mm_cmpeq_epi8(v, dq), _mm_cmpeq_epi8(v, bs)));
+    uint32_t hits = _mm_movemask_epi8(m);
+    if (hits)
+      return p + __builtin_ctz(hits);
+    p += 16;
+  }
+  return string_scalar(p, end);
+}
+
+__attribute__((target("sse2")))
+uint32_t lines_sse2(const char *p, const char *end) {
+  const __m128i nl = _mm_set1_epi8('\n');
+  uint32_t lines = 0;
+
+  while (end - p >= 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    lines += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl)));
+    p += 16;
+  }
+  return lines + lines_scalar(p, end);
+}
+
+__attribute__((target("avx2,popcnt,bmi")))
+const char *space_avx2(const char *p, const char *end, uint32_t *lines) {
+  const __m256i sp = _mm256_set1_epi8(' ');
+  const __m256i nl = _mm256_set1_epi8('\n');
+  const __m256i tab = _mm256_set1_epi8('\t');
+  const __m256i range = _mm256_set1_epi8('\r' - '\t');
+
+  while (end - p >= 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)p);
+    __m256i x = _mm256_sub_epi8(v, tab);
+    __m256i ws = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(x, range), x),
+				 _mm256_cmpeq_epi8(v, sp));
+    uint32_t other = ~(uint32_t)_mm256_movemask_epi8(ws);
+    uint32_t eols = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl));
+    if (other) {
+      uint32_t n = __builtin_ctz(other);
+      *lines += __builtin_popcount(eols & ((1u << n) - 1));
+      return p + n;
+    }
+    *lines += __builtin_popcount(eols);
+    p += 32;
+  }
+  return space_sse2(p, end, lines);
+}
+
+__attribute__((target("avx2,bmi")))
+const char *eol_avx2(const char *p, const char *end) {
+  const __m256i nl = _mm256_set1_epi8('\n');
+  const __m256i ff = _mm256_set1_epi8((char)0xff);
+
+  while (end - p >= 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)p);
+    uint32_t hits = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, nl),
+							 _mm256_cmpeq_epi8(v, ff)));
+    if (hits)
+      return p + __builtin_ctz(hits);
+    p += 32;
+  }
+  return eol_sse2(p, end);
+}
+
+__attribute__((target("avx2,bmi")))
+const char *string_avx2(const char *p, const char *end) {
+  const __m256i nl = _mm256_set1_epi8('\n');
+  const __m256i ff = _mm256_set1_epi8((char)0xff);
+  const __m256i dq = _mm256_set1_epi8('"');
+  const __m256i bs = _mm256_set1_epi8('\\');
+
+  while (end - p >= 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)p);
+    __m256i m = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, nl),
+						 _mm256_cmpeq_epi8(v, ff)),
+				_mm256_or_si256(_mm256_cmpeq_epi8(v, dq),
+						_mm256_cmpeq_epi8(v, bs)));
+    uint32_t hits = _mm256_movemask_epi8(m);
+    if (hits)
+      return p + __builtin_ctz(hits);
+    p += 32;
+  }
+  return string_sse2(p, end);
+}
+
+__attribute__((target("avx2,popcnt")))
+uint32_t lines_avx2(const char *p, const char *end) {
+  const __m256i nl = _mm256_set1_epi8('\n');
+  uint32_t lines = 0;
+
+  while (end - p >= 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)p);
+    lines += __builtin_popcount(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl)));
+    p += 32;
+  }
+  return lines + lines_sse2(p, end);
+}
+
+#endif
+
+/**
+ * ScanOps - The scanning functions of a SIMD level.
+ */
+struct ScanOps {
+  const char *(*space)(const char *p, const char *end, uint32_t *lines);
+  const char *(*eol)(const char *p, const char *end);
+  const char *(*string)(const char *p, const char *end);
+  uint32_t (*lines)(const char *p, const char *end);
+};
+
+const ScanOps OPS[] = {
+  {space_scalar, eol_scalar, string_scalar, lines_scalar},
+#ifdef SCAN_X86
+  {space_sse2, eol_sse2, string_sse2, lines_sse2},
+  {space_avx2, eol_avx2, string_avx2, lines_avx2},
+#endif
+};
+
+/**
+ * @name max_level - The best SIMD level of the CPU.
+ */
+int32_t max_level() {
+#ifdef SCAN_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt") &&
+      __builtin_cpu_supports("bmi"))
+    return SCAN_AVX2;
+  if (__builtin_cpu_supports("sse2"))
+    return SCAN_SSE2;
+#endif
+  return SCAN_SCALAR;
+}
+
+int32_t g_level = max_level();
+const ScanOps *g_ops = &OPS[g_level];
+
+}
+
+/**
+ * @name scan_level - The SIMD level in use.
+ *
+ * @return SCAN_SCALAR, SCAN_SSE2 or SCAN_AVX2.
+ */
+int32_t scan_level() {
+  return g_level;
+}
+
+/**
+ * @name scan_set_level - Select a SIMD level.
+ * @param level: The requested level.
+ *
+ * Selects a lower SIMD level than the one detected. It is meant for tests
+ * and benchmarks and it should be called before any analysis starts.
+ *
+ * @return 0 on success, -1 if the CPU does not support the level.
+ */
+int32_t scan_set_level(const int32_t level) {
+  if (level < SCAN_SCALAR || level > max_level())
+    return -1;
+  g_level = level;
+  g_ops = &OPS[level];
+  return 0;
+}
+
+/**
+ * @name scan_space - Skip white space.
+ * @param p: The first byte.
+ * @param end: The end of the input.
+ * @param lines: The new line counter.
+ *
+ * @return A pointer to the first byte that is not white space, or end.
+ */
+const char *scan_space(const char *p, const char *end, uint32_t *lines) {
+  return g_ops->space(p, end, lines);
+}
+
+/**
+ * @name scan_eol - Find the end of a line.
+ * @param p: The first byte.
+ * @param end: The end of the input.
+ *
+ * @return A pointer to the first new line or 0xff byte, or end.
+ */
+const char *scan_eol(const char *p, const char *end) {
+  return g_ops->eol(p, end);
+}
+
+/**
+ * @name scan_string - Find the end of a string body.
+ * @param p: The first byte after the opening ".
+ * @param end: The end of the input.
+ *
+ * @return A pointer to the first ", \, new line or 0xff byte, or end.
+ */
+const char *scan_string(const char *p, const char *end) {
+  return g_ops->string(p, end);
+}
+
+/**
+ * @name scan_lines - Count new lines.
+ * @param p: The first byte.
+ * @param end: The end of the input.
+ *
+ * @return The number of new lines in [p, end).
+ */
+uint32_t scan_lines(const char *p, const char *end) {
+  return g_ops->lines(p, end);
+}
@@ -0,0 +1,48 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Confslice - A simple configuration file parser.
+ *
+ * Copyright (C) 2014 Giorgos Kappes <geokapp@gmail.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file LICENSE.
+ *
+ */
+
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Scanning primitives for in-memory input.
+ *
+ * These functions skip the runs of bytes that the lexical analyzer would
+ * otherwise process one at a time: white space, comment bodies and string
+ * bodies. They work on 16 or 32 byte blocks with SSE2 or AVX2, chosen at
+ * run time from the CPUID flags, and fall back to scalar code. The byte
+ * 0xff stops every scan since the analyzer treats it as EOF.
+ */
+
+// SIMD levels
+#define SCAN_SCALAR 0
+#define SCAN_SSE2   1
+#define SCAN_AVX2   2
+
+int32_t scan_level();
+int32_t scan_set_level(const int32_t level);
+
+// Skip white space and new lines. The new lines are added to *lines.
+const char *scan_space(const char *p, const char *end, uint32_t *lines);
+// Find the end of a comment: the first new line or 0xff.
+const char *scan_eol(const char *p, const char *end);
+// Find the end of a string body: the first ", \, new line or 0xff.
+const char *scan_string(const char *p, const char *end);
+// Count the new lines.
+uint32_t scan_lines(const char *p, const char *end);
+
+#endif
@@ -0,0 +1,1025 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Confslice - A simple configuration file parser.
+ *
+ * Copyright (C) 2014 Giorgos Kappes <geokapp@gmail.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file LICENSE.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <map>
+#include <vector>
+#include "snapshot.h"
+#include "index.h"
+
+using namespace std;
+
+#define SNAPSHOT_MAGIC "CSLSNAP"
+#define SNAPSHOT_BYTE_ORDER 0x01020304
+
+/**
+ * SnapHeader - The header of a snapshot.
+ *
+ * The checksum is the hash_id() of everything after the header. The root
+ * is the offset of the SnapEntity of the configuration from the start of
+ * the snapshot.
+ */
+struct SnapHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint64_t size;
+  uint64_t checksum;
+  uint64_t root;
+};
+
+/**
+ * @name rel - Follow a relative offset.
+ * @param record: The record that holds the offset.
+ * @param offset: The offset.
+ *
+ * @return The target of the offset.
+ */
+template <typename T>
+static inline const T *rel(const void *record, const int32_t offset) {
+  return (const T *)((const char *)record + offset);
+}
+
+/**
+ * @name SnapWriter - The snapshot writer.
+ *
+ * This class lays out the records of a configuration in one buffer. The
+ * records of an entity are reserved before its contents are written, so
+ * the keys and the sub-entities of every entity end up in arrays. The
+ * strings are collected in a separate table that is appended at the end,
+ * when the offsets that point into it are known.
+ */
+class SnapWriter {
+ private:
+  struct Fixup {
+    size_t field;
+    size_t record;
+    uint32_t str;
+  };
+  std::string m_out;
+  std::string m_strings;
+  std::map<std::string, uint32_t, std::less<>> m_string_ids;
+  std::vector<Fixup> m_fixups;
+
+ public:
+  int32_t write(const Configuration *conf, std::string &out);
+
+ private:
+  size_t reserve(const size_t size);
+  void link(const size_t record, int32_t &field, const size_t target);
+  void string_ref(const size_t record, int32_t &field, const std::string_view str);
+
+  template <typename T>
+  T *record(const size_t pos) {
+    return (T *)&m_out[pos];
+  }
+
+  template <typename V>
+  size_t table(const V &items, uint32_t &slots);
+
+  template <typename E>
+  void write_entity(const size_t pos, const E *entity, const std::string_view id);
+  void write_key(const size_t pos, const Key *key);
+  template <typename L>
+  void write_list(const size_t pos, const L &klist);
+  void write_data(const size_t pos, const Data &data);
+};
+
+/**
+ * @name reserve - Reserve a record.
+ * @param size: The size of the record.
+ *
+ * Records are aligned to eight bytes and zeroed.
+ *
+ * @return The position of the record.
+ */
+size_t SnapWriter::reserve(const size_t size) {
+  size_t pos = (m_out.size() + 7) & ~(size_t)7;
+  m_out.resize(pos + size, '\0');
+  return pos;
+}
+
+/**
+ * @name link - Point a field of a record to another record.
+ * @param record: The position of the record that holds the field.
+ * @param field: The field.
+ * @param target: The position of the target.
+ *
+ * @return Void.
+ */
+void SnapWriter::link(const size_t record, int32_t &field, const size_t target) {
+  field = (int32_t)(target - record);
+}
+
+/**
+ * @name string_ref - Point a field of a record to a string.
+ * @param record: The position of the record that holds the field.
+ * @param field: The field.
+ * @param str: The string.
+ *
+ * The string is added to the string table once. The field is set when
+ * the position of the table is known.
+ *
+ * @return Void.
+ */
+void SnapWriter::string_ref(const size_t record, int32_t &field, const std::string_view str) {
+  auto it = m_string_ids.find(str);
+  if (it == m_string_ids.end()) {
+    it = m_string_ids.emplace(string(str), (uint32_t)m_strings.size()).first;
+    m_strings.append(str);
+    m_strings.push_back('\0');
+  }
+  m_fixups.push_back(Fixup{(size_t)((char *)&field - m_out.data()), record, it->second});
+}
+
+/**
+ * @name table - Write the hash table of an array of records.
+ * @param items: The objects of the records, in order.
+ * @param slots: A reference to the number of slots.
+ *
+ * Small arrays are searched linearly and get no table. Each slot holds
+ * the index of a record plus one, or 0 if it is empty.
+ *
+ * @return The position of the table or 0.
+ */
+template <typename V>
+size_t SnapWriter::table(const V &items, uint32_t &slots) {
+  slots = 0;
+  if (items.size() <= INDEX_SMALL)
+    return 0;
+  slots = 4 * INDEX_SMALL;
+  while (slots < 2 * items.size())
+    slots *= 2;
+  size_t pos = reserve(slots * sizeof(uint32_t));
+  uint32_t mask = slots - 1, index = 0;
+  for (const auto *item : items) {
+    uint32_t *slot = record<uint32_t>(pos);
+    uint32_t i = hash_id(item->id()) & mask;
+    while (slot[i])
+      i = (i + 1) & mask;
+    slot[i] = ++index;
+  }
+  return pos;
+}
+
+/**
+ * @name write_entity - Write an entity.
+ * @param pos: The position of its record.
+ * @param entity: The entity or the configuration.
+ * @param id: Its ID.
+ *
+ * @return Void.
+ */
+template <typename E>
+void SnapWriter::write_entity(const size_t pos, const E *entity, const std::string_view id) {
+  auto keys = entity->keys();
+  auto entities = entity->entities();
+  size_t keys_pos = reserve(keys.size() * sizeof(SnapKey));
+  size_t entities_pos = reserve(entities.size() * sizeof(SnapEntity));
+  uint32_t key_slots, entity_slots;
+  size_t key_table = table(keys, key_slots);
+  size_t entity_table = table(entities, entity_slots);
+
+  SnapEntity *e = record<SnapEntity>(pos);
+  e->m_hash = hash_id(id);
+  e->m_id_size = id.size();
+  string_ref(pos, e->m_id, id);
+  e->m_size_of_keys = keys.size();
+  link(pos, e->m_keys, keys_pos);
+  e->m_size_of_entities = entities.size();
+  link(pos, e->m_entities, entities_pos);
+  e->m_key_slots = key_slots;
+  link(pos, e->m_key_table, key_table ? key_table : pos);
+  e->m_entity_slots = entity_slots;
+  link(pos, e->m_entity_table, entity_table ? entity_table : pos);
+
+  size_t i = 0;
+  for (const Key *key : keys)
+    write_key(keys_pos + i++ * sizeof(SnapKey), key);
+  i = 0;
+  for (const Entity *sub : entities)
+    write_entity(entities_pos + i++ * sizeof(SnapEntity), sub, sub->id());
+}
+
+/**
+ * @name write_key - Write a key and its payload.
+ * @param pos: The position of its record.
+ * @param key: The key.
+ *
+ * Arrays of integers or of doubles are written unboxed; other arrays are
+ * written as SnapData records.
+ *
+ * @return Void.
+ */
+void SnapWriter::write_key(const size_t pos, const Key *key) {
+  size_t payload = pos;
+  uint32_t size = 0;
+  Data::Type data_type = Data::none_t;
+
+  SnapKey *k = record<SnapKey>(pos);
+  k->m_hash = hash_id(key->id());
+  k->m_id_size = key->id().size();
+  string_ref(pos, k->m_id, key->id());
+  k->m_type = key->type();
+
+  if (key->type() == Key::value_t) {
+    payload = reserve(sizeof(SnapData));
+    write_data(payload, ((const KValue *)key)->value());
+    size = 1;
+  } else if (key->type() == Key::array_t) {
+    const KArray *ka = (const KArray *)key;
+    size = ka->size();
+    data_type = ka->data_type();
+    if (data_type == Data::int_t) {
+      payload = reserve(size * sizeof(int64_t));
+      for (uint32_t i = 0; i < size; i++)
+	ka->at(i, *record<int64_t>(payload + i * sizeof(int64_t)));
+    } else if (data_type == Data::double_t) {
+      payload = reserve(size * sizeof(double));
+      for (uint32_t i = 0; i < size; i++)
+	ka->at(i, *record<double>(payload + i * sizeof(double)));
+    } else {
+      Span<Data> values;
+      ka->as_data_span(values);
+      payload = reserve(size * sizeof(SnapData));
+      for (uint32_t i = 0; i < size; i++)
+	write_data(payload + i * sizeof(SnapData), values[i]);
+    }
+  } else if (key->type() == Key::list_t) {
+    payload = reserve(sizeof(SnapList));
+    write_list(payload, *(const KList *)key);
+  } else if (key->type() == Key::pairs_t) {
+    KPairs::PairView pairs = ((const KPairs *)key)->pairs();
+    size = pairs.size();
+    payload = reserve(size * sizeof(SnapPair));
+    size_t p = payload;
+    for (const KPairs::Pair &pair : pairs) {
+      SnapPair *sp = record<SnapPair>(p);
+      sp->m_name_size = pair.first.size();
+      string_ref(p, sp->m_name, pair.first);
+      write_data(p + ((char *)&sp->m_value - (char *)sp), pair.second);
+      p += sizeof(SnapPair);
+    }
+  }
+
+  k = record<SnapKey>(pos);
+  k->m_data_type = data_type;
+  k->m_size = size;
+  link(pos, k->m_payload, payload);
+}
+
+/**
+ * @name write_list - Write a list and its sub-lists.
+ * @param pos: The position of its record.
+ * @param klist: The KList or a KListNode.
+ *
+ * @return Void.
+ */
+template <typename L>
+void SnapWriter::write_list(const size_t pos, const L &klist) {
+  Span<Data> data = klist.data();
+  size_t data_pos = reserve(data.size() * sizeof(SnapData));
+  for (size_t i = 0; i < data.size(); i++)
+    write_data(data_pos + i * sizeof(SnapData), data[i]);
+  auto klists = klist.klists();
+  size_t klists_pos = reserve(klists.size() * sizeof(SnapList));
+
+  SnapList *l = record<SnapList>(pos);
+  link(pos, l->m_data, data_pos);
+  l->m_size_of_data = data.size();
+  link(pos, l->m_klists, klists_pos);
+  l->m_size_of_klist = klists.size();
+
+  size_t i = 0;
+  for (const KListNode &sub : klists)
+    write_list(klists_pos + i++ * sizeof(SnapList), sub);
+}
+
+/**
+ * @name write_data - Write a value.
+ * @param pos: The position of its record.
+ * @param data: The value.
+ *
+ * @return Void.
+ */
+void SnapWriter::write_data(const size_t pos, const Data &data) {
+  SnapData *d = record<SnapData>(pos);
+  string_view str;
+
+  d->m_type = data.type();
+  if (data.type() == Data::int_t) {
+    data.as_int64(d->m_int);
+  } else if (data.type() == Data::double_t) {
+    data.as_double(d->m_double);
+  } else if (!data.as_string_view(str)) {
+    d->m_size = str.size();
+    string_ref(pos, d->m_str, str);
+  }
+}
+
+/**
+ * @name write - Write a configuration.
+ * @param conf: The configuration.
+ * @param out: A reference to the snapshot.
+ *
+ * @return 0 on success, 1 if the snapshot would be larger than 2GB.
+ */
+int32_t SnapWriter::write(const Configuration *conf, std::string &out) {
+  m_out.assign(sizeof(SnapHeader), '\0');
+  size_t root = reserve(sizeof(SnapEntity));
+  write_entity(root, conf, string_view());
+
+  size_t strings = m_out.size();
+  if (strings + m_strings.size() > INT32_MAX)
+    return 1;
+  for (const Fixup &fixup : m_fixups) {
+    int32_t offset = (int32_t)(strings + fixup.str - fixup.record);
+    memcpy(&m_out[fixup.field], &offset, sizeof(offset));
+  }
+  m_out += m_strings;
+
+  SnapHeader *header = record<SnapHeader>(0);
+  memcpy(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic));
+  header->version = SNAPSHOT_VERSION;
+  header->byte_order = SNAPSHOT_BYTE_ORDER;
+  header->size = m_out.size();
+  header->root = root;
+  header->checksum = hash_id(string_view(m_out).substr(sizeof(SnapHeader)));
+  out.swap(m_out);
+  return 0;
+}
+
+/**
+ * @name type - Get the type of the value.
+ *
+ * @return The data type.
+ */
+Data::Type SnapData::type() const {
+  return (Data::Type)m_type;
+}
+
+/**
+ * @name as_int64 - Get an integer value.
+ * @param value: A reference to the value.
+ *
+ * @return 0 on success, 1 if the value is not an integer.
+ */
+int32_t SnapData::as_int64(int64_t &value) const {
+  if (m_type != Data::int_t)
+    return 1;
+  value = m_int;
+  return 0;
+}
+
+/**
+ * @name as_double - Get a numeric value as a double.
+ * @param value: A reference to the value.
+ *
+ * @return 0 on success, 1 if the value is not a number.
+ */
+int32_t SnapData::as_double(double &value) const {
+  if (m_type == Data::double_t)
+    value = m_double;
+  else if (m_type == Data::int_t)
+    value = (double)m_int;
+  else
+    return 1;
+  return 0;
+}
+
+/**
+ * @name as_string_view - Get a string value.
+ * @param value: A reference to the value. It points into the snapshot.
+ *
+ * @return 0 on success, 1 if the value is not a string.
+ */
+int32_t SnapData::as_string_view(std::string_view &value) const {
+  if (m_type != Data::string_t)
+    return 1;
+  value = string_view(rel<char>(this, m_str), m_size);
+  return 0;
+}
+
+/**
+ * @name data_str - Get the value as a string.
+ *
+ * @return The value formatted as Data::data_str() does.
+ */
+std::string SnapData::data_str() const {
+  Data data;
+  string_view str;
+
+  if (m_type == Data::int_t)
+    data.set_int64(m_int);
+  else if (m_type == Data::double_t)
+    data.set_double(m_double);
+  else if (!as_string_view(str))
+    return string(str);
+  return data.data_str();
+}
+
+/**
+ * @name name - Get the name of the pair.
+ *
+ * @return The name.
+ */
+std::string_view SnapPair::name() const {
+  return string_view(rel<char>(this, m_name), m_name_size);
+}
+
+/**
+ * @name value - Get the value of the pair.
+ *
+ * @return The value.
+ */
+const SnapData &SnapPair::value() const {
+  return m_value;
+}
+
+/**
+ * @name data - Get the values of the list.
+ *
+ * @return A view of the values.
+ */
+Span<SnapData> SnapList::data() const {
+  return Span<SnapData>(rel<SnapData>(this, m_data), m_size_of_data);
+}
+
+/**
+ * @name klists - Get the sub-lists of the list.
+ *
+ * @return A view of the sub-lists.
+ */
+Span<SnapList> SnapList::klists() const {
+  return Span<SnapList>(rel<SnapList>(this, m_klists), m_size_of_klist);
+}
+
+/**
+ * @name size_of_data - Number of values.
+ *
+ * @return The number of values.
+ */
+int32_t SnapList::size_of_data() const {
+  return m_size_of_data;
+}
+
+/**
+ * @name size_of_klist - Number of sub-lists.
+ *
+ * @return The number of sub-lists.
+ */
+int32_t SnapList::size_of_klist() const {
+  return m_size_of_klist;
+}
+
+/**
+ * @name id - Get the key ID.
+ *
+ * @return The ID.
+ */
+std::string_view SnapKey::id() const {
+  return string_view(rel<char>(this, m_id), m_id_size);
+}
+
+/**
+ * @name type - Get the key type.
+ *
+ * @return The key type.
+ */
+Key::Type SnapKey::type() const {
+  return (Key::Type)m_type;
+}
+
+/**
+ * @name value - Get the value of a value_t key.
+ *
+ * @return The value or NULL.
+ */
+const SnapData *SnapKey::value() const {
+  if (m_type != Key::value_t)
+    return NULL;
+  return rel<SnapData>(this, m_payload);
+}
+
+/**
+ * @name data_type - Get the type of the elements of an array.
+ *
+ * @return int_t or double_t if the array is unboxed, otherwise string_t
+ *         if all the elements are strings, or none_t.
+ */
+Data::Type SnapKey::data_type() const {
+  return (Data::Type)m_data_type;
+}
+
+/**
+ * @name at - Get an integer element of an array.
+ * @param index: The index of the element.
+ * @param value: A reference to the value.
+ *
+ * @return 0 on success, 1 if the index is out of range or the element is
+ *         not an integer.
+ */
+int32_t SnapKey::at(const int32_t index, int64_t &value) const {
+  if (m_type != Key::array_t || index < 0 || (uint32_t)index >= m_size)
+    return 1;
+  if (m_data_type == Data::int_t) {
+    value = rel<int64_t>(this, m_payload)[index];
+    return 0;
+  }
+  if (m_data_type == Data::double_t)
+    return 1;
+  return rel<SnapData>(this, m_payload)[index].as_int64(value);
+}
+
+/**
+ * @name at - Get a numeric element of an array as a double.
+ * @param index: The index of the element.
+ * @param value: A reference to the value.
+ *
+ * @return 0 on success, 1 if the index is out of range or the element is
+ *         not a number.
+ */
+int32_t SnapKey::at(const int32_t index, double &value) const {
+  if (m_type != Key::array_t || index < 0 || (uint32_t)index >= m_size)
+    return 1;
+  if (m_data_type == Data::int_t) {
+    value = (double)rel<int64_t>(this, m_payload)[index];
+    return 0;
+  }
+  if (m_data_type == Data::double_t) {
+    value = rel<double>(this, m_payload)[index];
+    return 0;
+  }
+  return rel<SnapData>(this, m_payload)[index].as_double(value);
+}
+
+/**
+ * @name at - Get a string element of an array.
+ * @param index: The index of the element.
+ * @param value: A reference to the value.
+ *
+ * @return 0 on success, 1 if the index is out of range or the element is
+ *         not a string.
+ */
+int32_t SnapKey::at(const int32_t index, std::string_view &value) const {
+  if (m_type != Key::array_t || index < 0 || (uint32_t)index >= m_size ||
+      m_data_type == Data::int_t || m_data_type == Data::double_t)
+    return 1;
+  return rel<SnapData>(this, m_payload)[index].as_string_view(value);
+}
+
+/**
+ * @name as_int64_span - Get an array of integers.
+ * @param values: A reference to the view of the integers.
+ *
+ * @return 0 on success, 1 if the key is not an array of integers.
+ */
+int32_t SnapKey::as_int64_span(Span<int64_t> &values) const {
+  if (m_type != Key::array_t || m_data_type != Data::int_t)
+    return 1;
+  values = Span<int64_t>(rel<int64_t>(this, m_payload), m_size);
+  return 0;
+}
+
+/**
+ * @name as_double_span - Get an array of doubles.
+ * @param values: A reference to the view of the doubles.
+ *
+ * @return 0 on success, 1 if the key is not an array of doubles.
+ */
+int32_t SnapKey::as_double_span(Span<double> &values) const {
+  if (m_type != Key::array_t || m_data_type != Data::double_t)
+    return 1;
+  values = Span<double>(rel<double>(this, m_payload), m_size);
+  return 0;
+}
+
+/**
+ * @name as_data_span - Get an array of mixed values or of strings.
+ * @param values: A reference to the view of the values.
+ *
+ * @return 0 on success, 1 if the key is not an array or it is unboxed.
+ */
+int32_t SnapKey::as_data_span(Span<SnapData> &values) const {
+  if (m_type != Key::array_t || m_data_type == Data::int_t || m_data_type == Data::double_t)
+    return 1;
+  values = Span<SnapData>(rel<SnapData>(this, m_payload), m_size);
+  return 0;
+}
+
+/**
+ * @name list - Get the top list of a list_t key.
+ *
+ * @return The list or NULL.
+ */
+const SnapList *SnapKey::list() const {
+  if (m_type != Key::list_t)
+    return NULL;
+  return rel<SnapList>(this, m_payload);
+}
+
+/**
+ * @name pairs - Get the pairs of a pairs_t key.
+ *
+ * @return A view of the pairs. It is empty for other keys.
+ */
+Span<SnapPair> SnapKey::pairs() const {
+  if (m_type != Key::pairs_t)
+    return Span<SnapPair>();
+  return Span<SnapPair>(rel<SnapPair>(this, m_payload), m_size);
+}
+
+/**
+ * @name size - Get the number of elements.
+ *
+ * @return The number of elements of an array or of pairs, 1 for a value
+ *         and 0 for a list.
+ */
+int32_t SnapKey::size() const {
+  return m_size;
+}
+
+/**
+ * @name id - Get the entity ID.
+ *
+ * @return The ID.
+ */
+std::string_view SnapEntity::id() const {
+  return string_view(rel<char>(this, m_id), m_id_size);
+}
+
+/**
+ * @name find - Search an array of records.
+ * @param items: The offset of the records.
+ * @param size: The number of records.
+ * @param table: The offset of their hash table.
+ * @param slots: The number of slots of the table, or 0 if there is none.
+ * @param id: The ID to search.
+ * @param hash: The hash_id() of the ID.
+ *
+ * @return The record or NULL.
+ */
+template <typename T>
+const T *SnapEntity::find(const int32_t items, const uint32_t size, const int32_t table,
+			  const uint32_t slots, const std::string_view id,
+			  const uint64_t hash) const {
+  const T *base = rel<T>(this, items);
+
+  if (!slots) {
+    for (uint32_t i = 0; i < size; i++)
+      if (base[i].m_hash == hash && base[i].id() == id)
+	return &base[i];
+    return NULL;
+  }
+  const uint32_t *slot = rel<uint32_t>(this, table);
+  uint32_t mask = slots - 1;
+  for (uint32_t i = hash & mask; slot[i]; i = (i + 1) & mask) {
+    const T *item = &base[slot[i] - 1];
+    if (item->m_hash == hash && item->id() == id)
+      return item;
+  }
+  return NULL;
+}
+
+/**
+ * @name find_key - Search for a key.
+ * @param id: The id of the key.
+ *
+ * @return The key or NULL.
+ */
+const SnapKey *SnapEntity::find_key(const std::string_view id) const {
+  return find_key(id, hash_id(id));
+}
+
+/**
+ * @name find_entity - Search for an entity.
+ * @param id: The id of the entity.
+ *
+ * @return The entity or NULL.
+ */
+const SnapEntity *SnapEntity::find_entity(const std::string_view id) const {
+  return find_entity(id, hash_id(id));
+}
+
+/**
+ * @name find_key - Search for a key by a precomputed hash.
+ * @param id: The id of the key.
+ * @param hash: The hash_id() of the id.
+ *
+ * @return The key or NULL.
+ */
+const SnapKey *SnapEntity::find_key(const std::string_view id, const uint64_t hash) const {
+  return find<SnapKey>(m_keys, m_size_of_keys, m_key_table, m_key_slots, id, hash);
+}
+
+/**
+ * @name find_entity - Search for an entity by a precomputed hash.
+ * @param id: The id of the entity.
+ * @param hash: The hash_id() of the id.
+ *
+ * @return The entity or NULL.
+ */
+const SnapEntity *SnapEntity::find_entity(const std::string_view id, const uint64_t hash) const {
+  return find<SnapEntity>(m_entities, m_size_of_entities, m_entity_table, m_entity_slots,
+			  id, hash);
+}
+
+/**
+ * @name keys - Get the keys.
+ *
+ * @return A view of the keys in insertion order.
+ */
+Span<SnapKey> SnapEntity::keys() const {
+  return Span<SnapKey>(rel<SnapKey>(this, m_keys), m_size_of_keys);
+}
+
+/**
+ * @name entities - Get the sub-entities.
+ *
+ * @return A view of the sub-entities in insertion order.
+ */
+Span<SnapEntity> SnapEntity::entities() const {
+  return Span<SnapEntity>(rel<SnapEntity>(this, m_entities), m_size_of_entities);
+}
+
+/**
+ * @name size_of_keys - Number of keys.
+ *
+ * @return The number of keys.
+ */
+int32_t SnapEntity::size_of_keys() const {
+  return m_size_of_keys;
+}
+
+/**
+ * @name size_of_entities - Number of sub-entities.
+ *
+ * @return The number of sub-entities.
+ */
+int32_t SnapEntity::size_of_entities() const {
+  return m_size_of_entities;
+}
+
+/**
+ * @name Snapshot - Constructor.
+ *
+ * Creates an empty snapshot.
+ */
+Snapshot::Snapshot() : m_base(NULL), m_size(0), m_map(NULL), m_root(NULL) {}
+
+/**
+ * @name ~Snapshot - Destructor.
+ *
+ * Unmaps the snapshot file.
+ */
+Snapshot::~Snapshot() {
+  close();
+}
+
+/**
+ * @name compile - Compile a configuration.
+ * @param conf: The configuration.
+ * @param out: A reference to the snapshot.
+ *
+ * @return 0 on success, 1 if the snapshot would be larger than 2GB.
+ */
+int32_t Snapshot::compile(const Configuration *conf, std::string &out) {
+  SnapWriter writer;
+  return writer.write(conf, out);
+}
+
+/**
+ * @name compile - Compile a configuration into a file.
+ * @param conf: The configuration.
+ * @param filename: The snapshot file.
+ *
+ * @return 0 on success, 1 on error.
+ */
+int32_t Snapshot::compile(const Configuration *conf, const std::string &filename) {
+  string out;
+  FILE *file;
+
+  if (compile(conf, out)) {
+    fprintf(stderr, "The configuration is too large for a snapshot.\n");
+    return 1;
+  }
+  if (!(file = fopen(filename.c_str(), "wb"))) {
+    fprintf(stderr, "File \"%s\": %s. \n", filename.c_str(), strerror(errno));
+    return 1;
+  }
+  size_t written = fwrite(out.data(), 1, out.size(), file);
+  if (fclose(file) || written != out.size()) {
+    fprintf(stderr, "File \"%s\" could not be written. \n", filename.c_str());
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * @name open - Load a snapshot file.
+ * @param filename: The snapshot file.
+ * @param verify: Whether to verify the checksum.
+ *
+ * The file is mapped read-only and used in place.
+ *
+ * @return 0 on success, 1 on error.
+ */
+int32_t Snapshot::open(const std::string &filename, const bool verify) {
+  struct stat st;
+  void *addr;
+  int fd;
+
+  close();
+  if ((fd = ::open(filename.c_str(), O_RDONLY)) < 0) {
+    fprintf(stderr, "File \"%s\" not found. \n", filename.c_str());
+    return 1;
+  }
+  if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(SnapHeader)) {
+    fprintf(stderr, "File \"%s\" is not a snapshot. \n", filename.c_str());
+    ::close(fd);
+    return 1;
+  }
+  addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (addr == MAP_FAILED) {
+    fprintf(stderr, "File \"%s\" could not be loaded. \n", filename.c_str());
+    return 1;
+  }
+  if (open_buffer(addr, st.st_size, verify)) {
+    fprintf(stderr, "File \"%s\" is not a valid snapshot. \n", filename.c_str());
+    munmap(addr, st.st_size);
+    return 1;
+  }
+  m_map = addr;
+  return 0;
+}
+
+/**
+ * @name open_buffer - Use a snapshot that is in memory.
+ * @param data: The snapshot. It must be aligned to eight bytes.
+ * @param size: The size of the snapshot in bytes.
+ * @param verify: Whether to verify the checksum.
+ *
+ * The buffer is not copied, so it must stay valid until the snapshot is
+ * closed.
+ *
+ * @return 0 on success, 1 if the buffer does not hold a valid snapshot.
+ */
+int32_t Snapshot::open_buffer(const void *data, const size_t size, const bool verify) {
+  const SnapHeader *header = (const SnapHeader *)data;
+
+  close();
+  if (!data || ((uintptr_t)data & 7) || size < sizeof(SnapHeader))
+    return 1;
+  if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) ||
+      header->version != SNAPSHOT_VERSION || header->byte_order != SNAPSHOT_BYTE_ORDER ||
+      header->size != size || header->root < sizeof(SnapHeader) ||
+      header->root + sizeof(SnapEntity) > size)
+    return 1;
+  if (verify && header->checksum !=
+      hash_id(string_view((const char *)data + sizeof(SnapHeader), size - sizeof(SnapHeader))))
+    return 1;
+  m_base = (const char *)data;
+  m_size = size;
+  m_root = rel<SnapEntity>(data, header->root);
+  return 0;
+}
+
+/**
+ * @name close - Close the snapshot.
+ *
+ * Unmaps the snapshot file, if any.
+ *
+ * @return Void.
+ */
+void Snapshot::close() {
+  if (m_map)
+    munmap(m_map, m_size);
+  m_map = NULL;
+  m_base = NULL;
+  m_size = 0;
+  m_root = NULL;
+}
+
+/**
+ * @name root - Get the configuration.
+ *
+ * @return The entity that holds the 1-level keys and entities, or NULL if
+ *         no snapshot is loaded.
+ */
+const SnapEntity *Snapshot::root() const {
+  return m_root;
+}
+
+/**
+ * @name find_key - Search for a 1-level key.
+ * @param id: The id of the key.
+ *
+ * @return The key or NULL.
+ */
+const SnapKey *Snapshot::find_key(const std::string_view id) const {
+  return m_root ? m_root->find_key(id) : NULL;
+}
+
+/**
+ * @name find_entity - Search for a 1-level entity.
+ * @param id: The id of the entity.
+ *
+ * @return The entity or NULL.
+ */
+const SnapEntity *Snapshot::find_entity(const std::string_view id) const {
+  return m_root ? m_root->find_entity(id) : NULL;
+}
+
+/**
+ * @name find_path - Search for a key by its dotted path.
+ * @param path: The path of the key.
+ *
+ * @return The key or NULL.
+ */
+const SnapKey *Snapshot::find_path(const std::string_view path) const {
+  return m_root ? path_find_key(m_root, path) : NULL;
+}
+
+/**
+ * @name find_path - Search for a key by a precompiled path.
+ * @param path: The path of the key.
+ *
+ * @return The key or NULL.
+ */
+const SnapKey *Snapshot::find_path(const Path &path) const {
+  return m_root ? path_find_key(m_root, path) : NULL;
+}
+
+/**
+ * @name find_entity_path - Search for an entity by its dotted path.
+ * @param path: The path of the entity.
+ *
+ * @return The entity or NULL.
+ */
+const SnapEntity *Snapshot::find_entity_path(const std::string_view path) const {
+  return m_root ? path_find_entity(m_root, path) : NULL;
+}
+
+/**
+ * @name find_entity_path - Search for an entity by a precompiled path.
+ * @param path: The path of the entity.
+ *
+ * @return The entity or NULL.
+ */
+const SnapEntity *Snapshot::find_entity_path(const Path &path) const {
+  return m_root ? path_find_entity(m_root, path) : NULL;
+}
+
+/**
+ * @name keys - Get the 1-level keys.
+ *
+ * @return A view of the keys.
+ */
+Span<SnapKey> Snapshot::keys() const {
+  return m_root ? m_root->keys() : Span<SnapKey>();
+}
+
+/**
+ * @name entities - Get the 1-level entities.
+ *
+ * @return A view of the entities.
+ */
+Span<SnapEntity> Snapshot::entities() const {
+  return m_root ? m_root->entities() : Span<SnapEntity>();
+}
+
+/**
+ * @name size_of_keys - Number of 1-level keys.
+ *
+ * @return The number of keys.
+ */
+int32_t Snapshot::size_of_keys() const {
+  return m_root ? m_root->size_of_keys() : 0;
+}
+
+/**
+ * @name size_of_entities - Number of 1-level entities.
+ *
+ * @return The number of entities.
+ */
+int32_t Snapshot::size_of_entities() const {
+  return m_root ? m_root->size_of_entities() : 0;
+}
@@ -0,0 +1,263 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Confslice - A simple configuration file parser.
+ *
+ * Copyright (C) 2014 Giorgos Kappes <geokapp@gmail.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file LICENSE.
+ *
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include "configuration.h"
+#include "path.h"
+
+/*
+ * Compiled configuration snapshots.
+ *
+ * A snapshot is a parsed configuration written out as one block of fixed
+ * size records. Every reference inside it is a 32-bit offset relative to
+ * the record that holds it, so the block can be mapped at any address and
+ * read in place, without parsing or allocating. The records are:
+ *
+ *   header    magic, version, byte order, size, checksum and the root.
+ *   SnapEntity one per entity. The keys and the sub-entities of an entity
+ *             are arrays of records, followed by a hash table of each
+ *             array when it holds more than INDEX_SMALL records.
+ *   SnapKey   one per key, with a payload that depends on its type: a
+ *             SnapData, an unboxed int64_t or double array or an array
+ *             of SnapData, a SnapList tree, or an array of SnapPair.
+ *   strings   the IDs and the string values, deduplicated and stored
+ *             after all the records.
+ *
+ * A snapshot is written in the byte order of the host and is only loaded
+ * on hosts with the same byte order.
+ */
+
+#define SNAPSHOT_VERSION 1
+
+class SnapWriter;
+
+/**
+ * @name SnapData - A value in a snapshot.
+ *
+ * The read-only counterpart of Data.
+ */
+class SnapData {
+  friend class SnapWriter;
+
+ private:
+  uint32_t m_type;
+  uint32_t m_size;
+  union {
+    int64_t m_int;
+    double m_double;
+    int32_t m_str;
+  };
+
+ public:
+  Data::Type type() const;
+  int32_t as_int64(int64_t &value) const;
+  int32_t as_double(double &value) const;
+  int32_t as_string_view(std::string_view &value) const;
+  std::string data_str() const;
+};
+
+/**
+ * @name SnapPair - A pair of a KPairs key in a snapshot.
+ */
+class SnapPair {
+  friend class SnapWriter;
+
+ private:
+  int32_t m_name;
+  uint32_t m_name_size;
+  SnapData m_value;
+
+ public:
+  std::string_view name() const;
+  const SnapData &value() const;
+};
+
+/**
+ * @name SnapList - A list in a snapshot.
+ *
+ * The read-only counterpart of KListNode. The values and the sub-lists of
+ * a list are stored contiguously.
+ */
+class SnapList {
+  friend class SnapWriter;
+
+ private:
+  int32_t m_data;
+  uint32_t m_size_of_data;
+  int32_t m_klists;
+  uint32_t m_size_of_klist;
+
+ public:
+  Span<SnapData> data() const;
+  Span<SnapList> klists() const;
+  int32_t size_of_data() const;
+  int32_t size_of_klist() const;
+};
+
+/**
+ * @name SnapKey - A key in a snapshot.
+ *
+ * The read-only counterpart of the Key classes. value() is valid for
+ * value_t keys, the array methods for array_t keys, list() for list_t
+ * keys and pairs() for pairs_t keys.
+ */
+class SnapKey {
+  friend class SnapWriter;
+  friend class SnapEntity;
+
+ private:
+  uint64_t m_hash;
+  int32_t m_id;
+  uint32_t m_id_size;
+  uint16_t m_type;
+  uint16_t m_data_type;
+  uint32_t m_size;
+  int32_t m_payload;
+  uint32_t m_reserved;
+
+ public:
+  std::string_view id() const;
+  Key::Type type() const;
+
+  const SnapData *value() const;
+
+  Data::Type data_type() const;
+  int32_t at(const int32_t index, int64_t &value) const;
+  int32_t at(const int32_t index, double &value) const;
+  int32_t at(const int32_t index, std::string_view &value) const;
+  int32_t as_int64_span(Span<int64_t> &values) const;
+  int32_t as_double_span(Span<double> &values) const;
+  int32_t as_data_span(Span<SnapData> &values) const;
+
+  const SnapList *list() const;
+  Span<SnapPair> pairs() const;
+
+  int32_t size() const;
+};
+
+/**
+ * @name SnapEntity - An entity in a snapshot.
+ *
+ * The read-only counterpart of Entity. The configuration itself is stored
+ * as an entity with an empty ID.
+ */
+class SnapEntity {
+  friend class SnapWriter;
+
+ private:
+  uint64_t m_hash;
+  int32_t m_id;
+  uint32_t m_id_size;
+  uint32_t m_size_of_keys;
+  int32_t m_keys;
+  uint32_t m_size_of_entities;
+  int32_t m_entities;
+  uint32_t m_key_slots;
+  int32_t m_key_table;
+  uint32_t m_entity_slots;
+  int32_t m_entity_table;
+
+  template <typename T>
+  const T *find(const int32_t items, const uint32_t size, const int32_t table,
+		const uint32_t slots, const std::string_view id, const uint64_t hash) const;
+
+ public:
+  std::string_view id() const;
+
+  const SnapKey *find_key(const std::string_view id) const;
+  const SnapEntity *find_entity(const std::string_view id) const;
+  const SnapKey *find_key(const std::string_view id, const uint64_t hash) const;
+  const SnapEntity *find_entity(const std::string_view id, const uint64_t hash) const;
+
+  Span<SnapKey> keys() const;
+  Span<SnapEntity> entities() const;
+
+  int32_t size_of_keys() const;
+  int32_t size_of_entities() const;
+};
+
+/**
+ * @name Snapshot - A compiled configuration.
+ *
+ * compile() writes a configuration as a snapshot. open() maps a snapshot
+ * file and open_buffer() uses one that is already in memory; neither parses
+ * or copies it. Lookups follow the read-only API of Configuration and
+ * return pointers into the snapshot, which stay valid until it is closed.
+ *
+ * The header carries a checksum of the records. It is verified by default
+ * when the snapshot is loaded; the records themselves are trusted.
+ */
+class Snapshot {
+ private:
+  const char *m_base;
+  size_t m_size;
+  void *m_map;
+  const SnapEntity *m_root;
+
+ public:
+  Snapshot();
+  ~Snapshot();
+
+  static int32_t compile(const Configuration *conf, std::string &out);
+  static int32_t compile(const Configuration *conf, const std::string &filename);
+
+  int32_t open(const std::string &filename, const bool verify = true);
+  int32_t open_buffer(const void *data, const size_t size, const bool verify = true);
+  void close();
+
+  const SnapEntity *root() const;
+
+  const SnapKey *find_key(const std::string_view id) const;
+  const SnapEntity *find_entity(const std::string_view id) const;
+
+  const SnapKey *find_path(const std::string_view path) const;
+  const SnapKey *find_path(const Path &path) const;
+  const SnapEntity *find_entity_path(const std::string_view path) const;
+  const SnapEntity *find_entity_path(const Path &path) const;
+
+  /**
+   * @name get - Get the value of a key by its path.
+   * @param path: The dotted path of the key.
+   * @param fallback: The value to return if the key is not found.
+   *
+   * Same as Configuration::get(). A returned string view points into the
+   * snapshot.
+   *
+   * @return The value or the fallback.
+   */
+  template <typename T>
+  T get(const std::string_view path, const T &fallback) const {
+    const SnapKey *key = find_path(path);
+    return value_or(key ? key->value() : NULL, fallback);
+  }
+
+  template <typename T>
+  T get(const Path &path, const T &fallback) const {
+    const SnapKey *key = find_path(path);
+    return value_or(key ? key->value() : NULL, fallback);
+  }
+
+  Span<SnapKey> keys() const;
+  Span<SnapEntity> entities() const;
+
+  int32_t size_of_keys() const;
+  int32_t size_of_entities() const;
+};
+
+#endif
@@ -0,0 +1,208 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Confslice - A simple configuration file parser.
+ *
+ * Copyright (C) 2014 Giorgos Kappes <geokapp@gmail.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file LICENSE.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include "stats.h"
+
+using namespace std;
+
+/*
+ * The monotonic clock in nanoseconds, which calibrates the ticks.
+ */
+static uint64_t monotonic_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @name ParseStats - Constructor.
+ *
+ * Creates empty statistics.
+ */
+ParseStats::ParseStats() {
+  clear();
+}
+
+/**
+ * @name clear - Reset the statistics.
+ *
+ * @return Void.
+ */
+void ParseStats::clear() {
+  bytes = 0;
+  memset(tokens, 0, sizeof(tokens));
+  entities = 0;
+  memset(keys, 0, sizeof(keys));
+  duplicates = 0;
+  max_depth = 0;
+  allocations = 0;
+  allocated_bytes = 0;
+  memset(ns, 0, sizeof(ns));
+  total_ns = 0;
+  memset(ticks, 0, sizeof(ticks));
+}
+
+/**
+ * @name token_name - Get the name of a token kind.
+ * @param kind: The index of the kind in tokens.
+ *
+ * @return The name, or NULL if there is no such kind.
+ */
+const char *ParseStats::token_name(const size_t kind) {
+  static const char *names[token_kinds] = {
+    "id", "integer", "string", "double", "assign", "lbracket", "rbracket", "lparen",
+    "rparen", "lbrace", "rbrace", "langle", "rangle", "semicolon", "colon", "comma", "other"
+  };
+  return kind < token_kinds ? names[kind] : NULL;
+}
+
+/**
+ * @name phase_name - Get the name of a phase.
+ * @param phase: The phase.
+ *
+ * @return The name, or NULL if there is no such phase.
+ */
+const char *ParseStats::phase_name(const size_t phase) {
+  static const char *names[phases] = {"io", "lex", "tree", "insert"};
+  return phase < phases ? names[phase] : NULL;
+}
+
+/**
+ * @name dump - Format the statistics for a metrics agent.
+ * @param prefix: The prefix of every name.
+ *
+ * Writes one "name value" line per counter, e.g. "confslice_tokens_id 12".
+ * The names use only letters, digits and underscores, so the dump can be
+ * scraped as a Prometheus text exposition. Every counter is present even
+ * without statistics, when "<prefix>_stats_enabled" is 0.
+ *
+ * @return The dump.
+ */
+std::string ParseStats::dump(const std::string_view prefix) const {
+  static const char *key_names[4] = {"value", "array", "list", "pairs"};
+  string out;
+  char buf[160];
+  auto line = [&](const char *name, const char *sub, const uint64_t value) {
+    snprintf(buf, sizeof(buf), "%.*s_%s%s%s %llu\n", (int)prefix.size(), prefix.data(), name,
+	     sub ? "_" : "", sub ? sub : "", (unsigned long long)value);
+    out += buf;
+  };
+
+  line("stats_enabled", NULL, enabled ? 1 : 0);
+  line("bytes", NULL, bytes);
+  for (size_t i = 0; i < token_kinds; i++)
+    line("tokens", token_name(i), tokens[i]);
+  line("entities", NULL, entities);
+  for (size_t i = 0; i < 4; i++)
+    line("keys", key_names[i], keys[i]);
+  line("duplicates", NULL, duplicates);
+  line("max_depth", NULL, max_depth);
+  line("allocations", NULL, allocations);
+  line("allocated_bytes", NULL, allocated_bytes);
+  for (size_t i = 0; i < phases; i++)
+    line("ns", phase_name(i), ns[i]);
+  line("ns_total", NULL, total_ns);
+  return out;
+}
+
+/**
+ * @name StatsResource - Constructor.
+ * @param upstream: The resource that serves the requests.
+ */
+StatsResource::StatsResource(std::pmr::memory_resource *upstream)
+  : m_upstream(upstream), m_allocations(0), m_bytes(0) {
+}
+
+/**
+ * @name upstream - Get the upstream resource.
+ *
+ * @return The resource that serves the requests.
+ */
+std::pmr::memory_resource *StatsResource::upstream() const {
+  return m_upstream;
+}
+
+/**
+ * @name allocations - Get the number of allocations so far.
+ *
+ * @return The number of allocations.
+ */
+uint64_t StatsResource::allocations() const {
+  return m_allocations.load(std::memory_order_relaxed);
+}
+
+/**
+ * @name bytes - Get the number of bytes allocated so far.
+ *
+ * @return The number of bytes.
+ */
+uint64_t StatsResource::bytes() const {
+  return m_bytes.load(std::memory_order_relaxed);
+}
+
+void *StatsResource::do_allocate(size_t size, size_t align) {
+  m_allocations.fetch_add(1, std::memory_order_relaxed);
+  m_bytes.fetch_add(size, std::memory_order_relaxed);
+  return m_upstream->allocate(size, align);
+}
+
+void StatsResource::do_deallocate(void *p, size_t size, size_t align) {
+  m_upstream->deallocate(p, size, align);
+}
+
+bool StatsResource::do_is_equal(const std::pmr::memory_resource &other) const noexcept {
+  return this == &other;
+}
+
+/**
+ * @name start - Begin the statistics of an analysis.
+ *
+ * @return Void.
+ */
+void StatsScope::start() {
+  m_stats->clear();
+  m_allocations = m_resource ? m_resource->allocations() : 0;
+  m_bytes = m_resource ? m_resource->bytes() : 0;
+  m_start_ns = monotonic_ns();
+  m_start_ticks = stats_ticks();
+}
+
+/**
+ * @name finish - End the statistics of an analysis.
+ *
+ * The ticks of the phases are converted with the ratio of the elapsed
+ * nanoseconds to the elapsed ticks.
+ *
+ * @return Void.
+ */
+void StatsScope::finish() {
+  uint64_t ticks = stats_ticks() - m_start_ticks;
+  uint64_t other = 0;
+
+  m_stats->total_ns = monotonic_ns() - m_start_ns;
+  if (m_resource) {
+    m_stats->allocations = m_resource->allocations() - m_allocations;
+    m_stats->allocated_bytes = m_resource->bytes() - m_bytes;
+  }
+  for (size_t i = 0; i < ParseStats::phases; i++)
+    if (i != ParseStats::tree_phase)
+      other += m_stats->ticks[i];
+  m_stats->ticks[ParseStats::tree_phase] = ticks > other ? ticks - other : 0;
+  for (size_t i = 0; ticks && i < ParseStats::phases; i++)
+    m_stats->ns[i] = (uint64_t)((double)m_stats->ticks[i] * m_stats->total_ns / ticks);
+}
@@ -0,0 +1,195 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Confslice - A simple configuration file parser.
+ *
+ * Copyright (C) 2014 Giorgos Kappes <geokapp@gmail.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file LICENSE.
+ *
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <time.h>
+#include <atomic>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*
+ * The statistics are collected only when the library is built with
+ * CONFSLICE_STATS defined ("make STATS=1"). Otherwise every hook is dead
+ * code and the statistics stay empty.
+ */
+#ifdef CONFSLICE_STATS
+#define STATS_ENABLED true
+#else
+#define STATS_ENABLED false
+#endif
+
+/**
+ * @name ParseStats - Statistics of an analysis.
+ *
+ * Counts the input, the tokens by kind, the entities, the keys by type,
+ * the duplicates that were dropped, the deepest entity and the tree
+ * allocations, and splits the time of the analysis into phases: opening
+ * and loading the input, lexing, building the tree and inserting into it,
+ * which includes the duplicate checks. A memory-mapped file is read
+ * while it is lexed.
+ */
+struct ParseStats {
+  enum Phase
+  {
+    io_phase,       // Opening, mapping or reading the input.
+    lex_phase,      // The lexical analyzer.
+    tree_phase,     // The syntax analyzer, less the other phases.
+    insert_phase,   // Adding keys and entities to their scope.
+    phases
+  };
+
+  // Token kinds: the values, the punctuation and anything else but the
+  // end of the input.
+  static const size_t token_kinds = 17;
+
+  static constexpr bool enabled = STATS_ENABLED;
+
+  uint64_t bytes;
+  uint64_t tokens[token_kinds];
+  uint64_t entities;
+  uint64_t keys[4];          // By Key::Type.
+  uint64_t duplicates;
+  uint32_t max_depth;
+  uint64_t allocations;      // Tree allocations.
+  uint64_t allocated_bytes;
+  uint64_t ns[phases];
+  uint64_t total_ns;
+  uint64_t ticks[phases];    // The raw clock of every phase.
+
+  ParseStats();
+  void clear();
+
+  /**
+   * @name count_token - Count a token by its kind.
+   * @param id: The token ID.
+   */
+  void count_token(const int32_t id) {
+    if (id >= 40 && id <= 43)
+      tokens[id - 40]++;
+    else if (id >= 50 && id <= 61)
+      tokens[id - 50 + 4]++;
+    else
+      tokens[token_kinds - 1]++;
+  }
+
+  static const char *token_name(const size_t kind);
+  static const char *phase_name(const size_t phase);
+  std::string dump(const std::string_view prefix = "confslice") const;
+};
+
+/**
+ * @name stats_ticks - Read the clock of the statistics.
+ *
+ * The time stamp counter where there is one, otherwise the monotonic
+ * clock in nanoseconds. The ticks are converted to nanoseconds at the end
+ * of the analysis.
+ */
+static inline uint64_t stats_ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+/**
+ * @name StatsTimer - Add the time of a scope to a phase.
+ *
+ * Does nothing without statistics.
+ */
+class StatsTimer {
+ private:
+  ParseStats *m_stats;
+  ParseStats::Phase m_phase;
+  uint64_t m_start;
+
+ public:
+  StatsTimer(ParseStats *stats, const ParseStats::Phase phase)
+    : m_stats(stats), m_phase(phase), m_start(stats ? stats_ticks() : 0) {
+  }
+
+  ~StatsTimer() {
+    if (m_stats)
+      m_stats->ticks[m_phase] += stats_ticks() - m_start;
+  }
+};
+
+/**
+ * @name StatsResource - A memory resource that counts the allocations.
+ *
+ * Forwards every request to an upstream resource. The counters are
+ * atomic, since parallel analyses share the resource of the tree.
+ */
+class StatsResource : public std::pmr::memory_resource {
+ private:
+  std::pmr::memory_resource *m_upstream;
+  std::atomic<uint64_t> m_allocations;
+  std::atomic<uint64_t> m_bytes;
+
+ public:
+  explicit StatsResource(std::pmr::memory_resource *upstream);
+
+  std::pmr::memory_resource *upstream() const;
+  uint64_t allocations() const;
+  uint64_t bytes() const;
+
+ private:
+  void *do_allocate(size_t size, size_t align) override;
+  void do_deallocate(void *p, size_t size, size_t align) override;
+  bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override;
+};
+
+/**
+ * @name StatsScope - Collect the statistics of an analysis.
+ *
+ * Clears the statistics when the analysis begins and, when it ends,
+ * records the allocations made meanwhile and converts the phases to
+ * nanoseconds. The tree phase is the time that no other phase took.
+ */
+class StatsScope {
+ private:
+  ParseStats *m_stats;
+  const StatsResource *m_resource;
+  uint64_t m_allocations;
+  uint64_t m_bytes;
+  uint64_t m_start_ticks;
+  uint64_t m_start_ns;
+
+ public:
+  StatsScope(ParseStats *stats, const StatsResource *resource)
+    : m_stats(stats), m_resource(resource) {
+    if (m_stats)
+      start();
+  }
+
+  ~StatsScope() {
+    if (m_stats)
+      finish();
+  }
+
+ private:
+  void start();
+  void finish();
+};
+
+#endif
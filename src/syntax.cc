@@ -12,6 +12,7 @@
  * 
  */
 
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include "configuration.h"
@@ -22,22 +23,212 @@
 
 using namespace std;
 
+/**
+ * @name TreeBuilder - Constructor.
+ * @param gc: A pointer to a global context object.
+ *
+ * Creates a builder without a configuration.
+ */
+TreeBuilder::TreeBuilder(GlobalContext *gc) {
+  m_gc_ptr = gc;
+  m_conf = NULL;
+  m_key = NULL;
+}
+
+/**
+ * @name TreeBuilder - Destructor.
+ *
+ * Deletes the unfinished entities and key.
+ */
+TreeBuilder::~TreeBuilder() {
+  abort();
+}
+
+/**
+ * @name set_configuration - Set the configuration to build.
+ * @param conf_ptr: The configuration.
+ *
+ * @return Void.
+ */
+void TreeBuilder::set_configuration(Configuration *conf_ptr) {
+  abort();
+  m_conf = conf_ptr;
+}
+
+std::pmr::memory_resource *TreeBuilder::resource() {
+  return m_conf->resource();
+}
+
+/**
+ * @name add_key - Add a key to the current scope.
+ * @param key: The new key.
+ *
+ * Adds the key to the innermost open entity, or to the configuration if
+ * it is outside of an entity. A key whose ID is already defined in the
+ * same scope is dropped.
+ *
+ * @return Void.
+ */
+void TreeBuilder::add_key(Key *key) {
+  ParseStats *stats = m_gc_ptr->stats();
+  StatsTimer timer(stats, ParseStats::insert_phase);
+  int32_t result;
+  if (!m_entities.empty())
+    result = m_entities.back()->add_key(key);
+  else
+    result = m_conf->add_key(key);
+  if (stats) {
+    stats->keys[key->type()]++;
+    stats->duplicates += result ? 1 : 0;
+  }
+  if (result)
+    delete key;
+}
+
+/**
+ * @name add_entity - Add an entity to its scope.
+ * @param entity: The new entity.
+ *
+ * Adds the entity to the innermost open entity, or to the configuration
+ * if it is a 1-level entity. An entity whose ID is already defined in the
+ * same scope is dropped.
+ *
+ * @return Void.
+ */
+void TreeBuilder::add_entity(Entity *entity) {
+  ParseStats *stats = m_gc_ptr->stats();
+  StatsTimer timer(stats, ParseStats::insert_phase);
+  int32_t result = m_entities.empty() ? m_conf->add_entity(entity) :
+    m_entities.back()->add_entity(entity);
+  if (stats) {
+    stats->entities++;
+    stats->duplicates += result ? 1 : 0;
+  }
+  if (result)
+    delete entity;
+}
+
+int32_t TreeBuilder::begin_entity(const std::string_view id) {
+  Entity *entity = m_conf->create<Entity>();
+  entity->set_id(id);
+  m_entities.push_back(entity);
+  return 0;
+}
+
+int32_t TreeBuilder::end_entity() {
+  Entity *entity = m_entities.back();
+  m_entities.pop_back();
+  add_entity(entity);
+  return 0;
+}
+
+int32_t TreeBuilder::key_value(const std::string_view id, Data &value) {
+  KValue *kv = m_conf->create<KValue>();
+  kv->set_id(id);
+  kv->set_value(std::move(value));
+  add_key(kv);
+  return 0;
+}
+
+int32_t TreeBuilder::begin_array(const std::string_view id) {
+  m_key = m_conf->create<KArray>();
+  m_key->set_id(id);
+  return 0;
+}
+
+int32_t TreeBuilder::array_item(Data &value) {
+  ((KArray *)m_key)->insert_data(std::move(value));
+  return 0;
+}
+
+int32_t TreeBuilder::end_array() {
+  add_key(m_key);
+  m_key = NULL;
+  return 0;
+}
+
+int32_t TreeBuilder::begin_list(const std::string_view id) {
+  KList *klist = m_conf->create<KList>();
+  klist->set_id(id);
+  m_key = klist;
+  m_lists.begin(klist);
+  return 0;
+}
+
+int32_t TreeBuilder::begin_sublist() {
+  m_lists.begin_klist();
+  return 0;
+}
+
+int32_t TreeBuilder::list_item(Data &value) {
+  m_lists.insert_data(std::move(value));
+  return 0;
+}
+
+int32_t TreeBuilder::end_sublist() {
+  m_lists.end_klist();
+  return 0;
+}
+
+int32_t TreeBuilder::end_list() {
+  m_lists.end();
+  add_key(m_key);
+  m_key = NULL;
+  return 0;
+}
+
+int32_t TreeBuilder::begin_pairs(const std::string_view id) {
+  m_key = m_conf->create<KPairs>();
+  m_key->set_id(id);
+  return 0;
+}
+
+int32_t TreeBuilder::pair(const std::string_view id, Data &value) {
+  ((KPairs *)m_key)->insert(id, std::move(value));
+  return 0;
+}
+
+int32_t TreeBuilder::end_pairs() {
+  add_key(m_key);
+  m_key = NULL;
+  return 0;
+}
+
+/**
+ * @name abort - Drop the unfinished entities and key.
+ *
+ * The nested entities that were already added to an unfinished entity
+ * are deleted with it.
+ *
+ * @return Void.
+ */
+void TreeBuilder::abort() {
+  m_lists.clear();
+  if (m_key)
+    delete m_key;
+  m_key = NULL;
+  for (Entity *entity : m_entities)
+    delete entity;
+  m_entities.clear();
+}
+
 /**
  * @name SyntaxAnalyzer - Constructor.
  * @param gc: A pointer to a global context object.
  *
- * Creates the configuration and lectical analyzer objects.
+ * Creates the tree builder and lectical analyzer objects.
  */
-SyntaxAnalyzer::SyntaxAnalyzer(GlobalContext *gc) {
+SyntaxAnalyzer::SyntaxAnalyzer(GlobalContext *gc) : m_builder(gc) {
   m_gc_ptr = gc;
-  m_lex = new LexAnalyzer();
-  m_token_str.clear();
+  m_lex = new LexAnalyzer(gc);
+  m_handler = NULL;
+  m_stopped = false;
 }
 
 /**
  * @name SyntaxAnalyzer - Destructor.
  *
- * Deletes the configuration and lectical analyzer objects.
+ * Deletes the lectical analyzer object.
  */
 SyntaxAnalyzer::~SyntaxAnalyzer() {
   if (m_lex)
@@ -49,13 +240,29 @@ SyntaxAnalyzer::~SyntaxAnalyzer() {
 /**
  * @name open - Open a file.
  * @param filename: The filename.
+ * @param input: How the lexical analyzer reads the file.
  *
  * Loads a new configuration file for analysis.
  *
  * @return 0 on success, 1 on error.
  */
-int32_t SyntaxAnalyzer::open(const string filename) {
-  return (m_lex->open(filename));
+int32_t SyntaxAnalyzer::open(const string filename, const LexAnalyzer::Input input) {
+  return (m_lex->open(filename, input));
+}
+
+/**
+ * @name open_buffer - Open a memory buffer.
+ * @param data: The configuration text.
+ * @param len: The length of the text in bytes.
+ * @param line: The line number of the first line of the text.
+ *
+ * Loads a configuration that is already in memory for analysis. The buffer
+ * is not copied and must stay valid until the analysis ends.
+ *
+ * @return 0 on success, 1 on error.
+ */
+int32_t SyntaxAnalyzer::open_buffer(const char *data, const size_t len, const uint32_t line) {
+  return (m_lex->open_buffer(data, len, line));
 }
 
 /**
@@ -70,347 +277,268 @@ int32_t SyntaxAnalyzer::close() {
 }
 
 /**
- * @name analyze - Begin the syntax analysis.
+ * @name analyze - Analyze into a configuration.
+ * @param conf_ptr: The configuration.
  *
- * Close the configuration file if it is already opened.
+ * Adds the entities and keys of the input to the configuration and
+ * closes the input.
  *
  * @return 0 on success, 1 on error.
  */
 int32_t SyntaxAnalyzer::analyze(Configuration *conf_ptr) {
-  int32_t result = begin(conf_ptr);
+  m_builder.set_configuration(conf_ptr);
+  return analyze(&m_builder);
+}
+
+/**
+ * @name analyze - Analyze into a handler.
+ * @param handler: The receiver of the events.
+ *
+ * Sends the events of the input to the handler and closes the input. If
+ * the analysis fails, the handler is aborted.
+ *
+ * @return 0 on success, 1 on a syntax error or if the handler stopped.
+ */
+int32_t SyntaxAnalyzer::analyze(ParseHandler *handler) {
+  m_handler = handler;
+  m_stopped = false;
+  int32_t result = begin();
   close();
+  if (result)
+    handler->abort();
+  m_handler = NULL;
 
   return result;
 }
 
-int32_t SyntaxAnalyzer::begin(Configuration *conf_ptr) {
+/**
+ * @name error - Report a syntax error.
+ * @param expected: What was expected instead of the current token.
+ *
+ * Nothing is reported once the handler has stopped the analysis.
+ *
+ * @return Always 1.
+ */
+int32_t SyntaxAnalyzer::error(const char *expected) {
+  if (m_stopped)
+    return 1;
+  if (m_token_id == EOF_TK)
+    m_gc_ptr->report("Error at line %d: EOF is not allowed here. %s\n", m_lex->line(), expected);
+  else
+    m_gc_ptr->report("Error at line %d: %.*s is not allowed here. %s\n", m_lex->line(),
+	    (int)m_token.size(), m_token.data(), expected);
+  return 1;
+}
+
+/**
+ * @name stop - Stop the analysis at the request of the handler.
+ *
+ * @return Always 1.
+ */
+int32_t SyntaxAnalyzer::stop() {
+  m_stopped = true;
+  return 1;
+}
+
+/**
+ * @name value - Store the current token into a data object.
+ * @param data: The data object.
+ *
+ * Strings are stored without their quotes. Numbers are converted here.
+ *
+ * @return 0 on success, 1 if the token is not a value or it is a number
+ *         that is out of range.
+ */
+int32_t SyntaxAnalyzer::value(Data &data) {
+  if (m_token_id == INTEGER_TK)
+    return data.set_data(m_token, Data::int_t);
+  else if (m_token_id == STRING_TK)
+    return data.set_data(m_token.substr(1, m_token.size() - 2), Data::string_t);
+  else if (m_token_id == DOUBLE_TK)
+    return data.set_data(m_token, Data::double_t);
+  else
+    return 1;
+}
+
+/**
+ * @name keep_id - Keep the ID in the current token.
+ *
+ * The ID is passed to the handler after more tokens are read. A token of
+ * an input in memory points into the input, which stays until the end of
+ * the parse, so it is kept as it is. A token read through stdio is
+ * overwritten by the next one, so it is copied into a buffer that is
+ * reused for every ID: an ID is always passed to the handler before the
+ * next ID is read.
+ *
+ * @return The ID.
+ */
+string_view SyntaxAnalyzer::keep_id() {
+  if (m_lex->buffer().data())
+    return m_token;
+  m_id.assign(m_token.data(), m_token.size());
+  return m_id;
+}
+
+int32_t SyntaxAnalyzer::begin() {
   int32_t result = 0;
 
-  m_token_id = m_lex->analyze(m_token_str);
+  m_token_id = m_lex->analyze(m_token);
   while (m_token_id == ID_TK && !result) {
-    result = key_or_entity(conf_ptr, m_token_str, 0);
-    m_token_id = m_lex->analyze(m_token_str);
+    result = key_or_entity(keep_id(), 0);
+    m_token_id = m_lex->analyze(m_token);
   }
   if (!result && m_token_id == EOF_TK) {
     return 0;
   } else {
-    fprintf(stderr, "Error at line %d: %s is not allowed here. Entity or key definition was expected.\n",
-	    m_lex->line(), m_token_str.c_str());
-    return 1;
+    return error("Entity or key definition was expected.");
   }
 }
 
-int32_t SyntaxAnalyzer::key_or_entity(Configuration *conf_ptr, const string id, int32_t depth) {
+int32_t SyntaxAnalyzer::key_or_entity(const string_view id, int32_t depth) {
   int32_t result;
-  m_token_id = m_lex->analyze(m_token_str);
+  m_token_id = m_lex->analyze(m_token);
   if (m_token_id == COLON_TK)
-    result = entity(conf_ptr, id, depth);
+    result = entity(id, depth);
   else if (m_token_id == ASSIGN_TK)
-    result = key(conf_ptr, id);
-  else {
-    fprintf(stderr, "Error at line %d: %s is not allowed here. : or = was expected.\n",
-	    m_lex->line(), m_token_str.c_str());
-    return 1;
-  }
+    result = key(id);
+  else
+    return error(": or = was expected.");
+
   // After the key or entity we should find a question mark.
-  m_token_id = m_lex->analyze(m_token_str);
-  if (m_token_id != QMARK_TK) {
-    fprintf(stderr, "Error at line %d: %s is not allowed here. ; was expected.\n",
-	    m_lex->line(), m_token_str.c_str());
-    return 1;
-  }
+  m_token_id = m_lex->analyze(m_token);
+  if (m_token_id != QMARK_TK)
+    return error("; was expected.");
   return result;
 }
 
-int32_t SyntaxAnalyzer::entity(Configuration *conf_ptr, const string id, int32_t depth) {
-  int32_t result = 0;
-  Entity *my_entity;
-  
+int32_t SyntaxAnalyzer::entity(const string_view id, int32_t depth) {
   depth++;
-  m_token_id = m_lex->analyze(m_token_str);
-  if (m_token_id == LBRACKETS3_TK) {
-    // We must find an ID here. We expect a nested entity or a key.
-    m_token_id = m_lex->analyze(m_token_str);
-    if (m_token_id == ID_TK) {
-      // Proccess the new entity.
-      my_entity = new Entity;
-      my_entity->set_id(id);
-      m_gc_ptr->set_current_entity(my_entity);
-    } else {
-      fprintf(stderr, "Error at line %d: %s is not allowed here. Entity or key definition was expected.\n",
-	      m_lex->line(), m_token_str.c_str());
-      return 1;
-    }
-    while (m_token_id == ID_TK && !result) {
-      result = key_or_entity(conf_ptr, m_token_str, depth);
-
-      if (!result) {
-	// If m_current_entity does not match my_entity then a nested entity was found.
-	// We should add this to the entity list of my_entity and assign m_current_entity
-	// to my_entity.
-	if (m_gc_ptr->current_entity() != my_entity) {
-	  my_entity->add_entity(m_gc_ptr->current_entity()); 
-	  m_gc_ptr->set_current_entity(my_entity);
-	}
-      } else {
-	// Something strange happened. We must clean the pending entities and
-	// return an error.
-	if (m_gc_ptr->current_entity())
-	  if (m_gc_ptr->current_entity() != my_entity)
-	    delete m_gc_ptr->current_entity();
-
-	m_gc_ptr->set_current_entity(NULL);
-	if (my_entity)
-	  delete my_entity;
-	my_entity = NULL;
-	return 1;
-      }
-      m_token_id = m_lex->analyze(m_token_str);
-    }
+  if (ParseStats *stats = m_gc_ptr->stats())
+    stats->max_depth = std::max(stats->max_depth, (uint32_t)depth);
+  m_token_id = m_lex->analyze(m_token);
+  if (m_token_id != LBRACKETS3_TK)
+    return error("{ was expected.");
 
-    // We should find a } here.
-    if (m_token_id == RBRACKETS3_TK) {
-      // If this is a depth 1 entity we must put it into the configuration.
-      if (depth == 1) {
-	conf_ptr->add_entity(my_entity);
-	m_gc_ptr->set_current_entity(NULL);
-      }
-      return result;
-    } else {
-      m_gc_ptr->set_current_entity(NULL);
-      if (my_entity)
-	delete my_entity;
-      my_entity = NULL;
-      fprintf(stderr, "Error at line %d: %s is not allowed here. } was expected.\n",
-	      m_lex->line(), m_token_str.c_str());
+  // We must find an ID here. We expect a nested entity or a key.
+  m_token_id = m_lex->analyze(m_token);
+  if (m_token_id != ID_TK)
+    return error("Entity or key definition was expected.");
+  if (m_handler->begin_entity(id))
+    return stop();
+  while (m_token_id == ID_TK) {
+    if (key_or_entity(keep_id(), depth))
       return 1;
-    }
-  } else {
-    fprintf(stderr, "Error at line %d: %s is not allowed here. { was expected.\n",
-	    m_lex->line(), m_token_str.c_str());
-    // We can safely return an error. No entity was created.
-    return 1;
+    m_token_id = m_lex->analyze(m_token);
   }
-}
 
-int32_t SyntaxAnalyzer::key(Configuration *conf_ptr, const string id) {
-  int32_t result = 0;
+  // We should find a } here.
+  if (m_token_id != RBRACKETS3_TK)
+    return error("} was expected.");
+  return m_handler->end_entity() ? stop() : 0;
+}
 
-  m_token_id = m_lex->analyze(m_token_str);
-  if (m_token_id == INTEGER_TK || m_token_id == STRING_TK || m_token_id == DOUBLE_TK) {
+int32_t SyntaxAnalyzer::key(const string_view id) {
+  Data data(Data::allocator_type(m_handler->resource()));
+  m_token_id = m_lex->analyze(m_token);
+  if (!value(data)) {
     // Key with a single value.
-    // Add it to the configuration.
-    KValue *kv = new KValue;
-    kv->set_id(id);
-    // Set Value.
-    Data data;
-    if (m_token_id == INTEGER_TK) {
-      data.set_data(m_token_str, Data::int_t);
-    } else if (m_token_id == STRING_TK) {
-      std::string tmp_str = m_token_str.substr(1, m_token_str.size() - 2);
-      data.set_data(tmp_str, Data::string_t);
-    } else {	
-      data.set_data(m_token_str, Data::double_t);
-    }
-    kv->set_value(data);
-    if (m_gc_ptr->current_entity())
-      m_gc_ptr->current_entity()->add_key(kv);
-    else
-      conf_ptr->add_key(kv);
-    return 0;
+    return m_handler->key_value(id, data) ? stop() : 0;
   } else if (m_token_id == LBRACKETS1_TK) {
     // Key with array of values.
-    result = key_array(conf_ptr, id);
-    return result;
+    return key_array(id);
   } else if (m_token_id == LBRACKETS4_TK) {
     // Key with list of values.
-    KList *klist = NULL;
-    result = key_list(conf_ptr, id, &klist, 0);
-    return result;
+    return key_list(id);
   } else if (m_token_id == LBRACKETS3_TK) {
     // Key with list of pairs.
-    result = key_pairs(conf_ptr, id);
-    return result;
+    return key_pairs(id);
   } else {
-    fprintf(stderr, "Error at line %d: %s is not allowed here. Either a value, [, <, or { was expected.\n",
-	    m_lex->line(), m_token_str.c_str());
-    return 1;
+    return error("Either a value, [, <, or { was expected.");
   }
 }
 
-int32_t SyntaxAnalyzer::key_array(Configuration *conf_ptr, const string id) {
-  int32_t index = 0;
-  KArray *ka = new KArray;
-  ka->set_id(id);
-  
+int32_t SyntaxAnalyzer::key_array(const string_view id) {
+  if (m_handler->begin_array(id))
+    return stop();
   do {
-    m_token_id = m_lex->analyze(m_token_str); 
+    m_token_id = m_lex->analyze(m_token); 
     
     // This should be a value.
-    if (m_token_id == INTEGER_TK || m_token_id == STRING_TK || m_token_id == DOUBLE_TK) {
-      // Add this value to the array.
-      Data data;
-      if (m_token_id == INTEGER_TK) {
-	data.set_data(m_token_str, Data::int_t);
-      } else if (m_token_id == STRING_TK) {
-	std::string tmp_str = m_token_str.substr(1, m_token_str.size() - 2);
-	data.set_data(tmp_str, Data::string_t);
-      } else {	
-	data.set_data(m_token_str, Data::double_t);
-      }
-      (*ka)[index] = data;
-    } else {
-      fprintf(stderr, "Error at line %d: %s is not allowed here. A value was expected.\n",
-	      m_lex->line(), m_token_str.c_str());
-      return 1;
-    }
-    m_token_id = m_lex->analyze(m_token_str);
-    index++;
+    Data data(Data::allocator_type(m_handler->resource()));
+    if (value(data))
+      return error("A value was expected.");
+    if (m_handler->array_item(data))
+      return stop();
+    m_token_id = m_lex->analyze(m_token);
   } while (m_token_id == COMMA_TK);
   
   // The token should now be a ].
-  if (m_token_id == RBRACKETS1_TK) { 
-    if (m_gc_ptr->current_entity())
-      m_gc_ptr->current_entity()->add_key(ka);
-    else
-      conf_ptr->add_key(ka);
-    return 0;
-  } else { 
-    // Delete the array object.
-    delete ka;
-    fprintf(stderr, "Error at line %d: %s is not allowed here. ] was expected.\n",
-	    m_lex->line(), m_token_str.c_str());
-    return 1;
-  }
+  if (m_token_id != RBRACKETS1_TK)
+    return error("] was expected.");
+  return m_handler->end_array() ? stop() : 0;
 }
 
-int32_t SyntaxAnalyzer::key_list(Configuration *conf_ptr, const string id, KList **klist, int32_t depth) {
-  int32_t result = 0;
+int32_t SyntaxAnalyzer::key_list(const string_view id) {
+  if (m_handler->begin_list(id))
+    return stop();
+  if (list_items())
+    return 1;
+  return m_handler->end_list() ? stop() : 0;
+}
 
-  depth++;
-  
-  if (!(*klist))
-    *klist = new KList;
-  (*klist)->set_id(id);
-  
+int32_t SyntaxAnalyzer::list_items() {
   do {
-    m_token_id = m_lex->analyze(m_token_str);
+    m_token_id = m_lex->analyze(m_token);
     
     // This should be a value or a < for a sublist.
-    if (m_token_id == INTEGER_TK || m_token_id == STRING_TK || m_token_id == DOUBLE_TK) {
-      // add this to the list.
-      Data data;
-      if (m_token_id == INTEGER_TK) {
-	data.set_data(m_token_str, Data::int_t);
-      } else if (m_token_id == STRING_TK) {
-	std::string tmp_str = m_token_str.substr(1, m_token_str.size() - 2);
-	data.set_data(tmp_str, Data::string_t);
-      } else {	
-	data.set_data(m_token_str, Data::double_t);
-      }
-      (*klist)->insert_data(data);
+    Data data(Data::allocator_type(m_handler->resource()));
+    if (!value(data)) {
+      if (m_handler->list_item(data))
+	return stop();
     } else if (m_token_id == LBRACKETS4_TK) {
-      KList *klist_nested = NULL;
-      result = key_list(conf_ptr, id, &klist_nested, depth);
-      if (!result) {
-	// Add the sub list object.
-	if (klist_nested) {
-	  (*klist)->insert_klist(*klist_nested);
-	  // Delete the sublist object. We do not needed any more.
-	  delete klist_nested;
-	}
-      } else {
-	if (klist_nested)
-	  delete klist_nested;
-	if (*klist)
-	  delete *klist;
-	*klist = klist_nested = NULL;
+      if (m_handler->begin_sublist())
+	return stop();
+      if (list_items())
 	return 1;
-      }
+      if (m_handler->end_sublist())
+	return stop();
     } else {
-      fprintf(stderr, "Error at line %d: %s is not allowed here. A value or a < was expected.\n",
-	      m_lex->line(), m_token_str.c_str());
-      if (*klist)
-	delete (*klist);
-      *klist = NULL;
-      return 1;
+      return error("A value or a < was expected.");
     }
-    m_token_id = m_lex->analyze(m_token_str);    
+    m_token_id = m_lex->analyze(m_token);    
   } while(m_token_id == COMMA_TK);
 
   // The token should now be a >.
-  if (m_token_id == RBRACKETS4_TK) {
-    // If this is the top list add the klist object to the configuration.
-    if (depth == 1)
-      conf_ptr->add_key(*klist);
-    return 0;
-  } else {      
-    // Delete the list object.
-    if (*klist)
-      delete *klist;
-    *klist = NULL;
-    fprintf(stderr, "Error at line %d: %s is not allowed here. > was expected.\n",
-	    m_lex->line(), m_token_str.c_str());
-    return 1;
-  }
+  if (m_token_id != RBRACKETS4_TK)
+    return error("> was expected.");
+  return 0;
 }
 
-int32_t SyntaxAnalyzer::key_pairs(Configuration *conf_ptr, const string id) {
-  KPairs *kp_ptr = new KPairs;
-  kp_ptr->set_id(id);
-
+int32_t SyntaxAnalyzer::key_pairs(const string_view id) {
+  if (m_handler->begin_pairs(id))
+    return stop();
   do {
-    string pair_id;
-    
     // This should be an ID.
-    m_token_id = m_lex->analyze(m_token_str);
-    if (m_token_id == ID_TK) {
-      pair_id = m_token_id;
-      m_token_id = m_lex->analyze(m_token_str);
-      // This should be the =.
-      if (m_token_id == ASSIGN_TK) {
-	m_token_id = m_lex->analyze(m_token_str);
-	//this should be a value.
-	if (m_token_id == INTEGER_TK || m_token_id == STRING_TK || m_token_id == DOUBLE_TK) {
-	  // Put this pair to the key.
-	  Data data;
-	  if (m_token_id == INTEGER_TK) {
-	    data.set_data(m_token_str, Data::int_t);
-	  } else if (m_token_id == STRING_TK) {
-	    std::string tmp_str = m_token_str.substr(1, m_token_str.size() - 2);
-	    data.set_data(tmp_str, Data::string_t);
-	  } else {	
-	    data.set_data(m_token_str, Data::double_t);
-	  }
-	} else {
-	  fprintf(stderr, "Error at line %d: %s is not allowed here. A value was expected.\n",
-		  m_lex->line(), m_token_str.c_str());
-	  return 1;
-	}
-      } else {
-	fprintf(stderr, "Error at line %d: %s is not allowed here. =  was expected.\n",
-	      m_lex->line(), m_token_str.c_str());
-	return 1;
-      }
-    } else {
-      fprintf(stderr, "Error at line %d: %s is not allowed here. Am ID was expected.\n",
-	      m_lex->line(), m_token_str.c_str());
-      return 1;
-    }
-    m_token_id = m_lex->analyze(m_token_str);
+    m_token_id = m_lex->analyze(m_token);
+    if (m_token_id != ID_TK)
+      return error("Am ID was expected.");
+    string_view pair_id = keep_id();
+    m_token_id = m_lex->analyze(m_token);
+    // This should be the =.
+    if (m_token_id != ASSIGN_TK)
+      return error("=  was expected.");
+    m_token_id = m_lex->analyze(m_token);
+    //this should be a value.
+    Data data(Data::allocator_type(m_handler->resource()));
+    if (value(data))
+      return error("A value was expected.");
+    if (m_handler->pair(pair_id, data))
+      return stop();
+    m_token_id = m_lex->analyze(m_token);
   } while (m_token_id == QMARK_TK);
 
   // The token should now be a }.
-  if (m_token_id == RBRACKETS3_TK) {
-    conf_ptr->add_key(kp_ptr);
-    return 0;
-  } else {
-    // Delete the pairs object.
-    delete kp_ptr;
-    kp_ptr = NULL;
-    fprintf(stderr, "Error at line %d: %s is not allowed here. } was expected.\n",
-	    m_lex->line(), m_token_str.c_str());
-    
-    return 1;
-  }
+  if (m_token_id != RBRACKETS3_TK)
+    return error("} was expected.");
+  return m_handler->end_pairs() ? stop() : 0;
 }
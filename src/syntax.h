@@ -17,43 +17,148 @@
 
 #include <stdio.h>
 #include <string>
+#include <string_view>
+#include <vector>
 #include "configuration.h"
 #include "global.h"
 #include "lex.h"
 
+/**
+ * @name ParseHandler - The receiver of the parse events.
+ *
+ * The syntax analyzer reports what it recognizes as a stream of events in
+ * the order of the text, without building anything itself. An entity is
+ * reported by begin_entity() once its { and its first member are seen, and
+ * by end_entity() at its }. A key with a single value is a key_value()
+ * event. Arrays, lists and pairs are reported by a begin event with the ID
+ * of the key, an event per element and an end event; the sub-lists of a
+ * list are enclosed in begin_sublist() and end_sublist(). End events are
+ * sent only for well-formed keys and entities.
+ *
+ * The IDs are valid during the call only. The data may be moved by the
+ * handler; its strings are allocated from resource(). Every event returns
+ * 0 to continue, or 1 to stop the analysis, which then fails without a
+ * syntax error. If the analysis fails, abort() is called once, so the
+ * handler can drop what it holds for the unfinished keys and entities.
+ *
+ * Every event does nothing by default.
+ */
+class ParseHandler {
+ public:
+  virtual ~ParseHandler() {}
+
+  virtual std::pmr::memory_resource *resource() { return std::pmr::get_default_resource(); }
+
+  virtual int32_t begin_entity(const std::string_view) { return 0; }
+  virtual int32_t end_entity() { return 0; }
+  virtual int32_t key_value(const std::string_view, Data &) { return 0; }
+  virtual int32_t begin_array(const std::string_view) { return 0; }
+  virtual int32_t array_item(Data &) { return 0; }
+  virtual int32_t end_array() { return 0; }
+  virtual int32_t begin_list(const std::string_view) { return 0; }
+  virtual int32_t begin_sublist() { return 0; }
+  virtual int32_t list_item(Data &) { return 0; }
+  virtual int32_t end_sublist() { return 0; }
+  virtual int32_t end_list() { return 0; }
+  virtual int32_t begin_pairs(const std::string_view) { return 0; }
+  virtual int32_t pair(const std::string_view, Data &) { return 0; }
+  virtual int32_t end_pairs() { return 0; }
+  virtual void abort() {}
+};
+
+/**
+ * @name TreeBuilder - The handler that builds a configuration.
+ *
+ * This handler turns the parse events into entities and keys of a
+ * configuration. The entities that are still open are kept on a stack and
+ * every entity or key is added to its scope when it ends. An entity or a
+ * key whose ID is already defined in the same scope is dropped, so the
+ * first definition wins.
+ */
+class TreeBuilder : public ParseHandler {
+ private:
+  GlobalContext *m_gc_ptr;
+  Configuration *m_conf;
+  std::vector<Entity *> m_entities;
+  Key *m_key;
+  KListBuilder m_lists;
+
+ public:
+  explicit TreeBuilder(GlobalContext *gc);
+  ~TreeBuilder();
+
+  void set_configuration(Configuration *conf_ptr);
+
+  std::pmr::memory_resource *resource() override;
+  int32_t begin_entity(const std::string_view id) override;
+  int32_t end_entity() override;
+  int32_t key_value(const std::string_view id, Data &value) override;
+  int32_t begin_array(const std::string_view id) override;
+  int32_t array_item(Data &value) override;
+  int32_t end_array() override;
+  int32_t begin_list(const std::string_view id) override;
+  int32_t begin_sublist() override;
+  int32_t list_item(Data &value) override;
+  int32_t end_sublist() override;
+  int32_t end_list() override;
+  int32_t begin_pairs(const std::string_view id) override;
+  int32_t pair(const std::string_view id, Data &value) override;
+  int32_t end_pairs() override;
+  void abort() override;
+
+ private:
+  void add_key(Key *key);
+  void add_entity(Entity *entity);
+};
+
 /**
  * @name SyntaxAnalyzer - The syntax analyzer object.
  *
  * This class defines the syntax analyzer object. It is used to parse and
- * syntactically analyze configuration files. It builds a configuration object
- * that contains all the entities and keys that exist  in the configuration
- * file.
+ * syntactically analyze configuration files. The grammar rules send their
+ * events to a handler; analyze(conf_ptr) uses a TreeBuilder to build a
+ * configuration object that contains all the entities and keys that exist
+ * in the configuration file. Besides the handler, the analysis only holds
+ * the current token and one ID per open entity, so its memory does not
+ * grow with the size of the input.
  * You should first call the "open()" method to load a configuration file and
- * then the "analyze()" method to analyze it and build the configuration.
+ * then the "analyze()" method to analyze it.
  */
 class SyntaxAnalyzer {  
  private:
   LexAnalyzer *m_lex;
   GlobalContext *m_gc_ptr;
   int32_t m_token_id;
-  std::string m_token_str;
+  std::string_view m_token;
+  std::string m_id;   // The current ID, when the tokens do not outlive it.
+  ParseHandler *m_handler;
+  bool m_stopped;
+  TreeBuilder m_builder;
     
  public:
   SyntaxAnalyzer(GlobalContext *gc);
   ~SyntaxAnalyzer();
-  int32_t open(const std::string filename);
+  int32_t open(const std::string filename,
+	       const LexAnalyzer::Input input = LexAnalyzer::auto_in);
+  int32_t open_buffer(const char *data, const size_t len, const uint32_t line = 1);
   int32_t close();
   int32_t analyze(Configuration *conf_ptr);
+  int32_t analyze(ParseHandler *handler);
   
  private:
-  int32_t begin(Configuration *conf_ptr);
-  int32_t key_or_entity(Configuration *conf_ptr, const std::string id, int32_t depth);
-  int32_t entity(Configuration *conf_ptr, const std::string id, int32_t depth);
-  int32_t key(Configuration *conf_ptr, const std::string id);
-  int32_t key_array(Configuration *conf_ptr, const std::string id);
-  int32_t key_list(Configuration *conf_ptr, const std::string id, KList **klist, int32_t depth);
-  int32_t key_pairs(Configuration *conf_ptr, const std::string id);  
+  int32_t error(const char *expected);
+  int32_t stop();
+  int32_t value(Data &data);
+
+  std::string_view keep_id();
+  int32_t begin();
+  int32_t key_or_entity(const std::string_view id, int32_t depth);
+  int32_t entity(const std::string_view id, int32_t depth);
+  int32_t key(const std::string_view id);
+  int32_t key_array(const std::string_view id);
+  int32_t key_list(const std::string_view id);
+  int32_t list_items();
+  int32_t key_pairs(const std::string_view id);
 };
 
 #endif
-
@@ -0,0 +1,334 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Confslice - A simple configuration file parser.
+ *
+ * Copyright (C) 2014 Giorgos Kappes <geokapp@gmail.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file LICENSE.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include "configuration.h"
+#include "trace.h"
+
+using namespace std;
+
+// The first table of a thread, in slots.
+#define TRACE_TABLE 256
+
+std::atomic<AccessTrace *> AccessTrace::s_active(NULL);
+std::atomic<uint64_t> AccessTrace::s_epoch(0);
+thread_local AccessTrace::Local AccessTrace::t_local = {0, NULL};
+
+static uint64_t monotonic_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+AccessTrace::Table *AccessTrace::new_table(const size_t size) {
+  Table *table = new Table;
+  table->mask = size - 1;
+  table->used = 0;
+  table->slots = new Slot[size];
+  for (size_t i = 0; i < size; i++) {
+    table->slots[i].key.store(NULL, std::memory_order_relaxed);
+    table->slots[i].reads.store(0, std::memory_order_relaxed);
+  }
+  return table;
+}
+
+/*
+ * Places a key in a table whose owner is the calling thread. The count is
+ * stored before the key is published, so report() never sees a key with
+ * the count of another.
+ */
+void AccessTrace::place(Table *table, const Key *key, const uint64_t reads) {
+  uint64_t h = (uint64_t)(uintptr_t)key * 0x9e3779b97f4a7c15ULL;
+  size_t i = (h ^ (h >> 32)) & table->mask;
+  while (table->slots[i].key.load(std::memory_order_relaxed))
+    i = (i + 1) & table->mask;
+  table->slots[i].reads.store(reads, std::memory_order_relaxed);
+  table->slots[i].key.store(key, std::memory_order_release);
+  table->used++;
+}
+
+/**
+ * @name insert - Count the first read of a key by the thread.
+ *
+ * The table is replaced by one twice as large when it is half full. The
+ * old one is kept until the trace is destroyed, since report() may still
+ * be reading it.
+ *
+ * @return Void.
+ */
+void AccessTrace::Buffer::insert(const Key *key) {
+  Table *t = table.load(std::memory_order_relaxed);
+  if ((t->used + 1) * 2 > t->mask + 1) {
+    Table *bigger = new_table((t->mask + 1) * 2);
+    for (size_t i = 0; i <= t->mask; i++) {
+      const Key *k = t->slots[i].key.load(std::memory_order_relaxed);
+      if (k)
+	place(bigger, k, t->slots[i].reads.load(std::memory_order_relaxed));
+    }
+    tables.push_back(bigger);
+    table.store(bigger, std::memory_order_release);
+    t = bigger;
+  }
+  place(t, key, 1);
+}
+
+/**
+ * @name AccessTrace - Constructor.
+ * @param sample: Time one lookup in sample. 0 disables the timing.
+ */
+AccessTrace::AccessTrace(const uint32_t sample) {
+  m_epoch = s_epoch.fetch_add(1, std::memory_order_relaxed) + 1;
+  m_sample = sample;
+  m_start_ticks = stats_ticks();
+  m_start_ns = monotonic_ns();
+}
+
+/**
+ * @name ~AccessTrace - Destructor.
+ *
+ * Stops the trace and frees the buffers of the threads.
+ */
+AccessTrace::~AccessTrace() {
+  stop();
+  for (Buffer *buffer : m_buffers) {
+    for (Table *table : buffer->tables) {
+      delete[] table->slots;
+      delete table;
+    }
+    delete buffer;
+  }
+}
+
+/**
+ * @name start - Start tracing.
+ *
+ * The counters of an earlier run of the same trace are kept.
+ *
+ * @return 0 on success, 1 if another trace is active.
+ */
+int32_t AccessTrace::start() {
+  AccessTrace *expected = NULL;
+  if (s_active.load(std::memory_order_relaxed) == this)
+    return 0;
+  return s_active.compare_exchange_strong(expected, this, std::memory_order_acq_rel) ? 0 : 1;
+}
+
+/**
+ * @name stop - Stop tracing.
+ *
+ * @return Void.
+ */
+void AccessTrace::stop() {
+  AccessTrace *expected = this;
+  s_active.compare_exchange_strong(expected, NULL, std::memory_order_acq_rel);
+}
+
+/**
+ * @name started - Whether the trace is active.
+ *
+ * @return True if the trace is active.
+ */
+bool AccessTrace::started() const {
+  return s_active.load(std::memory_order_relaxed) == this;
+}
+
+/*
+ * Creates the buffer of the calling thread. This is the only place where
+ * a lookup takes a lock, once per thread.
+ */
+AccessTrace::Buffer *AccessTrace::attach() {
+  Buffer *buffer = new Buffer;
+  Table *table = new_table(TRACE_TABLE);
+  buffer->tables.push_back(table);
+  buffer->table.store(table, std::memory_order_relaxed);
+  for (size_t i = 0; i < lookups; i++) {
+    buffer->lookups[i].store(0, std::memory_order_relaxed);
+    buffer->timed[i].store(0, std::memory_order_relaxed);
+    for (size_t j = 0; j < buckets; j++)
+      buffer->histogram[i][j].store(0, std::memory_order_relaxed);
+  }
+  buffer->depth = 0;
+  buffer->sample = m_sample;
+  buffer->countdown = m_sample;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_buffers.push_back(buffer);
+  }
+  t_local.epoch = m_epoch;
+  t_local.buffer = buffer;
+  return buffer;
+}
+
+/**
+ * @name finish - Record the latency of a timed lookup.
+ *
+ * @return Void.
+ */
+void TraceLookup::finish() {
+  uint64_t ticks = stats_ticks() - m_start;
+  size_t bucket = 0;
+  while (bucket < AccessTrace::buckets - 1 && ticks >> (bucket + 1))
+    bucket++;
+  std::atomic<uint64_t> &timed = m_buffer->timed[m_lookup];
+  std::atomic<uint64_t> &count = m_buffer->histogram[m_lookup][bucket];
+  timed.store(timed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+/*
+ * Sorts the keys of a subtree into looked up and not looked up.
+ */
+template <typename T>
+static void collect(const T *node, string &path,
+		    const unordered_map<const Key *, uint64_t> &reads,
+		    AccessTrace::Report &report) {
+  size_t length = path.size();
+  for (const Key *key : node->keys()) {
+    Path::append(path, key->id());
+    auto it = reads.find(key);
+    if (it != reads.end())
+      report.reads.push_back(AccessTrace::Read{path, it->second});
+    else
+      report.not_looked_up.push_back(path);
+    path.resize(length);
+  }
+  for (const Entity *entity : node->entities()) {
+    Path::append(path, entity->id());
+    collect(entity, path, reads, report);
+    path.resize(length);
+  }
+}
+
+/**
+ * @name report - Report the reads of a configuration.
+ * @param conf: The configuration.
+ * @param report: Where the report is stored.
+ *
+ * Adds up the buffers of all the threads, which may keep counting
+ * meanwhile. Reads of keys that are not in the configuration are left
+ * out; the lookups are those of every configuration and entity.
+ *
+ * @return Void.
+ */
+void AccessTrace::report(const Configuration *conf, Report &report) const {
+  unordered_map<const Key *, uint64_t> reads;
+
+  report.clear();
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const Buffer *buffer : m_buffers) {
+      const Table *t = buffer->table.load(std::memory_order_acquire);
+      for (size_t i = 0; i <= t->mask; i++) {
+	const Key *key = t->slots[i].key.load(std::memory_order_acquire);
+	if (key)
+	  reads[key] += t->slots[i].reads.load(std::memory_order_relaxed);
+      }
+      for (size_t i = 0; i < lookups; i++) {
+	report.lookups[i] += buffer->lookups[i].load(std::memory_order_relaxed);
+	report.timed[i] += buffer->timed[i].load(std::memory_order_relaxed);
+	for (size_t j = 0; j < buckets; j++)
+	  report.histogram[i][j] += buffer->histogram[i][j].load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // The buckets are powers of two of the clock, converted to nanoseconds.
+  uint64_t ticks = stats_ticks() - m_start_ticks;
+  double ns_per_tick = ticks ? (double)(monotonic_ns() - m_start_ns) / ticks : 1.0;
+  for (size_t i = 0; i < buckets; i++)
+    report.bucket_ns[i] = (uint64_t)((double)(2ULL << i) * ns_per_tick + 0.5);
+
+  string path;
+  collect(conf, path, reads, report);
+  std::stable_sort(report.reads.begin(), report.reads.end(), [](const Read &a, const Read &b) {
+    return a.reads > b.reads;
+  });
+}
+
+/**
+ * @name Report - Constructor.
+ *
+ * Creates an empty report.
+ */
+AccessTrace::Report::Report() {
+  clear();
+}
+
+/**
+ * @name clear - Empty the report.
+ *
+ * @return Void.
+ */
+void AccessTrace::Report::clear() {
+  reads.clear();
+  not_looked_up.clear();
+  memset(lookups, 0, sizeof(lookups));
+  memset(timed, 0, sizeof(timed));
+  memset(histogram, 0, sizeof(histogram));
+  memset(bucket_ns, 0, sizeof(bucket_ns));
+}
+
+/**
+ * @name str - Format the report.
+ *
+ * Writes a section per part of the report: the lookups of each kind, the
+ * non-empty buckets of each histogram as "<upper bound in ns> <count>",
+ * the keys that were looked up as "<reads> <path>" and the keys that were
+ * not looked up.
+ *
+ * @return The report as text.
+ */
+std::string AccessTrace::Report::str() const {
+  static const char *names[AccessTrace::lookups] = {"key", "entity", "path", "entity_path"};
+  string out;
+  char buf[64];
+
+  out += "# lookups\n";
+  for (size_t i = 0; i < AccessTrace::lookups; i++) {
+    snprintf(buf, sizeof(buf), "%s %llu\n", names[i], (unsigned long long)lookups[i]);
+    out += buf;
+  }
+  out += "# latency\n";
+  for (size_t i = 0; i < AccessTrace::lookups; i++) {
+    if (!timed[i])
+      continue;
+    out += names[i];
+    for (size_t j = 0; j < buckets; j++) {
+      if (!histogram[i][j])
+	continue;
+      snprintf(buf, sizeof(buf), " <%lluns:%llu", (unsigned long long)bucket_ns[j],
+	       (unsigned long long)histogram[i][j]);
+      out += buf;
+    }
+    out += '\n';
+  }
+  out += "# reads\n";
+  for (const Read &read : reads) {
+    snprintf(buf, sizeof(buf), "%llu ", (unsigned long long)read.reads);
+    out += buf;
+    out += read.path;
+    out += '\n';
+  }
+  out += "# not looked up\n";
+  for (const string &path : not_looked_up) {
+    out += path;
+    out += '\n';
+  }
+  return out;
+}
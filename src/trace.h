@@ -0,0 +1,234 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Confslice - A simple configuration file parser.
+ *
+ * Copyright (C) 2014 Giorgos Kappes <geokapp@gmail.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file LICENSE.
+ *
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "stats.h"
+
+class Key;
+class Configuration;
+class TraceLookup;
+
+/**
+ * @name AccessTrace - Trace the reads of a configuration.
+ *
+ * While a trace is started, every key found by find_key(), directly or at
+ * the end of a path, is counted, and the lookups of configurations and
+ * entities are counted and timed by kind. Only the outermost lookup is timed, so a path
+ * lookup is not also counted as the lookups of its segments. A read through
+ * a Handle counts its key as well, but is a lookup only when the handle
+ * resolves its path. Keys that are reached through the keys() views or
+ * through kept pointers are not counted. The report therefore lists the
+ * keys that were not looked up, which may still be read that way, rather
+ * than the keys that are never read.
+ *
+ * Every thread counts into a buffer of its own, without locks or atomic
+ * read-modify-write instructions; report() adds the buffers up while the
+ * threads keep running. With a sample of N, one lookup in N is timed,
+ * since reading the clock costs more than the lookup itself. Without a
+ * started trace, a lookup costs one extra load and branch.
+ *
+ * One trace is active at a time. The keys are counted by address, so the
+ * traced tree should not be modified meanwhile, and the trace must outlive
+ * the lookups that started while it was active.
+ */
+class AccessTrace {
+  friend class TraceLookup;
+
+ public:
+  enum Lookup
+  {
+    key_l,           // find_key() of a configuration or an entity.
+    entity_l,        // find_entity() of a configuration or an entity.
+    path_l,          // find_path(), get() and handles.
+    entity_path_l,   // find_entity_path().
+    lookups
+  };
+
+  static const size_t buckets = 32;
+
+  struct Read {
+    std::string path;
+    uint64_t reads;
+  };
+
+  /**
+   * @name Report - The reads of a configuration.
+   *
+   * The keys that were looked up or read through a handle, the most read
+   * first, the keys that were not, in the order of the tree, and the number of lookups of each kind
+   * with a histogram of the latency of the timed ones. Bucket i holds the
+   * lookups that took less than bucket_ns[i] and at least bucket_ns[i - 1].
+   */
+  struct Report {
+    std::vector<Read> reads;
+    std::vector<std::string> not_looked_up;
+    uint64_t lookups[AccessTrace::lookups];
+    uint64_t timed[AccessTrace::lookups];
+    uint64_t histogram[AccessTrace::lookups][buckets];
+    uint64_t bucket_ns[buckets];
+
+    Report();
+    void clear();
+    std::string str() const;
+  };
+
+ private:
+  struct Slot {
+    std::atomic<const Key *> key;
+    std::atomic<uint64_t> reads;
+  };
+
+  struct Table {
+    size_t mask;
+    size_t used;
+    Slot *slots;
+  };
+
+  // Written by one thread only and read by report().
+  struct Buffer {
+    std::atomic<Table *> table;
+    std::vector<Table *> tables;
+    std::atomic<uint64_t> lookups[AccessTrace::lookups];
+    std::atomic<uint64_t> timed[AccessTrace::lookups];
+    std::atomic<uint64_t> histogram[AccessTrace::lookups][buckets];
+    uint32_t depth;
+    uint32_t sample;
+    uint32_t countdown;
+
+    void read(const Key *key);
+    void insert(const Key *key);
+  };
+
+  struct Local {
+    uint64_t epoch;
+    Buffer *buffer;
+  };
+
+  static std::atomic<AccessTrace *> s_active;
+  static std::atomic<uint64_t> s_epoch;
+  static thread_local Local t_local;
+
+  uint64_t m_epoch;
+  uint32_t m_sample;
+  uint64_t m_start_ticks;
+  uint64_t m_start_ns;
+  mutable std::mutex m_mutex;
+  std::vector<Buffer *> m_buffers;
+
+ public:
+  explicit AccessTrace(const uint32_t sample = 64);
+  ~AccessTrace();
+  AccessTrace(const AccessTrace &) = delete;
+  AccessTrace &operator=(const AccessTrace &) = delete;
+
+  int32_t start();
+  void stop();
+  bool started() const;
+
+  void report(const Configuration *conf, Report &report) const;
+
+  /**
+   * @name read - Count the read of a key.
+   * @param key: The key or NULL.
+   *
+   * @return Void.
+   */
+  static void read(const Key *key) {
+    AccessTrace *trace = s_active.load(std::memory_order_acquire);
+    if (!trace || !key)
+      return;
+    Buffer *buffer = trace->local();
+    if (buffer)
+      buffer->read(key);
+  }
+
+ private:
+  Buffer *local() {
+    if (t_local.epoch == m_epoch)
+      return t_local.buffer;
+    return attach();
+  }
+
+  Buffer *attach();
+  static Table *new_table(const size_t size);
+  static void place(Table *table, const Key *key, const uint64_t reads);
+};
+
+/**
+ * @name read - Count the read of a key in the buffer of the thread.
+ *
+ * The counters have a single writer, so a plain load and store suffice.
+ */
+inline void AccessTrace::Buffer::read(const Key *key) {
+  Table *t = table.load(std::memory_order_relaxed);
+  uint64_t h = (uint64_t)(uintptr_t)key * 0x9e3779b97f4a7c15ULL;
+  for (size_t i = (h ^ (h >> 32)) & t->mask;; i = (i + 1) & t->mask) {
+    const Key *k = t->slots[i].key.load(std::memory_order_relaxed);
+    if (k == key) {
+      std::atomic<uint64_t> &reads = t->slots[i].reads;
+      reads.store(reads.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      return;
+    }
+    if (!k)
+      break;
+  }
+  insert(key);
+}
+
+/**
+ * @name TraceLookup - Count and time a lookup.
+ *
+ * Does nothing unless a trace is started.
+ */
+class TraceLookup {
+ private:
+  AccessTrace::Buffer *m_buffer;
+  AccessTrace::Lookup m_lookup;
+  uint64_t m_start;
+
+ public:
+  explicit TraceLookup(const AccessTrace::Lookup lookup)
+    : m_buffer(NULL), m_lookup(lookup), m_start(0) {
+    AccessTrace *trace = AccessTrace::s_active.load(std::memory_order_acquire);
+    if (!trace || !(m_buffer = trace->local()))
+      return;
+    if (m_buffer->depth++)
+      return;
+    if (m_buffer->sample && !--m_buffer->countdown) {
+      m_buffer->countdown = m_buffer->sample;
+      m_start = stats_ticks();
+    }
+  }
+
+  ~TraceLookup() {
+    if (!m_buffer || --m_buffer->depth)
+      return;
+    std::atomic<uint64_t> &lookups = m_buffer->lookups[m_lookup];
+    lookups.store(lookups.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (m_start)
+      finish();
+  }
+
+ private:
+  void finish();
+};
+
+#endif
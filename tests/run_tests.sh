@@ -0,0 +1,24 @@
+#!/bin/sh
+#
+# Run the unit tests. Each test prints OK and exits with 0 on success.
+# test_1 is run against every example configuration.
+#
+
+cd "$(dirname "$0")/.." || exit 1
+failed=0
+
+for cfg in examples/*.cfg; do
+    printf "test_1 %s: " "$cfg"
+    ./tests/test_1 "$cfg" || failed=1
+done
+
+for test in tests/test_*; do
+    case "$test" in
+	*.cc|*.o|tests/test_1) continue ;;
+    esac
+    [ -x "$test" ] || continue
+    printf "%s: " "$test"
+    "$test" || failed=1
+done
+
+exit $failed
@@ -0,0 +1,670 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <iostream>
+#include <memory_resource>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "../src/confslice.h"
+#include "util.h"
+
+using namespace std;
+
+// Lookups, duplicates and insertion order on an entity with many keys.
+static int32_t check_index() {
+  Entity entity;
+  const int32_t n = 20000;
+  int32_t i;
+
+  for (i = 0; i < n; i++) {
+    KValue *kv = new KValue;
+    kv->set_id("key" + to_string(i));
+    if (entity.add_key(kv)) {
+      cout << "ERROR: add " << i << "\n";
+      return 1;
+    }
+  }
+  KValue dup;
+  dup.set_id("key7");
+  if (!entity.add_key(&dup) || entity.size_of_keys() != n) {
+    cout << "ERROR: duplicate\n";
+    return 1;
+  }
+  for (i = 0; i < n; i++) {
+    Key *key = entity.find_key("key" + to_string(i));
+    if (!key || key->id() != "key" + to_string(i)) {
+      cout << "ERROR: find " << i << "\n";
+      return 1;
+    }
+  }
+  if (entity.find_key("key") || entity.find_key("key20000")) {
+    cout << "ERROR: find missing\n";
+    return 1;
+  }
+  entity.reset_keys();
+  for (i = 0; i < n / 2; i++) {
+    Key *key = entity.get_next_key();
+    if (!key || key->id() != "key" + to_string(i) || entity.find_key(key->id())) {
+      cout << "ERROR: order " << i << "\n";
+      return 1;
+    }
+    delete key;
+  }
+  for (i = n / 2; i < n; i++) {
+    if (!entity.find_key("key" + to_string(i))) {
+      cout << "ERROR: find after remove " << i << "\n";
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// The first definition of an ID in a scope wins.
+static int32_t check_duplicates() {
+  ConfSlice cs;
+  const char text[] =
+    "a = 1; a = 2;\n"
+    "e: { k = 1; k = 2; n: { x = 1; }; n: { x = 2; }; };\n"
+    "e: { k = 3; };\n";
+
+  if (cs.analyze_buffer(text)) {
+    cout << "ERROR: analyze\n";
+    return 1;
+  }
+  Configuration *conf = cs.configuration();
+  Entity *e = conf->find_entity("e");
+  if (conf->size_of_keys() != 1 || conf->size_of_entities() != 1 || !e ||
+      e->size_of_keys() != 1 || e->size_of_entities() != 1) {
+    cout << "ERROR: duplicates\n";
+    return 1;
+  }
+  KValue *k = (KValue *)e->find_key("k");
+  KValue *x = (KValue *)e->find_entity("n")->find_key("x");
+  if (k->value().data<int32_t>() != 1 || x->value().data<int32_t>() != 1) {
+    cout << "ERROR: first definition\n";
+    return 1;
+  }
+  return 0;
+}
+
+// Walks the tree through the views.
+static string walk(const Configuration *conf) {
+  string out;
+
+  for (const Entity *entity : conf->entities()) {
+    out += string(entity->id()) + ":";
+    for (const Key *key : entity->keys())
+      out += key_str(key);
+    out += to_string(entity->entities().size()) + "|";
+  }
+  for (const Key *key : conf->keys())
+    out += string(key->id()) + ";";
+  return out;
+}
+
+// The views neither consume nor change the tree.
+static int32_t check_views() {
+  ConfSlice cs;
+  const char text[] =
+    "e: { v = 5; l = <1, 2, <3>, <4, 5>>; p = { a = 1; b = \"x\" }; n: { x = 1; }; };\n"
+    "f: { w = 2.5; };\n"
+    "top = 1; other = \"s\";\n";
+  const string expected =
+    "e:v=5;l=1,2,<3,><4,5,>;p=a:1,b:x,;1|f:w=2.5;0|top;other;";
+
+  if (cs.analyze_buffer(text)) {
+    cout << "ERROR: analyze\n";
+    return 1;
+  }
+  const Configuration *conf = cs.configuration();
+  for (int32_t i = 0; i < 2; i++) {
+    string out = walk(conf);
+    if (out != expected) {
+      cout << "ERROR: views: " << out << "\n";
+      return 1;
+    }
+  }
+  if (conf->size_of_entities() != 2 || conf->size_of_keys() != 2) {
+    cout << "ERROR: views consumed the tree\n";
+    return 1;
+  }
+  return 0;
+}
+
+// Values are stored in their own type and read back without parsing.
+static int32_t check_data() {
+  ConfSlice cs;
+  const char text[] =
+    "i = -42; p = +7; d = 0.25; s = \"Nick Nick\"; big = 9223372036854775807;\n";
+  int64_t i;
+  double d;
+  string_view sv;
+
+  if (cs.analyze_buffer(text)) {
+    cout << "ERROR: analyze\n";
+    return 1;
+  }
+  Configuration *conf = cs.configuration();
+  const Data &di = ((KValue *)conf->find_key("i"))->value();
+  const Data &dp = ((KValue *)conf->find_key("p"))->value();
+  const Data &dd = ((KValue *)conf->find_key("d"))->value();
+  const Data &ds = ((KValue *)conf->find_key("s"))->value();
+  const Data &db = ((KValue *)conf->find_key("big"))->value();
+  if (di.as_int64(i) || i != -42 || dp.as_int64(i) || i != 7 ||
+      db.as_int64(i) || i != INT64_MAX || dd.as_double(d) || d != 0.25 ||
+      di.as_double(d) || d != -42.0 || ds.as_string_view(sv) || sv != "Nick Nick") {
+    cout << "ERROR: typed read\n";
+    return 1;
+  }
+  if (!dd.as_int64(i) || !ds.as_double(d) || !di.as_string_view(sv)) {
+    cout << "ERROR: type check\n";
+    return 1;
+  }
+  if (di.data<int32_t>() != -42 || dd.data<double>() != 0.25 || dd.data<int32_t>() != 0 ||
+      ds.data<string>() != "Nick Nick" || di.data_str() != "-42" || dd.data_str() != "0.25") {
+    cout << "ERROR: data<T>()\n";
+    return 1;
+  }
+  ConfSlice big;
+  if (big.analyze_buffer("big = 9223372036854775808; small = -9223372036854775808;") ||
+      big.configuration()->get<int64_t>("big", 7) != 7 ||
+      big.configuration()->get<double>("big", 0) != 9223372036854775808.0 ||
+      big.configuration()->get<int64_t>("small", 0) != numeric_limits<int64_t>::min()) {
+    cout << "ERROR: out of range\n";
+    return 1;
+  }
+  return 0;
+}
+
+// Arrays are contiguous, and numeric arrays are unboxed.
+static int32_t check_array() {
+  ConfSlice cs;
+  const char text[] =
+    "ints = [1, -2, 3]; doubles = [0.5, 1.5]; strings = [\"a\", \"b\"]; mixed = [1, 2.5, \"c\"];\n";
+  Span<int64_t> ints;
+  Span<double> doubles;
+  Span<Data> data;
+  int64_t i;
+  double d;
+  string_view sv;
+
+  if (cs.analyze_buffer(text)) {
+    cout << "ERROR: analyze\n";
+    return 1;
+  }
+  Configuration *conf = cs.configuration();
+  KArray *ki = (KArray *)conf->find_key("ints");
+  KArray *kd = (KArray *)conf->find_key("doubles");
+  KArray *ks = (KArray *)conf->find_key("strings");
+  KArray *km = (KArray *)conf->find_key("mixed");
+  if (ki->as_int64_span(ints) || ints.size() != 3 || ints[1] != -2 ||
+      kd->as_double_span(doubles) || doubles.size() != 2 || doubles[1] != 1.5 ||
+      km->as_data_span(data) || data.size() != 3 || !ki->as_double_span(doubles) ||
+      !km->as_int64_span(ints)) {
+    cout << "ERROR: spans\n";
+    return 1;
+  }
+  if (ki->data_type() != Data::int_t || kd->data_type() != Data::double_t ||
+      ks->data_type() != Data::string_t || km->data_type() != Data::none_t) {
+    cout << "ERROR: data_type\n";
+    return 1;
+  }
+  if (ki->at(2, i) || i != 3 || ki->at(0, d) || d != 1.0 || !ki->at(3, i) || !ki->at(-1, i) ||
+      km->at(1, d) || d != 2.5 || km->at(2, sv) || sv != "c" || !km->at(2, i) ||
+      ks->at(1, sv) || sv != "b") {
+    cout << "ERROR: at\n";
+    return 1;
+  }
+  // Elements are returned as values that can be moved from.
+  static_assert(is_same_v<decltype((*ki)[0]), Data>);
+  const KArray *cki = ki;
+  Data moved = (*km)[2];
+  if ((*cki)[1].data_str() != "-2" || moved.data_str() != "c" || (*ki)[3].type() != Data::none_t ||
+      (*ki)[-1].type() != Data::none_t || (*km)[2].data_str() != "c" || ki->size() != 3 ||
+      ki->as_int64_span(ints)) {
+    cout << "ERROR: operator[]\n";
+    return 1;
+  }
+  Data five, half;
+  five.set_int64(5);
+  half.set_double(0.5);
+  if (ki->set_data(2, five) || !ki->set_data(3, five) || !ki->set_data(-1, five) ||
+      ki->as_int64_span(ints) || ints[2] != 5 || ki->set_data(0, half) ||
+      !ki->as_int64_span(ints) || ki->size() != 3 || ki->at(0, d) || d != 0.5 ||
+      ki->at(2, i) || i != 5 || ki->data_type() != Data::none_t) {
+    cout << "ERROR: set_data\n";
+    return 1;
+  }
+  return 0;
+}
+
+// Nested lists are flattened, and the old list API still works on them.
+static int32_t check_list() {
+  ConfSlice cs;
+  const char text[] = "l = <1, <2, <3, 4>, 5>, 6, <7>, 8>; bad = <1, <2, 3>;\n";
+
+  if (!cs.analyze_buffer(text)) {
+    cout << "ERROR: unbalanced list\n";
+    return 1;
+  }
+  KList *l = (KList *)cs.configuration()->find_key("l");
+  if (!l || list_str(*l) != "1,6,8,<2,5,<3,4,>><7,>" || l->size_of_data() != 3 ||
+      l->size_of_klist() != 2) {
+    cout << "ERROR: nested list\n";
+    return 1;
+  }
+
+  KList copy(l);
+  copy.insert_data(*l->data().begin());
+  copy.insert_klist(*l);
+  copy.insert_data(Data(*l->data().begin()));
+  if (list_str(copy) != "1,6,8,1,1,<2,5,<3,4,>><7,><1,6,8,<2,5,<3,4,>><7,>>") {
+    cout << "ERROR: insert: " << list_str(copy) << "\n";
+    return 1;
+  }
+
+  Data *data = l->get_next_data();
+  KList *sub = l->get_next_klist();
+  if (!data || data->data<int32_t>() != 1 || !sub || list_str(*sub) != "2,5,<3,4,>" ||
+      list_str(*l) != "6,8,<7,>") {
+    cout << "ERROR: get_next\n";
+    return 1;
+  }
+  delete data;
+  delete sub;
+  return 0;
+}
+
+// Keys and entities are found by their dotted paths.
+static int32_t check_path() {
+  ConfSlice cs;
+  const char text[] =
+    "data_server: { disk.1: { journal_size = 10000; ratio = 0.5; dev = \"sdb\"; }; port = 70000; };\n"
+    "top = -1; l = <1>;\n";
+
+  if (cs.analyze_buffer(text)) {
+    cout << "ERROR: analyze\n";
+    return 1;
+  }
+  const Configuration *conf = cs.configuration();
+  Path journal("data_server.\"disk.1\".journal_size");
+  if (journal.size() != 3 || journal.id(1) != "disk.1" ||
+      conf->get<int64_t>("data_server.\"disk.1\".journal_size", 0) != 10000 ||
+      conf->get<int32_t>(journal, 0) != 10000 ||
+      conf->get<double>("data_server.\"disk.1\".ratio", 0.0) != 0.5 ||
+      conf->get<string_view>("data_server.\"disk.1\".dev", "") != "sdb" ||
+      conf->get<string>(Path("data_server.\"disk.1\".dev"), "") != "sdb" ||
+      conf->get<int64_t>("top", 0) != -1 || conf->get<double>("top", 0.0) != -1.0) {
+    cout << "ERROR: get\n";
+    return 1;
+  }
+  // Missing keys, type mismatches, values out of range and bad paths.
+  if (conf->get<int64_t>("data_server.disk.1.journal_size", 7) != 7 ||
+      conf->get<int64_t>("data_server.\"disk.1\".ratio", 7) != 7 ||
+      conf->get<int64_t>("data_server.\"disk.1\".dev", 7) != 7 ||
+      conf->get<int16_t>("data_server.port", 7) != 7 ||
+      conf->get<uint32_t>("top", 7) != 7 || conf->get<int64_t>("l", 7) != 7 ||
+      conf->get<int64_t>("data_server", 7) != 7 || conf->get<int64_t>("", 7) != 7 ||
+      conf->get<int64_t>("data_server.", 7) != 7 || conf->get<int64_t>(".top", 7) != 7 ||
+      conf->get<int64_t>("\"top", 7) != 7 || conf->get<int64_t>(Path("a..b"), 7) != 7) {
+    cout << "ERROR: get fallback\n";
+    return 1;
+  }
+  const Entity *disk = conf->find_entity("data_server")->find_entity("disk.1");
+  if (conf->find_entity_path("data_server.\"disk.1\"") != disk ||
+      conf->find_entity_path(Path("data_server.\"disk.1\"")) != disk ||
+      conf->find_path("data_server.\"disk.1\".dev") != disk->find_key("dev") ||
+      conf->find_entity_path("data_server.disk") || Path("a.\"b").size()) {
+    cout << "ERROR: find path\n";
+    return 1;
+  }
+  // Appended segments are quoted where they contain dots.
+  string built;
+  Path::append(built, "data_server");
+  Path::append(built, "disk.1");
+  Path::append(built, "dev");
+  if (built != "data_server.\"disk.1\".dev" || conf->find_path(built) != disk->find_key("dev")) {
+    cout << "ERROR: append path\n";
+    return 1;
+  }
+  return 0;
+}
+
+// Handles cache their key until a removal advances the generation.
+static int32_t check_handle() {
+  ConfSlice cs;
+  const char text[] = "server: { port = 7000; name = \"blade\"; }; top = 1;\n";
+
+  if (cs.analyze_buffer(text)) {
+    cout << "ERROR: analyze\n";
+    return 1;
+  }
+  Configuration *conf = cs.configuration();
+  Handle port = conf->handle("server.port");
+  Handle name = conf->handle("server.name");
+  Handle late = conf->handle("late");
+  if (port.get<int32_t>(0) != 7000 || name.get<string_view>("") != "blade" ||
+      port.key() != conf->find_path("server.port") || late.key() || late.get<int32_t>(3) != 3 ||
+      Handle().get<int32_t>(4) != 4) {
+    cout << "ERROR: handle\n";
+    return 1;
+  }
+  // A missing key is looked up again, so it is found once it is added.
+  KValue *kv = conf->create<KValue>();
+  kv->set_id("late");
+  Data five;
+  five.set_int64(5);
+  kv->set_value(five);
+  conf->add_key(kv);
+  if (late.get<int32_t>(0) != 5) {
+    cout << "ERROR: handle after add\n";
+    return 1;
+  }
+  // Removals from another configuration leave the cached key alone.
+  uint64_t generation = conf->generation();
+  ConfSlice other;
+  other.analyze_buffer(text);
+  other.configuration()->remove_key("top");
+  other.configuration()->find_entity("server")->remove_key("port");
+  if (conf->generation() != generation || other.configuration()->generation() != 2) {
+    cout << "ERROR: generation of another configuration\n";
+    return 1;
+  }
+  // Removing the entity invalidates the cached key.
+  Entity *server = conf->get_next_entity();
+  if (conf->generation() == generation || port.key() || port.get<int32_t>(0) != 0) {
+    cout << "ERROR: handle after remove\n";
+    return 1;
+  }
+  conf->add_entity(server);
+  if (port.get<int32_t>(0) != 7000) {
+    cout << "ERROR: handle after re-add\n";
+    return 1;
+  }
+  server->clear_keys();
+  if (port.key() || name.data()) {
+    cout << "ERROR: handle after clear\n";
+    return 1;
+  }
+  return 0;
+}
+
+// Files loaded in parallel are merged in order, and errors are per file.
+static int32_t check_many() {
+  const char *texts[] = {
+    "a = 1; e: { x = 1; };\n",
+    "a = 2; b = 2; e: { x = 2; }; f: { y = 2; };\n",
+    "c = 3;\nbad = <1;\n",
+    "d = 4;\n",
+  };
+  const int32_t files = 40;
+  vector<string> filenames;
+  string expected;
+
+  for (int32_t i = 0; i < files; i++) {
+    char filename[] = "/tmp/test_conf_XXXXXX";
+    int fd = mkstemp(filename);
+    const char *text = texts[i % 4];
+    if (fd < 0 || write(fd, text, strlen(text)) != (ssize_t)strlen(text)) {
+      cout << "ERROR: write\n";
+      return 1;
+    }
+    close(fd);
+    filenames.push_back(filename);
+  }
+  filenames.push_back("/tmp/test_conf_missing.cfg");
+
+  int32_t result = 0;
+  for (int32_t memory = 0; memory < 2 && !result; memory++) {
+    ConfSlice cs(memory ? ConfSlice::arena_mem : ConfSlice::heap_mem);
+    vector<ConfSlice::FileReport> reports;
+    if (!cs.analyze_many(filenames, 4, &reports) || reports.size() != filenames.size()) {
+      cout << "ERROR: analyze_many\n";
+      result = 1;
+      break;
+    }
+    for (int32_t i = 0; i <= files; i++) {
+      bool bad = i == files || i % 4 == 2;
+      if (reports[i].filename != filenames[i] || reports[i].result != (bad ? 1 : 0) ||
+	  reports[i].errors.empty() != !bad) {
+	cout << "ERROR: report " << i << ": " << reports[i].errors << "\n";
+	result = 1;
+      }
+    }
+    Configuration *conf = cs.configuration();
+    if (walk(conf) != "e:x=1;0|f:y=2;0|a;b;d;" || conf->get<int32_t>("a", 0) != 1 ||
+	conf->find_key("c")) {
+      cout << "ERROR: merge: " << walk(conf) << "\n";
+      result = 1;
+    }
+  }
+  for (int32_t i = 0; i < files; i++)
+    unlink(filenames[i].c_str());
+  return result;
+}
+
+// Captures what a call prints to stderr.
+template <typename F>
+static string capture_stderr(F call) {
+  char filename[] = "/tmp/test_conf_XXXXXX";
+  int fd = mkstemp(filename), saved = dup(2);
+  string out;
+  char buf[4096];
+  ssize_t n;
+
+  fflush(stderr);
+  dup2(fd, 2);
+  call();
+  fflush(stderr);
+  dup2(saved, 2);
+  close(saved);
+  lseek(fd, 0, SEEK_SET);
+  while ((n = read(fd, buf, sizeof(buf))) > 0)
+    out.append(buf, n);
+  close(fd);
+  unlink(filename);
+  return out;
+}
+
+// A large text splits into chunks that parse like the whole.
+static int32_t check_parallel() {
+  string text, bad;
+
+  for (int32_t i = 0; text.size() < (1 << 20); i++) {
+    string n = to_string(i);
+    text += "// e" + n + ": { \"};\n"
+      "e" + n + ": { s = \"}; \\\" {\"; l = <1, <" + n + ">>;\n"
+      "\tp = { a = 1; b = \"};\" }; n: { x = " + n + "; }; };\n"
+      "k" + n + " = \"//{\";\n";
+  }
+  bad = text + "broken = <1;\n" + text;
+
+  int32_t result = 0;
+  for (int32_t memory = 0; memory < 2 && !result; memory++) {
+    ConfSlice serial, parallel(memory ? ConfSlice::arena_mem : ConfSlice::heap_mem);
+    if (serial.analyze_buffer(text) || parallel.analyze_buffer_parallel(text, 4) ||
+	walk(parallel.configuration()) != walk(serial.configuration()) ||
+	parallel.configuration()->get<string_view>("e777.s", "") !=
+	serial.configuration()->get<string_view>("e777.s", "") ||
+	parallel.configuration()->get<int32_t>("e777.n.x", 0) != 777 ||
+	parallel.configuration()->get<string_view>("k1000", "") != "//{") {
+      cout << "ERROR: analyze_buffer_parallel\n";
+      result = 1;
+    }
+    // Another analysis reuses the worker arenas and, since the first
+    // definition wins, leaves the tree as it was.
+    if (!result && (parallel.analyze_buffer_parallel(text, 4) ||
+		    walk(parallel.configuration()) != walk(serial.configuration()))) {
+      cout << "ERROR: analyze_buffer_parallel again\n";
+      result = 1;
+    }
+  }
+
+  // A quote after a run of backslashes is escaped, so every ';' of this
+  // text but the last of a line is inside a string.
+  string escaped;
+  for (int32_t i = 0; escaped.size() < (1 << 20); i++) {
+    string n = to_string(i);
+    escaped += "q" + n + " = \"x\\\\\"; t" + n + " = 1; \";\n";
+  }
+  ConfSlice escaped_serial, escaped_parallel;
+  if (escaped_serial.analyze_buffer(escaped) ||
+      escaped_parallel.analyze_buffer_parallel(escaped, 4) ||
+      walk(escaped_parallel.configuration()) != walk(escaped_serial.configuration()) ||
+      escaped_parallel.configuration()->get<string_view>("q777", "") !=
+      "x\\\\\"; t777 = 1; " || escaped_parallel.configuration()->find_key("t777")) {
+    cout << "ERROR: parallel escaped quotes\n";
+    result = 1;
+  }
+
+  ConfSlice serial, parallel;
+  string serial_errors = capture_stderr([&]() { serial.analyze_buffer(bad); });
+  string parallel_errors = capture_stderr([&]() {
+      if (!parallel.analyze_buffer_parallel(bad, 4))
+	result = 1;
+    });
+  string line = "Error at line " + to_string(count(text.begin(), text.end(), '\n') + 1) + ":";
+  if (result || parallel_errors != serial_errors || parallel_errors.find(line) != 0 ||
+      walk(parallel.configuration()) != walk(serial.configuration())) {
+    cout << "ERROR: parallel errors: " << parallel_errors;
+    result = 1;
+  }
+
+  // Unbalanced braces fall back to a serial analysis.
+  ConfSlice unbalanced;
+  capture_stderr([&]() {
+      if (!unbalanced.analyze_buffer_parallel(text + "}\n" + text, 4)) {
+	cout << "ERROR: unbalanced\n";
+	result = 1;
+      }
+    });
+  return result;
+}
+
+// A resource that counts the bytes it holds.
+// The tree can live in an arena or in a caller-supplied resource.
+static int32_t check_memory() {
+  const char text[] =
+    "e: { v = 5; l = <1, 2, <3>, <4, 5>>; p = { a = 1; b = \"x\" }; n: { x = 1; }; };\n"
+    "f: { w = 2.5; };\n"
+    "top = 1; other = \"s\";\n";
+  const string expected =
+    "e:v=5;l=1,2,<3,><4,5,>;p=a:1,b:x,;1|f:w=2.5;0|top;other;";
+
+  ConfSlice arena(ConfSlice::arena_mem);
+  if (arena.analyze_buffer(text) || walk(arena.configuration()) != expected) {
+    cout << "ERROR: arena\n";
+    return 1;
+  }
+  CountingResource counting;
+  {
+    ConfSlice cs(&counting);
+    if (cs.analyze_buffer(text) || walk(cs.configuration()) != expected) {
+      cout << "ERROR: resource\n";
+      return 1;
+    }
+    Key *key = cs.configuration()->find_entity("e")->get_next_key();
+    delete key;
+    if (!counting.allocations) {
+      cout << "ERROR: resource not used\n";
+      return 1;
+    }
+  }
+  if (counting.bytes) {
+    cout << "ERROR: " << counting.bytes << " bytes not returned\n";
+    return 1;
+  }
+  return 0;
+}
+
+// A new version reuses the unchanged statements and parses the others.
+static int32_t check_reanalyze() {
+  const string v1 =
+    "// Servers.\nserver: { port = 1; disk: { size = 10; }; };\n"
+    "client: { id = 2; };\ntop = 1;\nold = 2;\n";
+  const string v2 =
+    "// Servers.\nserver: { port = 1; disk: { size = 10; }; };\n"
+    "client: { id = 3; };\nfresh = 5;\ntop = 1;\n";
+  const string v3 = "top = 9; client: { id = 4; };\n" + v2;
+  const string bad =
+    "// Servers.\nserver: { port = 1; disk: { size = 10; }; };\n"
+    "client: { id = ; };\n";
+  auto expected = [](const string &text) {
+    ConfSlice cs;
+    cs.analyze_buffer(text);
+    return walk(cs.configuration());
+  };
+  CountingResource counting;
+  int32_t result = 0;
+  {
+    ConfSlice cs(&counting);
+    Configuration *conf = cs.configuration();
+    if (cs.analyze_buffer("gone = 1;") || cs.reanalyze_buffer(v1) ||
+	walk(conf) != expected(v1)) {
+      cout << "ERROR: reanalyze: " << walk(conf) << "\n";
+      return 1;
+    }
+    Entity *server = conf->find_entity("server"), *disk = server->find_entity("disk");
+    Key *top = conf->find_key("top");
+    if (cs.reanalyze_buffer(v2) || walk(conf) != expected(v2) ||
+	conf->find_entity("server") != server || server->find_entity("disk") != disk ||
+	conf->find_key("top") != top || conf->get<int32_t>("client.id", 0) != 3) {
+      cout << "ERROR: reanalyze changed: " << walk(conf) << "\n";
+      return 1;
+    }
+
+    // The first definition wins, wherever it comes from.
+    if (cs.reanalyze_buffer(v3) || walk(conf) != expected(v3) ||
+	conf->get<int32_t>("top", 0) != 9 || conf->get<int32_t>("client.id", 0) != 4) {
+      cout << "ERROR: reanalyze duplicates: " << walk(conf) << "\n";
+      return 1;
+    }
+
+    // An error leaves the configuration as it was.
+    string errors = capture_stderr([&]() {
+	if (!cs.reanalyze_buffer(bad) || !cs.reanalyze_buffer(v2 + "}"))
+	  result = 1;
+      });
+    if (result || errors.find("Error at line 3:") != 0 || walk(conf) != expected(v3)) {
+      cout << "ERROR: reanalyze errors: " << errors;
+      return 1;
+    }
+    if (cs.reanalyze_buffer(v2) || walk(conf) != expected(v2) ||
+	conf->get<int32_t>("top", 0) != 1 || conf->find_entity("server") != server) {
+      cout << "ERROR: reanalyze back: " << walk(conf) << "\n";
+      return 1;
+    }
+
+    // An edit that keeps the IDs is swapped in place.
+    string edited = v2;
+    edited.replace(edited.find("port = 1"), 8, "port = 2");
+    const Entity *client = conf->find_entity("client");
+    if (cs.reanalyze_buffer(edited) || walk(conf) != expected(edited) ||
+	conf->find_entity("client") != client || conf->get<int32_t>("server.port", 0) != 2) {
+      cout << "ERROR: reanalyze in place: " << walk(conf) << "\n";
+      return 1;
+    }
+    conf->freeze();
+    if (!cs.reanalyze_buffer(v1)) {
+      cout << "ERROR: reanalyze frozen\n";
+      return 1;
+    }
+  }
+  if (counting.bytes) {
+    cout << "ERROR: reanalyze kept " << counting.bytes << " bytes\n";
+    return 1;
+  }
+  return 0;
+}
+
+int main() {
+  if (check_index() || check_duplicates() || check_views() || check_data() ||
+      check_array() || check_list() || check_path() ||
+      check_handle() || check_many() || check_parallel() ||
+      check_memory() || check_reanalyze())
+    return 1;
+  cout << "OK\n";
+  return 0;
+}
@@ -0,0 +1,180 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../src/confslice.h"
+#include "../src/diff.h"
+
+using namespace std;
+
+static const char old_text[] =
+  "server: { port = 7000; name = \"blade\"; ratio = 0.5;\n"
+  "\tports = [1, 2, 3]; mixed = [1, \"a\"]; l = <1, <2, 3>>; p = { a = 1; b = \"x\" };\n"
+  "\tdisk.1: { size = 10; }; gone: { x = 1; }; };\n"
+  "same: { a = 1; b: { c = 2; }; };\n"
+  "top = 1; old = 2;\n";
+
+static const char new_text[] =
+  "top = 1; fresh = 3;\n"
+  "same: { b: { c = 2; }; a = 1; };\n"
+  "server: { port = \"7000\"; name = \"blade\"; ratio = 0.5;\n"
+  "\tports = [1, 2, 4]; mixed = [1, \"a\"]; l = <1, <2, 5>>; p = { a = 1; b = \"y\" };\n"
+  "\tdisk.1: { size = 20; }; extra: { y = 1; }; };\n";
+
+static const char expected[] =
+  "- old\n"
+  "+ fresh\n"
+  "~ server.port\n"
+  "~ server.ports\n"
+  "~ server.l\n"
+  "~ server.p\n"
+  "~ server.\"disk.1\".size\n"
+  "- server.gone:\n"
+  "+ server.extra:\n";
+
+// Prints the changes in a stable form.
+static string changes_str(const vector<Change> &changes) {
+  string out;
+  for (const Change &change : changes) {
+    out += change.kind == Change::added ? "+ " : change.kind == Change::removed ? "- " : "~ ";
+    out += change.path;
+    if (change.old_entity || change.new_entity)
+      out += ":";
+    out += "\n";
+  }
+  return out;
+}
+
+// Changes are found by ID and typed value. Trees that are not frozen are
+// refused.
+static int32_t check_diff() {
+  for (int32_t frozen = 0; frozen < 2; frozen++) {
+    ConfSlice a, b;
+    if (a.analyze_buffer(old_text) || b.analyze_buffer(new_text)) {
+      cout << "ERROR: analysis\n";
+      return 1;
+    }
+    vector<Change> changes, none;
+    if (!frozen) {
+      b.configuration()->freeze();
+      Patch patch;
+      if (!diff(a.configuration(), b.configuration(), changes) || !changes.empty() ||
+	  !diff(b.configuration(), a.configuration(), changes) ||
+	  !patch.make(a.configuration(), b.configuration())) {
+	cout << "ERROR: diff of a tree that is not frozen\n";
+	return 1;
+      }
+      continue;
+    }
+    a.configuration()->freeze();
+    b.configuration()->freeze();
+    if (diff(a.configuration(), b.configuration(), changes) ||
+	diff(b.configuration(), b.configuration(), none) ||
+	changes_str(changes) != expected || !none.empty()) {
+      cout << "ERROR: diff:\n" << changes_str(changes);
+      return 1;
+    }
+    if (a.configuration()->find_entity("same")->digest() !=
+	b.configuration()->find_entity("same")->digest() ||
+	a.configuration()->digest() == b.configuration()->digest()) {
+      cout << "ERROR: digests\n";
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// A patch turns a copy of the old tree into the new one.
+static int32_t check_patch() {
+  ConfSlice a, b, copy;
+  Patch patch;
+  if (a.analyze_buffer(old_text) || b.analyze_buffer(new_text) || copy.analyze_buffer(old_text)) {
+    cout << "ERROR: analysis\n";
+    return 1;
+  }
+  if (patch.make(a.configuration()->freeze(), b.configuration()->freeze()) || patch.size() != 9) {
+    cout << "ERROR: make\n";
+    return 1;
+  }
+  if (patch.str().find("~ server.port = \"7000\"\n") == string::npos) {
+    cout << "ERROR: str:\n" << patch.str();
+    return 1;
+  }
+  if (patch.apply(copy.configuration())) {
+    cout << "ERROR: apply\n";
+    return 1;
+  }
+
+  // The patch no longer matches once it is applied, nor does a frozen tree.
+  ConfSlice frozen;
+  frozen.analyze_buffer(old_text);
+  frozen.configuration()->freeze();
+  if (!patch.apply(copy.configuration()) || !patch.apply(frozen.configuration())) {
+    cout << "ERROR: apply mismatch\n";
+    return 1;
+  }
+
+  vector<Change> changes;
+  if (diff(copy.configuration()->freeze(), b.configuration(), changes) || !changes.empty() ||
+      copy.configuration()->get<int64_t>("server.extra.y", 0) != 1) {
+    cout << "ERROR: patched:\n" << changes_str(changes);
+    return 1;
+  }
+  return 0;
+}
+
+// Builds a level of many keys and an entity with a partial last run.
+static string level_text(const string &renamed, const string &changed) {
+  string text;
+  for (int32_t i = 0; i < 1000; i++) {
+    string id = "k" + to_string(i);
+    text += (id == renamed ? "x" + to_string(i) : id) + " = " +
+      (id == changed ? "-1" : to_string(i)) + ";\n";
+  }
+  text += "e: {";
+  for (int32_t i = 0; i < 300; i++) {
+    string id = "v" + to_string(i);
+    text += " " + id + " = " + ("e." + id == changed ? "-1" : to_string(i)) + ";";
+  }
+  return text + " };\n";
+}
+
+// Runs of keys that did not change are skipped, the others are compared
+// key by key, also after a level stops being aligned.
+static int32_t check_runs() {
+  const struct {
+    const char *renamed;
+    const char *changed;
+    const char *expected;
+  } cases[] = {
+    {"", "", ""},
+    {"", "k5", "~ k5\n"},
+    {"", "k999", "~ k999\n"},
+    {"", "e.v299", "~ e.v299\n"},
+    {"k130", "k999", "- k130\n~ k999\n+ x130\n"},
+    {"k64", "e.v64", "- k64\n+ x64\n~ e.v64\n"},
+  };
+  ConfSlice a;
+  if (a.analyze_buffer(level_text("", "").c_str())) {
+    cout << "ERROR: analysis\n";
+    return 1;
+  }
+  a.configuration()->freeze();
+  for (const auto &c : cases) {
+    ConfSlice b;
+    vector<Change> changes;
+    if (b.analyze_buffer(level_text(c.renamed, c.changed).c_str()) ||
+	diff(a.configuration(), b.configuration()->freeze(), changes) ||
+	changes_str(changes) != c.expected) {
+      cout << "ERROR: runs " << c.renamed << " " << c.changed << ":\n" << changes_str(changes);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int main() {
+  if (check_diff() || check_patch() || check_runs())
+    return 1;
+  cout << "OK\n";
+  return 0;
+}
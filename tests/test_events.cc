@@ -0,0 +1,166 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <iostream>
+#include <memory_resource>
+#include <string>
+#include "../src/confslice.h"
+#include "util.h"
+
+using namespace std;
+
+static const char text[] =
+  "top = 1;\n"
+  "server: { port = 7000; ports = [1, 2]; l = <1, <\"x\">>; p = { a = 1; b = 2.5 };\n"
+  "\tdisk: { size = 1; }; };\n"
+  "last = \"s\";\n";
+
+// Writes every event, and stops at the entity with a given ID.
+class Recorder : public ParseHandler {
+ public:
+  string events;
+  string stop_at;
+  bool aborted = false;
+  CountingResource live;
+  string_view input;   // If set, the IDs must point into it.
+  size_t copied = 0;
+
+  std::pmr::memory_resource *resource() override { return &live; }
+
+  string tag(const std::string_view id) {
+    if (!input.empty() && (id.data() < input.data() || id.data() >= input.data() + input.size()))
+      copied++;
+    return string(id);
+  }
+
+  int32_t begin_entity(const std::string_view id) override {
+    events += "E(" + tag(id) + ")";
+    return id == stop_at ? 1 : 0;
+  }
+  int32_t end_entity() override { events += "/E "; return 0; }
+  int32_t key_value(const std::string_view id, Data &value) override {
+    events += tag(id) + "=" + value.data_str() + " ";
+    return 0;
+  }
+  int32_t begin_array(const std::string_view id) override { events += tag(id) + "=["; return 0; }
+  int32_t array_item(Data &value) override { events += value.data_str() + ","; return 0; }
+  int32_t end_array() override { events += "] "; return 0; }
+  int32_t begin_list(const std::string_view id) override { events += tag(id) + "=<"; return 0; }
+  int32_t begin_sublist() override { events += "<"; return 0; }
+  int32_t list_item(Data &value) override { events += value.data_str() + ","; return 0; }
+  int32_t end_sublist() override { events += ">,"; return 0; }
+  int32_t end_list() override { events += "> "; return 0; }
+  int32_t begin_pairs(const std::string_view id) override { events += tag(id) + "={"; return 0; }
+  int32_t pair(const std::string_view id, Data &value) override {
+    events += tag(id) + ":" + value.data_str() + ",";
+    return 0;
+  }
+  int32_t end_pairs() override { events += "} "; return 0; }
+  void abort() override { aborted = true; }
+};
+
+static int32_t parse(const string &input, Recorder &recorder, string &errors) {
+  GlobalContext gc;
+  SyntaxAnalyzer syntax(&gc);
+  gc.set_errors(&errors);
+  if (syntax.open_buffer(input.data(), input.size()))
+    return 1;
+  return syntax.analyze(&recorder);
+}
+
+// IDs are passed as views into an input in memory, and through a reused
+// buffer when the input is read through stdio.
+static int32_t check_ids() {
+  const string long_text =
+    "a_long_entity_identifier: { a_long_key_identifier_1 = 1;\n"
+    "\tanother_long_entity_identifier: { a_long_key_identifier_2 = [1];\n"
+    "\t\ta_long_key_identifier_3 = { a_long_pair_identifier = 2 }; }; };\n";
+  const string expected =
+    "E(a_long_entity_identifier)a_long_key_identifier_1=1 "
+    "E(another_long_entity_identifier)a_long_key_identifier_2=[1,] "
+    "a_long_key_identifier_3={a_long_pair_identifier:2,} /E /E ";
+  Recorder memory, stdio;
+  string errors;
+  memory.input = long_text;
+  if (parse(long_text, memory, errors) || memory.events != expected || memory.copied) {
+    cout << "ERROR: ids in memory " << memory.copied << " " << memory.events << "\n";
+    return 1;
+  }
+
+  char filename[] = "/tmp/test_events_XXXXXX";
+  int fd = mkstemp(filename);
+  if (fd < 0 || write(fd, long_text.data(), long_text.size()) != (ssize_t)long_text.size()) {
+    cout << "ERROR: write\n";
+    return 1;
+  }
+  close(fd);
+  GlobalContext gc;
+  SyntaxAnalyzer syntax(&gc);
+  int32_t result = syntax.open(filename, LexAnalyzer::stdio_in) || syntax.analyze(&stdio);
+  syntax.close();
+  unlink(filename);
+  if (result || stdio.events != expected) {
+    cout << "ERROR: ids from stdio " << stdio.events << "\n";
+    return 1;
+  }
+  return 0;
+}
+
+int main() {
+  const string expected =
+    "top=1 E(server)port=7000 ports=[1,2,] l=<1,<x,>,> p={a:1,b:2.5,} "
+    "E(disk)size=1 /E /E last=s ";
+  Recorder recorder;
+  string errors;
+  if (parse(text, recorder, errors) || recorder.events != expected || recorder.aborted ||
+      !errors.empty()) {
+    cout << "ERROR: events " << recorder.events << "\n";
+    return 1;
+  }
+  if (check_ids())
+    return 1;
+
+  // A handler can stop the analysis without a syntax error.
+  Recorder stopped;
+  stopped.stop_at = "disk";
+  if (!parse(text, stopped, errors) || !stopped.aborted || !errors.empty() ||
+      stopped.events.find("E(disk)") == string::npos || stopped.events.find("/E") != string::npos) {
+    cout << "ERROR: stop " << stopped.events << "\n";
+    return 1;
+  }
+
+  // A syntax error aborts the handler after the events before it.
+  Recorder failed;
+  if (!parse("a = 1;\nb: { c = [1, ; };\n", failed, errors) || !failed.aborted ||
+      failed.events != "a=1 E(b)c=[1," || errors.find("Error at line 2") != 0) {
+    cout << "ERROR: syntax error " << failed.events << "\n";
+    return 1;
+  }
+
+  // Streaming holds no more memory for a large input than for a small one,
+  // and leaves the configuration alone.
+  string small, large;
+  for (int32_t i = 0; i < 5000; i++) {
+    string entity = "e" + to_string(i) + ": { name = \"a string too long to fit in place\"; "
+      "v = [1, 2, 3]; };\n";
+    if (i < 10)
+      small += entity;
+    large += entity;
+  }
+  ConfSlice cs;
+  Recorder a, b;
+  if (cs.parse_buffer(small, &a) || cs.parse_buffer(large, &b) || !a.live.peak ||
+      a.live.peak != b.live.peak || a.live.bytes || b.live.bytes ||
+      cs.configuration()->size_of_entities()) {
+    cout << "ERROR: memory " << a.live.peak << " " << b.live.peak << "\n";
+    return 1;
+  }
+
+  // The tree is built by a handler on the same events.
+  if (cs.analyze_buffer(text) || cs.configuration()->get<int32_t>("server.disk.size", 0) != 1 ||
+      cs.configuration()->get<string>("last", "") != "s") {
+    cout << "ERROR: tree\n";
+    return 1;
+  }
+  cout << "OK\n";
+  return 0;
+}
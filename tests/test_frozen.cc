@@ -0,0 +1,127 @@
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "../src/confslice.h"
+#include "util.h"
+
+using namespace std;
+
+// Lookups on a frozen configuration give read-only objects.
+static_assert(is_same_v<decltype(declval<const Configuration *>()->find_entity("e")),
+	      const Entity *>);
+static_assert(is_same_v<decltype(declval<const Configuration *>()->find_path("e.k")),
+	      const Key *>);
+static_assert(is_same_v<decltype(declval<const Entity *>()->find_key("k")), const Key *>);
+static_assert(is_same_v<decltype(declval<Configuration *>()->find_entity("e")), Entity *>);
+
+// Walks an entity and its sub-entities through the views.
+static string walk(const Entity *entity) {
+  string out = string(entity->id()) + ":";
+
+  for (const Key *key : entity->keys())
+    out += key_str(key);
+  for (const Entity *sub : entity->entities())
+    out += "{" + walk(sub) + "}";
+  return out;
+}
+
+// Reads a frozen configuration in every way a reader can.
+static string read_all(const Configuration *conf, const Handle &handle) {
+  string out;
+
+  for (const Entity *entity : conf->entities())
+    out += walk(entity) + "|";
+  for (const Key *key : conf->keys())
+    out += string(key->id()) + ";";
+  for (int32_t i = 0; i < 50; i += 7) {
+    string n = to_string(i);
+    const Entity *server = conf->find_entity("server" + n);
+    const Key *port = server ? server->find_key("port") : NULL;
+    out += port ? ((const KValue *)port)->value().data_str() : "-";
+    out += to_string(conf->get<int64_t>("server" + n + ".disk.size", -1));
+    out += conf->get<string>(Path("server" + n + ".name"), "-");
+  }
+  out += to_string(handle.get<int64_t>(-1));
+  return out;
+}
+
+// Any number of threads read a frozen configuration at once.
+static int32_t check_concurrent() {
+  string text;
+
+  for (int32_t i = 0; i < 50; i++) {
+    string n = to_string(i);
+    text += "server" + n + ": { port = " + to_string(7000 + i) + "; name = \"s" + n + "\";\n"
+      "\tports = [" + n + ", 1, 2]; l = <1, <" + n + ", 2>>; p = { a = 1; b = \"x\" };\n"
+      "\tdisk: { size = " + to_string(i * 10) + "; }; };\n"
+      "k" + n + " = " + n + ";\n";
+  }
+
+  ConfSlice cs;
+  if (cs.analyze_buffer(text)) {
+    cout << "ERROR: analysis\n";
+    return 1;
+  }
+  const Configuration *conf = cs.configuration()->freeze();
+  const string expected = read_all(conf, conf->handle("server7.disk.size"));
+  const int32_t threads = 8, rounds = 200;
+  atomic<int32_t> errors(0);
+  vector<thread> pool;
+
+  for (int32_t t = 0; t < threads; t++)
+    pool.emplace_back([&]() {
+	Handle handle = conf->handle("server7.disk.size");
+	for (int32_t r = 0; r < rounds; r++)
+	  if (read_all(conf, handle) != expected)
+	    errors++;
+      });
+  for (thread &t : pool)
+    t.join();
+  if (errors.load() || expected.find("server49:port=7049;") == string::npos) {
+    cout << "ERROR: concurrent reads: " << errors.load() << "\n";
+    return 1;
+  }
+  return 0;
+}
+
+// A frozen tree refuses every change.
+static int32_t check_immutable() {
+  ConfSlice cs, other;
+  if (cs.analyze_buffer("e: { k = 1; s: { x = 1; }; }; top = 1;\n") ||
+      other.analyze_buffer("more = 1;\n")) {
+    cout << "ERROR: analysis\n";
+    return 1;
+  }
+  Configuration *conf = cs.configuration();
+  const string before = walk(conf->find_entity("e"));
+  conf->freeze();
+
+  Entity *e = conf->find_entity("e");
+  Entity *s = e->find_entity("s");
+  KValue *key = conf->create<KValue>();
+  key->set_id("new");
+  int32_t refused = conf->add_key(key) && e->add_key(key) && s->add_key(key);
+  delete key;
+  e->clear_keys();
+  s->clear_keys();
+  conf->clear_entities();
+  conf->merge(other.configuration());
+  if (!refused || !conf->frozen() || !e->frozen() || !s->frozen() ||
+      conf->get_next_key() || e->get_next_entity() || s->get_next_key() ||
+      walk(conf->find_entity("e")) != before || conf->find_key("more") ||
+      other.configuration()->size_of_keys() != 1) {
+    cout << "ERROR: frozen changes\n";
+    return 1;
+  }
+  return 0;
+}
+
+int main() {
+  if (check_concurrent() || check_immutable())
+    return 1;
+  cout << "OK\n";
+  return 0;
+}
@@ -0,0 +1,91 @@
+#include <iostream>
+#include <string>
+#include "../src/lex.h"
+#include "../src/scan.h"
+
+using namespace std;
+
+// The expected token stream of the input below.
+static const struct {
+  int32_t id;
+  const char *word;
+} expected[] = {
+  {ID_TK, "server"}, {COLON_TK, ":"}, {LBRACKETS3_TK, "{"},
+  {ID_TK, "disk.1"}, {ASSIGN_TK, "="}, {INTEGER_TK, "-5"}, {QMARK_TK, ";"},
+  {ID_TK, "ratio"}, {ASSIGN_TK, "="}, {DOUBLE_TK, "+0.25"}, {QMARK_TK, ";"},
+  {ID_TK, "list"}, {ASSIGN_TK, "="}, {LBRACKETS4_TK, "<"}, {INTEGER_TK, "1"},
+  {COMMA_TK, ","}, {LBRACKETS4_TK, "<"}, {STRING_TK, "\"a\\\"b\""},
+  {RBRACKETS4_TK, ">"}, {RBRACKETS4_TK, ">"}, {QMARK_TK, ";"},
+  {ID_TK, "ports"}, {ASSIGN_TK, "="}, {LBRACKETS1_TK, "["}, {INTEGER_TK, "7000"},
+  {RBRACKETS1_TK, "]"}, {QMARK_TK, ";"},
+  {RBRACKETS3_TK, "}"}, {QMARK_TK, ";"},
+  {UNDERSCORE, "_"}, {OTHER, "/"}, {OTHER, "."}, {OTHER, "-"},
+};
+
+static const char input[] =
+  "// A comment.\n"
+  "server: {\n"
+  "\tdisk.1 = -5; // Another comment.\n"
+  "\tratio = +0.25;\n"
+  "\tlist = <1, <\"a\\\"b\">>;\n"
+  "\tports = [7000];\n"
+  "};\n"
+  "_ / . -\n";
+
+static int32_t check_tokens() {
+  LexAnalyzer lex;
+  string word;
+  int32_t id;
+  size_t i;
+
+  if (lex.open_buffer(input, sizeof(input) - 1))
+    return 1;
+  for (i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+    id = lex.analyze(word);
+    if (id != expected[i].id || word != expected[i].word) {
+      cout << "ERROR: token " << i << ": " << id << " " << word << "\n";
+      return 1;
+    }
+  }
+  if (lex.analyze(word) != EOF_TK || lex.line() != 9) {
+    cout << "ERROR: EOF\n";
+    return 1;
+  }
+  return 0;
+}
+
+// Long runs of white space, comments and strings cross the SIMD blocks.
+static int32_t check_runs() {
+  LexAnalyzer lex;
+  string text, word, body;
+  uint32_t i;
+
+  for (i = 0; i < 100; i++)
+    body += (char)('a' + i % 26);
+  body += " with spaces";
+  for (i = 1; i <= 50; i++) {
+    text += string(i, ' ') + "\t\r\n";
+    text += "// " + string(i, 'c') + "\n";
+    text += "\"" + body.substr(0, i * 2) + "\"";
+  }
+  lex.open_buffer(text.data(), text.size());
+  for (i = 1; i <= 50; i++) {
+    if (lex.analyze(word) != STRING_TK || word != "\"" + body.substr(0, i * 2) + "\"" ||
+	lex.line() != i * 2 + 1) {
+      cout << "ERROR: run " << i << ": " << word << " at " << lex.line() << "\n";
+      return 1;
+    }
+  }
+  return lex.analyze(word) != EOF_TK;
+}
+
+int main() {
+  for (int32_t level = SCAN_SCALAR; level <= scan_level(); level++) {
+    if (scan_set_level(level) || check_tokens() || check_runs()) {
+      cout << "ERROR: level " << level << "\n";
+      return 1;
+    }
+  }
+  cout << "OK\n";
+  return 0;
+}
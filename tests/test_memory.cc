@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <iostream>
+#include <memory_resource>
+#include <string>
+#include "../src/confslice.h"
+#include "../src/memory.h"
+#include "util.h"
+
+using namespace std;
+
+static const char text[] =
+  "server: { port = 7000; name = \"a string that does not fit in place\";\n"
+  "\tports = [1, 2, 3]; l = <1, <\"x\", 2.5>>; p = { a = 1; b = \"y\" };\n"
+  "\tdisk: { size = 1.5; }; };\n"
+  "client: { port = 1; };\n"
+  "top = 1;\n";
+
+// The consumers and the configuration add up to the whole account.
+static int32_t check_sums(const MemoryUsage &usage, const string &name) {
+  uint64_t kinds = 0, parts = 0, consumers = 0;
+  for (size_t i = 0; i < MemoryUsage::kinds; i++)
+    kinds += usage.bytes[i];
+  for (size_t i = 0; i < MemoryUsage::parts; i++)
+    parts += usage.part_bytes[i];
+  for (const MemoryUsage::Consumer &c : usage.consumers)
+    consumers += c.bytes;
+  if (kinds != usage.total || parts != usage.total ||
+      consumers + usage.bytes[MemoryUsage::configuration_k] != usage.total ||
+      usage.consumers.size() != 3 || usage.nodes[MemoryUsage::entity_k] != 3 ||
+      usage.nodes[MemoryUsage::value_k] != 5 || usage.nodes[MemoryUsage::array_k] != 1 ||
+      usage.nodes[MemoryUsage::list_k] != 1 || usage.nodes[MemoryUsage::pairs_k] != 1 ||
+      usage.part_bytes[MemoryUsage::vptr_p] != 8 * sizeof(void *) ||
+      !usage.part_bytes[MemoryUsage::string_p] || !usage.part_bytes[MemoryUsage::list_node_p]) {
+    cout << "ERROR: " << name << " sums\n";
+    return 1;
+  }
+  vector<MemoryUsage::Consumer> top = usage.top(2);
+  if (top.size() != 2 || top[0].id != "server" || !top[0].entity || top[0].nodes != 8 ||
+      top[1].bytes > top[0].bytes || usage.top(10).size() != 3) {
+    cout << "ERROR: " << name << " top\n";
+    return 1;
+  }
+  return 0;
+}
+
+int main() {
+  MemoryUsage heap_usage, arena_usage, live_usage;
+
+  // Without malloc in the way, the account matches what the resource holds.
+  CountingResource live;
+  {
+    ConfSlice cs(&live);
+    if (cs.analyze_buffer(text)) {
+      cout << "ERROR: analysis\n";
+      return 1;
+    }
+    memory_usage(cs.configuration(), live_usage);
+    if (check_sums(live_usage, "resource"))
+      return 1;
+    // The configuration object itself comes from the heap.
+    if (live_usage.total - sizeof(Configuration) != live.bytes ||
+	live_usage.allocations - 1 != live.allocations) {
+      cout << "ERROR: resource holds " << live.bytes << " bytes in " << live.allocations
+	   << " allocations, counted " << live_usage.total - sizeof(Configuration) << " in "
+	   << live_usage.allocations - 1 << "\n";
+      return 1;
+    }
+  }
+
+  // The run digests of the large levels of a frozen tree are counted too,
+  // and returned with the tree.
+  CountingResource frozen;
+  {
+    string many = "e: {";
+    for (int32_t i = 0; i < 200; i++)
+      many += " k" + to_string(i) + " = 1;";
+    many += " };\n";
+    for (int32_t i = 0; i < 200; i++)
+      many += "k" + to_string(i) + " = 1;\n";
+    ConfSlice cs(&frozen);
+    MemoryUsage usage;
+    if (cs.analyze_buffer(many)) {
+      cout << "ERROR: analysis\n";
+      return 1;
+    }
+    cs.configuration()->freeze();
+    memory_usage(cs.configuration(), usage);
+    if (usage.total - sizeof(Configuration) != frozen.bytes ||
+	usage.allocations - 1 != frozen.allocations) {
+      cout << "ERROR: frozen resource holds " << frozen.bytes << " bytes, counted "
+	   << usage.total - sizeof(Configuration) << "\n";
+      return 1;
+    }
+  }
+  if (frozen.bytes || frozen.allocations) {
+    cout << "ERROR: frozen tree leaks " << frozen.bytes << " bytes\n";
+    return 1;
+  }
+
+  ConfSlice heap, arena(ConfSlice::arena_mem);
+  if (heap.analyze_buffer(text) || arena.analyze_buffer(text)) {
+    cout << "ERROR: analysis\n";
+    return 1;
+  }
+  memory_usage(heap.configuration(), heap_usage);
+  memory_usage(arena.configuration(), arena_usage);
+  if (check_sums(heap_usage, "heap") || check_sums(arena_usage, "arena"))
+    return 1;
+
+  // Every node has a header; malloc adds to every allocation on the heap.
+  uint64_t headers = 11 * alignof(max_align_t);
+  if (arena_usage.part_bytes[MemoryUsage::overhead_p] != headers ||
+      heap_usage.part_bytes[MemoryUsage::overhead_p] <= headers ||
+      heap_usage.total - heap_usage.part_bytes[MemoryUsage::overhead_p] !=
+      arena_usage.total - arena_usage.part_bytes[MemoryUsage::overhead_p]) {
+    cout << "ERROR: overhead\n";
+    return 1;
+  }
+  cout << "OK\n";
+  return 0;
+}
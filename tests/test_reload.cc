@@ -0,0 +1,170 @@
+#include <signal.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../src/reload.h"
+
+using namespace std;
+
+static Reloader *reloader;
+
+// Writes version n of the configuration and moves it into place at once.
+static int32_t write_version(const string &filename, int64_t n, bool bad = false) {
+  string text, tmp = filename + ".tmp";
+  string v = to_string(n);
+
+  text = "a = " + v + ";\ne: { c = " + v + "; s = \"v" + v + "\"; };\n";
+  for (int32_t i = 0; i < 200; i++)
+    text += "k" + to_string(i) + " = <" + v + ", <" + v + ">>;\n";
+  text += "b = " + v + ";\n";
+  if (bad)
+    text += "broken = <1;\n";
+  FILE *file = fopen(tmp.c_str(), "w");
+  if (!file || fwrite(text.data(), 1, text.size(), file) != text.size()) {
+    if (file)
+      fclose(file);
+    return 1;
+  }
+  fclose(file);
+  return rename(tmp.c_str(), filename.c_str()) ? 1 : 0;
+}
+
+static void on_sighup(int) {
+  reloader->request();
+}
+
+// Readers see whole versions, in order, while reloads run.
+static int32_t check_stress() {
+  char filename[] = "/tmp/test_reload_XXXXXX";
+  int fd = mkstemp(filename);
+  const int32_t readers = 8, reloads = 300;
+  atomic<bool> done(false);
+  atomic<int32_t> errors(0);
+  atomic<int64_t> reads(0);
+
+  if (fd < 0)
+    return 1;
+  close(fd);
+  Reloader r(filename);
+  reloader = &r;
+  if (write_version(filename, 1) || r.reload() || r.version() != 1) {
+    cout << "ERROR: first reload\n";
+    return 1;
+  }
+
+  vector<thread> pool;
+  for (int32_t t = 0; t < readers; t++)
+    pool.emplace_back([&]() {
+	Reloader::Reader reader(r);
+	uint64_t last = 0;
+	int64_t count = 0;
+	while (!done.load() || !count) {
+	  Reloader::Guard guard(reader);
+	  int64_t v = (int64_t)guard.version();
+	  string s = "v" + to_string(v);
+	  if (guard.version() < last || guard->get<int64_t>("a", -1) != v ||
+	      guard->get<int64_t>("b", -1) != v || guard->get<int64_t>("e.c", -1) != v ||
+	      guard->get<string_view>("e.s", "") != s) {
+	    errors++;
+	    break;
+	  }
+	  if (count % 64 == 0) {
+	    // Nested guards pin the version of the outer one.
+	    Reloader::Guard inner(reader);
+	    if (inner.version() < guard.version())
+	      errors++;
+	  }
+	  last = guard.version();
+	  count++;
+	}
+	reads += count;
+      });
+
+  int32_t result = 0;
+  for (int32_t i = 2; i <= reloads && !result; i++)
+    if (write_version(filename, i) || r.reload() || r.version() != (uint64_t)i)
+      result = 1;
+
+  // A file that does not parse keeps the current version.
+  write_version(filename, reloads + 1, true);
+  if (!r.reload() || r.version() != (uint64_t)reloads)
+    result = 1;
+
+  // Reloads requested from a signal handler run on the reload thread.
+  signal(SIGHUP, on_sighup);
+  r.start();
+  for (int32_t i = reloads + 1; i <= reloads + 20 && !result; i++) {
+    write_version(filename, i);
+    raise(SIGHUP);
+    for (int32_t wait = 0; r.version() < (uint64_t)i && wait < 5000; wait++)
+      usleep(1000);
+    if (r.version() != (uint64_t)i)
+      result = 1;
+  }
+  r.stop();
+  signal(SIGHUP, SIG_DFL);
+
+  done.store(true);
+  for (thread &t : pool)
+    t.join();
+  r.reclaim();
+  if (result || errors.load() || !reads.load() || r.retired()) {
+    cout << "ERROR: stress: version " << r.version() << ", " << errors.load() << " errors, "
+	 << r.retired() << " retired\n";
+    result = 1;
+  }
+  unlink(filename);
+  return result;
+}
+
+// Handles of a reloader follow its reloads, which report what changed.
+static int32_t check_handle() {
+  char filename[] = "/tmp/test_reload_XXXXXX";
+  int fd = mkstemp(filename);
+  int32_t result = 0;
+  size_t changes = 0;
+
+  if (fd < 0)
+    return 1;
+  close(fd);
+  {
+    Reloader r(filename);
+    Reloader::Reader reader(r);
+    Handle a = r.handle("a"), s = r.handle("e.s");
+    if (write_version(filename, 1) || r.reload()) {
+      cout << "ERROR: handle: first reload\n";
+      unlink(filename);
+      return 1;
+    }
+    for (int64_t v = 1; v <= 3 && !result; v++) {
+      // Every value of the file changes, a, e.c, e.s, k0 to k199 and b.
+      if (v > 1 && (write_version(filename, v) ||
+		    r.reload([&](const Change &change) { changes += change.old_key != NULL; }) ||
+		    changes != 204 * (size_t)(v - 1)))
+	result = 1;
+      Reloader::Guard guard(reader);
+      if (a.get<int64_t>(-1) != v || s.get<string>("") != "v" + to_string(v) ||
+	  a.key() != guard->find_key("a"))
+	result = 1;
+    }
+    // The replaced versions are freed while the handles are kept.
+    r.reclaim();
+    if (r.retired())
+      result = 1;
+  }
+  if (result)
+    cout << "ERROR: handle\n";
+  unlink(filename);
+  return result;
+}
+
+int main() {
+  if (check_stress() || check_handle())
+    return 1;
+  cout << "OK\n";
+  return 0;
+}
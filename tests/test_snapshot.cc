@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <iostream>
+#include <string>
+#include "../src/confslice.h"
+#include "util.h"
+
+using namespace std;
+
+// Prints a key of a snapshot.
+template <typename K>
+static string snap_key_str(const K *key) {
+  string out = string(key->id()) + "=";
+  int64_t i;
+  double d;
+  string_view sv;
+
+  if (key->type() == Key::value_t) {
+    out += key->value()->data_str();
+  } else if (key->type() == Key::array_t) {
+    for (int32_t n = 0; n < key->size(); n++) {
+      if (!key->at(n, i))
+	out += to_string(i) + ",";
+      else if (!key->at(n, d))
+	out += to_string(d) + ",";
+      else if (!key->at(n, sv))
+	out += string(sv) + ",";
+    }
+  } else if (key->type() == Key::list_t) {
+    out += list_str(*key->list());
+  } else if (key->type() == Key::pairs_t) {
+    for (const SnapPair &p : key->pairs())
+      out += string(p.name()) + ":" + p.value().data_str() + ",";
+  }
+  return out + ";";
+}
+
+// Walks an entity of a snapshot.
+static string walk(const SnapEntity *entity) {
+  string out = string(entity->id()) + "{";
+  for (const SnapKey &key : entity->keys())
+    out += snap_key_str(&key);
+  for (const SnapEntity &sub : entity->entities())
+    out += walk(&sub);
+  return out + "}";
+}
+
+static const char text[] =
+  "e: { v = 5; l = <1, 2, <3>, <4, <5, \"x\">>>; p = { a = 1; b = \"x\" }; n: { x = 1; }; };\n"
+  "data_server: { disk.1: { journal_size = 10000; }; };\n"
+  "ints = [1, -2, 3]; doubles = [0.5, 1.5]; mixed = [1, 2.5, \"c\"]; s = \"Nick Nick\";\n";
+static const string expected =
+  "{ints=1,-2,3,;doubles=0.500000,1.500000,;mixed=1,2.500000,c,;s=Nick Nick;"
+  "e{v=5;l=1,2,<3,><4,<5,x,>>;p=a:1,b:x,;n{x=1;}}data_server{disk.1{journal_size=10000;}}}";
+
+// A snapshot holds the same tree and answers the same queries.
+static int32_t check_roundtrip() {
+  ConfSlice cs;
+  string out;
+  Snapshot snapshot;
+
+  if (cs.analyze_buffer(text) || Snapshot::compile(cs.configuration(), out)) {
+    cout << "ERROR: compile\n";
+    return 1;
+  }
+  if (snapshot.open_buffer(out.data(), out.size()) || walk(snapshot.root()) != expected) {
+    cout << "ERROR: roundtrip: " << walk(snapshot.root()) << "\n";
+    return 1;
+  }
+  Span<int64_t> ints;
+  Span<double> doubles;
+  if (snapshot.get<int64_t>("data_server.\"disk.1\".journal_size", 0) != 10000 ||
+      snapshot.get<int32_t>(Path("e.v"), 0) != 5 ||
+      snapshot.get<string_view>("s", "") != "Nick Nick" || snapshot.get<int64_t>("s", 7) != 7 ||
+      snapshot.get<int64_t>("e.n", 7) != 7 || snapshot.find_path("e.missing") ||
+      snapshot.find_entity_path("data_server.\"disk.1\"") !=
+      snapshot.find_entity("data_server")->find_entity("disk.1") ||
+      snapshot.find_key("ints")->as_int64_span(ints) || ints.size() != 3 || ints[1] != -2 ||
+      snapshot.find_key("doubles")->as_double_span(doubles) || doubles[1] != 1.5 ||
+      snapshot.size_of_keys() != 4 || snapshot.size_of_entities() != 2) {
+    cout << "ERROR: queries\n";
+    return 1;
+  }
+  return 0;
+}
+
+// Entities with many keys get hash tables.
+static int32_t check_large() {
+  ConfSlice cs;
+  string config = "big: {\n", out;
+  Snapshot snapshot;
+  const int32_t n = 1000;
+
+  for (int32_t i = 0; i < n; i++)
+    config += "k" + to_string(i) + " = " + to_string(i) + "; e" + to_string(i) + ": { v = 1; };\n";
+  config += "};\n";
+  if (cs.analyze_buffer(config) || Snapshot::compile(cs.configuration(), out) ||
+      snapshot.open_buffer(out.data(), out.size())) {
+    cout << "ERROR: compile\n";
+    return 1;
+  }
+  const SnapEntity *big = snapshot.find_entity("big");
+  for (int32_t i = 0; i < n; i++) {
+    string id = to_string(i);
+    if (snapshot.get<int32_t>("big.k" + id, -1) != i || !big->find_entity("e" + id) ||
+	big->keys()[i].id() != "k" + id) {
+      cout << "ERROR: find " << i << "\n";
+      return 1;
+    }
+  }
+  if (big->find_key("k1000") || big->find_entity("k1")) {
+    cout << "ERROR: find missing\n";
+    return 1;
+  }
+  return 0;
+}
+
+// Snapshot files are mapped, and damaged snapshots are rejected.
+static int32_t check_file() {
+  ConfSlice cs;
+  char filename[] = "/tmp/test_snapshot_XXXXXX";
+  int fd = mkstemp(filename);
+  string out;
+
+  if (fd < 0 || cs.analyze_buffer(text) || Snapshot::compile(cs.configuration(), string(filename))) {
+    cout << "ERROR: compile\n";
+    return 1;
+  }
+  ::close(fd);
+  {
+    Snapshot snapshot;
+    if (snapshot.open(filename) || walk(snapshot.root()) != expected) {
+      cout << "ERROR: open\n";
+      unlink(filename);
+      return 1;
+    }
+  }
+  unlink(filename);
+
+  Snapshot::compile(cs.configuration(), out);
+  Snapshot snapshot;
+  string damaged = out;
+  damaged[damaged.size() - 2] ^= 1;
+  if (!snapshot.open_buffer(damaged.data(), damaged.size()) ||
+      snapshot.open_buffer(damaged.data(), damaged.size(), false) ||
+      !snapshot.open_buffer(out.data(), out.size() - 8) ||
+      !snapshot.open_buffer(text, sizeof(text)) || snapshot.find_key("s") ||
+      snapshot.get<int32_t>("e.v", 3) != 3) {
+    cout << "ERROR: validation\n";
+    return 1;
+  }
+  return 0;
+}
+
+int main() {
+  if (check_roundtrip() || check_large() || check_file())
+    return 1;
+  cout << "OK\n";
+  return 0;
+}
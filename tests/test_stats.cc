@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <iostream>
+#include <string>
+#include "../src/confslice.h"
+#include "../src/stats.h"
+
+using namespace std;
+
+static const char text[] =
+  "// Servers.\n"
+  "server: { port = 7000; ports = [1, 2]; l = <1, <2>>; p = { a = 1 };\n"
+  "\tdisk: { size = 1.5; name = \"x\"; }; port = 1; };\n"
+  "server: { x = 1; };\n"
+  "top = 1;\n";
+
+// The statistics count what was parsed, or stay empty when not built in.
+static int32_t check_stats(const ParseStats &stats, const string &name) {
+  string dump = stats.dump();
+  if (!ParseStats::enabled) {
+    if (stats.bytes || stats.entities || stats.total_ns ||
+	dump.find("confslice_stats_enabled 0\n") != 0) {
+      cout << "ERROR: " << name << " disabled stats:\n" << dump;
+      return 1;
+    }
+    return 0;
+  }
+
+  uint64_t tokens = 0, phases = 0;
+  for (size_t i = 0; i < ParseStats::token_kinds; i++)
+    tokens += stats.tokens[i];
+  for (size_t i = 0; i < ParseStats::phases; i++)
+    phases += stats.ns[i];
+  if (stats.bytes != sizeof(text) - 1 || stats.tokens[0] != 13 || stats.tokens[2] != 1 ||
+      stats.tokens[3] != 1 || tokens != 65 || stats.entities != 3 || stats.duplicates != 2 ||
+      stats.keys[Key::value_t] != 6 || stats.keys[Key::array_t] != 1 ||
+      stats.keys[Key::list_t] != 1 || stats.keys[Key::pairs_t] != 1 || stats.max_depth != 2 ||
+      !stats.allocations || !stats.ns[ParseStats::lex_phase] || !stats.total_ns ||
+      phases > stats.total_ns + ParseStats::phases) {
+    cout << "ERROR: " << name << " stats:\n" << dump;
+    return 1;
+  }
+  if (dump.find("confslice_stats_enabled 1\n") != 0 ||
+      dump.find("\nconfslice_keys_value 6\n") == string::npos ||
+      dump.find("\nconfslice_tokens_id 13\n") == string::npos) {
+    cout << "ERROR: " << name << " dump:\n" << dump;
+    return 1;
+  }
+  return 0;
+}
+
+int main() {
+  char filename[] = "/tmp/test_stats_XXXXXX";
+  int fd = mkstemp(filename);
+  if (fd < 0 || write(fd, text, sizeof(text) - 1) != (ssize_t)sizeof(text) - 1) {
+    cout << "ERROR: write\n";
+    return 1;
+  }
+  close(fd);
+
+  ConfSlice heap, arena(ConfSlice::arena_mem);
+  int32_t result = heap.analyze(filename) || arena.analyze_buffer(text);
+  unlink(filename);
+  if (result || heap.configuration()->get<int32_t>("server.port", 0) != 7000) {
+    cout << "ERROR: analysis\n";
+    return 1;
+  }
+  if (check_stats(heap.stats(), "file") || check_stats(arena.stats(), "buffer"))
+    return 1;
+  if (ParseStats::enabled && !heap.stats().ns[ParseStats::io_phase]) {
+    cout << "ERROR: no I/O time\n";
+    return 1;
+  }
+  cout << "OK\n";
+  return 0;
+}
@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../src/confslice.h"
+#include "../src/trace.h"
+
+using namespace std;
+
+static const char text[] =
+  "server: { port = 7000; name = \"x\"; disk: { size = 1; }; };\n"
+  "client: { port = 1; };\n"
+  "top = 1;\n";
+
+static uint64_t sum(const uint64_t *values, const size_t count) {
+  uint64_t total = 0;
+  for (size_t i = 0; i < count; i++)
+    total += values[i];
+  return total;
+}
+
+// Threads count on their own and the report adds them up.
+static int32_t check_threads(const Configuration *conf) {
+  AccessTrace trace(1), other;
+  AccessTrace::Report report;
+
+  conf->get<int32_t>("server.port", 0);
+  if (trace.start() || !trace.started() || other.start() != 1) {
+    cout << "ERROR: start\n";
+    return 1;
+  }
+  vector<thread> threads;
+  for (int32_t t = 0; t < 4; t++) {
+    threads.push_back(thread([conf]() {
+      for (int32_t i = 0; i < 1000; i++)
+	conf->get<int32_t>("server.port", 0);
+      Handle handle = conf->handle("server.disk.size");
+      for (int32_t i = 0; i < 10; i++)
+	handle.get<int32_t>(0);
+      conf->find_entity("client")->find_key("port");
+      conf->find_entity("server")->find_entity("disk");
+      conf->find_key("missing");
+    }));
+  }
+  for (thread &t : threads)
+    t.join();
+  trace.stop();
+  conf->get<int32_t>("server.port", 0);
+
+  trace.report(conf, report);
+  if (report.reads.size() != 3 || report.reads[0].path != "server.port" ||
+      report.reads[0].reads != 4000 || report.reads[1].path != "server.disk.size" ||
+      report.reads[1].reads != 40 || report.reads[2].path != "client.port" ||
+      report.not_looked_up.size() != 2 || report.not_looked_up[0] != "top" ||
+      report.not_looked_up[1] != "server.name") {
+    cout << "ERROR: reads\n" << report.str();
+    return 1;
+  }
+  // Lookups of entities count too, but the segments of a path do not.
+  if (report.lookups[AccessTrace::path_l] != 4004 || report.lookups[AccessTrace::entity_l] != 12 ||
+      report.lookups[AccessTrace::key_l] != 8 || report.timed[AccessTrace::path_l] != 4004 ||
+      report.timed[AccessTrace::entity_l] != 12 || report.timed[AccessTrace::key_l] != 8 ||
+      sum(report.histogram[AccessTrace::path_l], AccessTrace::buckets) != 4004 ||
+      report.bucket_ns[1] <= report.bucket_ns[0]) {
+    cout << "ERROR: lookups\n" << report.str();
+    return 1;
+  }
+  if (report.str().find("# reads\n4000 server.port\n") == string::npos) {
+    cout << "ERROR: str\n" << report.str();
+    return 1;
+  }
+  return 0;
+}
+
+// A thread that reads many keys grows its table, and sampling times a
+// share of the lookups.
+static int32_t check_many() {
+  string many;
+  for (int32_t i = 0; i < 2000; i++)
+    many += "k" + to_string(i) + " = " + to_string(i) + ";\n";
+  ConfSlice cs;
+  if (cs.analyze_buffer(many)) {
+    cout << "ERROR: analysis\n";
+    return 1;
+  }
+  const Configuration *conf = cs.configuration()->freeze();
+  AccessTrace trace(10);
+  AccessTrace::Report report;
+  trace.start();
+  for (int32_t i = 0; i < 2000; i++)
+    for (int32_t j = 0; j <= i % 3; j++)
+      conf->get<int32_t>("k" + to_string(i), -1);
+  trace.report(conf, report);
+  uint64_t reads = 0;
+  for (const AccessTrace::Read &read : report.reads)
+    reads += read.reads;
+  if (report.reads.size() != 2000 || !report.not_looked_up.empty() || reads != 3999 ||
+      report.reads[0].reads != 3 || report.reads[1999].reads != 1 ||
+      report.timed[AccessTrace::path_l] != 399) {
+    cout << "ERROR: many\n";
+    return 1;
+  }
+  return 0;
+}
+
+int main() {
+  ConfSlice cs;
+  if (cs.analyze_buffer(text)) {
+    cout << "ERROR: analysis\n";
+    return 1;
+  }
+  const Configuration *conf = cs.configuration()->freeze();
+  if (check_threads(conf) || check_many())
+    return 1;
+  cout << "OK\n";
+  return 0;
+}
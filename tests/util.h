@@ -0,0 +1,74 @@
+#ifndef TESTS_UTIL_H
+#define TESTS_UTIL_H
+
+#include <stddef.h>
+#include <memory_resource>
+#include <string>
+#include "../src/confslice.h"
+
+// Prints a list and its sub-lists, of a tree or of a snapshot.
+template <typename L>
+static std::string list_str(const L &klist) {
+  std::string out;
+  for (const auto &data : klist.data())
+    out += data.data_str() + ",";
+  for (const auto &sub : klist.klists())
+    out += "<" + list_str(sub) + ">";
+  return out;
+}
+
+// Prints a key of the tree as "<id>=<contents>;".
+static inline std::string key_str(const Key *key) {
+  std::string out = std::string(key->id()) + "=";
+
+  if (key->type() == Key::value_t) {
+    out += ((const KValue *)key)->value().data_str();
+  } else if (key->type() == Key::array_t) {
+    const KArray *array = (const KArray *)key;
+    int64_t i;
+    double d;
+    std::string_view sv;
+    for (int32_t n = 0; n < array->size(); n++) {
+      if (!array->at(n, i))
+	out += std::to_string(i) + ",";
+      else if (!array->at(n, d))
+	out += std::to_string(d) + ",";
+      else if (!array->at(n, sv))
+	out += std::string(sv) + ",";
+    }
+  } else if (key->type() == Key::list_t) {
+    out += list_str(*(const KList *)key);
+  } else if (key->type() == Key::pairs_t) {
+    for (const KPairs::Pair &p : ((const KPairs *)key)->pairs())
+      out += std::string(p.first) + ":" + p.second.data_str() + ",";
+  }
+  return out + ";";
+}
+
+// Counts the bytes and the allocations that are still held, and the most
+// bytes ever held.
+class CountingResource : public std::pmr::memory_resource {
+ public:
+  size_t bytes = 0;
+  size_t allocations = 0;
+  size_t peak = 0;
+
+ private:
+  void *do_allocate(size_t size, size_t align) override {
+    bytes += size;
+    allocations++;
+    if (bytes > peak)
+      peak = bytes;
+    return std::pmr::new_delete_resource()->allocate(size, align);
+  }
+  void do_deallocate(void *p, size_t size, size_t align) override {
+    bytes -= size;
+    allocations--;
+    std::pmr::new_delete_resource()->deallocate(p, size, align);
+  }
+  bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+};
+
+#endif
@@ -0,0 +1,42 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Confslice - A simple configuration file parser.
+ *
+ * Copyright (C) 2014 Giorgos Kappes <geokapp@gmail.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file LICENSE.
+ *
+ */
+
+/*
+ * Compiles a configuration file into a snapshot that can be loaded with
+ * Snapshot::open() without parsing it.
+ *
+ * Usage: confslice-compile <configuration> <snapshot>
+ */
+
+#include <stdio.h>
+#include "../src/confslice.h"
+
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s <configuration> <snapshot>\n", argv[0]);
+    return 1;
+  }
+
+  ConfSlice cs(ConfSlice::arena_mem);
+  if (cs.analyze(argv[1]))
+    return 1;
+  if (Snapshot::compile(cs.configuration(), argv[2]))
+    return 1;
+
+  // Load it back to catch a short write.
+  Snapshot snapshot;
+  if (snapshot.open(argv[2]))
+    return 1;
+  return 0;
+}
@@ -0,0 +1,61 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Confslice - A simple configuration file parser.
+ *
+ * Copyright (C) 2014 Giorgos Kappes <geokapp@gmail.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file LICENSE.
+ *
+ */
+
+/*
+ * Writes a deterministic synthetic configuration, for benchmarks and for
+ * reproducing reports.
+ *
+ * Usage: confslice-gen [-e entities] [-d depth] [-c children] [-k keys]
+ *                      [-a elements] [-m comment %] [-s string length]
+ *                      [-S seed] [output]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include "../bench/generate.h"
+
+int main(int argc, char *argv[]) {
+  GenOptions options;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "e:d:c:k:a:m:s:S:")) != -1) {
+    switch (opt) {
+    case 'e': options.entities = atoi(optarg); break;
+    case 'd': options.depth = atoi(optarg); break;
+    case 'c': options.children = atoi(optarg); break;
+    case 'k': options.keys = atoi(optarg); break;
+    case 'a': options.elements = atoi(optarg); break;
+    case 'm': options.comments = atoi(optarg); break;
+    case 's': options.string_length = atoi(optarg); break;
+    case 'S': options.seed = strtoull(optarg, NULL, 10); break;
+    default:
+      fprintf(stderr, "Usage: %s [-e entities] [-d depth] [-c children] [-k keys] "
+	      "[-a elements] [-m comment %%] [-s string length] [-S seed] [output]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  std::string text = generate_config(options);
+  FILE *f = optind < argc ? fopen(argv[optind], "w") : stdout;
+  if (!f) {
+    fprintf(stderr, "Cannot open %s\n", argv[optind]);
+    return 1;
+  }
+  size_t n = fwrite(text.data(), 1, text.size(), f);
+  if (f != stdout)
+    n = fclose(f) ? 0 : n;
+  return n == text.size() ? 0 : 1;
+}
@@ -0,0 +1,81 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Confslice - A simple configuration file parser.
+ *
+ * Copyright (C) 2014 Giorgos Kappes <geokapp@gmail.com>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file LICENSE.
+ *
+ */
+
+/*
+ * Parses a configuration file and prints the memory its tree holds, by
+ * kind of node, by part and by top-level entity or key, the largest
+ * first. With -a the tree is allocated in an arena instead of the heap.
+ *
+ * Usage: confslice-mem [-a] [-n count] file
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "../src/confslice.h"
+#include "../src/memory.h"
+
+static double percent(const uint64_t part, const uint64_t total) {
+  return total ? 100.0 * part / total : 0.0;
+}
+
+int main(int argc, char *argv[]) {
+  ConfSlice::Memory memory = ConfSlice::heap_mem;
+  size_t count = 10;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "an:")) != -1) {
+    switch (opt) {
+    case 'a': memory = ConfSlice::arena_mem; break;
+    case 'n': count = strtoul(optarg, NULL, 10); break;
+    default:
+      fprintf(stderr, "Usage: %s [-a] [-n count] file\n", argv[0]);
+      return 1;
+    }
+  }
+  if (optind != argc - 1) {
+    fprintf(stderr, "Usage: %s [-a] [-n count] file\n", argv[0]);
+    return 1;
+  }
+
+  ConfSlice cs(memory);
+  if (cs.analyze(argv[optind])) {
+    fprintf(stderr, "Cannot parse %s\n", argv[optind]);
+    return 1;
+  }
+  MemoryUsage usage;
+  memory_usage(cs.configuration(), usage);
+
+  printf("%s: %llu bytes in %llu allocations (%s)\n\n", argv[optind],
+	 (unsigned long long)usage.total, (unsigned long long)usage.allocations,
+	 memory == ConfSlice::arena_mem ? "arena" : "heap");
+  printf("%-14s %10s %12s %7s\n", "kind", "nodes", "bytes", "%");
+  for (size_t i = 0; i < MemoryUsage::kinds; i++)
+    printf("%-14s %10llu %12llu %6.2f%%\n", MemoryUsage::kind_name(i),
+	   (unsigned long long)usage.nodes[i], (unsigned long long)usage.bytes[i],
+	   percent(usage.bytes[i], usage.total));
+  printf("\n%-14s %10s %12s %7s\n", "part", "", "bytes", "%");
+  for (size_t i = 0; i < MemoryUsage::parts; i++)
+    printf("%-14s %10s %12llu %6.2f%%\n", MemoryUsage::part_name(i), "",
+	   (unsigned long long)usage.part_bytes[i], percent(usage.part_bytes[i], usage.total));
+
+  std::vector<MemoryUsage::Consumer> top = usage.top(count);
+  printf("\n%-32s %-7s %10s %12s %7s\n", "top consumers", "", "nodes", "bytes", "%");
+  for (const MemoryUsage::Consumer &c : top)
+    printf("%-32s %-7s %10llu %12llu %6.2f%%\n", c.id.c_str(), c.entity ? "entity" : "key",
+	   (unsigned long long)c.nodes, (unsigned long long)c.bytes, percent(c.bytes, usage.total));
+  return 0;
+}